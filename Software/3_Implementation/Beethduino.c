@@ -16,9 +16,28 @@
 *                   Compiled in Arduino IDE, version 1.6.13
 *
 *   Dependencies:   LiquidCrystal.h (Library required to handle an LCD).     
+*                   avr/sleep.h (Sleep modes of the AVR).
 *
 *   Notes:          BPM - Beats Per Minute.
 *                   LCD - Liquid Crystal Display.
+*                   Timer1 is used as time base (one tick every millisecond).
+*                   Its timed events (sounds, beats, debouncing, holding of 
+*                   the buttons) are the timers of a timing wheel.
+*                   Between the events, the CPU sleeps (idle mode) until the
+*                   next tick or button edge.
+*                   The pins, BPM bounds and sound duration are fixed at 
+*                   compile time by the BoardConfig typedef.
+*                   The buttons are debounced in the Timer1 interrupt, 
+*                   activated by the pin change interrupt 0 (pins 9 to 13 
+*                   are PCINT1 to PCINT5, in the port B).
+*                   The restart button, held (long pressing), selects the 
+*                   time signature; the first beat of every bar is accented.
+*                   The modifier button, held, selects the subdivision of 
+*                   the beat (clicks between the beats).
+*                   The mute button, held, starts the tempo map (a program 
+*                   of tempo changes on the bar boundaries). The tempo map
+*                   can add polyrhythm voices (i.e: 3 against 4), in the
+*                   buzzer or in pins of their own.
 *
 *   Author:         Alberto Martin Cajal
 *                   amartin.glimpse23@gmail.com
@@ -31,241 +50,2872 @@
 *******************************************************************************/
 
 #include <LiquidCrystal.h>
+#include <avr/sleep.h>
 
-const int MUTE_BUZZER_BUTTON_PIN        = 13;              
-const int CHANGE_BPM_BY_TEN_BUTTON_PIN  = 12;                                             
-const int CHANGE_BPM_BY_ONE_BUTTON_PIN  = 11;                                        
-const int ADD_OR_SUB_BPM_BUTTON_PIN     = 10;       
-const int RESTART_BPM_BUTTON_PIN        = 9;    
-const int ACTIVE_BUZZER_PIN             = 8;    
+/*  Board configuration, fixed at compile time: pin layout (the buttons, 
+*   the buzzer, the LCD, the digital pins of the port B, and the outputs of
+*   the polyrhythm voices), BPM bounds and sound duration. Every value is a
+*   constant expression, so no RAM is used and the pin accesses are folded 
+*   into single port instructions. A board variant is one more 
+*   configuration struct, selected by the BoardConfig typedef; the layout 
+*   is checked below (static_assert).
+*/
+struct UnoBoardConfig
+{
+    static const byte MUTE_BUZZER_BUTTON_PIN        = 13;
+    static const byte CHANGE_BPM_BY_TEN_BUTTON_PIN  = 12;
+    static const byte CHANGE_BPM_BY_ONE_BUTTON_PIN  = 11;
+    static const byte ADD_OR_SUB_BPM_BUTTON_PIN     = 10;
+    static const byte RESTART_BPM_BUTTON_PIN        = 9;
+    static const byte ACTIVE_BUZZER_PIN             = 8;
+    
+    static const byte LCD_RS_PIN                    = 2;
+    static const byte LCD_ENABLE_PIN                = 3;
+    static const byte LCD_D4_PIN                    = 4;
+    static const byte LCD_D5_PIN                    = 5;
+    static const byte LCD_D6_PIN                    = 6;
+    static const byte LCD_D7_PIN                    = 7;
+    
+    static const byte PORTB_FIRST_PIN               = 8;  /* Pin of PB0. */
+    static const byte PORTB_LAST_PIN                = 13; /* Pin of PB5. */
+    
+    static const byte FIRST_VOICE_PIN               = A0; /* LED. */
+    static const byte TONE_VOICE_PIN                = A1; /* Passive buzzer. */
+    static const byte SECOND_VOICE_PIN              = A2; /* LED. */
+    
+    static const int BPM_UPPER_BOUND                = 300;
+    static const int BPM_LOWER_BOUND                = 1;
+    
+    static const int SOUND_DURATION                 = 25; /* In Milliseconds. */
+    static const int ACCENT_SOUND_DURATION          = 40; /* In Milliseconds. */
+    static const int SUBDIVISION_SOUND_DURATION     = 10; /* In Milliseconds. */
+};
+
+typedef UnoBoardConfig BoardConfig;
+
+const int MUTE_BUZZER_BUTTON_PIN    = BoardConfig::MUTE_BUZZER_BUTTON_PIN;
+const int CHANGE_BPM_BY_TEN_BUTTON_PIN 
+    = BoardConfig::CHANGE_BPM_BY_TEN_BUTTON_PIN;
+const int CHANGE_BPM_BY_ONE_BUTTON_PIN 
+    = BoardConfig::CHANGE_BPM_BY_ONE_BUTTON_PIN;
+const int ADD_OR_SUB_BPM_BUTTON_PIN = BoardConfig::ADD_OR_SUB_BPM_BUTTON_PIN;
+const int RESTART_BPM_BUTTON_PIN    = BoardConfig::RESTART_BPM_BUTTON_PIN;
+const int ACTIVE_BUZZER_PIN         = BoardConfig::ACTIVE_BUZZER_PIN;
+
+/*  Pin of the port B (the digital pins of the board from PORTB_FIRST_PIN 
+*   to PORTB_LAST_PIN), with its bit in PINB and PORTB. The writes are "sbi"
+*   and "cbi" (2 cycles) instead of digitalWrite (about 56 cycles, with the 
+*   pin looked up in tables).
+*/
+const int PORTB_FIRST_PIN           = BoardConfig::PORTB_FIRST_PIN;
+const int PORTB_LAST_PIN            = BoardConfig::PORTB_LAST_PIN;
+
+template <int PIN>
+struct PortBPin
+{
+    static_assert((PIN >= PORTB_FIRST_PIN) && (PIN <= PORTB_LAST_PIN),
+                  "The pin is not in the port B.");
+    
+    static const byte BIT = 1 << (PIN - PORTB_FIRST_PIN);
+    
+    static void set_high()
+    {
+        PORTB |= BIT;
+    }
+    
+    static void set_low()
+    {
+        PORTB &= ~BIT;
+    }
+};
+
+LiquidCrystal lcd(BoardConfig::LCD_RS_PIN, BoardConfig::LCD_ENABLE_PIN,
+                  BoardConfig::LCD_D4_PIN, BoardConfig::LCD_D5_PIN,
+                  BoardConfig::LCD_D6_PIN, BoardConfig::LCD_D7_PIN);
+
+/*  The LCD is drawn in lcd_frame, and only the characters that differ from
+*   lcd_shown_frame (shadow copy of the display) are sent. lcd.clear() is 
+*   never called: it takes about 2 milliseconds, and the whole display had 
+*   to be rewritten after it.
+*   The characters are not sent by update_lcd(), but by the main loop, 
+*   LCD_BYTES_PER_SLICE bytes per iteration (every byte blocks about 250 
+*   microseconds in the LiquidCrystal library), so a redraw never delays the
+*   attention of the buttons more than one slice.
+*/
+const byte LCD_COLUMNS              = 16;
+const byte LCD_ROWS                 = 2;
+const byte LCD_CELLS                = LCD_COLUMNS * LCD_ROWS;
+const byte LCD_NO_CELL              = 0xFF;
+const byte LCD_BYTES_PER_SLICE      = 2;    /* setCursor and one character. */
+
+char lcd_frame[LCD_ROWS][LCD_COLUMNS];
+char lcd_shown_frame[LCD_ROWS][LCD_COLUMNS];
+byte lcd_next_cell;         /*  Next cell to compare (row * LCD_COLUMNS + 
+                            *   column), or LCD_CELLS when all are sent.
+                            */
+byte lcd_address_cell;      /*  Cell of the LCD address counter, or 
+                            *   LCD_NO_CELL if setCursor is required.
+                            */
+
+/*  Texts of the LCD, in the flash memory (PROGMEM): the string literals are
+*   copied to the RAM at start-up. The BPM is formatted in a stack buffer;
+*   no String is used, so the heap is never used.
+*/
+const char MUTE_TEXT[] PROGMEM      = "MUTE_MUTE_MUTE_";
+const char ADD_BPM_TEXT[] PROGMEM   = "ADD BPM: ";
+const char SUB_BPM_TEXT[] PROGMEM   = "SUB BPM: ";
+const byte NUMBER_TEXT_SIZE         = 6;    /* 65535 and '\0'. */
+
+const int BPM_UPPER_BOUND           = BoardConfig::BPM_UPPER_BOUND;
+const int BPM_LOWER_BOUND           = BoardConfig::BPM_LOWER_BOUND;
+
+const int SOUND_DURATION            = BoardConfig::SOUND_DURATION;
+const int ACCENT_SOUND_DURATION     = BoardConfig::ACCENT_SOUND_DURATION;
+const int SUBDIVISION_SOUND_DURATION 
+    = BoardConfig::SUBDIVISION_SOUND_DURATION;
+
+const unsigned int MILLISECONDS_IN_MINUTE = 60000;  /*  Integer type: no
+                                                    *   floating point math
+                                                    *   (no FPU in the AVR).
+                                                    */
+
+/*  Table of beat periods (required iterations) for every BPM value, 
+*   generated at compile time and stored in the flash memory (PROGMEM). 
+*   BpmSequence holds the BPM values from BPM_LOWER_BOUND to BPM_UPPER_BOUND;
+*   BeatPeriodTable expands it into one MILLISECONDS_IN_MINUTE / bpm per BPM.
+*   In this way, no division is executed when the BPM is changed.
+*/
+template <unsigned int... BPM_VALUES>
+struct BpmSequence
+{
+};
+
+template <unsigned int FIRST_BPM, unsigned int LAST_BPM, 
+          unsigned int... BPM_VALUES>
+struct MakeBpmSequence 
+    : MakeBpmSequence<FIRST_BPM, LAST_BPM - 1, LAST_BPM, BPM_VALUES...>
+{
+};
+
+template <unsigned int FIRST_BPM, unsigned int... BPM_VALUES>
+struct MakeBpmSequence<FIRST_BPM, FIRST_BPM, BPM_VALUES...>
+{
+    typedef BpmSequence<FIRST_BPM, BPM_VALUES...> type;
+};
+
+template <typename BPM_SEQUENCE>
+struct BeatPeriodTable;
+
+template <unsigned int... BPM_VALUES>
+struct BeatPeriodTable< BpmSequence<BPM_VALUES...> >
+{
+    static const unsigned int required_iterations[sizeof...(BPM_VALUES)];
+};
+
+template <unsigned int... BPM_VALUES>
+const unsigned int BeatPeriodTable< BpmSequence<BPM_VALUES...> >
+    ::required_iterations[sizeof...(BPM_VALUES)] PROGMEM =
+{
+    (MILLISECONDS_IN_MINUTE / BPM_VALUES)...
+};
+
+typedef BeatPeriodTable< 
+            MakeBpmSequence<BPM_LOWER_BOUND, BPM_UPPER_BOUND>::type > 
+        BeatPeriods;
+
+/*  Time signatures (stored in the flash memory), selected in turn by the 
+*   long pressing of the restart button, and shown at the end of the second
+*   row of the LCD. The first beat of every bar (downbeat) is accented: its
+*   sound lasts ACCENT_SOUND_DURATION instead of SOUND_DURATION.
+*   The position in the bar is a counter, set back to 0 when it reaches the
+*   beats of the bar: one increment and one comparison per beat, with no 
+*   division nor table read in the timer interrupt.
+*/
+struct TimeSignature
+{
+    byte beats_per_bar;
+    char text[4];   /* i.e: "4/4" and '\0'. */
+};
+
+const TimeSignature TIME_SIGNATURES[] PROGMEM = 
+{
+    {2, "2/4"},
+    {3, "3/4"},
+    {4, "4/4"},
+    {6, "6/8"},
+    {7, "7/8"}
+};
+const byte TIME_SIGNATURES_COUNT    = sizeof(TIME_SIGNATURES) 
+                                      / sizeof(TIME_SIGNATURES[0]);
+const byte DEFAULT_TIME_SIGNATURE   = 2;    /* 4/4. */
+const byte TIME_SIGNATURE_COLUMN    = LCD_COLUMNS - 3;
+
+/*  Subdivisions of the beat (stored in the flash memory), selected in turn
+*   by the long pressing of the modifier button, and shown at the end of the
+*   first row of the LCD (clicks per beat). The sub-beat clicks sound 
+*   SUBDIVISION_SOUND_DURATION. 
+*   The beats keep their own schedule; every beat schedules its sub-beats 
+*   from its own period (bpm_freq_req_iter, or one tick more), so the 
+*   sub-beats never drift from the beats, i.e: triplets. The step is
+*   floor(period / clicks_per_beat), obtained in the main loop with the
+*   multiplier of the table (ceil(2^17 / clicks_per_beat), exact for every
+*   period up to 60000 ticks), instead of a division; the fraction of the
+*   step is accumulated as the fraction of the beat period.
+*/
+struct Subdivision
+{
+    byte clicks_per_beat;
+    unsigned long period_multiplier;    /* 0 without subdivision. */
+    char text[2];   /* i.e: "3" (triplets) and '\0'. */
+};
+
+const Subdivision SUBDIVISIONS[] PROGMEM = 
+{
+    {1, 0,      "1"},
+    {2, 65536,  "2"},
+    {3, 43691,  "3"},
+    {4, 32768,  "4"}
+};
+const byte SUBDIVISIONS_COUNT       = sizeof(SUBDIVISIONS) 
+                                      / sizeof(SUBDIVISIONS[0]);
+const byte DEFAULT_SUBDIVISION      = 0;    /* Only the beats. */
+const byte MAX_CLICKS_PER_BEAT      = 4;
+const byte SUBDIVISION_PERIOD_SHIFT = 17;
+const byte SUBDIVISION_COLUMN       = LCD_COLUMNS - 1;
+
+static_assert(ACCENT_SOUND_DURATION 
+              < (MILLISECONDS_IN_MINUTE 
+                 / (BPM_UPPER_BOUND * MAX_CLICKS_PER_BEAT)),
+              "The accented sound must end before the next sub-beat.");
+static_assert(SUBDIVISION_SOUND_DURATION < SOUND_DURATION,
+              "The sub-beats must sound shorter than the beats.");
+
+/*  Polyrhythm voices (stored in the flash memory), selected by the tempo
+*   map (TEMPO_MAP_VOICES). Every voice plays its pulses, evenly spaced,
+*   against beats of the metronome (i.e: 3 against 4), with its own accents
+*   and output:
+*   - VOICE_OUTPUT_BUZZER: pulses of the buzzer, told apart by their length.
+*   - VOICE_OUTPUT_PIN: pulses of a pin of its own (i.e: a LED, or a second
+*     active buzzer).
+*   - VOICE_OUTPUT_TONE: tone() in a pin of its own (a passive buzzer).
+*     Timer2 generates one tone at a time: one tone voice sounds at a time.
+*   The sound of a voice must end before its next pulse. The cycles of the
+*   voices start together when they are selected, in a beat, and every voice
+*   is locked to the beats: the pulse i sounds in the beat
+*   floor(i * beats / pulses) of its cycle, floor(position * period /
+*   pulses) ticks after it, where position is (i * beats) mod pulses and
+*   period is the one of that beat (as the sub-beats). So the voices follow
+*   the tempo map and its smooth ramps, with no drift. The position advances
+*   by additions, and the division by pulses is done with the multiplier of
+*   VOICE_MULTIPLIERS, ceil(2^16 / pulses), and one correction.
+*   The upcoming events of all the voices (the next pulse of every voice,
+*   and the end of the sound of the pin outputs) are merged in a min-heap of
+*   VOICE_EVENTS_SIZE entries, ordered by deadline: every tick compares only
+*   the first deadline, whatever the number of voices, and an event costs
+*   log2(VOICE_EVENTS_SIZE) moves at most.
+*/
+const byte VOICE_OUTPUT_BUZZER      = 0;
+const byte VOICE_OUTPUT_PIN         = 1;
+const byte VOICE_OUTPUT_TONE        = 2;
+
+struct Voice
+{
+    byte pulses;            /* 1 to MAX_VOICE_PULSES. */
+    byte beats;             /* 1 to MAX_VOICE_PULSES. */
+    byte accents;           /* Bit i: the pulse i is accented. */
+    byte output;            /* VOICE_OUTPUT_BUZZER, _PIN or _TONE. */
+    byte pin;               /* VOICE_OUTPUT_PIN and VOICE_OUTPUT_TONE. */
+    byte sound_duration;            /* In Milliseconds. */
+    byte accent_sound_duration;     /* In Milliseconds. */
+    unsigned int tone_frequency;    /* In Hz (VOICE_OUTPUT_TONE). */
+};
+
+const Voice VOICES[] PROGMEM =
+{
+    {3, 4, 0x01, VOICE_OUTPUT_PIN, BoardConfig::FIRST_VOICE_PIN, 
+     20, 40, 0},                                        /* 3 against 4. */
+    {5, 7, 0x01, VOICE_OUTPUT_TONE, BoardConfig::TONE_VOICE_PIN, 
+     20, 40, 880},                                      /* 5 against 7. */
+    {2, 3, 0x01, VOICE_OUTPUT_BUZZER, 0, 15, 15, 0},    /* 2 against 3. */
+    {7, 4, 0x09, VOICE_OUTPUT_PIN, BoardConfig::SECOND_VOICE_PIN, 
+     10, 20, 0}                                         /* 7 (3 + 4). */
+};
+const byte VOICES_COUNT             = sizeof(VOICES) / sizeof(VOICES[0]);
+const byte ALL_VOICES_MASK          = (1 << VOICES_COUNT) - 1;
+const byte MAX_VOICE_PULSES         = 8;    /* Bits of the accents. */
+const byte VOICE_MULTIPLIER_SHIFT   = 16;
+
+const unsigned long VOICE_MULTIPLIERS[MAX_VOICE_PULSES + 1] PROGMEM =
+{
+    0, 65536, 32768, 21846, 16384, 13108, 10923, 9363, 8192
+};
+
+const byte VOICE_EVENTS_SIZE        = 2 * VOICES_COUNT; /*  One pulse and one
+                                                        *   end of sound per
+                                                        *   voice.
+                                                        */
+const byte VOICE_EVENT_OFF          = 0x80; /* Code of an end of sound. */
+
+static_assert(VOICES_COUNT <= 8, "The voices are the bits of a byte.");
+
+/*  Tempo map: a program of tempo changes (i.e: 4 bars at 80 BPM, then +5 
+*   BPM every 8 bars up to 140), stored in the flash memory and started by 
+*   the long pressing of the mute button. The BPM buttons, the restart, the
+*   mute and the time signature take the control back (the program stops).
+*   The program is a sequence of instructions: one opcode byte, followed by
+*   its operands (the words are little-endian). It is compiled on the host,
+*   from its text, by beethduino_host_compile_tempo_map:
+*   - TEMPO_MAP_PLAY bpm(2) bars(1): the bars at the BPM.
+*   - TEMPO_MAP_RAMP step(1, signed) bars(1) bpm(2): from the current BPM, 
+*     the BPM changes by step every bars, up to bpm (included).
+*   - TEMPO_MAP_TIME_SIGNATURE index(1): time signature of the next bars.
+*   - TEMPO_MAP_REPEAT: the program starts again.
+*   - TEMPO_MAP_END: the last tempo is kept.
+*   - TEMPO_MAP_LINEAR_RAMP bars(1) bpm(2): accelerando or ritardando, beat
+*     by beat, from the current BPM to bpm (reached in the next downbeat):
+*     the period changes by the same number of ticks in every beat.
+*   - TEMPO_MAP_EXPONENTIAL_RAMP bars(1) bpm(2): the same, but the period 
+*     changes by the same ratio in every beat.
+*   - TEMPO_MAP_VOICES mask(1): polyrhythm voices of the next bars (bit v: 
+*     VOICES[v]; 0 for none). A program starts without voices, and they go
+*     on after its end, until the restart button.
+*   The main loop interprets the next segment (bars at one BPM) in advance,
+*   and stages its period, read from the BeatPeriods table. The timer 
+*   interrupt switches to it in the downbeat where the bars of the current 
+*   segment end, before the next deadline is computed as always 
+*   (schedule_next_beat): every tempo change lands on a bar boundary, and 
+*   the beat k of a segment is floor(k * 60000 / bpm) ticks after its first
+*   downbeat, with no jitter added.
+*/
+const byte TEMPO_MAP_END            = 0;
+const byte TEMPO_MAP_PLAY           = 1;
+const byte TEMPO_MAP_RAMP           = 2;
+const byte TEMPO_MAP_TIME_SIGNATURE = 3;
+const byte TEMPO_MAP_REPEAT         = 4;
+const byte TEMPO_MAP_LINEAR_RAMP    = 5;
+const byte TEMPO_MAP_EXPONENTIAL_RAMP = 6;
+const byte TEMPO_MAP_VOICES         = 7;
+
+const byte TEMPO_MAP_PLAY_SIZE      = 4;
+const byte TEMPO_MAP_RAMP_SIZE      = 5;
+const byte TEMPO_MAP_TIME_SIGNATURE_SIZE = 2;
+const byte TEMPO_MAP_SMOOTH_RAMP_SIZE = 4;
+const byte TEMPO_MAP_VOICES_SIZE    = 2;
+
+/*  Smooth ramps. The period of the next beat is bpm_freq_req_iter + 
+*   bpm_freq_remainder / bpm_freq_divisor ticks, and the timer interrupt 
+*   advances it after every beat of the ramp, with no division:
+*   - Linear: the delta of the period, ramp_delta_iter + 
+*     ramp_delta_remainder / bpm_freq_divisor ticks, is added. The divisor 
+*     is start_bpm * target_bpm * beats, so every period is exact, and the 
+*     beat k is floor of the exact sum of the periods before it.
+*   - Exponential: the period, with RAMP_PERIOD_SHIFT fractional bits (the 
+*     divisor is RAMP_PERIOD_ONE), is multiplied by ramp_ratio, with 
+*     RAMP_RATIO_SHIFT fractional bits. The ratio, 
+*     (start_bpm / target_bpm) ^ (1 / beats), is computed once per ramp by
+*     the main loop, with integer math: 2 raised to the difference of the 
+*     base 2 logarithms, divided by the beats. The logarithms (and the 
+*     terms of the power) have RAMP_LOG_SHIFT fractional bits, and the 
+*     mantissas RAMP_MANTISSA_SHIFT; RAMP_LN_2 is ln(2), with 
+*     RAMP_LOG_SHIFT bits. Every time signature has 2 beats or more, so the
+*     ratio is less than sqrt(300) < 32: it fits in 5 integer bits.
+*/
+const byte TEMPO_RAMP_NONE          = 0;
+const byte TEMPO_RAMP_LINEAR        = 1;
+const byte TEMPO_RAMP_EXPONENTIAL   = 2;
+const byte RAMP_PERIOD_SHIFT        = 16;
+const unsigned long RAMP_PERIOD_ONE = 1UL << RAMP_PERIOD_SHIFT;
+const byte RAMP_RATIO_SHIFT         = 27;
+const unsigned long RAMP_RATIO_ONE  = 1UL << RAMP_RATIO_SHIFT;
+const byte RAMP_LOG_SHIFT           = 32;
+const long long RAMP_LOG_ONE        = 1LL << RAMP_LOG_SHIFT;
+const byte RAMP_MANTISSA_SHIFT      = 31;
+const unsigned long long RAMP_LN_2  = 2977044472ULL;
+
+const byte TEMPO_MAP[] PROGMEM = 
+{
+    TEMPO_MAP_PLAY, 80, 0, 4,       /* 4 bars at 80 BPM. */
+    TEMPO_MAP_RAMP, 5, 8, 140, 0,   /* +5 BPM every 8 bars, up to 140. */
+    TEMPO_MAP_END
+};
+const unsigned int TEMPO_MAP_SIZE   = sizeof(TEMPO_MAP);
+const char TEMPO_MAP_TEXT[] PROGMEM = "MAP";
+
+const unsigned int TIMER1_COMPARE_VALUE = 249;  /*  16MHz / 64 (prescaler) / 
+                                                *   (249 + 1) = 1 KHz, this is,
+                                                *   one timer tick every
+                                                *   millisecond.
+                                                */
+
+/*  Button events, generated by the debouncer (timer interrupt) and attended
+*   by the main loop, in order of arrival. The queue is a ring buffer with 
+*   one writer for each index: the interrupt writes button_event_head and 
+*   the main loop button_event_tail. Both are bytes (atomic access in the 
+*   AVR), so no interrupt has to be disabled. If the queue is full, the new
+*   events are lost.
+*/
+const byte BUTTON_EVENT_QUEUE_SIZE  = 16;   /* Power of two. */
+const byte BUTTONS                  = 5;
+const int FIRST_BUTTON_PIN          = RESTART_BPM_BUTTON_PIN;
+const int LAST_BUTTON_PIN           = FIRST_BUTTON_PIN + BUTTONS - 1;
+const byte BUTTON_PINS_MASK 
+    = PortBPin<MUTE_BUZZER_BUTTON_PIN>::BIT
+      | PortBPin<CHANGE_BPM_BY_TEN_BUTTON_PIN>::BIT
+      | PortBPin<CHANGE_BPM_BY_ONE_BUTTON_PIN>::BIT
+      | PortBPin<ADD_OR_SUB_BPM_BUTTON_PIN>::BIT
+      | PortBPin<RESTART_BPM_BUTTON_PIN>::BIT;
+
+/*  The debouncer indexes the buttons from FIRST_BUTTON_PIN (one PINB 
+*   snapshot, and one pin change interrupt, for all of them).
+*/
+static_assert(BUTTON_PINS_MASK == (((1 << BUTTONS) - 1) 
+                                   << (FIRST_BUTTON_PIN - PORTB_FIRST_PIN)),
+              "The buttons must be consecutive pins of the port B.");
+static_assert((PortBPin<ACTIVE_BUZZER_PIN>::BIT & BUTTON_PINS_MASK) == 0,
+              "The buzzer pin must not be a button pin.");
+
+const byte BUTTON_PRESSED           = 1;
+const byte BUTTON_RELEASED          = 2;
+const byte BUTTON_LONG_PRESSED      = 3;    /* Held BUTTON_LONG_PRESS_TICKS. */
+const byte BUTTON_REPEATED          = 4;    /*  Held after the long pressing
+                                            *   (only the repeated buttons).
+                                            */
+
+const byte BUTTON_DEBOUNCE_TICKS            = 5;    /* Debounce window. */
+const unsigned int BUTTON_LONG_PRESS_TICKS  = 500;  /* Delay of the repeat. */
+
+/*  Auto-repeat of the held BPM buttons (by one and by ten): after the long 
+*   pressing, the button is repeated with the periods of 
+*   BUTTON_REPEAT_PERIODS, in ticks, one after another (acceleration curve);
+*   the last period is kept until the release. The rate and the curve are
+*   configured here.
+*/
+const byte BUTTON_REPEAT_PINS_MASK 
+    = PortBPin<CHANGE_BPM_BY_ONE_BUTTON_PIN>::BIT
+      | PortBPin<CHANGE_BPM_BY_TEN_BUTTON_PIN>::BIT;
+const unsigned int BUTTON_REPEAT_PERIODS[] PROGMEM = 
+{
+    200, 150, 120, 100, 80, 70, 60, 50
+};
+const byte BUTTON_REPEAT_STEPS      = sizeof(BUTTON_REPEAT_PERIODS) 
+                                      / sizeof(BUTTON_REPEAT_PERIODS[0]);
+
+/*  Buttons with an operation of their own in the long pressing (not 
+*   repeated); their release does not perform the short operation then.
+*/
+const byte BUTTON_LONG_PRESS_PINS_MASK 
+    = PortBPin<RESTART_BPM_BUTTON_PIN>::BIT
+      | PortBPin<ADD_OR_SUB_BPM_BUTTON_PIN>::BIT
+      | PortBPin<MUTE_BUZZER_BUTTON_PIN>::BIT;
+
+static_assert((BUTTON_LONG_PRESS_PINS_MASK & BUTTON_REPEAT_PINS_MASK) == 0,
+              "A repeated button has no long pressing operation.");
+
+/*  Operations of the buttons. Every operation returns the parts of the state
+*   it has changed (STATE_ flags, 0 if nothing has changed), so only what is
+*   affected is recomputed: the beat period is recalculated by the BPM 
+*   operations only if the BPM has changed, and the LCD is redrawn only if a
+*   part shown in it has changed. A new control is one more entry of 
+*   BUTTON_ACTIONS (stored in the flash memory), and its operation. The 
+*   event of an action is BUTTON_RELEASED (short pressing, and the 
+*   repetitions of the held BPM buttons) or BUTTON_LONG_PRESSED.
+*/
+const byte STATE_BPM                = 1 << 0;
+const byte STATE_BPM_MODIFIER       = 1 << 1;
+const byte STATE_MUTE               = 1 << 2;
+const byte STATE_TIME_SIGNATURE     = 1 << 3;
+const byte STATE_SUBDIVISION        = 1 << 4;
+const byte STATE_TEMPO_MAP          = 1 << 5;
+const byte STATE_SHOWN_IN_LCD       = STATE_BPM | STATE_BPM_MODIFIER 
+                                      | STATE_MUTE | STATE_TIME_SIGNATURE
+                                      | STATE_SUBDIVISION | STATE_TEMPO_MAP;
+
+typedef byte (*ButtonOperation)();
+
+struct ButtonAction
+{
+    byte pin;
+    byte button_event;
+    ButtonOperation operation;
+};
+
+byte reset_bpm();
+byte invert_bpm_modifier();
+byte change_bpm_by_one();
+byte change_bpm_by_ten();
+byte change_mute_state();
+byte change_time_signature();
+byte change_subdivision();
+byte start_tempo_map();
+
+const ButtonAction BUTTON_ACTIONS[] PROGMEM = 
+{
+    {RESTART_BPM_BUTTON_PIN,        BUTTON_RELEASED,    reset_bpm},
+    {ADD_OR_SUB_BPM_BUTTON_PIN,     BUTTON_RELEASED,    invert_bpm_modifier},
+    {CHANGE_BPM_BY_ONE_BUTTON_PIN,  BUTTON_RELEASED,    change_bpm_by_one},
+    {CHANGE_BPM_BY_TEN_BUTTON_PIN,  BUTTON_RELEASED,    change_bpm_by_ten},
+    {MUTE_BUZZER_BUTTON_PIN,        BUTTON_RELEASED,    change_mute_state},
+    {RESTART_BPM_BUTTON_PIN,        BUTTON_LONG_PRESSED, change_time_signature},
+    {ADD_OR_SUB_BPM_BUTTON_PIN,     BUTTON_LONG_PRESSED, change_subdivision},
+    {MUTE_BUZZER_BUTTON_PIN,        BUTTON_LONG_PRESSED, start_tempo_map}
+};
+const byte BUTTON_ACTIONS_COUNT     = sizeof(BUTTON_ACTIONS) 
+                                      / sizeof(BUTTON_ACTIONS[0]);
+
+/*  Timing wheel of the timer interrupt. Every timed event (the end of the 
+*   sound, the beat, the sub-beat, the next voice event, the debouncing and
+*   the holding of every button) is one timer, armed at its absolute tick, 
+*   and the interrupt only looks at the slot of the current tick: the cost 
+*   of a tick does not grow with the events. The wheel is hierarchical: the
+*   level l has TIMER_WHEEL_SLOTS slots of TIMER_WHEEL_SLOTS^l ticks, and 
+*   holds the timers due in less than TIMER_WHEEL_SLOTS^(l + 1) ticks; when
+*   the slots of a level wrap, the next slot of the level above is cascaded
+*   (its timers are armed again, one level down). A slot is a doubly linked
+*   list of timers (indexes of fixed arrays, no allocation), so arming, 
+*   cancelling and expiring a timer are O(1). The timers due in the same 
+*   tick expire in the order of their numbers: the buzzer is stopped before
+*   a new sound, a pulse in the tick of a beat sounds after it, and the 
+*   buttons are debounced before their holding is counted. A new timed 
+*   event is one more timer number and its handler in TIMER_HANDLERS.
+*/
+const byte TIMER_WHEEL_SLOT_BITS    = 4;
+const byte TIMER_WHEEL_SLOTS        = 1 << TIMER_WHEEL_SLOT_BITS;
+const byte TIMER_WHEEL_LEVELS       = 4;
+const unsigned long TIMER_WHEEL_RANGE 
+    = 1UL << (TIMER_WHEEL_SLOT_BITS * TIMER_WHEEL_LEVELS);  /* 65536 ticks. */
+const byte NO_TIMER                 = 0xFF; /* End of the list of a slot. */
+const byte TIMER_IDLE               = 0xFF; /* Slot of a timer not armed. */
+const byte TIMER_DUE                = 0xFE; /* Slot of a timer due. */
+
+const byte TIMER_BUZZER_OFF         = 0;
+const byte TIMER_BEAT               = 1;
+const byte TIMER_SUBDIVISION        = 2;
+const byte TIMER_VOICE_EVENT        = 3;    /* First event of the heap. */
+const byte TIMER_DEBOUNCE           = 4;    /* Every tick, while active. */
+const byte TIMER_BUTTON_HOLD        = 5;    /* One per button. */
+const byte TIMERS                   = TIMER_BUTTON_HOLD + BUTTONS;
+
+static_assert(TIMERS <= 16, "The due timers are the bits of an unsigned int.");
+static_assert((MILLISECONDS_IN_MINUTE / BPM_LOWER_BOUND) < TIMER_WHEEL_RANGE,
+              "The longest beat period must fit in the timing wheel.");
+
+typedef void (*TimerHandler)(byte timer);
+
+void expire_buzzer_off(byte timer);
+void expire_beat(byte timer);
+void expire_subdivision(byte timer);
+void expire_voice_event(byte timer);
+void expire_debounce(byte timer);
+void expire_button_hold(byte timer);
+
+const TimerHandler TIMER_HANDLERS[] PROGMEM = 
+{
+    expire_buzzer_off,
+    expire_beat,
+    expire_subdivision,
+    expire_voice_event,
+    expire_debounce,
+    expire_button_hold,     /* RESTART_BPM_BUTTON_PIN. */
+    expire_button_hold,
+    expire_button_hold,
+    expire_button_hold,
+    expire_button_hold      /* MUTE_BUZZER_BUTTON_PIN. */
+};
+
+static_assert(sizeof(TIMER_HANDLERS) == TIMERS * sizeof(TimerHandler),
+              "Every timer must have its handler.");
+
+volatile byte button_event_pins[BUTTON_EVENT_QUEUE_SIZE];
+volatile byte button_event_types[BUTTON_EVENT_QUEUE_SIZE];
+volatile byte button_event_head;
+volatile byte button_event_tail;
+
+/*  Debouncer state, one entry per button (index 0 is FIRST_BUTTON_PIN). 
+*   Every button is tracked independently, so overlapped pressings are not
+*   lost.
+*/
+volatile byte button_integrators[BUTTONS];  /*  From 0 (released) to 
+                                            *   BUTTON_DEBOUNCE_TICKS 
+                                            *   (pressed).
+                                            */
+volatile byte button_repeat_steps[BUTTONS];  /*  Next period of 
+                                            *   BUTTON_REPEAT_PERIODS.
+                                            */
+volatile byte button_pin_levels;    /*  Debounced level of the buttons, with 
+                                    *   the PINB bits.
+                                    */
+volatile byte long_pressed_buttons; /*  Same bits; set after the long 
+                                    *   pressing, until the release.
+                                    */
+volatile boolean is_button_debounce_active; /*  false when all the buttons are
+                                            *   released and stable: the pin
+                                            *   change interrupt sets it again.
+                                            */
+
+int last_pressed_button_pin;    /* Last pressed button still held, or 0. */
+byte repeated_button_pins;      /*  Buttons whose operation has been 
+                                *   performed while held (repetitions or 
+                                *   long pressing), with the PINB bits: the
+                                *   release does not perform it again.
+                                */
+int bpm;
+int bpm_modifier; /* 1 (one) or -1 (minus one). */
+byte time_signature;    /* Index of TIME_SIGNATURES. */
+byte subdivision;       /* Index of SUBDIVISIONS. */
+
+volatile unsigned int bpm_freq_req_iter;    /*  bpm frequency required 
+                                            *   iterations, this is, timer
+                                            *   ticks between two beats.
+                                            *   unsigned int in order to store
+                                            *   a max. value of 60000.
+                                            */
+
+/*  The period of a beat is MILLISECONDS_IN_MINUTE / bpm ticks. The integer 
+*   part is bpm_freq_req_iter; the fractional part is bpm_freq_remainder / 
+*   bpm_freq_divisor. The fractions are accumulated in beat_error_accumulator,
+*   and once they sum a whole tick, the beat is delayed by one tick; in this 
+*   way, the average period is exact and there is no drift. unsigned long 
+*   for the divisors of the smooth ramps.
+*/
+volatile unsigned long bpm_freq_remainder;
+volatile unsigned long bpm_freq_divisor;
+volatile unsigned long beat_error_accumulator;
+
+volatile unsigned long timer_ticks;         /*  Ticks elapsed since start-up. */
+volatile unsigned long beat_deadline_tick;  /*  Absolute tick of next beat. */
+volatile unsigned long buzzer_off_tick;     /*  Absolute tick to end the
+                                            *   sound of the current beat.
+                                            */
+volatile boolean is_buzzer_sounding;
+                                           
+volatile boolean is_buzzer_muted;   
+
+volatile byte beats_per_bar;
+volatile byte beat_in_bar;  /* Position of the next beat; 0 is the downbeat. */
+
+/*  Sub-beats. The step of the base period (bpm_freq_req_iter) is 
+*   subdivision_req_iter + subdivision_remainder / clicks_per_beat ticks; 
+*   the step of the current beat is beat_subdivision_iter and 
+*   beat_subdivision_remainder (one tick more in the period, if the beat has
+*   it), and its fraction is accumulated in subdivision_error_accumulator.
+*/
+volatile byte clicks_per_beat;
+volatile unsigned int subdivision_req_iter;
+volatile byte subdivision_remainder;
+volatile unsigned int beat_subdivision_iter;
+volatile byte beat_subdivision_remainder;
+volatile byte subdivision_error_accumulator;
+volatile unsigned long subdivision_deadline_tick;   /*  Absolute tick of 
+                                                    *   next sub-beat.
+                                                    */
+volatile byte pending_subdivisions; /* Sub-beats left in the current beat. */
+
+/*  Tempo map. The interpreter (tempo_map_pc, tempo_map_bpm and 
+*   tempo_map_time_signature) belongs to the main loop. The staged segment 
+*   is written by the main loop while is_tempo_segment_staged is false, and
+*   taken by the timer interrupt while it is true; staged_bars is 0 at the 
+*   end of the program. The interrupt sets is_tempo_map_changed when a 
+*   segment starts (or the program ends), so the main loop shows it.
+*/
+unsigned int tempo_map_pc;          /* Next instruction of TEMPO_MAP. */
+int tempo_map_bpm;                  /* BPM of the last interpreted segment. */
+byte tempo_map_time_signature;      /* Its time signature. */
+volatile boolean is_tempo_map_running;
+volatile boolean is_tempo_segment_staged;
+volatile boolean is_tempo_map_changed;
+volatile byte tempo_map_bars_left;  /*  Bars of the current segment after the
+                                    *   current bar.
+                                    */
+volatile unsigned int staged_req_iter;
+volatile unsigned long staged_remainder;
+volatile unsigned long staged_divisor;
+volatile byte staged_beats_per_bar;
+volatile byte staged_bars;
+
+/*  Smooth ramp of the current segment (tempo_ramp), and of the staged one 
+*   (staged_ramp and its parameters), both TEMPO_RAMP_NONE out of a ramp. 
+*   ramp_start_bpm is written by the interpreter. The period is advanced 
+*   after every beat while tempo_ramp_beats_left is not 0.
+*/
+int ramp_start_bpm;
+volatile byte tempo_ramp;
+volatile unsigned int tempo_ramp_beats_left;
+volatile int ramp_delta_iter;
+volatile unsigned long ramp_delta_remainder;
+volatile unsigned long ramp_ratio;
+volatile byte staged_ramp;
+volatile unsigned int staged_ramp_beats;
+volatile int staged_delta_iter;
+volatile unsigned long staged_delta_remainder;
+volatile unsigned long staged_ratio;
+
+byte tempo_map_voices;              /* Voices of the interpreted segment. */
+volatile byte staged_voices;
+
+/*  Polyrhythm voices (bit v of active_voices: VOICES[v]), advanced by the
+*   timer interrupt. voice_positions is the next pulse of the voice in
+*   1 / pulses of the current beat, from it (pulse * beats - beat * pulses).
+*   The step of the current beat is voice_step_iters +
+*   voice_step_remainders / pulses ticks. sounding_voice_pins has the bits
+*   of the pin outputs whose end of sound is in the heap.
+*/
+volatile byte active_voices;
+volatile byte voice_beats[VOICES_COUNT];    /* Beat of the cycle. */
+volatile byte voice_pulses[VOICES_COUNT];   /* Next pulse of the cycle. */
+volatile byte voice_positions[VOICES_COUNT];
+volatile unsigned int voice_step_iters[VOICES_COUNT];
+volatile byte voice_step_remainders[VOICES_COUNT];
+volatile unsigned long voices_beat_tick;    /* Tick of the current beat. */
+volatile byte sounding_voice_pins;
+
+/*  Min-heap of the voice events: the entry 0 has the earliest deadline, and
+*   no entry is later than its children (entries 2 * i + 1 and 2 * i + 2).
+*   The code of an event is the index of its voice, with VOICE_EVENT_OFF in
+*   an end of sound.
+*/
+volatile unsigned long voice_event_ticks[VOICE_EVENTS_SIZE];
+volatile byte voice_event_codes[VOICE_EVENTS_SIZE];
+volatile byte voice_event_count;
+
+/*  Timing wheel, served by the timer interrupt; the main loop arms and 
+*   cancels the timers with the interrupts disabled. timer_wheel_slots has 
+*   the first timer of every slot (level * TIMER_WHEEL_SLOTS + slot), and 
+*   timer_slots the slot of every timer (or TIMER_IDLE, TIMER_DUE). 
+*   wheel_tick is the last tick served.
+*/
+volatile unsigned long wheel_tick;
+volatile byte timer_wheel_slots[TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS];
+volatile unsigned long timer_expiry_ticks[TIMERS];
+volatile byte timer_slots[TIMERS];
+volatile byte next_timers[TIMERS];
+volatile byte previous_timers[TIMERS];
+volatile unsigned int due_timers;   /* Bit t: the timer t is due. */
+
+/******************************************************************************/
+
+
+void setup()
+{
+    pinMode(MUTE_BUZZER_BUTTON_PIN, INPUT);
+    pinMode(CHANGE_BPM_BY_TEN_BUTTON_PIN, INPUT);
+    pinMode(CHANGE_BPM_BY_ONE_BUTTON_PIN, INPUT);
+    pinMode(ADD_OR_SUB_BPM_BUTTON_PIN, INPUT);
+    pinMode(RESTART_BPM_BUTTON_PIN, INPUT);
+    
+    pinMode(ACTIVE_BUZZER_PIN, OUTPUT);
+    configure_voice_pins();
+
+    lcd.begin(LCD_COLUMNS, LCD_ROWS); /* Set LCD columns and rows. */
+    init_lcd_frame();
+    
+    time_signature = DEFAULT_TIME_SIGNATURE;
+    beats_per_bar = pgm_read_byte(
+        &TIME_SIGNATURES[DEFAULT_TIME_SIGNATURE].beats_per_bar);
+    beat_in_bar = 0;
+    
+    subdivision = DEFAULT_SUBDIVISION;
+    clicks_per_beat = pgm_read_byte(
+        &SUBDIVISIONS[DEFAULT_SUBDIVISION].clicks_per_beat);
+    pending_subdivisions = 0;
+    
+    init_timer_wheel();
+    reset_bpm();
+    update_lcd();
+    
+    last_pressed_button_pin     = 0;
+    repeated_button_pins        = 0;
+    timer_ticks                 = 0;
+    beat_deadline_tick          = 0;
+    buzzer_off_tick             = 0;
+    is_buzzer_sounding          = false;
+    
+    configure_beat_timer();
+    configure_button_interrupts();
+}
+
+
+/**
+* The pins of the voices with an output of their own, low until their first
+* pulse.
+*/
+void configure_voice_pins()
+{
+    byte voice;
+    byte pin;
+    
+    for (voice = 0; voice < VOICES_COUNT; voice++)
+    {
+        if (pgm_read_byte(&VOICES[voice].output) != VOICE_OUTPUT_BUZZER)
+        {
+            pin = pgm_read_byte(&VOICES[voice].pin);
+            pinMode(pin, OUTPUT);
+            digitalWrite(pin, LOW);
+        }
+    }
+}
+
+
+/**
+* Configure Timer1 in CTC mode to raise a compare match interrupt every
+* millisecond. The interrupt is the time base of the metronome: beats are
+* triggered there, at absolute deadlines, so the time spent by the main loop
+* (buttons, LCD) does not delay nor accumulate error in the beats.
+*/
+void configure_beat_timer()
+{
+    noInterrupts();
+    
+    TCCR1A = 0;
+    TCCR1B = (1 << WGM12) | (1 << CS11) | (1 << CS10); /* CTC, prescaler 64. */
+    TCNT1  = 0;
+    OCR1A  = TIMER1_COMPARE_VALUE;
+    TIMSK1 = (1 << OCIE1A);
+    
+    interrupts();
+}
+
+
+ISR(TIMER1_COMPA_vect)
+{
+    timer_ticks++;
+    serve_timer_wheel();
+}
+
+
+/**
+* Enable the pin change interrupt of the button pins. The current levels are
+* the initial ones: a button held at start-up is not a pressing.
+*/
+void configure_button_interrupts()
+{
+    byte button;
+    byte pin_bit;
+    
+    noInterrupts();
+    
+    button_event_head = 0;
+    button_event_tail = 0;
+    button_pin_levels = PINB & BUTTON_PINS_MASK;
+    long_pressed_buttons = 0;
+    
+    for (button = 0; button < BUTTONS; button++)
+    {
+        pin_bit = 1 << (FIRST_BUTTON_PIN - PORTB_FIRST_PIN + button);
+        button_integrators[button] = ((button_pin_levels & pin_bit) != 0) 
+                                     ? BUTTON_DEBOUNCE_TICKS : 0;
+        button_repeat_steps[button] = 0;
+        
+        if ((button_pin_levels & pin_bit) != 0)
+        {
+            arm_timer(TIMER_BUTTON_HOLD + button, 
+                      timer_ticks + BUTTON_LONG_PRESS_TICKS);
+        }
+        else
+        {
+            cancel_timer(TIMER_BUTTON_HOLD + button);
+        }
+    }
+    
+    is_button_debounce_active = (button_pin_levels != 0);
+    
+    if (is_button_debounce_active == true)
+    {
+        arm_timer(TIMER_DEBOUNCE, timer_ticks + 1);
+    }
+    
+    PCMSK0 = BUTTON_PINS_MASK;  /* PCINT1 to PCINT5 are PB1 to PB5. */
+    PCICR  = PCICR | (1 << PCIE0);
+    
+    interrupts();
+}
+
+
+/**
+* A button pin has changed: the debouncer samples the buttons again, from 
+* the next tick.
+*/
+ISR(PCINT0_vect)
+{
+    is_button_debounce_active = true;
+    arm_timer(TIMER_DEBOUNCE, timer_ticks + 1);
+}
+
+
+/**
+* Executed by the timer interrupt in every tick, while a button is pressed or
+* bouncing (the timer is armed again for the next tick while it is active, 
+* and by the pin change interrupt). The whole port B is read once.
+* Integrator debouncer: the integrator of a button is increased in the ticks
+* its pin is HIGH, and decreased in the ticks it is LOW; the button is 
+* pressed when it reaches BUTTON_DEBOUNCE_TICKS, and released when it 
+* reaches 0. The bounces shorter than the window are filtered, and the 
+* changed buttons are the bits that differ from the previous debounced 
+* levels. There is no delay: nothing is blocked while a button bounces.
+*/
+void debounce_buttons()
+{
+    byte button;
+    byte pin_bit;
+    byte port_snapshot;
+    byte debounced_levels;
+    byte changed_pins;
+    boolean is_any_button_bouncing;
+    
+    port_snapshot = PINB & BUTTON_PINS_MASK;
+    debounced_levels = button_pin_levels;
+    is_any_button_bouncing = false;
+    
+    for (button = 0; button < BUTTONS; button++)
+    {
+        pin_bit = 1 << (FIRST_BUTTON_PIN - PORTB_FIRST_PIN + button);
+        
+        if ((port_snapshot & pin_bit) != 0)
+        {
+            if (button_integrators[button] < BUTTON_DEBOUNCE_TICKS)
+            {
+                button_integrators[button]++;
+            }
+        }
+        else if (button_integrators[button] > 0)
+        {
+            button_integrators[button]--;
+        }
+        
+        if (button_integrators[button] == BUTTON_DEBOUNCE_TICKS)
+        {
+            debounced_levels = debounced_levels | pin_bit;
+        }
+        else if (button_integrators[button] == 0)
+        {
+            debounced_levels = debounced_levels & ~pin_bit;
+        }
+        else
+        {
+            is_any_button_bouncing = true;
+        }
+    }
+    
+    changed_pins = debounced_levels ^ button_pin_levels;
+    button_pin_levels = debounced_levels;
+    
+    for (button = 0; button < BUTTONS; button++)
+    {
+        pin_bit = 1 << (FIRST_BUTTON_PIN - PORTB_FIRST_PIN + button);
+        
+        if ((changed_pins & pin_bit) != 0)
+        {
+            if ((debounced_levels & pin_bit) != 0)
+            {
+                button_repeat_steps[button] = 0;
+                arm_timer(TIMER_BUTTON_HOLD + button, 
+                          timer_ticks + BUTTON_LONG_PRESS_TICKS);
+                push_button_event(FIRST_BUTTON_PIN + button, BUTTON_PRESSED);
+            }
+            else
+            {
+                long_pressed_buttons = long_pressed_buttons & ~pin_bit;
+                cancel_timer(TIMER_BUTTON_HOLD + button);
+                push_button_event(FIRST_BUTTON_PIN + button, BUTTON_RELEASED);
+            }
+        }
+    }
+    
+    is_button_debounce_active = (is_any_button_bouncing == true)
+                                || (debounced_levels != 0);
+    
+    if (is_button_debounce_active == true)
+    {
+        arm_timer(TIMER_DEBOUNCE, timer_ticks + 1);
+    }
+}
+
+
+void expire_debounce(byte /* timer */)
+{
+    debounce_buttons();
+}
+
+
+/**
+* The timer of a held button, armed by the debouncer in the pressing and 
+* cancelled in the release. The long pressing is generated 
+* BUTTON_LONG_PRESS_TICKS after the pressing; then, only the buttons of 
+* BUTTON_REPEAT_PINS_MASK are repeated, every period of the acceleration 
+* curve (the timer is armed again).
+*/
+void expire_button_hold(byte timer)
+{
+    byte button = timer - TIMER_BUTTON_HOLD;
+    byte pin_bit = 1 << (FIRST_BUTTON_PIN - PORTB_FIRST_PIN + button);
+    byte repeat_step = button_repeat_steps[button];
+    
+    if ((BUTTON_REPEAT_PINS_MASK & pin_bit) != 0)
+    {
+        arm_timer(timer, timer_ticks 
+                         + pgm_read_word(&BUTTON_REPEAT_PERIODS[repeat_step]));
+        
+        if (repeat_step < (BUTTON_REPEAT_STEPS - 1))
+        {
+            button_repeat_steps[button] = repeat_step + 1;
+        }
+    }
+    
+    if ((long_pressed_buttons & pin_bit) == 0)
+    {
+        long_pressed_buttons = long_pressed_buttons | pin_bit;
+        push_button_event(FIRST_BUTTON_PIN + button, BUTTON_LONG_PRESSED);
+    }
+    else
+    {
+        push_button_event(FIRST_BUTTON_PIN + button, BUTTON_REPEATED);
+    }
+}
+
+
+void push_button_event(int pin_to_check, byte button_event)
+{
+    byte next_head = (button_event_head + 1) & (BUTTON_EVENT_QUEUE_SIZE - 1);
+    
+    if (next_head != button_event_tail)
+    {
+        button_event_pins[button_event_head] = pin_to_check;
+        button_event_types[button_event_head] = button_event;
+        button_event_head = next_head;
+    }
+}
+
+
+/**
+* The beats and the button debouncing are processed by the timer interrupt,
+* so the main loop only has to attend the button events, stage the next 
+* segment of the tempo map, and send the LCD changes in slices. Without 
+* events nor changes, it does not call the core, and the CPU sleeps.
+*/
+void loop() /* Cyclic Executive at 16MHz. */
+{
+    check_button_pressing();
+    service_tempo_map();
+    service_lcd();
+    sleep_until_event();
+}
+
+
+/**
+* The CPU sleeps when the main loop has nothing to do: no button event, no
+* tempo map segment to show or to stage, and the LCD up to date. The idle
+* mode keeps Timer1 (the time base), Timer2 (tone) and the pin change 
+* interrupt running, so the next tick or button edge wakes the CPU; the 
+* power-save and power-down modes would stop Timer1. The condition is 
+* checked with the interrupts disabled, and the instruction after sei is 
+* executed before any interrupt: an event set meanwhile wakes the CPU at 
+* once, instead of waiting for the next tick.
+*/
+void sleep_until_event()
+{
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    noInterrupts();
+    
+    if ((button_event_tail == button_event_head)
+        && (is_tempo_map_changed == false)
+        && ((is_tempo_map_running == false) 
+            || (is_tempo_segment_staged == true))
+        && (lcd_next_cell == LCD_CELLS))
+    {
+        sleep_enable();
+        interrupts();
+        sleep_cpu();
+        sleep_disable();
+    }
+    
+    interrupts();
+}
+
+
+void check_button_pressing()
+{
+    int pin_to_check;
+    byte button_event;
+    
+    while (button_event_tail != button_event_head)
+    {
+        pin_to_check = button_event_pins[button_event_tail];
+        button_event = button_event_types[button_event_tail];
+        button_event_tail = (button_event_tail + 1) 
+                            & (BUTTON_EVENT_QUEUE_SIZE - 1);
+        
+        detect_single_pulsation(pin_to_check, button_event);
+    }
+}
+
+
+/**
+* Detect the button that, after being pressed, has been released.
+* Actions are performed only in the releasing process of a button, not in
+* the pressings. This is done to avoid complex State Change Detection
+* methods, and to allow the user to control the modifications (start and stop).
+* The debouncer tracks every button, so a release always follows the 
+* pressing of the same button, even if other buttons were pressed meanwhile.
+* The held BPM buttons are the exception: their operation is performed in the
+* long pressing and in every repetition, and not again in the release. The 
+* buttons of BUTTON_LONG_PRESS_PINS_MASK perform their long pressing 
+* operation instead of the short one.
+*/
+void detect_single_pulsation(int pin_to_check, byte button_event)
+{
+    byte pin_bit = 1 << (pin_to_check - PORTB_FIRST_PIN);
+    
+    /* Detect what button is pressed. */
+    if (button_event == BUTTON_PRESSED)
+    {
+        last_pressed_button_pin = pin_to_check;
+    }
+    
+    /* Detect if the held button is repeated. */
+    if (((button_event == BUTTON_LONG_PRESSED) 
+         || (button_event == BUTTON_REPEATED))
+        && ((BUTTON_REPEAT_PINS_MASK & pin_bit) != 0))
+    {
+        repeated_button_pins = repeated_button_pins | pin_bit;
+        perform_operation(pin_to_check, BUTTON_RELEASED);
+    }
+    else if ((button_event == BUTTON_LONG_PRESSED)
+             && ((BUTTON_LONG_PRESS_PINS_MASK & pin_bit) != 0))
+    {
+        repeated_button_pins = repeated_button_pins | pin_bit;
+        perform_operation(pin_to_check, BUTTON_LONG_PRESSED);
+    }
+    else
+    {
+        /* No operation. */
+    }
+    
+    /* Detect if the pressed button is now released. */
+    if (button_event == BUTTON_RELEASED)
+    {
+        if (last_pressed_button_pin == pin_to_check)
+        {
+            last_pressed_button_pin = 0;
+        }
+        
+        if ((repeated_button_pins & pin_bit) == 0)
+        {
+            perform_operation(pin_to_check, BUTTON_RELEASED);
+        }
+        
+        repeated_button_pins = repeated_button_pins & ~pin_bit;
+    } 
+}
+
+
+/**
+* The operation of the pin and event is looked up in BUTTON_ACTIONS; a pin
+* without action does nothing.
+*/
+void perform_operation(int pin_to_check, byte button_event)
+{
+    byte action;
+    byte changed_state = 0;
+    ButtonOperation operation;
+    
+    for (action = 0; action < BUTTON_ACTIONS_COUNT; action++)
+    {
+        if ((pgm_read_byte(&BUTTON_ACTIONS[action].pin) == pin_to_check)
+            && (pgm_read_byte(&BUTTON_ACTIONS[action].button_event) 
+                == button_event))
+        {
+            operation = (ButtonOperation) 
+                        pgm_read_ptr(&BUTTON_ACTIONS[action].operation);
+            changed_state = changed_state | operation();
+        }
+    }
+    
+    if ((changed_state & STATE_SHOWN_IN_LCD) != 0)
+    {
+        update_lcd();
+    }
+}
+
+
+byte reset_bpm()
+{
+    byte changed_state = stop_tempo_map();
+    
+    if (bpm != 60)
+    {
+        changed_state = changed_state | STATE_BPM;
+    }
+    
+    if (bpm_modifier != 1)
+    {
+        changed_state = changed_state | STATE_BPM_MODIFIER;
+    }
+    
+    if (is_buzzer_muted != true)
+    {
+        changed_state = changed_state | STATE_MUTE;
+    }
+    
+    noInterrupts();
+    
+    bpm                 = 60;
+    bpm_modifier        = 1;
+    bpm_freq_req_iter   = 1000;
+    bpm_freq_remainder  = 0;
+    bpm_freq_divisor    = 60;
+    beat_error_accumulator = 0;
+    is_buzzer_muted     = true;
+    pending_subdivisions = 0;
+    active_voices       = 0;
+    arm_beat_timers();
+    restart_voices();
+    
+    interrupts();
+    
+    calculate_subdivision_step();
+    
+    return changed_state;
+}
+
+
+byte invert_bpm_modifier()
+{
+    bpm_modifier = bpm_modifier * -1;
+    
+    return STATE_BPM_MODIFIER;
+}
+
+
+byte change_bpm_by_one()
+{
+    return update_bpm(1);
+}
+
+
+byte change_bpm_by_ten()
+{
+    return update_bpm(10);
+}
+
+
+/**
+* At the bounds, the BPM does not change: the period is not recalculated.
+*/
+byte update_bpm(int value)
+{
+    byte changed_state = stop_tempo_map();
+    int previous_bpm = bpm;
+    
+    bpm = bpm + (bpm_modifier * value);
+    
+    if (bpm > BPM_UPPER_BOUND)
+    {
+        bpm = BPM_UPPER_BOUND;
+    } 
+    else if (bpm < BPM_LOWER_BOUND)
+    {
+        bpm = BPM_LOWER_BOUND;
+    }
+    else 
+    {
+        /* No operation. */
+    }
+    
+    if (bpm == previous_bpm)
+    {
+        return changed_state;
+    }
+    
+    calculate_required_iterations();
+    
+    return changed_state | STATE_BPM;
+}
+
+
+/**
+* The SOUND_DURATION is not subtracted from the period: the buzzer does not
+* stop the timer, so the whole period is counted by the timer interrupt.
+* The next beat is rescheduled one new period after the previous beat.
+* The accumulated fraction of the previous tempo is discarded (less than
+* one tick, only once per tempo change).
+* The period is read from the BeatPeriods table; the remainder is obtained
+* with a multiplication (hardware instruction), instead of a division.
+* The sub-beats left in the current beat are dropped.
+*/
+void calculate_required_iterations()
+{
+    unsigned int required_iterations;
+    unsigned int required_remainder;
+    
+    required_iterations = pgm_read_word(
+        &BeatPeriods::required_iterations[bpm - BPM_LOWER_BOUND]);
+    required_remainder  = MILLISECONDS_IN_MINUTE - (required_iterations * bpm);
+    
+    noInterrupts();
+    
+    beat_deadline_tick = beat_deadline_tick - bpm_freq_req_iter;
+    bpm_freq_req_iter = required_iterations;
+    beat_deadline_tick = beat_deadline_tick + bpm_freq_req_iter;
+    
+    bpm_freq_remainder = required_remainder;
+    bpm_freq_divisor = bpm;
+    beat_error_accumulator = 0;
+    pending_subdivisions = 0;
+    arm_beat_timers();
+    
+    interrupts();
+    
+    calculate_subdivision_step();
+}
+
+
+/**
+* The step is computed with the interrupts disabled: the timer interrupt 
+* changes the base period when a segment of the tempo map starts.
+*/
+void calculate_subdivision_step()
+{
+    noInterrupts();
+    
+    set_subdivision_step();
+    
+    interrupts();
+}
+
+
+/**
+* The step of the base period: floor(bpm_freq_req_iter / clicks_per_beat),
+* with the multiplier of the table, and its remainder, with a 
+* multiplication. Without subdivision there are no sub-beats (no step).
+* Executed with the interrupts disabled, or by the timer interrupt.
+*/
+void set_subdivision_step()
+{
+    unsigned long period_multiplier;
+    
+    period_multiplier = pgm_read_dword(
+        &SUBDIVISIONS[subdivision].period_multiplier);
+    
+    if (period_multiplier != 0)
+    {
+        subdivision_req_iter = (bpm_freq_req_iter * period_multiplier) 
+                               >> SUBDIVISION_PERIOD_SHIFT;
+        subdivision_remainder = bpm_freq_req_iter 
+                                - (subdivision_req_iter * clicks_per_beat);
+    }
+    else
+    {
+        subdivision_req_iter = 0;
+        subdivision_remainder = 0;
+    }
+}
+
+
+/**
+* When the buzzer is unmuted, the first beat is scheduled one period later,
+* and it is the downbeat of a bar, where the cycles of the voices start.
+*/
+byte change_mute_state()
+{
+    byte changed_state = stop_tempo_map();
+    
+    noInterrupts();
+    
+    beat_deadline_tick = timer_ticks + bpm_freq_req_iter;
+    beat_in_bar = 0;
+    pending_subdivisions = 0;
+    is_buzzer_muted = !is_buzzer_muted;
+    arm_beat_timers();
+    restart_voices();
+    
+    interrupts();
+    
+    return changed_state | STATE_MUTE;
+}
+
+
+/**
+* Selects the next time signature (after the last one, the first again). 
+* The next beat starts a new bar, and new cycles of the voices; the tempo 
+* is not changed.
+*/
+byte change_time_signature()
+{
+    byte changed_state = stop_tempo_map();
+    byte next_beats_per_bar;
+    
+    time_signature++;
+    
+    if (time_signature == TIME_SIGNATURES_COUNT)
+    {
+        time_signature = 0;
+    }
+    
+    next_beats_per_bar = pgm_read_byte(
+        &TIME_SIGNATURES[time_signature].beats_per_bar);
+    
+    noInterrupts();
+    
+    beats_per_bar = next_beats_per_bar;
+    beat_in_bar = 0;
+    restart_voices();
+    
+    interrupts();
+    
+    return changed_state | STATE_TIME_SIGNATURE;
+}
+
+
+/**
+* Selects the next subdivision (after the last one, only the beats again).
+* The sub-beats start in the next beat; the tempo is not changed.
+*/
+byte change_subdivision()
+{
+    subdivision++;
+    
+    if (subdivision == SUBDIVISIONS_COUNT)
+    {
+        subdivision = 0;
+    }
+    
+    noInterrupts();
+    
+    clicks_per_beat = pgm_read_byte(&SUBDIVISIONS[subdivision].clicks_per_beat);
+    pending_subdivisions = 0;
+    arm_beat_timers();
+    
+    interrupts();
+    
+    calculate_subdivision_step();
+    
+    return STATE_SUBDIVISION;
+}
+
+
+/**
+* Starts TEMPO_MAP from its first instruction, with the current BPM and 
+* time signature. The first segment is applied at once, and the buzzer is
+* unmuted: the first beat, one period later, is the downbeat of its first 
+* bar, where the timer interrupt takes the staged segment (the same one).
+* A program without bars does not start.
+*/
+byte start_tempo_map()
+{
+    byte changed_state = stop_tempo_map();
+    
+    tempo_map_pc = 0;
+    tempo_map_bpm = bpm;
+    tempo_map_time_signature = time_signature;
+    tempo_map_voices = 0;
+    stage_tempo_segment();
+    
+    if (staged_bars == 0)
+    {
+        is_tempo_segment_staged = false;
+        return changed_state;
+    }
+    
+    bpm = tempo_map_bpm;
+    time_signature = tempo_map_time_signature;
+    calculate_required_iterations();
+    
+    noInterrupts();
+    
+    beats_per_bar = staged_beats_per_bar;
+    beat_deadline_tick = timer_ticks + bpm_freq_req_iter;
+    beat_in_bar = 0;
+    pending_subdivisions = 0;
+    is_buzzer_muted = false;
+    arm_beat_timers();
+    active_voices = staged_voices;
+    restart_voices();
+    tempo_map_bars_left = 0;
+    is_tempo_map_running = true;
+    
+    interrupts();
+    
+    return STATE_BPM | STATE_MUTE | STATE_TIME_SIGNATURE | STATE_TEMPO_MAP;
+}
+
+
+/**
+* The tempo map stops, and the current tempo is kept. A segment started by
+* the timer interrupt, and not shown yet, is taken as the current BPM and 
+* time signature. In a smooth ramp, the period goes to the one of the BPM
+* shown (the target of the ramp). Returns STATE_TEMPO_MAP if the LCD has 
+* to show it.
+*/
+byte stop_tempo_map()
+{
+    byte changed_state = 0;
+    boolean is_ramp_stopped;
+    
+    noInterrupts();
+    
+    if (is_tempo_map_changed == true)
+    {
+        bpm = tempo_map_bpm;
+        time_signature = tempo_map_time_signature;
+        changed_state = STATE_TEMPO_MAP;
+    }
+    
+    if (is_tempo_map_running == true)
+    {
+        changed_state = STATE_TEMPO_MAP;
+    }
+    
+    is_ramp_stopped = (tempo_ramp != TEMPO_RAMP_NONE);
+    is_tempo_map_running = false;
+    is_tempo_segment_staged = false;
+    is_tempo_map_changed = false;
+    tempo_ramp = TEMPO_RAMP_NONE;
+    tempo_ramp_beats_left = 0;
+    
+    interrupts();
+    
+    if (is_ramp_stopped == true)
+    {
+        calculate_required_iterations();
+    }
+    
+    return changed_state;
+}
+
+
+/**
+* Executed by the main loop. Shows the segment started by the timer 
+* interrupt (its BPM and time signature are the last interpreted ones), 
+* and then stages the next one. Both flags are read at once, so a segment
+* started meanwhile is shown before the interpreter goes on.
+*/
+void service_tempo_map()
+{
+    boolean is_segment_started;
+    boolean is_staging_required;
+    
+    noInterrupts();
+    
+    is_segment_started = is_tempo_map_changed;
+    is_staging_required = (is_tempo_map_running == true) 
+                          && (is_tempo_segment_staged == false);
+    is_tempo_map_changed = false;
+    
+    interrupts();
+    
+    if (is_segment_started == true)
+    {
+        bpm = tempo_map_bpm;
+        time_signature = tempo_map_time_signature;
+        update_lcd();
+    }
+    
+    if (is_staging_required == true)
+    {
+        stage_tempo_segment();
+    }
+}
+
+
+/**
+* Interprets TEMPO_MAP from tempo_map_pc up to the next segment, and stages
+* it, with its period read from the BeatPeriods table (no division). At the
+* end of the program, the end is staged (no bars). At most TEMPO_MAP_SIZE 
+* instructions are read, so a program without bars (i.e: only 
+* TEMPO_MAP_REPEAT) ends.
+*/
+void stage_tempo_segment()
+{
+    unsigned int instructions = 0;
+    unsigned int required_iterations;
+    byte bars = 0;
+    
+    while ((bars == 0) && (tempo_map_pc < TEMPO_MAP_SIZE)
+           && (instructions < TEMPO_MAP_SIZE))
+    {
+        staged_ramp = TEMPO_RAMP_NONE;
+        bars = interpret_tempo_map();
+        instructions++;
+    }
+    
+    if (tempo_map_bpm > BPM_UPPER_BOUND)
+    {
+        tempo_map_bpm = BPM_UPPER_BOUND;
+    }
+    else if (tempo_map_bpm < BPM_LOWER_BOUND)
+    {
+        tempo_map_bpm = BPM_LOWER_BOUND;
+    }
+    else
+    {
+        /* No operation. */
+    }
+    
+    required_iterations = pgm_read_word(
+        &BeatPeriods::required_iterations[tempo_map_bpm - BPM_LOWER_BOUND]);
+    
+    staged_req_iter = required_iterations;
+    staged_remainder = MILLISECONDS_IN_MINUTE 
+                       - (required_iterations * tempo_map_bpm);
+    staged_divisor = tempo_map_bpm;
+    staged_beats_per_bar = pgm_read_byte(
+        &TIME_SIGNATURES[tempo_map_time_signature].beats_per_bar);
+    staged_bars = bars;
+    staged_voices = tempo_map_voices;
+    staged_ramp_beats = 0;
+    
+    /* A ramp without bars, or to its start BPM, is a plain segment. */
+    if ((bars == 0) || (ramp_start_bpm == tempo_map_bpm)
+        || (ramp_start_bpm > BPM_UPPER_BOUND)
+        || (ramp_start_bpm < BPM_LOWER_BOUND))
+    {
+        staged_ramp = TEMPO_RAMP_NONE;
+    }
+    
+    if (staged_ramp != TEMPO_RAMP_NONE)
+    {
+        stage_tempo_ramp();
+    }
+    
+    is_tempo_segment_staged = true;
+}
+
+
+/**
+* Stages the smooth ramp from ramp_start_bpm to tempo_map_bpm, in 
+* staged_bars bars: the period of its first beat (the one of 
+* ramp_start_bpm), and the delta (linear) or the ratio (exponential) of 
+* the period. Executed by the main loop once per ramp, so the timer 
+* interrupt executes neither divisions nor the power (integer math only:
+* calculate_ramp_ratio).
+*/
+void stage_tempo_ramp()
+{
+    unsigned int start_iterations;
+    unsigned long start_remainder;
+    unsigned int beats = staged_bars * staged_beats_per_bar;
+    long delta;
+    long delta_iter;
+    
+    start_iterations = pgm_read_word(
+        &BeatPeriods::required_iterations[ramp_start_bpm - BPM_LOWER_BOUND]);
+    start_remainder = MILLISECONDS_IN_MINUTE 
+                      - (start_iterations * ramp_start_bpm);
+    
+    staged_req_iter = start_iterations;
+    staged_ramp_beats = beats;
+    
+    if (staged_ramp == TEMPO_RAMP_LINEAR)
+    {
+        staged_divisor = (unsigned long) ramp_start_bpm * tempo_map_bpm 
+                         * beats;
+        staged_remainder = start_remainder * tempo_map_bpm * beats;
+        
+        /* Floor of the delta: the remainder is never negative. */
+        delta = (long) MILLISECONDS_IN_MINUTE 
+                * (ramp_start_bpm - tempo_map_bpm);
+        delta_iter = delta / (long) staged_divisor;
+        delta = delta - (delta_iter * (long) staged_divisor);
+        
+        if (delta < 0)
+        {
+            delta = delta + staged_divisor;
+            delta_iter--;
+        }
+        
+        staged_delta_iter = delta_iter;
+        staged_delta_remainder = delta;
+    }
+    else
+    {
+        staged_divisor = RAMP_PERIOD_ONE;
+        staged_remainder = ((start_remainder << RAMP_PERIOD_SHIFT) 
+                            + (ramp_start_bpm / 2)) / ramp_start_bpm;
+        staged_ratio = calculate_ramp_ratio(beats);
+    }
+}
+
+
+/**
+* Ratio of the period in every beat of the exponential ramp staged, 
+* (ramp_start_bpm / tempo_map_bpm) ^ (1 / beats), with RAMP_RATIO_SHIFT 
+* fractional bits. It is 2 raised to the difference of the logarithms, 
+* divided by the beats (rounded to the nearest). No floating point: the 
+* AVR has no FPU, and pow() would link the soft float library.
+*/
+unsigned long calculate_ramp_ratio(unsigned int beats)
+{
+    long long exponent = calculate_log2(ramp_start_bpm) 
+                         - calculate_log2(tempo_map_bpm);
+    
+    if (exponent < 0)
+    {
+        exponent = -((-exponent + (beats / 2)) / beats);
+    }
+    else
+    {
+        exponent = (exponent + (beats / 2)) / beats;
+    }
+    
+    return calculate_exp2(exponent);
+}
+
+
+/**
+* log2(value) of a BPM value, with RAMP_LOG_SHIFT fractional bits. The 
+* integer part is the position of the most significant bit. The fractional
+* bits are found one by one, from the first, squaring the mantissa (value 
+* shifted to [1, 2), with RAMP_MANTISSA_SHIFT fractional bits): when the 
+* square reaches 2, the bit is 1 and the square is halved.
+*/
+long long calculate_log2(unsigned int value)
+{
+    unsigned long long mantissa;
+    long long logarithm;
+    byte msb = 0;
+    byte bit;
+    
+    while ((value >> msb) > 1)
+    {
+        msb++;
+    }
+    
+    mantissa = (unsigned long long) value << (RAMP_MANTISSA_SHIFT - msb);
+    logarithm = (long long) msb << RAMP_LOG_SHIFT;
+    
+    for (bit = RAMP_LOG_SHIFT; bit > 0; bit--)
+    {
+        mantissa = (mantissa * mantissa) >> RAMP_MANTISSA_SHIFT;
+        
+        if (mantissa >= (2ULL << RAMP_MANTISSA_SHIFT))
+        {
+            mantissa = mantissa >> 1;
+            logarithm = logarithm | (1LL << (bit - 1));
+        }
+    }
+    
+    return logarithm;
+}
+
+
+/**
+* 2 ^ exponent (RAMP_LOG_SHIFT fractional bits), with RAMP_RATIO_SHIFT 
+* fractional bits, for the exponents of the ramps (at most 
+* log2(BPM_UPPER_BOUND) / 2 in absolute value). It is 2 ^ whole, a shift, 
+* times e ^ (fraction * ln(2)), whole being the floor of the exponent; the
+* power of e is its Taylor series, summed until its terms are 0 (every 
+* term is rounded: truncated, their errors would add up to several units
+* of the ratio).
+*/
+unsigned long calculate_exp2(long long exponent)
+{
+    signed char whole = 0;
+    unsigned long long x;
+    unsigned long long term = RAMP_LOG_ONE;
+    unsigned long long power = term;
+    byte order = 1;
+    byte shift;
+    
+    while (exponent < 0)
+    {
+        exponent = exponent + RAMP_LOG_ONE;
+        whole--;
+    }
+    
+    while (exponent >= RAMP_LOG_ONE)
+    {
+        exponent = exponent - RAMP_LOG_ONE;
+        whole++;
+    }
+    
+    x = ((unsigned long long) exponent * RAMP_LN_2) >> RAMP_LOG_SHIFT;
+    
+    while (term != 0)
+    {
+        term = ((((term * x) + (RAMP_LOG_ONE >> 1)) >> RAMP_LOG_SHIFT) 
+                + (order / 2)) / order;
+        power = power + term;
+        order++;
+    }
+    
+    shift = RAMP_LOG_SHIFT - RAMP_RATIO_SHIFT - whole;
+    
+    return (power + (1ULL << (shift - 1))) >> shift;
+}
+
+
+/**
+* Executes the instruction of tempo_map_pc; returns the bars of the segment
+* it starts (0 if it does not start one). After TEMPO_MAP_END, or an 
+* unknown opcode, tempo_map_pc is TEMPO_MAP_SIZE.
+*/
+byte interpret_tempo_map()
+{
+    const byte *instruction = &TEMPO_MAP[tempo_map_pc];
+    byte opcode = pgm_read_byte(instruction);
+    byte operand;
+    byte bars = 0;
+    
+    if (opcode == TEMPO_MAP_PLAY)
+    {
+        tempo_map_bpm = read_tempo_map_word(instruction + 1);
+        bars = pgm_read_byte(instruction + 3);
+        tempo_map_pc = tempo_map_pc + TEMPO_MAP_PLAY_SIZE;
+    }
+    else if (opcode == TEMPO_MAP_RAMP)
+    {
+        bars = ramp_tempo_map_bpm(instruction);
+    }
+    else if (opcode == TEMPO_MAP_TIME_SIGNATURE)
+    {
+        operand = pgm_read_byte(instruction + 1);
+        
+        if (operand < TIME_SIGNATURES_COUNT)
+        {
+            tempo_map_time_signature = operand;
+        }
+        
+        tempo_map_pc = tempo_map_pc + TEMPO_MAP_TIME_SIGNATURE_SIZE;
+    }
+    else if (opcode == TEMPO_MAP_REPEAT)
+    {
+        tempo_map_pc = 0;
+    }
+    else if ((opcode == TEMPO_MAP_LINEAR_RAMP) 
+             || (opcode == TEMPO_MAP_EXPONENTIAL_RAMP))
+    {
+        ramp_start_bpm = tempo_map_bpm;
+        bars = pgm_read_byte(instruction + 1);
+        tempo_map_bpm = read_tempo_map_word(instruction + 2);
+        staged_ramp = (opcode == TEMPO_MAP_LINEAR_RAMP) 
+                      ? TEMPO_RAMP_LINEAR : TEMPO_RAMP_EXPONENTIAL;
+        tempo_map_pc = tempo_map_pc + TEMPO_MAP_SMOOTH_RAMP_SIZE;
+    }
+    else if (opcode == TEMPO_MAP_VOICES)
+    {
+        tempo_map_voices = pgm_read_byte(instruction + 1) & ALL_VOICES_MASK;
+        tempo_map_pc = tempo_map_pc + TEMPO_MAP_VOICES_SIZE;
+    }
+    else
+    {
+        tempo_map_pc = TEMPO_MAP_SIZE;
+    }
+    
+    return bars;
+}
+
+
+/**
+* The words of the program are little-endian, read byte by byte (they are 
+* not aligned).
+*/
+unsigned int read_tempo_map_word(const byte *address)
+{
+    return pgm_read_byte(address) | (pgm_read_byte(address + 1) << 8);
+}
+
+/**
+* One segment of a TEMPO_MAP_RAMP: the BPM moves one step towards the 
+* target, without passing it. Once the target is reached, the next 
+* instruction follows. Returns the bars of the segment (0 after the ramp).
+*/
+byte ramp_tempo_map_bpm(const byte *instruction)
+{
+    signed char step = (signed char) pgm_read_byte(instruction + 1);
+    byte bars = pgm_read_byte(instruction + 2);
+    int target_bpm = read_tempo_map_word(instruction + 3);
+    
+    if ((tempo_map_bpm == target_bpm) || (step == 0))
+    {
+        tempo_map_pc = tempo_map_pc + TEMPO_MAP_RAMP_SIZE;
+        return 0;
+    }
+    
+    tempo_map_bpm = tempo_map_bpm + step;
+    
+    if (((step > 0) && (tempo_map_bpm > target_bpm))
+        || ((step < 0) && (tempo_map_bpm < target_bpm)))
+    {
+        tempo_map_bpm = target_bpm;
+    }
+    
+    return bars;
+}
+
+
+/**
+* lcd.begin() leaves the display cleared (all characters are spaces).
+*/
+void init_lcd_frame()
+{
+    byte row;
+    byte column;
+    
+    for (row = 0; row < LCD_ROWS; row++)
+    {
+        for (column = 0; column < LCD_COLUMNS; column++)
+        {
+            lcd_shown_frame[row][column] = ' ';
+        }
+    }
+    
+    lcd_next_cell = LCD_CELLS;
+    lcd_address_cell = LCD_NO_CELL;
+}
+
+
+void update_lcd()
+{    
+    byte row;
+    byte column;
+    char bpm_text[NUMBER_TEXT_SIZE];
+    
+    for (row = 0; row < LCD_ROWS; row++)
+    {
+        for (column = 0; column < LCD_COLUMNS; column++)
+        {
+            lcd_frame[row][column] = ' ';
+        }
+    }
+    
+    if (is_buzzer_muted == true)
+    {
+        print_lcd_frame_P(0, 0, MUTE_TEXT);
+    }
+    else if (is_tempo_map_running == true)
+    {
+        print_lcd_frame_P(0, 0, TEMPO_MAP_TEXT);
+    }
+    else
+    {
+        /* No operation: the row is blank. */
+    }
+    
+    print_lcd_frame_P(0, SUBDIVISION_COLUMN, SUBDIVISIONS[subdivision].text);
+    
+    column = 0;
+    
+    if (bpm_modifier == -1)
+    {
+        column = print_lcd_frame_P(1, column, SUB_BPM_TEXT);
+    }
+    else if (bpm_modifier == 1)
+    {
+        column = print_lcd_frame_P(1, column, ADD_BPM_TEXT);
+    }
+    else
+    {
+        /* No operation. */
+    }
+    
+    format_number(bpm, bpm_text);
+    print_lcd_frame(1, column, bpm_text);
+    
+    print_lcd_frame_P(1, TIME_SIGNATURE_COLUMN, 
+                      TIME_SIGNATURES[time_signature].text);
+    
+    lcd_next_cell = 0;  /* The new frame is sent by service_lcd(). */
+}
+
+
+/**
+* Returns the column after the text (the text is cut at the end of the row).
+*/
+byte print_lcd_frame(byte row, byte column, const char *text)
+{
+    while ((column < LCD_COLUMNS) && (*text != '\0'))
+    {
+        lcd_frame[row][column] = *text;
+        column++;
+        text++;
+    }
+    
+    return column;
+}
+
+
+/**
+* Same as print_lcd_frame, with a text stored in the flash memory.
+*/
+byte print_lcd_frame_P(byte row, byte column, const char *text)
+{
+    char character = pgm_read_byte(text);
+    
+    while ((column < LCD_COLUMNS) && (character != '\0'))
+    {
+        lcd_frame[row][column] = character;
+        column++;
+        text++;
+        character = pgm_read_byte(text);
+    }
+    
+    return column;
+}
+
+
+/**
+* Integer to ASCII (decimal), in a buffer of NUMBER_TEXT_SIZE characters. 
+* The digits are obtained from the lowest one, and written from the end of
+* the buffer; then, they are moved to its start.
+*/
+void format_number(unsigned int number, char *text)
+{
+    char digits[NUMBER_TEXT_SIZE];
+    byte first_digit = NUMBER_TEXT_SIZE - 1;
+    byte position = 0;
+    
+    digits[first_digit] = '\0';
+    
+    do
+    {
+        first_digit--;
+        digits[first_digit] = '0' + (number % 10);
+        number = number / 10;
+    } while (number != 0);
+    
+    do
+    {
+        text[position] = digits[first_digit];
+        position++;
+        first_digit++;
+    } while (digits[first_digit - 1] != '\0');
+}
+
+
+/**
+* Executed by the main loop. Sends the next changed characters, at most 
+* LCD_BYTES_PER_SLICE bytes; the comparison goes on in the next iteration.
+* The LCD increments its address after every character, so the cursor is 
+* only set at the start of every run of changed characters (i.e: "60" to 
+* "61" is one setCursor and one character). Without changes, nothing is sent.
+*/
+void service_lcd()
+{
+    byte row;
+    byte column;
+    byte sent_bytes = 0;
+    
+    while ((lcd_next_cell < LCD_CELLS) && (sent_bytes < LCD_BYTES_PER_SLICE))
+    {
+        row = lcd_next_cell / LCD_COLUMNS;
+        column = lcd_next_cell % LCD_COLUMNS;
+        
+        if (lcd_frame[row][column] == lcd_shown_frame[row][column])
+        {
+            lcd_next_cell++;
+        }
+        else if (lcd_address_cell != lcd_next_cell)
+        {
+            lcd.setCursor(column, row);
+            lcd_address_cell = lcd_next_cell;
+            sent_bytes++;
+        }
+        else
+        {
+            lcd.write(lcd_frame[row][column]);
+            lcd_shown_frame[row][column] = lcd_frame[row][column];
+            sent_bytes++;
+            
+            /* The address of the next row is not the next one. */
+            lcd_next_cell++;
+            lcd_address_cell = (column < (LCD_COLUMNS - 1)) 
+                               ? lcd_next_cell : LCD_NO_CELL;
+        }
+    }
+}
+
+
+/**
+* All the timers idle, and the wheel at the current tick.
+*/
+void init_timer_wheel()
+{
+    byte slot;
+    byte timer;
+    
+    for (slot = 0; slot < (TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS); slot++)
+    {
+        timer_wheel_slots[slot] = NO_TIMER;
+    }
+    
+    for (timer = 0; timer < TIMERS; timer++)
+    {
+        timer_slots[timer] = TIMER_IDLE;
+    }
+    
+    due_timers = 0;
+    wheel_tick = timer_ticks;
+}
+
+
+/**
+* Executed by the timer interrupt in every tick. When the slots of the 
+* first level wrap, the upper levels are cascaded; then the timers of the
+* slot of the tick are due, and expire (lowest number first) with the ones
+* armed for the same tick meanwhile. Without due timers, a tick costs one 
+* increment and two tests.
+*/
+void serve_timer_wheel()
+{
+    byte timer;
+    TimerHandler handler;
+    
+    while (wheel_tick != timer_ticks)
+    {
+        wheel_tick++;
+        
+        if ((wheel_tick & (TIMER_WHEEL_SLOTS - 1)) == 0)
+        {
+            cascade_timer_wheel();
+        }
+        
+        collect_due_timers(wheel_tick & (TIMER_WHEEL_SLOTS - 1));
+        
+        while (due_timers != 0)
+        {
+            timer = 0;
+            
+            while ((due_timers & (1U << timer)) == 0)
+            {
+                timer++;
+            }
+            
+            due_timers = due_timers & ~(1U << timer);
+            timer_slots[timer] = TIMER_IDLE;
+            handler = (TimerHandler) pgm_read_ptr(&TIMER_HANDLERS[timer]);
+            handler(timer);
+        }
+    }
+}
+
+
+/**
+* The levels whose slots have wrapped in this tick are cascaded, the 
+* highest first: their timers go down to the levels below (or to the first
+* one) before these are cascaded.
+*/
+void cascade_timer_wheel()
+{
+    byte level = 1;
+    unsigned long slot_ticks = wheel_tick >> TIMER_WHEEL_SLOT_BITS;
+    
+    while ((level < (TIMER_WHEEL_LEVELS - 1)) 
+           && ((slot_ticks & (TIMER_WHEEL_SLOTS - 1)) == 0))
+    {
+        slot_ticks = slot_ticks >> TIMER_WHEEL_SLOT_BITS;
+        level++;
+    }
+    
+    while (level != 0)
+    {
+        cascade_timer_slot((level * TIMER_WHEEL_SLOTS) 
+                           + ((wheel_tick >> (level * TIMER_WHEEL_SLOT_BITS))
+                              & (TIMER_WHEEL_SLOTS - 1)));
+        level--;
+    }
+}
+
+
+void cascade_timer_slot(byte slot)
+{
+    byte timer = timer_wheel_slots[slot];
+    byte next_timer;
+    
+    timer_wheel_slots[slot] = NO_TIMER;
+    
+    while (timer != NO_TIMER)
+    {
+        next_timer = next_timers[timer];
+        link_timer(timer);
+        timer = next_timer;
+    }
+}
+
+
+void collect_due_timers(byte slot)
+{
+    byte timer = timer_wheel_slots[slot];
+    
+    timer_wheel_slots[slot] = NO_TIMER;
+    
+    while (timer != NO_TIMER)
+    {
+        timer_slots[timer] = TIMER_DUE;
+        due_timers = due_timers | (1U << timer);
+        timer = next_timers[timer];
+    }
+}
+
+
+/**
+* Executed by the timer interrupt, or with the interrupts disabled. The 
+* tick is less than TIMER_WHEEL_RANGE ticks ahead; a tick already served is
+* due at once (in the timer interrupt), or in the next tick (out of it).
+*/
+void arm_timer(byte timer, unsigned long tick)
+{
+    cancel_timer(timer);
+    timer_expiry_ticks[timer] = tick;
+    
+    if ((long) (tick - wheel_tick) <= 0)
+    {
+        timer_slots[timer] = TIMER_DUE;
+        due_timers = due_timers | (1U << timer);
+    }
+    else
+    {
+        link_timer(timer);
+    }
+}
+
+
+void cancel_timer(byte timer)
+{
+    byte slot = timer_slots[timer];
+    
+    if (slot == TIMER_IDLE)
+    {
+        return;
+    }
+    
+    if (slot == TIMER_DUE)
+    {
+        due_timers = due_timers & ~(1U << timer);
+    }
+    else
+    {
+        if (previous_timers[timer] == NO_TIMER)
+        {
+            timer_wheel_slots[slot] = next_timers[timer];
+        }
+        else
+        {
+            next_timers[previous_timers[timer]] = next_timers[timer];
+        }
+        
+        if (next_timers[timer] != NO_TIMER)
+        {
+            previous_timers[next_timers[timer]] = previous_timers[timer];
+        }
+    }
+    
+    timer_slots[timer] = TIMER_IDLE;
+}
 
-LiquidCrystal lcd(2, 3, 4, 5, 6, 7);
 
-const int BPM_UPPER_BOUND           = 300;
-const int BPM_LOWER_BOUND           = 1;
+/**
+* The timer goes to the first slot of the lowest level that holds its 
+* distance, in the slot of its tick bits (at most 
+* TIMER_WHEEL_LEVELS - 1 shifts).
+*/
+void link_timer(byte timer)
+{
+    unsigned long tick = timer_expiry_ticks[timer];
+    unsigned long distance = (tick - wheel_tick) >> TIMER_WHEEL_SLOT_BITS;
+    byte level = 0;
+    byte slot;
+    
+    while (distance != 0)
+    {
+        distance = distance >> TIMER_WHEEL_SLOT_BITS;
+        tick = tick >> TIMER_WHEEL_SLOT_BITS;
+        level++;
+    }
+    
+    slot = (level * TIMER_WHEEL_SLOTS) + (tick & (TIMER_WHEEL_SLOTS - 1));
+    
+    timer_slots[timer] = slot;
+    previous_timers[timer] = NO_TIMER;
+    next_timers[timer] = timer_wheel_slots[slot];
+    
+    if (timer_wheel_slots[slot] != NO_TIMER)
+    {
+        previous_timers[timer_wheel_slots[slot]] = timer;
+    }
+    
+    timer_wheel_slots[slot] = timer;
+}
 
-const int SOUND_DURATION            = 25;   /* In Milliseconds. */
-const int MILLISECONDS_IN_SECOND    = 1000; 
-  
-const double SECONDS_IN_MINUTE = 60.00; /*  double type to force decimals
-                                        *   in the divisions.
-                                        */  
 
-int last_pressed_button_pin;
-int bpm;
-int bpm_modifier; /* 1 (one) or -1 (minus one). */
-int iteration_counter;
+/**
+* Executed with the interrupts disabled, when the deadlines of the beats 
+* are changed by the main loop: the beat timer is armed while the buzzer 
+* is unmuted, and the sub-beat timer while the beat has sub-beats left.
+*/
+void arm_beat_timers()
+{
+    if (is_buzzer_muted == false)
+    {
+        arm_timer(TIMER_BEAT, beat_deadline_tick);
+    }
+    else
+    {
+        cancel_timer(TIMER_BEAT);
+    }
+    
+    if (pending_subdivisions != 0)
+    {
+        arm_timer(TIMER_SUBDIVISION, subdivision_deadline_tick);
+    }
+    else
+    {
+        cancel_timer(TIMER_SUBDIVISION);
+    }
+}
 
-unsigned int bpm_freq_req_iter; /*  bpm frequency required iterations.
-                                *   unsigned int in order to store a max. value
-                                *   of 59975.
-                                */
-                                           
-boolean is_buzzer_muted;   
 
-/******************************************************************************/
+void expire_buzzer_off(byte /* timer */)
+{
+    stop_buzzer();
+}
 
 
-void setup()
+/**
+* A beat starts the sound at its deadline, and the sound is stopped 
+* SOUND_DURATION ticks later (ACCENT_SOUND_DURATION for the downbeat of the
+* bar); there is no delay, so the main loop is never blocked by the buzzer.
+* The sub-beats of a beat are between it and the next beat, so they never
+* are due in the same tick than a beat.
+* In the downbeats, the tempo map can switch to its next segment before the
+* next beat is scheduled. Every beat schedules the voices, and their events
+* expire after it: a pulse in the tick of the beat sounds after it.
+*/
+void expire_beat(byte /* timer */)
 {
-    pinMode(MUTE_BUZZER_BUTTON_PIN, INPUT);
-    pinMode(CHANGE_BPM_BY_TEN_BUTTON_PIN, INPUT);
-    pinMode(CHANGE_BPM_BY_ONE_BUTTON_PIN, INPUT);
-    pinMode(ADD_OR_SUB_BPM_BUTTON_PIN, INPUT);
-    pinMode(RESTART_BPM_BUTTON_PIN, INPUT);
+    unsigned long beat_tick = beat_deadline_tick;
     
-    pinMode(ACTIVE_BUZZER_PIN, OUTPUT);
-
-    lcd.begin(16, 2); /* Set LCD number of columns and rows. */ 
+    if ((beat_in_bar == 0) && (is_tempo_map_running == true))
+    {
+        advance_tempo_map();
+    }
     
-    reset_bpm();
-    update_lcd();
+    schedule_next_beat();
+    arm_timer(TIMER_BEAT, beat_deadline_tick);
+    schedule_subdivisions(beat_tick);
     
-    last_pressed_button_pin     = 0;
-    iteration_counter           = 0;
+    if (active_voices != 0)
+    {
+        schedule_voices(beat_tick);
+    }
+    
+    if (tempo_ramp_beats_left != 0)
+    {
+        advance_tempo_ramp();
+    }
+    
+    play_buzzer();
 }
 
 
-void loop() /* Cyclic Executive at 16MHz. */
+void expire_subdivision(byte /* timer */)
 {
-    check_button_pressing();
-    process_bpm_frequency();
+    pending_subdivisions--;
+    schedule_next_subdivision();
+    play_subdivision();
 }
 
 
-void check_button_pressing()
+void expire_voice_event(byte /* timer */)
 {
-    int pin_to_check;
+    serve_voice_events();
+}
+
+
+/**
+* Executed by the timer interrupt in every downbeat while the tempo map 
+* runs. When the bars of the current segment end, the staged one starts:
+* a few assignments, and the step of the sub-beats (one multiplication), 
+* with no division. The accumulated fraction starts again, so the downbeat
+* is the origin of the new timeline, and new voices start their cycles in
+* it. If the main loop has not staged the next segment yet, the current 
+* one goes on for one more bar.
+*/
+void advance_tempo_map()
+{
+    if (tempo_map_bars_left != 0)
+    {
+        tempo_map_bars_left--;
+        return;
+    }
+    
+    if (is_tempo_segment_staged == false)
+    {
+        return;
+    }
+    
+    beats_per_bar = staged_beats_per_bar;
+    
+    if (staged_bars == 0)
+    {
+        is_tempo_map_running = false;
+    }
+    else
+    {
+        tempo_map_bars_left = staged_bars - 1;
+    }
     
-    for (pin_to_check = 9; pin_to_check <= 13; pin_to_check++)
+    /* After a smooth ramp, the end keeps its target (the staged period). */
+    if ((staged_bars != 0) || (tempo_ramp != TEMPO_RAMP_NONE))
     {
-        detect_single_pulsation(pin_to_check);
+        bpm_freq_req_iter = staged_req_iter;
+        bpm_freq_remainder = staged_remainder;
+        bpm_freq_divisor = staged_divisor;
+        beat_error_accumulator = 0;
+        set_subdivision_step();
     }
+    
+    if (staged_voices != active_voices)
+    {
+        active_voices = staged_voices;
+        restart_voices();
+    }
+    
+    tempo_ramp = staged_ramp;
+    tempo_ramp_beats_left = staged_ramp_beats;
+    ramp_delta_iter = staged_delta_iter;
+    ramp_delta_remainder = staged_delta_remainder;
+    ramp_ratio = staged_ratio;
+    is_tempo_segment_staged = false;
+    is_tempo_map_changed = true;
 }
 
 
 /**
-* Detect the button that, after being pressed, has been released.
-* Actions are performed only in the releasing process of a button, not in
-* the pressings. This is done to avoid complex State Change Detection
-* methods, and to allow the user to control the modifications (start and stop).
+* Executed by the timer interrupt after every beat of a smooth ramp, once
+* the beat and its sub-beats are scheduled: the period of the next beat. 
+* Linear: two additions (and the carry of the fraction). Exponential: one
+* fixed point multiplication, rounded. No division in both cases; the step
+* of the sub-beats follows the new period.
 */
-void detect_single_pulsation(int pin_to_check)
+void advance_tempo_ramp()
 {
-    /* Detect what button is pressed. */
-    if (digitalRead(pin_to_check) == HIGH)
+    unsigned long long period;
+    
+    if (tempo_ramp == TEMPO_RAMP_LINEAR)
     {
-        last_pressed_button_pin = pin_to_check;
+        bpm_freq_req_iter = bpm_freq_req_iter + ramp_delta_iter;
+        bpm_freq_remainder = bpm_freq_remainder + ramp_delta_remainder;
+        
+        if (bpm_freq_remainder >= bpm_freq_divisor)
+        {
+            bpm_freq_remainder = bpm_freq_remainder - bpm_freq_divisor;
+            bpm_freq_req_iter++;
+        }
     }
-    
-    /* Detect if the pressed button is now released. */
-    if ((digitalRead(pin_to_check) == LOW)
-        && (last_pressed_button_pin == pin_to_check))
+    else
     {
-        last_pressed_button_pin = 0;
-        perform_operation(pin_to_check);
-    } 
+        period = ((unsigned long) bpm_freq_req_iter << RAMP_PERIOD_SHIFT) 
+                 | bpm_freq_remainder;
+        period = ((period * ramp_ratio) + (RAMP_RATIO_ONE >> 1)) 
+                 >> RAMP_RATIO_SHIFT;
+        bpm_freq_req_iter = period >> RAMP_PERIOD_SHIFT;
+        bpm_freq_remainder = period & (RAMP_PERIOD_ONE - 1);
+    }
+    
+    tempo_ramp_beats_left--;
+    set_subdivision_step();
 }
 
 
-void perform_operation(int pin_to_check)
+void schedule_next_beat()
 {
-    switch (pin_to_check) 
+    beat_deadline_tick = beat_deadline_tick + bpm_freq_req_iter;
+    beat_error_accumulator = beat_error_accumulator + bpm_freq_remainder;
+    
+    if (beat_error_accumulator >= bpm_freq_divisor)
     {
-        case 9:
-            reset_bpm();
-            break;
-        case 10:
-            invert_bpm_modifier();
-            break;
-        case 11:
-            update_bpm(1);
-            break;
-        case 12:
-            update_bpm(10);
-            break;
-        case 13:
-            change_mute_state();
-            break;
-        default: 
-            /* No operation. */
-        break;
+        beat_error_accumulator = beat_error_accumulator - bpm_freq_divisor;
+        beat_deadline_tick++;
     }
-    
-    update_lcd();
 }
 
 
-void reset_bpm()
+/**
+* The step of the beat is the step of the base period, or, if the beat has
+* one tick more (fraction of the period), one more unit of remainder. No 
+* division: one comparison and one increment per beat.
+*/
+void schedule_subdivisions(unsigned long beat_tick)
 {
-    bpm                 = 60;
-    bpm_modifier        = 1;
-    bpm_freq_req_iter   = 975;
-    is_buzzer_muted     = true;
+    beat_subdivision_iter = subdivision_req_iter;
+    beat_subdivision_remainder = subdivision_remainder;
+    
+    if ((beat_deadline_tick - beat_tick) != bpm_freq_req_iter)
+    {
+        beat_subdivision_remainder++;
+        
+        if (beat_subdivision_remainder == clicks_per_beat)
+        {
+            beat_subdivision_remainder = 0;
+            beat_subdivision_iter++;
+        }
+    }
+    
+    subdivision_deadline_tick = beat_tick;
+    subdivision_error_accumulator = 0;
+    pending_subdivisions = clicks_per_beat - 1;
+    schedule_next_subdivision();
 }
 
 
-void invert_bpm_modifier()
+/**
+* The sub-beat i of a beat is floor(i * period / clicks_per_beat) ticks 
+* after it. Its timer is armed if the beat has sub-beats left.
+*/
+void schedule_next_subdivision()
 {
-    bpm_modifier = bpm_modifier * -1;
+    subdivision_deadline_tick = subdivision_deadline_tick 
+                                + beat_subdivision_iter;
+    subdivision_error_accumulator = subdivision_error_accumulator 
+                                    + beat_subdivision_remainder;
+    
+    if (subdivision_error_accumulator >= clicks_per_beat)
+    {
+        subdivision_error_accumulator = subdivision_error_accumulator 
+                                        - clicks_per_beat;
+        subdivision_deadline_tick++;
+    }
+    
+    if (pending_subdivisions != 0)
+    {
+        arm_timer(TIMER_SUBDIVISION, subdivision_deadline_tick);
+    }
 }
 
 
-void update_bpm(int value)
+/**
+* The downbeat of the bar sounds ACCENT_SOUND_DURATION.
+*/
+void play_buzzer()
 {
-    bpm = bpm + (bpm_modifier * value);
+    PortBPin<ACTIVE_BUZZER_PIN>::set_high();
     
-    if (bpm > BPM_UPPER_BOUND)
+    if (advance_beat_in_bar() == true)
     {
-        bpm = BPM_UPPER_BOUND;
-    } 
-    else if (bpm < BPM_LOWER_BOUND)
+        buzzer_off_tick = timer_ticks + ACCENT_SOUND_DURATION;
+    }
+    else
     {
-        bpm = BPM_LOWER_BOUND;
+        buzzer_off_tick = timer_ticks + SOUND_DURATION;
     }
-    else 
+    
+    is_buzzer_sounding = true;
+    arm_timer(TIMER_BUZZER_OFF, buzzer_off_tick);
+}
+
+
+/**
+* Returns true if the beat is the downbeat, and moves to the next beat of 
+* the bar.
+*/
+boolean advance_beat_in_bar()
+{
+    boolean is_downbeat = (beat_in_bar == 0);
+    
+    beat_in_bar++;
+    
+    if (beat_in_bar == beats_per_bar)
     {
-        /* No operation. */
+        beat_in_bar = 0;
     }
     
-    calculate_required_iterations();
+    return is_downbeat;
 }
 
 
-void calculate_required_iterations()
+void play_subdivision()
+{
+    PortBPin<ACTIVE_BUZZER_PIN>::set_high();
+    buzzer_off_tick = timer_ticks + SUBDIVISION_SOUND_DURATION;
+    is_buzzer_sounding = true;
+    arm_timer(TIMER_BUZZER_OFF, buzzer_off_tick);
+}
+
+
+void stop_buzzer()
 {
-    double temp_required_iterations;
+    PortBPin<ACTIVE_BUZZER_PIN>::set_low();
+    is_buzzer_sounding = false;
+}
+
+
+/**
+* Executed by the timer interrupt in every beat, once the next one is 
+* scheduled: for every active voice, the step of the beat (its period / 
+* pulses, with the multiplier: the estimate is never less than the floor, 
+* nor more than the floor plus one, since the period is less than 2^16 
+* ticks), and its first pulse in the beat, if the beat has one.
+*/
+void schedule_voices(unsigned long beat_tick)
+{
+    unsigned long period = beat_deadline_tick - beat_tick;
+    unsigned long step;
+    byte voice;
+    byte pulses;
     
-    temp_required_iterations 
-        = ((SECONDS_IN_MINUTE / bpm) * MILLISECONDS_IN_SECOND) - SOUND_DURATION;
-        
-    bpm_freq_req_iter = (unsigned int) temp_required_iterations;
+    voices_beat_tick = beat_tick;
+    
+    for (voice = 0; voice < VOICES_COUNT; voice++)
+    {
+        if ((active_voices & (1 << voice)) != 0)
+        {
+            pulses = pgm_read_byte(&VOICES[voice].pulses);
+            step = (period * pgm_read_dword(&VOICE_MULTIPLIERS[pulses])) 
+                   >> VOICE_MULTIPLIER_SHIFT;
+            
+            if ((step * pulses) > period)
+            {
+                step--;
+            }
+            
+            voice_step_iters[voice] = step;
+            voice_step_remainders[voice] = period - (step * pulses);
+            
+            if (voice_beats[voice] == 0)
+            {
+                voice_pulses[voice] = 0;
+                voice_positions[voice] = 0;
+            }
+            else
+            {
+                voice_positions[voice] = voice_positions[voice] - pulses;
+            }
+            
+            voice_beats[voice]++;
+            
+            if (voice_beats[voice] == pgm_read_byte(&VOICES[voice].beats))
+            {
+                voice_beats[voice] = 0;
+            }
+            
+            if (voice_positions[voice] < pulses)
+            {
+                push_voice_event(beat_tick 
+                                 + voice_pulse_offset(voice, pulses), voice);
+            }
+        }
+    }
 }
 
 
-void change_mute_state()
+/**
+* floor(position * period / pulses) ticks: position * step, plus the floor
+* of position * remainder / pulses (less than pulses, exact with the 
+* multiplier).
+*/
+unsigned long voice_pulse_offset(byte voice, byte pulses)
 {
-    is_buzzer_muted = !is_buzzer_muted;
+    byte position = voice_positions[voice];
+    unsigned int fraction = position * voice_step_remainders[voice];
+    
+    return ((unsigned long) position * voice_step_iters[voice])
+           + ((fraction * pgm_read_dword(&VOICE_MULTIPLIERS[pulses])) 
+              >> VOICE_MULTIPLIER_SHIFT);
 }
 
 
-void update_lcd()
-{    
-    lcd.clear();
+/**
+* Executed by the timer of the first event of the heap (armed at its tick 
+* by push_voice_event and pop_voice_event). Several voices can sound in the
+* same tick.
+*/
+void serve_voice_events()
+{
+    byte code;
     
-    lcd.setCursor(0, 0);
-    if (is_buzzer_muted == true)
+    while ((voice_event_count != 0)
+           && ((long) (timer_ticks - voice_event_ticks[0]) >= 0))
+    {
+        code = voice_event_codes[0];
+        pop_voice_event();
+        
+        if ((code & VOICE_EVENT_OFF) != 0)
+        {
+            code = code & ~VOICE_EVENT_OFF;
+            digitalWrite(pgm_read_byte(&VOICES[code].pin), LOW);
+            sounding_voice_pins = sounding_voice_pins & ~(1 << code);
+        }
+        else
+        {
+            play_voice(code);
+        }
+    }
+}
+
+
+/**
+* The pulse sounds in the output of the voice, accented or not, and the 
+* next pulse is pushed if it is in the same beat (otherwise, 
+* schedule_voices pushes it in its beat). In the buzzer, the sound of a 
+* beat or a sub-beat is not shortened. The pins of the voices are written
+* with digitalWrite: they are not known at compile time.
+*/
+void play_voice(byte voice)
+{
+    const Voice *entry = &VOICES[voice];
+    byte pulses = pgm_read_byte(&entry->pulses);
+    byte output = pgm_read_byte(&entry->output);
+    byte pin = pgm_read_byte(&entry->pin);
+    unsigned int duration;
+    
+    if (((pgm_read_byte(&entry->accents) >> voice_pulses[voice]) & 1) != 0)
     {
-        lcd.print("MUTE_MUTE_MUTE_");
+        duration = pgm_read_byte(&entry->accent_sound_duration);
     }
-    else if (is_buzzer_muted == false)
+    else
     {
-        lcd.print("");
+        duration = pgm_read_byte(&entry->sound_duration);
     }
-    else 
+    
+    if (output == VOICE_OUTPUT_BUZZER)
     {
-        /* No operation. */
+        PortBPin<ACTIVE_BUZZER_PIN>::set_high();
+        
+        if ((is_buzzer_sounding == false)
+            || ((long) (timer_ticks + duration - buzzer_off_tick) > 0))
+        {
+            buzzer_off_tick = timer_ticks + duration;
+            arm_timer(TIMER_BUZZER_OFF, buzzer_off_tick);
+        }
+        
+        is_buzzer_sounding = true;
+    }
+    else if (output == VOICE_OUTPUT_PIN)
+    {
+        digitalWrite(pin, HIGH);
+        
+        if ((sounding_voice_pins & (1 << voice)) == 0)
+        {
+            sounding_voice_pins = sounding_voice_pins | (1 << voice);
+            push_voice_event(timer_ticks + duration, 
+                             voice | VOICE_EVENT_OFF);
+        }
+    }
+    else
+    {
+        tone(pin, pgm_read_word(&entry->tone_frequency), duration);
     }
     
-    String bpm_text_info;
-    lcd.setCursor(0, 1);
+    voice_pulses[voice]++;
+    voice_positions[voice] = voice_positions[voice] 
+                             + pgm_read_byte(&entry->beats);
     
-    if (bpm_modifier == -1)
+    if (voice_positions[voice] < pulses)
     {
-        bpm_text_info = "SUB BPM: ";        
+        push_voice_event(voices_beat_tick 
+                         + voice_pulse_offset(voice, pulses), voice);
     }
-    else if (bpm_modifier == 1)
+}
+
+
+/**
+* The event goes up from the end of the heap while its deadline is earlier
+* than the one of its parent. If the heap is full, the event is lost; it 
+* never is: every voice has one pulse and one end of sound at most. A new 
+* first event arms the timer of the heap.
+*/
+void push_voice_event(unsigned long tick, byte code)
+{
+    byte entry = voice_event_count;
+    byte parent;
+    
+    if (entry == VOICE_EVENTS_SIZE)
     {
-        bpm_text_info = "ADD BPM: ";
+        return;
     }
-    else
+    
+    voice_event_count++;
+    
+    while ((entry != 0) 
+           && ((long) (tick - voice_event_ticks[(entry - 1) >> 1]) < 0))
     {
-        /* No operation. */
+        parent = (entry - 1) >> 1;
+        voice_event_ticks[entry] = voice_event_ticks[parent];
+        voice_event_codes[entry] = voice_event_codes[parent];
+        entry = parent;
     }
     
-    bpm_text_info.concat(bpm);
-    lcd.print(bpm_text_info);
+    voice_event_ticks[entry] = tick;
+    voice_event_codes[entry] = code;
+    
+    if (entry == 0)
+    {
+        arm_timer(TIMER_VOICE_EVENT, tick);
+    }
 }
 
 
-void process_bpm_frequency()
+/**
+* The first event is removed: the last one goes down from the top while 
+* the earliest of its children has an earlier deadline.
+*/
+void pop_voice_event()
 {
-    if (is_buzzer_muted == false)
+    byte entry = 0;
+    byte child = 1;
+    unsigned long tick;
+    byte code;
+    boolean is_placed = false;
+    
+    voice_event_count--;
+    tick = voice_event_ticks[voice_event_count];
+    code = voice_event_codes[voice_event_count];
+    
+    while ((is_placed == false) && (child < voice_event_count))
     {
-        delay(1);
-        iteration_counter++;
-        if (iteration_counter >= bpm_freq_req_iter)
+        if (((child + 1) < voice_event_count)
+            && ((long) (voice_event_ticks[child + 1] 
+                        - voice_event_ticks[child]) < 0))
+        {
+            child++;
+        }
+        
+        if ((long) (voice_event_ticks[child] - tick) < 0)
         {
-            play_buzzer();
-            iteration_counter = 0;
+            voice_event_ticks[entry] = voice_event_ticks[child];
+            voice_event_codes[entry] = voice_event_codes[child];
+            entry = child;
+            child = (2 * entry) + 1;
         }
+        else
+        {
+            is_placed = true;
+        }
+    }
+    
+    voice_event_ticks[entry] = tick;
+    voice_event_codes[entry] = code;
+    
+    if (voice_event_count != 0)
+    {
+        arm_timer(TIMER_VOICE_EVENT, voice_event_ticks[0]);
+    }
+    else
+    {
+        cancel_timer(TIMER_VOICE_EVENT);
     }
 }
 
 
-void play_buzzer()
+/**
+* Executed with the interrupts disabled: the events are dropped, the pins 
+* of the voices go low, and every cycle starts again in the next beat.
+*/
+void restart_voices()
 {
-    digitalWrite(ACTIVE_BUZZER_PIN, HIGH);
-    delay(SOUND_DURATION);
-    digitalWrite(ACTIVE_BUZZER_PIN, LOW);
+    byte voice;
+    
+    voice_event_count = 0;
+    cancel_timer(TIMER_VOICE_EVENT);
+    
+    for (voice = 0; voice < VOICES_COUNT; voice++)
+    {
+        voice_beats[voice] = 0;
+        
+        if ((sounding_voice_pins & (1 << voice)) != 0)
+        {
+            digitalWrite(pgm_read_byte(&VOICES[voice].pin), LOW);
+        }
+    }
+    
+    sounding_voice_pins = 0;
 }
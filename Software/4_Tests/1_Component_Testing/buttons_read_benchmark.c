@@ -0,0 +1,243 @@
+/*******************************************************************************
+*   Project:        Beethduino, an Arduino Do-it-yourself electronic metronome.
+*
+*   File:           buttons_read_benchmark.c
+*
+*   Description:    Beethduino Component Benchmark.
+*                   Its purpose is to measure, in the board, the CPU cycles
+*                   of the three versions of the button input path:
+*                   - Polling: the first "check_button_pressing", executed
+*                   in every main loop (two digitalRead per button).
+*                   - Pin by pin latch: pin change interrupt body that reads
+*                   every button with digitalRead.
+*                   - Port snapshot latch: pin change interrupt body that
+*                   reads PINB once (current version).
+*                   The results are printed in the serial monitor; press
+*                   buttons while it runs to measure the edges too.
+*
+*   Language:       Arduino (C/C++ set, compatible with avr-g++).
+*                   Compiled in Arduino IDE, version 1.6.13
+*
+*   Dependencies:   None.
+*
+*   Notes:          BPM - Beats Per Minute.
+*                   LCD - Liquid Crystal Display.
+*                   Timer1 counts CPU cycles (no prescaler); the cycles of
+*                   an empty measurement are subtracted. The same versions
+*                   are compared in the host simulator by
+*                   beethduino_host_benchmark_button_snapshot.cpp.
+*
+*   Author:         Alberto Martin Cajal
+*                   amartin.glimpse23@gmail.com
+*                   amartin<DOT>glimpse23<AT>gmail<DOT>.com
+*
+*   License:        GNU GPL v3.0
+*
+*   URL:            https://github.com/amcajal/beethduino
+*
+*******************************************************************************/
+
+const int MUTE_BUZZER_BUTTON_PIN        = 13;
+const int CHANGE_BPM_BY_TEN_BUTTON_PIN  = 12;
+const int CHANGE_BPM_BY_ONE_BUTTON_PIN  = 11;
+const int ADD_OR_SUB_BPM_BUTTON_PIN     = 10;
+const int RESET_BPM_BUTTON_PIN          = 9;
+
+const int FIRST_BUTTON_PIN              = 9;
+const int LAST_BUTTON_PIN               = 13;
+const int PORTB_FIRST_PIN               = 8;    /* Digital pin of PB0. */
+const byte BUTTON_PINS_MASK             = (1 << PINB1) | (1 << PINB2)
+                                          | (1 << PINB3) | (1 << PINB4)
+                                          | (1 << PINB5);
+
+const int MEASUREMENTS                  = 1000;
+
+int last_pressed_button_pin;
+volatile int detected_events;   /* volatile: the code shall not be removed. */
+
+byte pin_by_pin_levels;         /* Bit 0 is pin 9. */
+byte button_pin_levels;         /* PINB bits. */
+
+unsigned int empty_cycles;
+
+/******************************************************************************/
+
+
+void setup()
+{
+    pinMode(MUTE_BUZZER_BUTTON_PIN, INPUT);
+    pinMode(CHANGE_BPM_BY_TEN_BUTTON_PIN, INPUT);
+    pinMode(CHANGE_BPM_BY_ONE_BUTTON_PIN, INPUT);
+    pinMode(ADD_OR_SUB_BPM_BUTTON_PIN, INPUT);
+    pinMode(RESET_BPM_BUTTON_PIN, INPUT);
+
+    last_pressed_button_pin = 0;
+    pin_by_pin_levels = 0;
+    button_pin_levels = 0;
+
+    /* Timer1 in normal mode, without prescaler: one count per CPU cycle. */
+    TCCR1A = 0;
+    TCCR1B = (1 << CS10);
+    TIMSK1 = 0;
+
+    Serial.begin(9600); /* Start serial port at 9600 bps. */
+    Serial.println("Buttons read benchmark started (CPU cycles, min / max)");
+
+    empty_cycles = 0;
+    empty_cycles = measure_min_cycles(empty_input_path);
+}
+
+
+void loop() /* Cyclic Executive at 16MHz. */
+{
+    print_cycles("polling:             ", polling_check_button_pressing);
+    print_cycles("pin by pin latch:    ", pin_by_pin_latch_button_events);
+    print_cycles("port snapshot latch: ", port_snapshot_latch_button_events);
+    Serial.println("");
+
+    delay(1000);
+}
+
+
+void print_cycles(const char *name, void (*input_path)())
+{
+    Serial.print(name);
+    Serial.print(measure_min_cycles(input_path));
+    Serial.print(" / ");
+    Serial.println(measure_max_cycles(input_path));
+}
+
+
+unsigned int measure_min_cycles(void (*input_path)())
+{
+    unsigned int min_cycles = 0xFFFF;
+
+    for (int i = 0; i < MEASUREMENTS; i++)
+    {
+        unsigned int cycles = measure_cycles(input_path);
+
+        if (cycles < min_cycles)
+        {
+            min_cycles = cycles;
+        }
+    }
+
+    return min_cycles;
+}
+
+
+unsigned int measure_max_cycles(void (*input_path)())
+{
+    unsigned int max_cycles = 0;
+
+    for (int i = 0; i < MEASUREMENTS; i++)
+    {
+        unsigned int cycles = measure_cycles(input_path);
+
+        if (cycles > max_cycles)
+        {
+            max_cycles = cycles;
+        }
+    }
+
+    return max_cycles;
+}
+
+
+/**
+* Interrupts disabled: the millis() interrupt shall not be measured.
+*/
+unsigned int measure_cycles(void (*input_path)())
+{
+    unsigned int start_cycles;
+    unsigned int end_cycles;
+
+    noInterrupts();
+    start_cycles = TCNT1;
+    input_path();
+    end_cycles = TCNT1;
+    interrupts();
+
+    return end_cycles - start_cycles - empty_cycles;
+}
+
+
+void empty_input_path()
+{
+}
+
+
+void polling_check_button_pressing()
+{
+    int pin_to_check;
+
+    for (pin_to_check = 9; pin_to_check <= 13; pin_to_check++)
+    {
+        polling_detect_single_pulsation(pin_to_check);
+    }
+}
+
+
+void polling_detect_single_pulsation(int pin_to_check)
+{
+    /* Detect what button is pressed. */
+    if (digitalRead(pin_to_check) == HIGH)
+    {
+        last_pressed_button_pin = pin_to_check;
+    }
+
+    /* Detect if the pressed button is now released. */
+    if ((digitalRead(pin_to_check) == LOW)
+        && (last_pressed_button_pin == pin_to_check))
+    {
+        last_pressed_button_pin = 0;
+        detected_events++;
+    }
+}
+
+
+void pin_by_pin_latch_button_events()
+{
+    int pin_to_check;
+    byte pin_bit;
+    byte pin_level;
+
+    for (pin_to_check = FIRST_BUTTON_PIN; pin_to_check <= LAST_BUTTON_PIN;
+         pin_to_check++)
+    {
+        pin_bit = 1 << (pin_to_check - FIRST_BUTTON_PIN);
+        pin_level = digitalRead(pin_to_check);
+
+        if ((pin_level == HIGH) != ((pin_by_pin_levels & pin_bit) != 0))
+        {
+            pin_by_pin_levels = pin_by_pin_levels ^ pin_bit;
+            detected_events++;
+        }
+    }
+}
+
+
+void port_snapshot_latch_button_events()
+{
+    int pin_to_check;
+    byte pin_bit;
+    byte port_snapshot;
+    byte changed_pins;
+
+    port_snapshot = PINB & BUTTON_PINS_MASK;
+    changed_pins = port_snapshot ^ button_pin_levels;
+    button_pin_levels = port_snapshot;
+
+    for (pin_to_check = FIRST_BUTTON_PIN;
+         (pin_to_check <= LAST_BUTTON_PIN) && (changed_pins != 0);
+         pin_to_check++)
+    {
+        pin_bit = 1 << (pin_to_check - PORTB_FIRST_PIN);
+
+        if ((changed_pins & pin_bit) != 0)
+        {
+            changed_pins = changed_pins ^ pin_bit;
+            detected_events++;
+        }
+    }
+}
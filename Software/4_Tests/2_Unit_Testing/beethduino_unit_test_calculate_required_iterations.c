@@ -31,14 +31,57 @@
 const int BPM_UPPER_BOUND           = 300;
 const int BPM_LOWER_BOUND           = 1;
 
-const int SOUND_DURATION          = 25;   /* In Milliseconds. */
-const int MILLISECONDS_IN_SECOND  = 1000;
+const unsigned int MILLISECONDS_IN_MINUTE = 60000;
+
+/*  Table of beat periods (required iterations) for every BPM value, 
+*   generated at compile time and stored in the flash memory (PROGMEM). 
+*   BpmSequence holds the BPM values from BPM_LOWER_BOUND to BPM_UPPER_BOUND;
+*   BeatPeriodTable expands it into one MILLISECONDS_IN_MINUTE / bpm per BPM.
+*   In this way, no division is executed when the BPM is changed.
+*/
+template <unsigned int... BPM_VALUES>
+struct BpmSequence
+{
+};
+
+template <unsigned int FIRST_BPM, unsigned int LAST_BPM, 
+          unsigned int... BPM_VALUES>
+struct MakeBpmSequence 
+    : MakeBpmSequence<FIRST_BPM, LAST_BPM - 1, LAST_BPM, BPM_VALUES...>
+{
+};
 
-const double SECONDS_IN_MINUTE = 60.00; /*  double type to force decimals
-                                        *   in the divisions.
-                                        */                                                  
+template <unsigned int FIRST_BPM, unsigned int... BPM_VALUES>
+struct MakeBpmSequence<FIRST_BPM, FIRST_BPM, BPM_VALUES...>
+{
+    typedef BpmSequence<FIRST_BPM, BPM_VALUES...> type;
+};
+
+template <typename BPM_SEQUENCE>
+struct BeatPeriodTable;
+
+template <unsigned int... BPM_VALUES>
+struct BeatPeriodTable< BpmSequence<BPM_VALUES...> >
+{
+    static const unsigned int required_iterations[sizeof...(BPM_VALUES)];
+};
+
+template <unsigned int... BPM_VALUES>
+const unsigned int BeatPeriodTable< BpmSequence<BPM_VALUES...> >
+    ::required_iterations[sizeof...(BPM_VALUES)] PROGMEM =
+{
+    (MILLISECONDS_IN_MINUTE / BPM_VALUES)...
+};
+
+typedef BeatPeriodTable< 
+            MakeBpmSequence<BPM_LOWER_BOUND, BPM_UPPER_BOUND>::type > 
+        BeatPeriods;
 
 unsigned int bpm_freq_req_iter;
+unsigned int bpm_freq_remainder;
+unsigned int bpm_freq_divisor;
+unsigned int beat_error_accumulator;
+unsigned long beat_deadline_tick;
 int bpm;
 
 boolean is_unit_testing_done;
@@ -74,6 +117,7 @@ void execute_tests()
     test_bpm_lower_bound();
     test_bpm_upper_bound();
     test_bpm_nominal_value();
+    test_all_bpm_values();
 }
 
 
@@ -103,7 +147,24 @@ void test_bpm_nominal_value()
     bpm = 146;
     calculate_required_iterations();
     check_assertions();
-    assert (bpm_freq_req_iter == 385);
+    assert (bpm_freq_req_iter == 410);
+    assert (bpm_freq_remainder == 140);
+    restore_initial_test_values();
+}
+
+
+/**
+* Check the whole table against the division it replaces.
+*/
+void test_all_bpm_values()
+{
+    Serial.println("test_all_bpm_values");
+    for (bpm = BPM_LOWER_BOUND; bpm <= BPM_UPPER_BOUND; bpm++)
+    {
+        calculate_required_iterations();
+        check_assertions();
+        assert (bpm_freq_req_iter == MILLISECONDS_IN_MINUTE / bpm);
+    }
     restore_initial_test_values();
 }
 
@@ -111,6 +172,10 @@ void test_bpm_nominal_value()
 void restore_initial_test_values()
 {
     bpm_freq_req_iter = 0;
+    bpm_freq_remainder = 0;
+    bpm_freq_divisor = 0;
+    beat_error_accumulator = 0;
+    beat_deadline_tick = 0;
     bpm = 0;
     Serial.println("");
 }
@@ -120,8 +185,12 @@ void check_assertions()
 {
     assert (bpm >= 1);
     assert (bpm <= 300);
-    assert (bpm_freq_req_iter <= 59975);
-    assert (bpm_freq_req_iter >= 175);
+    assert (bpm_freq_req_iter <= 60000);
+    assert (bpm_freq_req_iter >= 200);
+    assert (bpm_freq_remainder < (unsigned int) bpm);
+    assert (bpm_freq_divisor == (unsigned int) bpm);
+    assert ((((unsigned long) bpm_freq_req_iter * bpm) + bpm_freq_remainder)
+            == MILLISECONDS_IN_MINUTE);
 }
 
 
@@ -129,24 +198,41 @@ void check_assertions()
 * PRECONDITIONS     =>      bpm GREATER OR EQUAL TO 1
 *                       AND bpm LESS OR EQUAL TO 300
 *
-* EXCEPTIONS        =>  temp_required_iterations OUT OF RANGE (double)
+* EXCEPTIONS        =>  No exceptions expected.
 *
-* POSTCONDITIONS    =>      temp_required_iterations LESS OR EQUAL TO 59975
-*                       AND temp_required_iterations GREATER OR EQUAL TO 175
+* POSTCONDITIONS    =>      bpm_freq_req_iter LESS OR EQUAL TO 60000
+*                       AND bpm_freq_req_iter GREATER OR EQUAL TO 200
+*                       AND bpm_freq_remainder LESS THAN bpm
+*                       AND (bpm_freq_req_iter * bpm) + bpm_freq_remainder
+*                           EQUAL TO 60000
 *
-* ANALYSIS          =>  double type occupy 32 bits in Arduino UNO based boards.
-*                       temp_required_iterations occupy 16 bits. Max. and min.
-*                       values are inside double type range. No out of range 
-*                       exceptions expected.
+* ANALYSIS          =>  Only integer operations are performed; the result is
+*                       exact (no floating point rounding). 60000 fits in
+*                       an unsigned int (16 bits), and the remainder is lower
+*                       than bpm. The table index (bpm - BPM_LOWER_BOUND) is
+*                       inside the table for all the allowed BPM values.
+*                       No errors expected.
 */ 
 void calculate_required_iterations()
 {
-    double temp_required_iterations;
+    unsigned int required_iterations;
+    unsigned int required_remainder;
+    
+    required_iterations = pgm_read_word(
+        &BeatPeriods::required_iterations[bpm - BPM_LOWER_BOUND]);
+    required_remainder  = MILLISECONDS_IN_MINUTE - (required_iterations * bpm);
+    
+    noInterrupts();
+    
+    beat_deadline_tick = beat_deadline_tick - bpm_freq_req_iter;
+    bpm_freq_req_iter = required_iterations;
+    beat_deadline_tick = beat_deadline_tick + bpm_freq_req_iter;
+    
+    bpm_freq_remainder = required_remainder;
+    bpm_freq_divisor = bpm;
+    beat_error_accumulator = 0;
     
-    temp_required_iterations 
-        = ((SECONDS_IN_MINUTE / bpm) * MILLISECONDS_IN_SECOND) - SOUND_DURATION;
-        
-    bpm_freq_req_iter = (unsigned int) temp_required_iterations;
+    interrupts();
 }
 
 
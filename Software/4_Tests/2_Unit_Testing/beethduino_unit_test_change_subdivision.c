@@ -0,0 +1,267 @@
+/*******************************************************************************
+*   Project:        Beethduino, an Arduino Do-it-yourself electronic metronome.
+*
+*   File:           beethduino_unit_test_change_subdivision.c
+*
+*   Description:    Unit testing for "change_subdivision" function (and 
+*                   "calculate_subdivision_step").
+*                   Checks established preconditions and postconditions, related
+*                   to the possible values of subdivision, clicks_per_beat and
+*                   the step of the sub-beats.
+*
+*   Language:       Arduino (C/C++ set, compatible with avr-g++).
+*                   Compiled in Arduino IDE, version 1.6.13
+*
+*   Dependencies:   assert.h
+*
+*   Notes:          BPM - Beats Per Minute.
+*                   LCD - Liquid Crystal Display.
+*
+*   Author:         Alberto Martin Cajal
+*                   amartin.glimpse23@gmail.com
+*                   amartin<DOT>glimpse23<AT>gmail<DOT>.com
+*
+*   License:        GNU GPL v3.0
+*
+*   URL:            https://github.com/amcajal/beethduino
+*
+*******************************************************************************/
+#define __ASSERT_USE_STDERR
+
+#include <assert.h>
+
+struct Subdivision
+{
+    byte clicks_per_beat;
+    unsigned long period_multiplier;    /* 0 without subdivision. */
+    char text[2];   /* i.e: "3" (triplets) and '\0'. */
+};
+
+const Subdivision SUBDIVISIONS[] PROGMEM = 
+{
+    {1, 0,      "1"},
+    {2, 65536,  "2"},
+    {3, 43691,  "3"},
+    {4, 32768,  "4"}
+};
+const byte SUBDIVISIONS_COUNT       = sizeof(SUBDIVISIONS) 
+                                      / sizeof(SUBDIVISIONS[0]);
+const byte DEFAULT_SUBDIVISION      = 0;    /* Only the beats. */
+const byte SUBDIVISION_PERIOD_SHIFT = 17;
+
+const byte STATE_SUBDIVISION        = 1 << 4;
+
+unsigned int bpm_freq_req_iter;
+
+byte subdivision;
+byte clicks_per_beat;
+unsigned int subdivision_req_iter;
+byte subdivision_remainder;
+byte pending_subdivisions;
+
+boolean is_unit_testing_done;
+
+/******************************************************************************/
+
+
+void setup()
+{
+    is_unit_testing_done = false;
+    
+    restore_initial_test_values();
+    
+    Serial.begin(9600); /* Start serial port at 9600 bits per second. */
+    Serial.println("UNIT TESTING STARTED\n******************************");
+    Serial.println("%%%Testing function: change_subdivision");
+}
+
+
+void loop() /* Cyclic Executive at 16MHz. */
+{
+    if (is_unit_testing_done == false)
+    {
+        execute_tests();
+        is_unit_testing_done = true;
+        Serial.println("UNIT TESTING FINISHED\n******************************");
+    }
+}
+
+
+void execute_tests()
+{
+    test_eighths();
+    test_triplets();
+    test_last_to_first_subdivision();
+    test_slowest_period();
+}
+
+
+/**
+* Test that at 60 BPM (1000 ticks) the eighths are 500 ticks apart, and that
+* the pending sub-beats of the current beat are dropped.
+*/
+void test_eighths()
+{
+    Serial.println("test_eighths");
+    pending_subdivisions = 3;
+    byte changed_state = change_subdivision();
+    assert (changed_state == STATE_SUBDIVISION);
+    check_assertions(1, 2, 500, 0);
+    restore_initial_test_values();
+}
+
+
+/**
+* Test that at 300 BPM (200 ticks) the triplets are 66 + 2/3 ticks apart.
+*/
+void test_triplets()
+{
+    Serial.println("test_triplets");
+    bpm_freq_req_iter = 200;
+    subdivision = 1;
+    change_subdivision();
+    check_assertions(2, 3, 66, 2);
+    restore_initial_test_values();
+}
+
+
+void test_last_to_first_subdivision()
+{
+    Serial.println("test_last_to_first_subdivision");
+    subdivision = SUBDIVISIONS_COUNT - 1;
+    change_subdivision();
+    check_assertions(0, 1, 0, 0);
+    restore_initial_test_values();
+}
+
+
+/**
+* Test that the multiplication does not overflow at 1 BPM (60000 ticks):
+* the triplets are 20000 ticks apart, the sixteenths 15000.
+*/
+void test_slowest_period()
+{
+    Serial.println("test_slowest_period");
+    bpm_freq_req_iter = 60000;
+    subdivision = 1;
+    change_subdivision();
+    check_assertions(2, 3, 20000, 0);
+    
+    change_subdivision();
+    check_assertions(3, 4, 15000, 0);
+    restore_initial_test_values();
+}
+
+
+void restore_initial_test_values()
+{
+    bpm_freq_req_iter = 1000;
+    subdivision = DEFAULT_SUBDIVISION;
+    clicks_per_beat = 1;
+    subdivision_req_iter = 0;
+    subdivision_remainder = 0;
+    pending_subdivisions = 0;
+    Serial.println("");
+}
+
+
+void check_assertions(byte index, byte clicks, unsigned int step, byte rest)
+{
+    assert (subdivision == index);
+    assert (clicks_per_beat == clicks);
+    assert (subdivision_req_iter == step);
+    assert (subdivision_remainder == rest);
+    assert (pending_subdivisions == 0);
+}
+
+
+/**
+* PRECONDITIONS     =>      subdivision LESS THAN SUBDIVISIONS_COUNT
+*                       AND (bpm_freq_req_iter >= 200)
+*                       AND (bpm_freq_req_iter <= 60000)
+*
+* EXCEPTIONS        =>  No exceptions expected.
+*
+* POSTCONDITIONS    =>      subdivision LESS THAN SUBDIVISIONS_COUNT
+*                       AND clicks_per_beat EQUAL TO 
+*                           SUBDIVISIONS[subdivision].clicks_per_beat
+*                       AND pending_subdivisions EQUAL TO 0
+*
+* ANALYSIS          =>  subdivision is set back to 0 when it reaches
+*                       SUBDIVISIONS_COUNT, so the table is never read out
+*                       of bounds. No errors expected.
+*/
+byte change_subdivision()
+{
+    subdivision++;
+    
+    if (subdivision == SUBDIVISIONS_COUNT)
+    {
+        subdivision = 0;
+    }
+    
+    noInterrupts();
+    
+    clicks_per_beat = pgm_read_byte(&SUBDIVISIONS[subdivision].clicks_per_beat);
+    pending_subdivisions = 0;
+    
+    interrupts();
+    
+    calculate_subdivision_step();
+    
+    return STATE_SUBDIVISION;
+}
+
+
+/**
+* PRECONDITIONS     =>      (bpm_freq_req_iter >= 200)
+*                       AND (bpm_freq_req_iter <= 60000)
+*
+* EXCEPTIONS        =>  Integer overflow (multiplication).
+*
+* POSTCONDITIONS    =>      subdivision_req_iter EQUAL TO 
+*                           bpm_freq_req_iter / clicks_per_beat
+*                       AND subdivision_remainder LESS THAN clicks_per_beat
+*
+* ANALYSIS          =>  The product is at most 60000 * 65536, lower than 
+*                       2^32, so it fits in an unsigned long. 
+*                       No errors expected.
+*/
+void calculate_subdivision_step()
+{
+    unsigned long period_multiplier;
+    unsigned int step_iterations = 0;
+    byte step_remainder = 0;
+    
+    period_multiplier = pgm_read_dword(
+        &SUBDIVISIONS[subdivision].period_multiplier);
+    
+    if (period_multiplier != 0)
+    {
+        step_iterations = (bpm_freq_req_iter * period_multiplier) 
+                          >> SUBDIVISION_PERIOD_SHIFT;
+        step_remainder = bpm_freq_req_iter 
+                         - (step_iterations * clicks_per_beat);
+    }
+    
+    noInterrupts();
+    
+    subdivision_req_iter = step_iterations;
+    subdivision_remainder = step_remainder;
+    
+    interrupts();
+}
+
+
+void __assert(const char *__func, const char *__file,
+              int __lineno, const char *__sexp)
+{
+    Serial.println("TEST_FAILED");
+    Serial.println(__file);
+    Serial.println(__func);
+    Serial.println(__lineno, DEC);
+    Serial.println(__sexp);
+    Serial.flush();
+
+    //abort();
+}
@@ -0,0 +1,198 @@
+/*******************************************************************************
+*   Project:        Beethduino, an Arduino Do-it-yourself electronic metronome.
+*
+*   File:           beethduino_unit_test_change_time_signature.c
+*
+*   Description:    Unit testing for "change_time_signature" function.
+*                   Checks established preconditions and postconditions, related
+*                   to the possible values of time_signature, beats_per_bar and
+*                   beat_in_bar.
+*
+*   Language:       Arduino (C/C++ set, compatible with avr-g++).
+*                   Compiled in Arduino IDE, version 1.6.13
+*
+*   Dependencies:   assert.h
+*
+*   Notes:          BPM - Beats Per Minute.
+*                   LCD - Liquid Crystal Display.
+*
+*   Author:         Alberto Martin Cajal
+*                   amartin.glimpse23@gmail.com
+*                   amartin<DOT>glimpse23<AT>gmail<DOT>.com
+*
+*   License:        GNU GPL v3.0
+*
+*   URL:            https://github.com/amcajal/beethduino
+*
+*******************************************************************************/
+#define __ASSERT_USE_STDERR
+
+#include <assert.h>
+
+struct TimeSignature
+{
+    byte beats_per_bar;
+    char text[4];   /* i.e: "4/4" and '\0'. */
+};
+
+const TimeSignature TIME_SIGNATURES[] PROGMEM = 
+{
+    {2, "2/4"},
+    {3, "3/4"},
+    {4, "4/4"},
+    {6, "6/8"},
+    {7, "7/8"}
+};
+const byte TIME_SIGNATURES_COUNT    = sizeof(TIME_SIGNATURES) 
+                                      / sizeof(TIME_SIGNATURES[0]);
+const byte DEFAULT_TIME_SIGNATURE   = 2;    /* 4/4. */
+
+const byte STATE_TIME_SIGNATURE     = 1 << 3;
+
+byte time_signature;
+byte beats_per_bar;
+byte beat_in_bar;
+
+boolean is_unit_testing_done;
+
+/******************************************************************************/
+
+
+void setup()
+{
+    is_unit_testing_done = false;
+    
+    restore_initial_test_values();
+    
+    Serial.begin(9600); /* Start serial port at 9600 bits per second. */
+    Serial.println("UNIT TESTING STARTED\n******************************");
+    Serial.println("%%%Testing function: change_time_signature");
+}
+
+
+void loop() /* Cyclic Executive at 16MHz. */
+{
+    if (is_unit_testing_done == false)
+    {
+        execute_tests();
+        is_unit_testing_done = true;
+        Serial.println("UNIT TESTING FINISHED\n******************************");
+    }
+}
+
+
+void execute_tests()
+{
+    test_next_time_signature();
+    test_last_to_first_time_signature();
+    test_full_cycle();
+}
+
+
+void test_next_time_signature()
+{
+    Serial.println("test_next_time_signature");
+    beat_in_bar = 3;
+    byte changed_state = change_time_signature();
+    assert (changed_state == STATE_TIME_SIGNATURE);
+    check_assertions(3, 6);
+    restore_initial_test_values();
+}
+
+
+void test_last_to_first_time_signature()
+{
+    Serial.println("test_last_to_first_time_signature");
+    time_signature = TIME_SIGNATURES_COUNT - 1;
+    beats_per_bar = 7;
+    beat_in_bar = 6;
+    change_time_signature();
+    check_assertions(0, 2);
+    restore_initial_test_values();
+}
+
+
+/**
+* Test that every time signature is selected once, and that the default one
+* is selected again after a full cycle.
+*/
+void test_full_cycle()
+{
+    Serial.println("test_full_cycle");
+    for (int i = 0; i < TIME_SIGNATURES_COUNT; i++)
+    {
+        change_time_signature();
+    }
+    check_assertions(DEFAULT_TIME_SIGNATURE, 4);
+    restore_initial_test_values();
+}
+
+
+void restore_initial_test_values()
+{
+    time_signature = DEFAULT_TIME_SIGNATURE;
+    beats_per_bar = 4;
+    beat_in_bar = 0;
+    Serial.println("");
+}
+
+
+void check_assertions(byte check_time_signature, byte check_beats_per_bar)
+{
+    assert (time_signature == check_time_signature);
+    assert (beats_per_bar == check_beats_per_bar);
+    assert (beat_in_bar == 0);
+}
+
+
+/**
+* PRECONDITIONS     =>      time_signature LESS THAN TIME_SIGNATURES_COUNT
+*
+* EXCEPTIONS        =>  No exceptions expected.
+*
+* POSTCONDITIONS    =>      time_signature LESS THAN TIME_SIGNATURES_COUNT
+*                       AND beats_per_bar EQUAL TO 
+*                           TIME_SIGNATURES[time_signature].beats_per_bar
+*                       AND beat_in_bar EQUAL TO 0
+*
+* ANALYSIS          =>  time_signature is set back to 0 when it reaches
+*                       TIME_SIGNATURES_COUNT, so the table is never read out
+*                       of bounds. No errors expected.
+*/
+byte change_time_signature()
+{
+    byte next_beats_per_bar;
+    
+    time_signature++;
+    
+    if (time_signature == TIME_SIGNATURES_COUNT)
+    {
+        time_signature = 0;
+    }
+    
+    next_beats_per_bar = pgm_read_byte(
+        &TIME_SIGNATURES[time_signature].beats_per_bar);
+    
+    noInterrupts();
+    
+    beats_per_bar = next_beats_per_bar;
+    beat_in_bar = 0;
+    
+    interrupts();
+    
+    return STATE_TIME_SIGNATURE;
+}
+
+
+void __assert(const char *__func, const char *__file,
+              int __lineno, const char *__sexp)
+{
+    Serial.println("TEST_FAILED");
+    Serial.println(__file);
+    Serial.println(__func);
+    Serial.println(__lineno, DEC);
+    Serial.println(__sexp);
+    Serial.flush();
+
+    //abort();
+}
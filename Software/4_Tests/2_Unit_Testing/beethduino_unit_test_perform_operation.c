@@ -5,7 +5,9 @@
 *
 *   Description:    Unit testing for "perform_operation" function.
 *                   Checks established preconditions and postconditions, related
-*                   to the possible branches in a SWITCH statement.  
+*                   to the entries of the BUTTON_ACTIONS table (pin and 
+*                   button event), and to the update of the LCD (only if a
+*                   shown part has changed).
 *
 *   Language:       Arduino (C/C++ set, compatible with avr-g++).
 *                   Compiled in Arduino IDE, version 1.6.13
@@ -28,7 +30,54 @@
 
 #include <assert.h>
 
+const byte BUTTON_RELEASED          = 2;
+const byte BUTTON_LONG_PRESSED      = 3;
+
+const byte STATE_BPM                = 1 << 0;
+const byte STATE_BPM_MODIFIER       = 1 << 1;
+const byte STATE_MUTE               = 1 << 2;
+const byte STATE_TIME_SIGNATURE     = 1 << 3;
+const byte STATE_SUBDIVISION        = 1 << 4;
+const byte STATE_TEMPO_MAP          = 1 << 5;
+const byte STATE_SHOWN_IN_LCD       = STATE_BPM | STATE_BPM_MODIFIER 
+                                      | STATE_MUTE | STATE_TIME_SIGNATURE
+                                      | STATE_SUBDIVISION | STATE_TEMPO_MAP;
+
+typedef byte (*ButtonOperation)();
+
+struct ButtonAction
+{
+    byte pin;
+    byte button_event;
+    ButtonOperation operation;
+};
+
+byte reset_bpm();
+byte invert_bpm_modifier();
+byte change_bpm_by_one();
+byte change_bpm_by_ten();
+byte change_mute_state();
+byte change_time_signature();
+byte change_subdivision();
+byte start_tempo_map();
+
+const ButtonAction BUTTON_ACTIONS[] PROGMEM = 
+{
+    {9,     BUTTON_RELEASED,        reset_bpm},
+    {10,    BUTTON_RELEASED,        invert_bpm_modifier},
+    {11,    BUTTON_RELEASED,        change_bpm_by_one},
+    {12,    BUTTON_RELEASED,        change_bpm_by_ten},
+    {13,    BUTTON_RELEASED,        change_mute_state},
+    {9,     BUTTON_LONG_PRESSED,    change_time_signature},
+    {10,    BUTTON_LONG_PRESSED,    change_subdivision},
+    {13,    BUTTON_LONG_PRESSED,    start_tempo_map}
+};
+const byte BUTTON_ACTIONS_COUNT     = sizeof(BUTTON_ACTIONS) 
+                                      / sizeof(BUTTON_ACTIONS[0]);
+
 int function_called;
+int lcd_updates;
+byte bpm_changed_state; /* Returned by the BPM operations. */
 
 boolean is_unit_testing_done;
 
@@ -62,74 +111,179 @@ void execute_tests()
 {
     for (int i = 9; i <= 13; i++)
     {
-        Serial.print("Testing branch function: ");
+        Serial.print("Testing table entry: ");
         Serial.println(i);
-        perform_operation(i);
-        check_assertions(i * -1);
+        perform_operation(i, BUTTON_RELEASED);
+        check_assertions(i * -1, 1);
+        restore_initial_test_values();
     }
+    
+    test_long_press_action();
+    test_pin_without_action();
+    test_operation_without_changes();
+}
+
+
+/* Same pins than reset_bpm, invert_bpm_modifier and change_mute_state, 
+*  other event. */
+void test_long_press_action()
+{
+    Serial.println("test_long_press_action");
+    perform_operation(9, BUTTON_LONG_PRESSED);
+    check_assertions(-109, 1);
+    restore_initial_test_values();
+    
+    perform_operation(10, BUTTON_LONG_PRESSED);
+    check_assertions(-110, 1);
+    restore_initial_test_values();
+    
+    perform_operation(13, BUTTON_LONG_PRESSED);
+    check_assertions(-113, 1);
+    restore_initial_test_values();
+    
+    /* Repeated, not long pressed: no entry. */
+    perform_operation(11, BUTTON_LONG_PRESSED);
+    check_assertions(0, 0);
+    restore_initial_test_values();
+}
+
+
+void test_pin_without_action()
+{
+    Serial.println("test_pin_without_action");
+    perform_operation(8, BUTTON_RELEASED);
+    check_assertions(0, 0);
+    restore_initial_test_values();
+}
+
+
+/* BPM at a bound: nothing has changed, so the LCD is not updated. */
+void test_operation_without_changes()
+{
+    Serial.println("test_operation_without_changes");
+    bpm_changed_state = 0;
+    perform_operation(12, BUTTON_RELEASED);
+    check_assertions(-12, 0);
+    restore_initial_test_values();
 }
 
 
 void restore_initial_test_values()
 {
+    function_called = 0;
+    lcd_updates = 0;
+    bpm_changed_state = STATE_BPM;
     Serial.println("");
 }
 
 
-void check_assertions(int check_value)
+void check_assertions(int check_value, int check_lcd_updates)
 {
     assert (function_called == check_value);
+    assert (lcd_updates == check_lcd_updates);
 }
 
 
 /**
-* PRECONDITIONS     =>      pin_to_check GREATER OR EQUAL TO 9
-*                       AND pin_to_check LESS OR EQUAL TO 13
+* PRECONDITIONS     =>      pin_to_check GREATER OR EQUAL TO 0
+*                       AND (button_event = BUTTON_RELEASED
+*                            OR button_event = BUTTON_LONG_PRESSED)
 *
 * EXCEPTIONS        =>  No exceptions expected.
 *
-* POSTCONDITIONS    =>      function_called DIFFERENT FROM 0
-*                       AND function_called GREATER OR EQUAL TO -13
-*                       AND function called LESS OR EQUAL TO -9
+* POSTCONDITIONS    =>      function_called EQUAL TO -pin_to_check (minus
+*                           100 for BUTTON_LONG_PRESSED), if the pin and 
+*                           event have an entry in BUTTON_ACTIONS; 
+*                           otherwise, EQUAL TO 0.
+*                       AND lcd_updates EQUAL TO 1 if the operation has 
+*                           changed a part shown in the LCD; otherwise, 
+*                           EQUAL TO 0.
 *
 *                           function_called represents a call to a certain
-*                           function in the SWITCH statement.
+*                           operation of the table.
 *
-* ANALYSIS          =>  Basic comparissons operations performed. Switch block
-*                       covers all possibilities. No errors expected.
+* ANALYSIS          =>  The table is searched with a bounded loop (one 
+*                       iteration per entry). No errors expected.
 */ 
-void perform_operation(int pin_to_check)
+void perform_operation(int pin_to_check, byte button_event)
 {
-    switch (pin_to_check) 
+    byte action;
+    byte changed_state = 0;
+    ButtonOperation operation;
+    
+    for (action = 0; action < BUTTON_ACTIONS_COUNT; action++)
     {
-        case 9:
-            //reset_bpm();
-            function_called = 9;
-            break;
-        case 10:
-            //invert_bpm_modifier();
-            function_called = 10;
-            break;
-        case 11:
-            //update_bpm(1);
-            function_called = 11;
-            break;
-        case 12:
-            //update_bpm(10);
-            function_called = 12;
-            break;
-        case 13:
-            //change_mute_state();
-            function_called = 13;
-            break;
-        default: 
-            /* No operation. */
-            function_called = 0;
-        break;
+        if ((pgm_read_byte(&BUTTON_ACTIONS[action].pin) == pin_to_check)
+            && (pgm_read_byte(&BUTTON_ACTIONS[action].button_event) 
+                == button_event))
+        {
+            operation = (ButtonOperation) 
+                        pgm_read_ptr(&BUTTON_ACTIONS[action].operation);
+            changed_state = changed_state | operation();
+        }
     }
     
-    function_called = function_called * -1;
-    //update_lcd();
+    if ((changed_state & STATE_SHOWN_IN_LCD) != 0)
+    {
+        //update_lcd();
+        lcd_updates++;
+    }
+}
+
+
+byte reset_bpm()
+{
+    function_called = -9;
+    return STATE_BPM | STATE_BPM_MODIFIER | STATE_MUTE;
+}
+
+
+byte invert_bpm_modifier()
+{
+    function_called = -10;
+    return STATE_BPM_MODIFIER;
+}
+
+
+byte change_bpm_by_one()
+{
+    function_called = -11;
+    return bpm_changed_state;
+}
+
+
+byte change_bpm_by_ten()
+{
+    function_called = -12;
+    return bpm_changed_state;
+}
+
+
+byte change_mute_state()
+{
+    function_called = -13;
+    return STATE_MUTE;
+}
+
+
+byte change_time_signature()
+{
+    function_called = -109;
+    return STATE_TIME_SIGNATURE;
+}
+
+
+byte change_subdivision()
+{
+    function_called = -110;
+    return STATE_SUBDIVISION;
+}
+
+
+byte start_tempo_map()
+{
+    function_called = -113;
+    return STATE_BPM | STATE_MUTE | STATE_TIME_SIGNATURE | STATE_TEMPO_MAP;
 }
 
 
@@ -3,40 +3,72 @@
 *
 *   File:           beethduino_unit_test_process_bpm_frequency.c
 *
-*   Description:    Unit testing for "process_bpm_frequency" function.
+*   Description:    Unit testing for "process_bpm_frequency" function, 
+*                   executed by the Timer1 interrupt in every tick.
 *                   Checks established preconditions and postconditions, related
-*                   to the possible values and behaviour of iteration_counter.   
+*                   to the possible values and behaviour of beat_deadline_tick
+*                   and buzzer_off_tick (longer in the downbeat of the bar),
+*                   and to the sub-beats scheduled between the beats.
 *
 *   Language:       Arduino (C/C++ set, compatible with avr-g++).
 *                   Compiled in Arduino IDE, version 1.6.13
 *
-*   Dependencies:   assert.h   
+*   Dependencies:   assert.h
 *
 *   Notes:          BPM - Beats Per Minute.
 *                   LCD - Liquid Crystal Display.
+*                   The interrupt body is called by hand (timer_compare_isr)
+*                   to simulate the timer ticks in a deterministic way.
 *
 *   Author:         Alberto Martin Cajal
 *                   amartin.glimpse23@gmail.com
 *                   amartin<DOT>glimpse23<AT>gmail<DOT>.com
-*  
+*
 *   License:        GNU GPL v3.0
 *
-*   URL:            https://github.com/amcajal/beethduino        
-*             
+*   URL:            https://github.com/amcajal/beethduino
+*
 *******************************************************************************/
 #define __ASSERT_USE_STDERR
 
 #include <assert.h>
 
-int iteration_counter;
+const int SOUND_DURATION = 25;  /* In Milliseconds. */
+const int ACCENT_SOUND_DURATION = 40;  /* In Milliseconds. */
+const int SUBDIVISION_SOUND_DURATION = 10;  /* In Milliseconds. */
 
 unsigned int bpm_freq_req_iter; /*  bpm frequency required iterations.
                                 *   unsigned int in order to store a max. value
-                                *   of 59975.
+                                *   of 60000.
                                 */
-                                           
+
+unsigned int bpm_freq_remainder;
+unsigned int bpm_freq_divisor;
+unsigned int beat_error_accumulator;
+
+unsigned long timer_ticks;
+unsigned long beat_deadline_tick;
+unsigned long buzzer_off_tick;
+boolean is_buzzer_sounding;
+
 boolean is_buzzer_muted;
 
+byte beats_per_bar;
+byte beat_in_bar;
+
+byte clicks_per_beat;
+unsigned int subdivision_req_iter;
+byte subdivision_remainder;
+unsigned int beat_subdivision_iter;
+byte beat_subdivision_remainder;
+byte subdivision_error_accumulator;
+unsigned long subdivision_deadline_tick;
+byte pending_subdivisions;
+
+int subdivision_bips;
+
+int buzzer_bips;
+
 boolean is_unit_testing_done;
 
 /******************************************************************************/
@@ -45,9 +77,9 @@ boolean is_unit_testing_done;
 void setup()
 {
     is_unit_testing_done = false;
-   
+
     restore_initial_test_values();
-    
+
     Serial.begin(9600); /* Start serial port at 9600 bits per second. */
     Serial.println("UNIT TESTING STARTED\n******************************");
     Serial.println("%%%Testing function: process_bpm_frequency");
@@ -68,154 +100,429 @@ void loop() /* Cyclic Executive at 16MHz. */
 void execute_tests()
 {
     test_mute_condition();
-    test_simple_iteration_condition();
-    test_complex_iteration_increase();
-    test_complex_iteration_decrease();
+    test_simple_deadline_condition();
+    test_sound_duration();
+    test_fractional_period();
+    test_accented_downbeat();
+    test_triplets();
+    test_subdivisions_of_longer_beat();
+    test_timer_ticks_overflow();
 }
 
 
 /**
-* Test that when muted, no operation is performed, and thus,
-* the value of iteration_counter is not altered.
+* Test that when muted, no beat is detected, and thus,
+* the value of beat_deadline_tick is not altered.
 */
 void test_mute_condition()
 {
     Serial.println("test_mute_condition");
+    bpm_freq_req_iter = 100;
+    beat_deadline_tick = 5;
     for (int i = 0; i < 10; i++)
     {
-        process_bpm_frequency();
+        timer_compare_isr();
     }
-    check_assertions(0);
+    check_assertions(5, 0);
     restore_initial_test_values();
 }
 
 
 /**
-* Test that iteration_counter is updated to the correct value, equal
-* to the number of iterations of the for loop that executes the method
-* process_bpm_frequency().
+* Test that the beat is played exactly when the deadline tick is reached, and
+* that the next deadline is one period after the previous one.
 */
-void test_simple_iteration_condition()
+void test_simple_deadline_condition()
 {
-    Serial.println("test_simple_iteration_condition");
+    Serial.println("test_simple_deadline_condition");
     is_buzzer_muted = false;
     bpm_freq_req_iter = 100;
-    for (int i = 0; i < 30; i++)
+    beat_deadline_tick = 100;
+    for (int i = 0; i < 99; i++)
     {
-        process_bpm_frequency();
+        timer_compare_isr();
     }
-    check_assertions(30);
+    check_assertions(100, 0);
+
+    timer_compare_isr();
+    check_assertions(200, 1);
+    assert (is_buzzer_sounding == true);
+    assert (buzzer_off_tick == 100 + SOUND_DURATION);
     restore_initial_test_values();
 }
 
 
 /**
-* Test that iteration_counter increases if bpm_req_iteration value is increased 
-* while the process_bpm_frequency method is executing. This test simulates
-* the pulsation of a button that modifies bpm while the comparisson of
-* iteration_counter and req_iteration is taking place.
+* Test that the sound is stopped exactly SOUND_DURATION ticks after the
+* beat, without any delay.
 */
-void test_complex_iteration_increase()
+void test_sound_duration()
 {
-    Serial.println("test_complex_iteration_increase");
+    Serial.println("test_sound_duration");
     is_buzzer_muted = false;
     bpm_freq_req_iter = 100;
-    
-    for (int i = 0; i < bpm_freq_req_iter-1; i++)
+    beat_deadline_tick = 1;
+    timer_compare_isr();
+    for (int i = 0; i < SOUND_DURATION - 1; i++)
     {
-        process_bpm_frequency();
+        timer_compare_isr();
     }
-    
-    bpm_freq_req_iter = 150;
-    
-    process_bpm_frequency();
-    process_bpm_frequency();
-    
-    check_assertions(101);
+    assert (is_buzzer_sounding == true);
+
+    timer_compare_isr();
+    assert (is_buzzer_sounding == false);
+    check_assertions(101, 1);
     restore_initial_test_values();
 }
 
 
 /**
-* Test that iteration_counter sets to 0 if bpm_req_iteration value is decreased 
-* below the actual iteration_counter value while the process_bpm_frequency
-* is executed. This test simulates the pulsation of a button that modifies bpm 
-* while the comparisson of iteration_counter and req_iteration is taking place.
+* Test that the fractional part of the period is accumulated: at 7 BPM the
+* period is 8571 + 3/7 ticks, so 7 beats last exactly one minute.
 */
-void test_complex_iteration_decrease()
+void test_fractional_period()
 {
-    Serial.println("test_complex_iteration_decrease");
+    Serial.println("test_fractional_period");
     is_buzzer_muted = false;
-    bpm_freq_req_iter = 100;
-    for (int i = 0; i < bpm_freq_req_iter-1; i++)
+    bpm_freq_req_iter = 8571;
+    bpm_freq_remainder = 3;
+    bpm_freq_divisor = 7;
+    beat_deadline_tick = 1;
+    for (int beat = 0; beat < 7; beat++)
     {
-        process_bpm_frequency();
+        timer_ticks = beat_deadline_tick - 1;
+        timer_compare_isr();
     }
-    
-    bpm_freq_req_iter = 10;
-    
-    for (int i = 0; i < bpm_freq_req_iter; i++)
+    check_assertions(1 + 60000, 7);
+    assert (beat_error_accumulator == 0);
+    restore_initial_test_values();
+}
+
+
+/**
+* Test that only the first beat of every bar (3/4) lasts ACCENT_SOUND_DURATION
+* ticks, and that the accent does not move the deadlines.
+*/
+void test_accented_downbeat()
+{
+    Serial.println("test_accented_downbeat");
+    is_buzzer_muted = false;
+    bpm_freq_req_iter = 200;
+    beats_per_bar = 3;
+    beat_in_bar = 0;
+    beat_deadline_tick = 1;
+    for (int beat = 0; beat < 7; beat++)
     {
-        process_bpm_frequency();
+        timer_ticks = beat_deadline_tick - 1;
+        timer_compare_isr();
+
+        if ((beat % 3) == 0)
+        {
+            assert (buzzer_off_tick == timer_ticks + ACCENT_SOUND_DURATION);
+        }
+        else
+        {
+            assert (buzzer_off_tick == timer_ticks + SOUND_DURATION);
+        }
     }
-    
-    check_assertions(bpm_freq_req_iter - 1);
+    check_assertions(1 + (7 * 200), 7);
+    assert (beat_in_bar == 1);
+    restore_initial_test_values();
+}
+
+
+/**
+* Test that the triplets of a beat of 200 ticks are 66 and 133 ticks after 
+* it, and that they sound SUBDIVISION_SOUND_DURATION ticks.
+*/
+void test_triplets()
+{
+    Serial.println("test_triplets");
+    is_buzzer_muted = false;
+    bpm_freq_req_iter = 200;
+    clicks_per_beat = 3;
+    subdivision_req_iter = 66;
+    subdivision_remainder = 2;
+    beat_deadline_tick = 1;
+    for (int i = 0; i < 200; i++)
+    {
+        timer_compare_isr();
+
+        if ((timer_ticks == 1 + 66) || (timer_ticks == 1 + 133))
+        {
+            assert (buzzer_off_tick == timer_ticks 
+                                       + SUBDIVISION_SOUND_DURATION);
+        }
+    }
+    check_assertions(201, 1);
+    assert (subdivision_bips == 2);
+    assert (pending_subdivisions == 0);
+    restore_initial_test_values();
+}
+
+
+/**
+* Test that the sixteenths of a beat with one tick more (201 ticks) are 
+* floor(i * 201 / 4) ticks after it: 50, 100 and 150; the last step ends on
+* the next beat.
+*/
+void test_subdivisions_of_longer_beat()
+{
+    Serial.println("test_subdivisions_of_longer_beat");
+    is_buzzer_muted = false;
+    bpm_freq_req_iter = 200;
+    bpm_freq_remainder = 1;
+    bpm_freq_divisor = 1;   /* Every beat has one tick more. */
+    clicks_per_beat = 4;
+    subdivision_req_iter = 50;
+    subdivision_remainder = 0;
+    beat_deadline_tick = 1;
+    timer_compare_isr();
+    assert (subdivision_deadline_tick == 1 + 50);
+    assert (beat_subdivision_remainder == 1);
+
+    for (int i = 0; i < 200; i++)
+    {
+        timer_compare_isr();
+    }
+    check_assertions(1 + 201, 1);
+    assert (subdivision_bips == 3);
+    assert (subdivision_deadline_tick == 1 + 201);
+    restore_initial_test_values();
+}
+
+
+/**
+* Test that the deadline is detected when timer_ticks overflows.
+*/
+void test_timer_ticks_overflow()
+{
+    Serial.println("test_timer_ticks_overflow");
+    is_buzzer_muted = false;
+    bpm_freq_req_iter = 100;
+    timer_ticks = (unsigned long) -16; /* 16 ticks before the overflow. */
+    beat_deadline_tick = timer_ticks + bpm_freq_req_iter;
+    for (int i = 0; i < 100 + SOUND_DURATION; i++)
+    {
+        timer_compare_isr();
+    }
+    assert (is_buzzer_sounding == false);
+    check_assertions((unsigned long) -16 + 200, 1);
     restore_initial_test_values();
 }
 
 
 void restore_initial_test_values()
 {
-    iteration_counter = 0;
+    timer_ticks = 0;
+    beat_deadline_tick = 0;
+    buzzer_off_tick = 0;
+    is_buzzer_sounding = false;
     bpm_freq_req_iter = 0;
+    bpm_freq_remainder = 0;
+    bpm_freq_divisor = 1;
+    beat_error_accumulator = 0;
     is_buzzer_muted = true;
+    beats_per_bar = 4;
+    beat_in_bar = 1;    /* Not the downbeat. */
+    clicks_per_beat = 1;
+    subdivision_req_iter = 0;
+    subdivision_remainder = 0;
+    beat_subdivision_iter = 0;
+    beat_subdivision_remainder = 0;
+    subdivision_error_accumulator = 0;
+    subdivision_deadline_tick = 0;
+    pending_subdivisions = 0;
+    subdivision_bips = 0;
+    buzzer_bips = 0;
     Serial.println("");
 }
 
 
-void check_assertions(int check_value)
+void check_assertions(unsigned long check_deadline, int check_bips)
 {
-    assert (iteration_counter <= 59975);
-    assert (iteration_counter >= 0);
-    assert (iteration_counter == check_value);
+    assert (beat_deadline_tick == check_deadline);
+    assert (buzzer_bips == check_bips);
+}
+
+
+void timer_compare_isr()
+{
+    timer_ticks++;
+    process_bpm_frequency();
 }
 
 
 /**
-* PRECONDITIONS     =>      (is_buzzer_muted = TRUE OR is_buzzer_muted = TRUE)
-*                       AND (iteration_counter >= 0) 
-*                       AND (iteration_counter <= 59975)
+* PRECONDITIONS     =>      (is_buzzer_muted = TRUE OR is_buzzer_muted = FALSE)
+*                       AND (bpm_freq_req_iter >= 200)
+*                       AND (bpm_freq_req_iter <= 60000)
+*                       AND (beat_in_bar LESS THAN beats_per_bar)
+*                       AND (subdivision_remainder LESS THAN clicks_per_beat)
 *
-* EXCEPTIONS        =>  Integer overflow (caused by iteration_counter).
+* EXCEPTIONS        =>  Integer overflow (caused by timer_ticks).
 *
-* POSTCONDITIONS    =>      (is_buzzer_muted = TRUE OR is_buzzer_muted = TRUE)
-*                       AND (iteration_counter >= 0)
-*                       AND (iteration_counter <= 59975)
+* POSTCONDITIONS    =>      (beat_deadline_tick - timer_ticks)
+*                           <= bpm_freq_req_iter
+*                       AND (buzzer_off_tick - timer_ticks)
+*                           <= ACCENT_SOUND_DURATION
 *
-* ANALYSIS          =>  iteration_counter is initialized a to 0. The max. value
-*                       of bpm_freq_req_iter is 59975. Even in the worst case
-*                       when bpm_freq_req_iter is updated after the IF check,
-*                       the condition of "greater than or equal to" avoids
-*                       a infinite iteration_counter increase. 
+* ANALYSIS          =>  timer_ticks overflows every 49 days. The deadlines are
+*                       compared with a signed difference, so the overflow
+*                       of timer_ticks, beat_deadline_tick and buzzer_off_tick
+*                       is supported. ACCENT_SOUND_DURATION is lower than the
+*                       minimum bpm_freq_req_iter divided by the maximum 
+*                       clicks_per_beat, so sounds never overlap. The 
+*                       sub-beats of a beat are before the next beat.
 *                       No errors expected.
 */
 void process_bpm_frequency()
 {
-    if (is_buzzer_muted == false)
+    unsigned long beat_tick;
+    
+    if ((is_buzzer_sounding == true)
+        && ((long) (timer_ticks - buzzer_off_tick) >= 0))
+    {
+        stop_buzzer();
+    }
+
+    if ((is_buzzer_muted == false)
+        && ((long) (timer_ticks - beat_deadline_tick) >= 0))
+    {
+        beat_tick = beat_deadline_tick;
+        schedule_next_beat();
+        schedule_subdivisions(beat_tick);
+        play_buzzer();
+    }
+    else if ((pending_subdivisions != 0)
+             && ((long) (timer_ticks - subdivision_deadline_tick) >= 0))
+    {
+        pending_subdivisions--;
+        schedule_next_subdivision();
+        play_subdivision();
+    }
+    else
+    {
+        /* No operation. */
+    }
+}
+
+
+/**
+* PRECONDITIONS     =>      bpm_freq_remainder LESS THAN bpm_freq_divisor
+*                       AND beat_error_accumulator LESS THAN bpm_freq_divisor
+*
+* EXCEPTIONS        =>  No exceptions expected.
+*
+* POSTCONDITIONS    =>  beat_error_accumulator LESS THAN bpm_freq_divisor
+*
+* ANALYSIS          =>  The accumulator is lower than 2 * 300 before the
+*                       subtraction, so it fits in an unsigned int.
+*                       No errors expected.
+*/
+void schedule_next_beat()
+{
+    beat_deadline_tick = beat_deadline_tick + bpm_freq_req_iter;
+    beat_error_accumulator = beat_error_accumulator + bpm_freq_remainder;
+
+    if (beat_error_accumulator >= bpm_freq_divisor)
+    {
+        beat_error_accumulator = beat_error_accumulator - bpm_freq_divisor;
+        beat_deadline_tick++;
+    }
+}
+
+
+void schedule_subdivisions(unsigned long beat_tick)
+{
+    beat_subdivision_iter = subdivision_req_iter;
+    beat_subdivision_remainder = subdivision_remainder;
+    
+    if ((beat_deadline_tick - beat_tick) != bpm_freq_req_iter)
     {
-        delay(1);
-        iteration_counter++;
-        if (iteration_counter >= bpm_freq_req_iter)
+        beat_subdivision_remainder++;
+        
+        if (beat_subdivision_remainder == clicks_per_beat)
         {
-            //play_buzzer();
-            iteration_counter = 0;
+            beat_subdivision_remainder = 0;
+            beat_subdivision_iter++;
         }
     }
+    
+    subdivision_deadline_tick = beat_tick;
+    subdivision_error_accumulator = 0;
+    pending_subdivisions = clicks_per_beat - 1;
+    schedule_next_subdivision();
+}
+
+
+void schedule_next_subdivision()
+{
+    subdivision_deadline_tick = subdivision_deadline_tick 
+                                + beat_subdivision_iter;
+    subdivision_error_accumulator = subdivision_error_accumulator 
+                                    + beat_subdivision_remainder;
+    
+    if (subdivision_error_accumulator >= clicks_per_beat)
+    {
+        subdivision_error_accumulator = subdivision_error_accumulator 
+                                        - clicks_per_beat;
+        subdivision_deadline_tick++;
+    }
+}
+
+
+void play_buzzer()
+{
+    //digitalWrite(ACTIVE_BUZZER_PIN, HIGH);
+    
+    if (advance_beat_in_bar() == true)
+    {
+        buzzer_off_tick = timer_ticks + ACCENT_SOUND_DURATION;
+    }
+    else
+    {
+        buzzer_off_tick = timer_ticks + SOUND_DURATION;
+    }
+    
+    is_buzzer_sounding = true;
+    buzzer_bips++;
+}
+
+
+boolean advance_beat_in_bar()
+{
+    boolean is_downbeat = (beat_in_bar == 0);
+    
+    beat_in_bar++;
+    
+    if (beat_in_bar == beats_per_bar)
+    {
+        beat_in_bar = 0;
+    }
+    
+    return is_downbeat;
+}
+
+
+void play_subdivision()
+{
+    //digitalWrite(ACTIVE_BUZZER_PIN, HIGH);
+    buzzer_off_tick = timer_ticks + SUBDIVISION_SOUND_DURATION;
+    is_buzzer_sounding = true;
+    subdivision_bips++;
+}
+
+
+void stop_buzzer()
+{
+    //digitalWrite(ACTIVE_BUZZER_PIN, LOW);
+    is_buzzer_sounding = false;
 }
 
 
-void __assert(const char *__func, const char *__file, 
-              int __lineno, const char *__sexp) 
+void __assert(const char *__func, const char *__file,
+              int __lineno, const char *__sexp)
 {
     Serial.println("TEST_FAILED");
     Serial.println(__file);
@@ -131,7 +131,7 @@ void check_assertions()
 {
     assert (bpm == 60);
     assert (bpm_modifier == 1);
-    assert (bpm_freq_req_iter <= 975);
+    assert (bpm_freq_req_iter == 1000);
     assert (is_buzzer_muted == true);
 }
 
@@ -143,8 +143,8 @@ void check_assertions()
 *                               bpm <= 300 
 *                           AND bpm >= 1
 *                           AND ( (bpm_modifier = 1) OR (bpm_modifier = -1) )
-*                           AND bpm_freq_req_iter <= 59975
-*                           AND bpm_freq_req_iter >= 175
+*                           AND bpm_freq_req_iter <= 60000
+*                           AND bpm_freq_req_iter >= 200
 *                           AND (   (is_buzzer_muted = true) 
 *                               OR  (is_buzzer_muted = false))
 *
@@ -152,7 +152,7 @@ void check_assertions()
 *
 * POSTCONDITIONS    =>      bpm = 60
 *                       AND bpm_modifier = 1
-*                       AND bpm_freq_req_iter = 975
+*                       AND bpm_freq_req_iter = 1000
 *                       AND is_buzzer_muted = true
 *
 * ANALYSIS          =>  Basic assignments are performed. All values are inside
@@ -162,7 +162,7 @@ void reset_bpm()
 {
     bpm                 = 60;
     bpm_modifier        = 1;
-    bpm_freq_req_iter   = 975;
+    bpm_freq_req_iter   = 1000;
     is_buzzer_muted     = true;
 }
 
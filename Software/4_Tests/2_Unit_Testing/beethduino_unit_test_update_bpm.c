@@ -31,8 +31,11 @@
 const int BPM_UPPER_BOUND           = 300;
 const int BPM_LOWER_BOUND           = 1;
 
+const byte STATE_BPM                = 1 << 0;
+
 int bpm;
 int bpm_modifier; /* 1 (one) or -1 (minus one). */
+int period_calculations;
 
 boolean is_unit_testing_done;
 
@@ -67,13 +70,17 @@ void execute_tests()
     test_bpm_upper_bound();
     test_bpm_lower_bound();
     test_bpm_nominal_value();
+    test_bpm_at_bound_unchanged();
 }
 
 
 void test_bpm_upper_bound()
 {
     Serial.println("test_bpm_upper_bound");
-    update_bpm(500); /* Precondition violated in order to simplify test. */
+    byte changed_state = update_bpm(500); /* Precondition violated in order 
+                                           * to simplify test. 
+                                           */
+    assert (changed_state == STATE_BPM);
     check_assertions(BPM_UPPER_BOUND);
     restore_initial_test_values();
 }
@@ -94,6 +101,20 @@ void test_bpm_nominal_value()
     Serial.println("test_bpm_nominal_value");
     update_bpm(60); /* Precondition violated in order to simplify test. */
     check_assertions(120);
+    assert (period_calculations == 1);
+    restore_initial_test_values();
+}
+
+
+/* At the bound, the BPM does not change: the period is not recalculated. */
+void test_bpm_at_bound_unchanged()
+{
+    Serial.println("test_bpm_at_bound_unchanged");
+    bpm = BPM_UPPER_BOUND;
+    byte changed_state = update_bpm(10);
+    assert (changed_state == 0);
+    check_assertions(BPM_UPPER_BOUND);
+    assert (period_calculations == 0);
     restore_initial_test_values();
 }
 
@@ -102,6 +123,7 @@ void restore_initial_test_values()
 {
     bpm = 60;
     bpm_modifier = 1;
+    period_calculations = 0;
     Serial.println("");
 }
 
@@ -124,12 +146,16 @@ void check_assertions(int check_value)
 *
 * POSTCONDITIONS    =>      bpm GREATER OR EQUAL TO 1
 *                       AND bpm LESS OR EQUAL TO 300
+*                       AND return value EQUAL TO STATE_BPM if bpm has 
+*                           changed; otherwise, EQUAL TO 0.
 *
 * ANALYSIS          =>  Basic additions are performed. bpm value is always
 *                       in range. No errors expected.
 */ 
-void update_bpm(int value)
+byte update_bpm(int value)
 {
+    int previous_bpm = bpm;
+    
     bpm = bpm + (bpm_modifier * value);
     
     if (bpm > BPM_UPPER_BOUND)
@@ -145,7 +171,15 @@ void update_bpm(int value)
         /* No operation. */
     }
     
+    if (bpm == previous_bpm)
+    {
+        return 0;
+    }
+    
     // calculate_required_iterations();
+    period_calculations++;
+    
+    return STATE_BPM;
 }
 
 
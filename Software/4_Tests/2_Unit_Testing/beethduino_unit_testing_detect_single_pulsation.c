@@ -6,7 +6,8 @@
 *   Description:    Unit testing for "detect_single_pulsation" function.
 *                   Checks established preconditions and postconditions, related
 *                   to the behaviour of last_pressed_button_pin when buttons
-*                   are pressed or released.
+*                   are pressed or released (debounced button events), and
+*                   of repeated_button_pins when they are held.
 *
 *   Language:       Arduino (C/C++ set, compatible with avr-g++).
 *                   Compiled in Arduino IDE, version 1.6.13
@@ -30,7 +31,18 @@
 
 #include <assert.h>
 
+const byte BUTTON_PRESSED           = 1;
+const byte BUTTON_RELEASED          = 2;
+const byte BUTTON_LONG_PRESSED      = 3;
+const byte BUTTON_REPEATED          = 4;
+
+const int PORTB_FIRST_PIN           = 8;
+const byte BUTTON_REPEAT_PINS_MASK  = (1 << PINB3) | (1 << PINB4);
+const byte BUTTON_LONG_PRESS_PINS_MASK = (1 << PINB1) | (1 << PINB2)
+                                         | (1 << PINB5);
+
 int last_pressed_button_pin;
+byte repeated_button_pins;
 int pin_to_check = 9;
 
 boolean is_button_being_pressed;
@@ -43,6 +55,7 @@ boolean is_unit_testing_done;
 void setup()
 {
     last_pressed_button_pin = 0;
+    repeated_button_pins = 0;
     
     /*  pinMode inverted in purpose, in order to allow the pin_to_check
     *   remain HIGH until is not required. */
@@ -75,13 +88,17 @@ void execute_tests()
 {
     simulate_button_press(pin_to_check);
     simulate_button_release(pin_to_check);
+    simulate_button_hold(11);   /* CHANGE_BPM_BY_ONE_BUTTON_PIN, repeated. */
+    simulate_button_hold(9);    /* RESTART_BPM_BUTTON_PIN, long pressing. */
+    simulate_button_hold(10);   /* ADD_OR_SUB_BPM_BUTTON_PIN, long pressing. */
+    simulate_button_hold(13);   /* MUTE_BUZZER_BUTTON_PIN, long pressing. */
 }
 
 void simulate_button_press(int pin_to_check)
 {
     Serial.println("simulate_button_press");
     digitalWrite(pin_to_check, HIGH);
-    detect_single_pulsation(pin_to_check);
+    detect_single_pulsation(pin_to_check, BUTTON_PRESSED);
     check_assertions(pin_to_check);
     restore_initial_test_values();
 }
@@ -91,11 +108,26 @@ void simulate_button_release(int pin_to_check)
 {
     Serial.println("simulate_button_release");
     digitalWrite(pin_to_check, LOW);
-    detect_single_pulsation(pin_to_check);
+    detect_single_pulsation(pin_to_check, BUTTON_RELEASED);
     check_assertions(pin_to_check);
     restore_initial_test_values();
 }
 
+void simulate_button_hold(int pin_to_check)
+{
+    Serial.println("simulate_button_hold");
+    detect_single_pulsation(pin_to_check, BUTTON_PRESSED);
+    detect_single_pulsation(pin_to_check, BUTTON_LONG_PRESSED);
+    detect_single_pulsation(pin_to_check, BUTTON_REPEATED);
+    assert (last_pressed_button_pin == pin_to_check);
+    assert (repeated_button_pins == (1 << (pin_to_check - PORTB_FIRST_PIN)));
+    
+    detect_single_pulsation(pin_to_check, BUTTON_RELEASED);
+    assert (last_pressed_button_pin == 0);
+    assert (repeated_button_pins == 0);
+    restore_initial_test_values();
+}
+
 void restore_initial_test_values()
 {
     Serial.println("");
@@ -120,33 +152,65 @@ void check_assertions(int pin_to_check)
 /**
 * PRECONDITIONS     =>      pin_to_check GREATER OR EQUAL TO 9
 *                       AND pin_to_check LESS OR EQUAL TO 13
-*                       AND ( (pin_to_check = HIGH) OR (pin_to_check = LOW))
+*                       AND ( (button_event = BUTTON_PRESSED) 
+*                             OR (button_event = BUTTON_RELEASED)
+*                             OR (button_event = BUTTON_LONG_PRESSED)
+*                             OR (button_event = BUTTON_REPEATED))
 *
 * EXCEPTIONS        =>  No exceptions expected.
 *
-* POSTCONDITIONS    =>  IF pin_to_check = HIGH THEN
+* POSTCONDITIONS    =>  IF button_event = BUTTON_PRESSED THEN
 *                           last_pressed_button_pin = pin_to_check
-*                       ELSE
+*                       ELSE IF button_event = BUTTON_RELEASED THEN
 *                           last_pressed_button_pin = 0
+*                           AND repeated_button_pins = 0
 *
-* ANALYSIS          =>  In the worst case, when pin_to_check is HIGH and LOW
-*                       in the same cycle, the program flow allows a correct
-*                       data processing. No errors expected.
+* ANALYSIS          =>  The event is generated by the debouncer, so it can
+*                       not change during the function. No errors expected.
 */ 
-void detect_single_pulsation(int pin_to_check)
+void detect_single_pulsation(int pin_to_check, byte button_event)
 {
+    byte pin_bit = 1 << (pin_to_check - PORTB_FIRST_PIN);
+    
     /* Detect what button is pressed. */
-    if (digitalRead(pin_to_check) == HIGH)
+    if (button_event == BUTTON_PRESSED)
     {
         last_pressed_button_pin = pin_to_check;
     }
     
+    /* Detect if the held button is repeated. */
+    if (((button_event == BUTTON_LONG_PRESSED) 
+         || (button_event == BUTTON_REPEATED))
+        && ((BUTTON_REPEAT_PINS_MASK & pin_bit) != 0))
+    {
+        repeated_button_pins = repeated_button_pins | pin_bit;
+        // perform_operation(pin_to_check, BUTTON_RELEASED);
+    }
+    else if ((button_event == BUTTON_LONG_PRESSED)
+             && ((BUTTON_LONG_PRESS_PINS_MASK & pin_bit) != 0))
+    {
+        repeated_button_pins = repeated_button_pins | pin_bit;
+        // perform_operation(pin_to_check, BUTTON_LONG_PRESSED);
+    }
+    else
+    {
+        /* No operation. */
+    }
+    
     /* Detect if the pressed button is now released. */
-    if ((digitalRead(pin_to_check) == LOW)
-        && (last_pressed_button_pin == pin_to_check))
+    if (button_event == BUTTON_RELEASED)
     {
-        last_pressed_button_pin = 0;
-        // perform_operation(pin_to_check);
+        if (last_pressed_button_pin == pin_to_check)
+        {
+            last_pressed_button_pin = 0;
+        }
+        
+        if ((repeated_button_pins & pin_bit) == 0)
+        {
+            // perform_operation(pin_to_check, BUTTON_RELEASED);
+        }
+        
+        repeated_button_pins = repeated_button_pins & ~pin_bit;
     } 
 }
 
@@ -15,6 +15,7 @@
 *
 *   Dependencies:   Arduino.h
 *                   Beethduino.h 
+*                   avr/sleep.h
 *
 *   Notes:          BPM - Beats Per Minute.
 *                   LCD - Liquid Crystal Display.
@@ -33,7 +34,204 @@
 #include "Beethduino.h"
 
 #include <LiquidCrystal.h>
-LiquidCrystal lcd(2, 3, 4, 5, 6, 7);
+#include <avr/sleep.h>
+LiquidCrystal lcd(BoardConfig::LCD_RS_PIN, BoardConfig::LCD_ENABLE_PIN,
+                  BoardConfig::LCD_D4_PIN, BoardConfig::LCD_D5_PIN,
+                  BoardConfig::LCD_D6_PIN, BoardConfig::LCD_D7_PIN);
+
+Beethduino *Beethduino::active_instance = 0;
+
+static_assert(Beethduino::BUTTON_PINS_MASK 
+              == (((1 << Beethduino::BUTTONS) - 1) 
+                  << (Beethduino::FIRST_BUTTON_PIN 
+                      - Beethduino::PORTB_FIRST_PIN)),
+              "The buttons must be consecutive pins of the port B.");
+static_assert((PortBPin<Beethduino::ACTIVE_BUZZER_PIN>::BIT 
+               & Beethduino::BUTTON_PINS_MASK) == 0,
+              "The buzzer pin must not be a button pin.");
+static_assert((Beethduino::BUTTON_LONG_PRESS_PINS_MASK 
+               & Beethduino::BUTTON_REPEAT_PINS_MASK) == 0,
+              "A repeated button has no long pressing operation.");
+static_assert(Beethduino::ACCENT_SOUND_DURATION 
+              < (Beethduino::MILLISECONDS_IN_MINUTE 
+                 / (Beethduino::BPM_UPPER_BOUND 
+                    * Beethduino::MAX_CLICKS_PER_BEAT)),
+              "The accented sound must end before the next sub-beat.");
+static_assert(Beethduino::SUBDIVISION_SOUND_DURATION 
+              < Beethduino::SOUND_DURATION,
+              "The sub-beats must sound shorter than the beats.");
+static_assert(Beethduino::TIMERS <= 16, 
+              "The due timers are the bits of an unsigned int.");
+static_assert((Beethduino::MILLISECONDS_IN_MINUTE 
+               / Beethduino::BPM_LOWER_BOUND) 
+              < Beethduino::TIMER_WHEEL_RANGE,
+              "The longest beat period must fit in the timing wheel.");
+
+/*  Texts of the LCD and of the serial monitor simulation, in the flash 
+*   memory (PROGMEM). The BPM is formatted in a stack buffer (no String).
+*/
+const char MUTE_TEXT[] PROGMEM      = "MUTE_MUTE_MUTE_";
+const char LFCR_TEXT[] PROGMEM      = "LFCR"; /*Line Feed and Carriage Return.*/
+const char ADD_BPM_TEXT[] PROGMEM   = "ADD BPM: ";
+const char SUB_BPM_TEXT[] PROGMEM   = "SUB BPM: ";
+const char TEMPO_MAP_TEXT[] PROGMEM = "MAP";
+
+/*  Table of beat periods (required iterations) for every BPM value, 
+*   generated at compile time and stored in the flash memory (PROGMEM). 
+*   BpmSequence holds the BPM values from BPM_LOWER_BOUND to BPM_UPPER_BOUND;
+*   BeatPeriodTable expands it into one MILLISECONDS_IN_MINUTE / bpm per BPM.
+*   In this way, no division is executed when the BPM is changed.
+*/
+template <unsigned int... BPM_VALUES>
+struct BpmSequence
+{
+};
+
+template <unsigned int FIRST_BPM, unsigned int LAST_BPM, 
+          unsigned int... BPM_VALUES>
+struct MakeBpmSequence 
+    : MakeBpmSequence<FIRST_BPM, LAST_BPM - 1, LAST_BPM, BPM_VALUES...>
+{
+};
+
+template <unsigned int FIRST_BPM, unsigned int... BPM_VALUES>
+struct MakeBpmSequence<FIRST_BPM, FIRST_BPM, BPM_VALUES...>
+{
+    typedef BpmSequence<FIRST_BPM, BPM_VALUES...> type;
+};
+
+template <typename BPM_SEQUENCE>
+struct BeatPeriodTable;
+
+template <unsigned int... BPM_VALUES>
+struct BeatPeriodTable< BpmSequence<BPM_VALUES...> >
+{
+    static const unsigned int required_iterations[sizeof...(BPM_VALUES)];
+};
+
+template <unsigned int... BPM_VALUES>
+const unsigned int BeatPeriodTable< BpmSequence<BPM_VALUES...> >
+    ::required_iterations[sizeof...(BPM_VALUES)] PROGMEM =
+{
+    (Beethduino::MILLISECONDS_IN_MINUTE / BPM_VALUES)...
+};
+
+typedef BeatPeriodTable< 
+            MakeBpmSequence<Beethduino::BPM_LOWER_BOUND,
+                            Beethduino::BPM_UPPER_BOUND>::type > 
+        BeatPeriods;
+
+/* Acceleration curve of the auto-repeat, in ticks (stored in PROGMEM). */
+const unsigned int Beethduino::BUTTON_REPEAT_PERIODS[] PROGMEM = 
+{
+    200, 150, 120, 100, 80, 70, 60, 50
+};
+const byte Beethduino::BUTTON_REPEAT_STEPS = sizeof(BUTTON_REPEAT_PERIODS) 
+                                             / sizeof(BUTTON_REPEAT_PERIODS[0]);
+
+/*  Operations of the buttons; every one returns the STATE_ flags of the 
+*   parts it has changed. The member function pointers are not plain 
+*   addresses (pgm_read_ptr cannot read them), so this table is not in 
+*   PROGMEM, as it is in the main code.
+*/
+const Beethduino::ButtonAction Beethduino::BUTTON_ACTIONS[] = 
+{
+    {RESTART_BPM_BUTTON_PIN,        BUTTON_RELEASED,    
+     &Beethduino::reset_bpm},
+    {ADD_OR_SUB_BPM_BUTTON_PIN,     BUTTON_RELEASED,    
+     &Beethduino::invert_bpm_modifier},
+    {CHANGE_BPM_BY_ONE_BUTTON_PIN,  BUTTON_RELEASED,    
+     &Beethduino::change_bpm_by_one},
+    {CHANGE_BPM_BY_TEN_BUTTON_PIN,  BUTTON_RELEASED,    
+     &Beethduino::change_bpm_by_ten},
+    {MUTE_BUZZER_BUTTON_PIN,        BUTTON_RELEASED,    
+     &Beethduino::change_mute_state},
+    {RESTART_BPM_BUTTON_PIN,        BUTTON_LONG_PRESSED, 
+     &Beethduino::change_time_signature},
+    {ADD_OR_SUB_BPM_BUTTON_PIN,     BUTTON_LONG_PRESSED, 
+     &Beethduino::change_subdivision},
+    {MUTE_BUZZER_BUTTON_PIN,        BUTTON_LONG_PRESSED, 
+     &Beethduino::start_tempo_map}
+};
+const byte Beethduino::BUTTON_ACTIONS_COUNT = sizeof(BUTTON_ACTIONS) 
+                                              / sizeof(BUTTON_ACTIONS[0]);
+
+/*  Handlers of the timers of the timing wheel, by timer number (the timers
+*   due in the same tick expire lowest number first). Not in PROGMEM, as 
+*   BUTTON_ACTIONS.
+*/
+const Beethduino::TimerHandler Beethduino::TIMER_HANDLERS[TIMERS] = 
+{
+    &Beethduino::expire_buzzer_off,
+    &Beethduino::expire_beat,
+    &Beethduino::expire_subdivision,
+    &Beethduino::expire_voice_event,
+    &Beethduino::expire_debounce,
+    &Beethduino::expire_button_hold,    /* RESTART_BPM_BUTTON_PIN. */
+    &Beethduino::expire_button_hold,
+    &Beethduino::expire_button_hold,
+    &Beethduino::expire_button_hold,
+    &Beethduino::expire_button_hold     /* MUTE_BUZZER_BUTTON_PIN. */
+};
+
+/*  Time signatures, selected in turn by the long pressing of the restart 
+*   button (stored in PROGMEM); the downbeat sounds ACCENT_SOUND_DURATION.
+*/
+const Beethduino::TimeSignature Beethduino::TIME_SIGNATURES[] PROGMEM = 
+{
+    {2, "2/4"},
+    {3, "3/4"},
+    {4, "4/4"},
+    {6, "6/8"},
+    {7, "7/8"}
+};
+const byte Beethduino::TIME_SIGNATURES_COUNT = sizeof(TIME_SIGNATURES) 
+                                               / sizeof(TIME_SIGNATURES[0]);
+
+/*  Subdivisions of the beat, selected in turn by the long pressing of the 
+*   modifier button (stored in PROGMEM). Every beat schedules its sub-beats
+*   from its own period; the step is obtained with the multiplier, 
+*   ceil(2^17 / clicks_per_beat), instead of a division.
+*/
+const Beethduino::Subdivision Beethduino::SUBDIVISIONS[] PROGMEM = 
+{
+    {1, 0,      "1"},
+    {2, 65536,  "2"},
+    {3, 43691,  "3"},
+    {4, 32768,  "4"}
+};
+const byte Beethduino::SUBDIVISIONS_COUNT = sizeof(SUBDIVISIONS) 
+                                            / sizeof(SUBDIVISIONS[0]);
+
+/*  Tempo map (stored in PROGMEM), started by the long pressing of the mute
+*   button: 4 bars at 80 BPM, then +5 BPM every 8 bars, up to 140. Every 
+*   instruction is one opcode byte and its operands (little-endian words);
+*   the programs are compiled on the host by beethduino_host_compile_tempo_map.
+*   The main loop stages the next segment, and the timer interrupt switches
+*   to it in the downbeat where the bars of the current one end.
+*/
+const byte Beethduino::TEMPO_MAP[] PROGMEM = 
+{
+    TEMPO_MAP_PLAY, 80, 0, 4,       /* 4 bars at 80 BPM. */
+    TEMPO_MAP_RAMP, 5, 8, 140, 0,   /* +5 BPM every 8 bars, up to 140. */
+    TEMPO_MAP_END
+};
+const unsigned int Beethduino::TEMPO_MAP_SIZE = sizeof(TEMPO_MAP);
+
+/*  Polyrhythm voices (their values are in Beethduino.h): pulses against 
+*   beats, locked to the beats (the pulses of a beat are placed in its own 
+*   period). The division by pulses is done with the multiplier, 
+*   ceil(2^16 / pulses), and one correction; the events of all the voices 
+*   are merged in a min-heap, ordered by deadline.
+*/
+constexpr Beethduino::Voice Beethduino::VOICES[] PROGMEM;
+
+const unsigned long Beethduino::VOICE_MULTIPLIERS[MAX_VOICE_PULSES + 1] 
+    PROGMEM = 
+{
+    0, 65536, 32768, 21846, 16384, 13108, 10923, 9363, 8192
+};
+
 
 Beethduino::Beethduino()
 {
@@ -48,234 +246,2140 @@ Beethduino::Beethduino()
     pinMode(RESTART_BPM_BUTTON_PIN, OUTPUT);
     
     pinMode(ACTIVE_BUZZER_PIN, OUTPUT);
+    configure_voice_pins();
 
-    lcd.begin(16, 2); /* Set LCD number of columns and rows. */
+    lcd.begin(LCD_COLUMNS, LCD_ROWS); /* Set LCD columns and rows. */
+    init_lcd_frame();
+    
+    time_signature = DEFAULT_TIME_SIGNATURE;
+    beats_per_bar = pgm_read_byte(
+        &TIME_SIGNATURES[DEFAULT_TIME_SIGNATURE].beats_per_bar);
+    beat_in_bar = 0;
     
+    subdivision = DEFAULT_SUBDIVISION;
+    clicks_per_beat = pgm_read_byte(
+        &SUBDIVISIONS[DEFAULT_SUBDIVISION].clicks_per_beat);
+    pending_subdivisions = 0;
+    
+    tempo_map = TEMPO_MAP;
+    tempo_map_size = TEMPO_MAP_SIZE;
+    tempo_map_pc = 0;
+    tempo_map_bpm = 0;
+    tempo_map_time_signature = DEFAULT_TIME_SIGNATURE;
+    is_tempo_map_running = false;
+    is_tempo_segment_staged = false;
+    is_tempo_map_changed = false;
+    tempo_map_bars_left = 0;
+    staged_bars = 0;
+    ramp_start_bpm = 0;
+    tempo_ramp = TEMPO_RAMP_NONE;
+    tempo_ramp_beats_left = 0;
+    staged_ramp = TEMPO_RAMP_NONE;
+    staged_ramp_beats = 0;
+    tempo_map_voices = 0;
+    staged_voices = 0;
+    active_voices = 0;
+    sounding_voice_pins = 0;
+    voice_event_count = 0;
+    
+    timer_ticks = 0;
+    init_timer_wheel();
+    
+    /* reset_bpm compares them with their reset values (for its STATE_ 
+    * flags), so they are set first.
+    */
+    bpm = 60;
+    bpm_modifier = 1;
+    is_buzzer_muted = true;
     reset_bpm();
     update_lcd();
     update_serial_monitor();
     
     buzzer_bips = 0;  
+    is_sleep_enabled = false;
+    button_event_head           = 0;
+    button_event_tail           = 0;
+    button_pin_levels           = 0;
+    long_pressed_buttons        = 0;
+    is_button_debounce_active   = false;
     last_pressed_button_pin     = 0;
-    iteration_counter           = 0;
+    repeated_button_pins        = 0;
+    beat_deadline_tick          = 0;
+    buzzer_off_tick             = 0;
+    is_buzzer_sounding          = false;
 }
 
 
-void Beethduino::exec_main_loop()
+/*
+* The pins of the voices with an output of their own, low until their first
+* pulse.
+*/
+void Beethduino::configure_voice_pins()
 {
-    check_button_pressing();
-    process_bpm_frequency();
+    byte voice;
+    byte pin;
+    
+    for (voice = 0; voice < VOICES_COUNT; voice++)
+    {
+        if (pgm_read_byte(&VOICES[voice].output) != VOICE_OUTPUT_BUZZER)
+        {
+            pin = pgm_read_byte(&VOICES[voice].pin);
+            pinMode(pin, OUTPUT);
+            digitalWrite(pin, LOW);
+        }
+    }
 }
 
 
-void Beethduino::check_button_pressing()
+/*
+* Timer1 is not configured in the constructor because the Arduino core 
+* initialization (executed after global constructors) overwrites it.
+* Call this method in the setup() of the test.
+*/
+void Beethduino::configure_beat_timer()
 {
-    int pin_to_check;
+    noInterrupts();
+    
+    active_instance = this;
     
-    for (pin_to_check = 9; pin_to_check <= 13; pin_to_check++)
+    TCCR1A = 0;
+    TCCR1B = (1 << WGM12) | (1 << CS11) | (1 << CS10); /* CTC, prescaler 64. */
+    TCNT1  = 0;
+    OCR1A  = TIMER1_COMPARE_VALUE;
+    TIMSK1 = (1 << OCIE1A);
+    
+    interrupts();
+}
+
+
+void Beethduino::timer_compare_isr()
+{
+    timer_ticks++;
+    serve_timer_wheel();
+}
+
+
+ISR(TIMER1_COMPA_vect)
+{
+    if (Beethduino::active_instance != 0)
     {
-        detect_single_pulsation(pin_to_check);
+        Beethduino::active_instance->timer_compare_isr();
     }
 }
 
+
 /*
-* Detect the button that, after being pressed, has been released.
-* The method allows to detect the pulsation of a button, and its release.
-* Actions are performed only in the releasing process of a button, not in
-* the pressings. This is done to avoid comples State Change Detection
-* methods, and to allow the user to control the modifications (start and stop).
+* As the Timer1, call this method in the setup() of the test; it also sets
+* this instance as the one served by the interrupts.
 */
-void Beethduino::detect_single_pulsation(int pin_to_check)
+void Beethduino::configure_button_interrupts()
 {
-    /* Detect what button is pressed. */
-    if (digitalRead(pin_to_check) == HIGH)
+    byte button;
+    byte pin_bit;
+    
+    noInterrupts();
+    
+    active_instance = this;
+    
+    button_event_head = 0;
+    button_event_tail = 0;
+    button_pin_levels = PINB & BUTTON_PINS_MASK;
+    long_pressed_buttons = 0;
+    
+    for (button = 0; button < BUTTONS; button++)
     {
-        last_pressed_button_pin = pin_to_check;
+        pin_bit = 1 << (FIRST_BUTTON_PIN - PORTB_FIRST_PIN + button);
+        button_integrators[button] = ((button_pin_levels & pin_bit) != 0) 
+                                     ? BUTTON_DEBOUNCE_TICKS : 0;
+        button_repeat_steps[button] = 0;
+        
+        if ((button_pin_levels & pin_bit) != 0)
+        {
+            arm_timer(TIMER_BUTTON_HOLD + button, 
+                      timer_ticks + BUTTON_LONG_PRESS_TICKS);
+        }
+        else
+        {
+            cancel_timer(TIMER_BUTTON_HOLD + button);
+        }
     }
     
-    /* Detect if the pressed button is now released. */
-    if ((digitalRead(pin_to_check) == LOW)
-        && (last_pressed_button_pin == pin_to_check))
+    is_button_debounce_active = (button_pin_levels != 0);
+    
+    if (is_button_debounce_active == true)
     {
-        last_pressed_button_pin = 0;
-        perform_operation(pin_to_check);
-    } 
+        arm_timer(TIMER_DEBOUNCE, timer_ticks + 1);
+    }
+    
+    PCMSK0 = BUTTON_PINS_MASK;  /* PCINT1 to PCINT5 are PB1 to PB5. */
+    PCICR  = PCICR | (1 << PCIE0);
+    
+    interrupts();
 }
 
 
-void Beethduino::perform_operation(int pin_to_check)
+ISR(PCINT0_vect)
 {
-    switch (pin_to_check) 
+    if (Beethduino::active_instance != 0)
     {
-        case 9:
-            reset_bpm();
-            break;
-        case 10:
-            invert_bpm_modifier();
-            break;
-        case 11:
-            update_bpm(1);
-            break;
-        case 12:
-            update_bpm(10);
-            break;
-        case 13:
-            change_mute_state();
-            break;
-        default: 
-            /* No operation. */
-        break;
+        Beethduino::active_instance->is_button_debounce_active = true;
+        Beethduino::active_instance->arm_timer(
+            Beethduino::TIMER_DEBOUNCE, 
+            Beethduino::active_instance->timer_ticks + 1);
     }
-    
-    update_lcd();
-    update_serial_monitor();
 }
 
 
-void Beethduino::reset_bpm()
+void Beethduino::debounce_buttons()
 {
-    bpm                 = 60;
-    bpm_modifier        = 1;
-    bpm_freq_req_iter   = 975;
-    is_buzzer_muted     = true;
+    byte button;
+    byte pin_bit;
+    byte port_snapshot;
+    byte debounced_levels;
+    byte changed_pins;
+    boolean is_any_button_bouncing;
+    
+    port_snapshot = PINB & BUTTON_PINS_MASK;
+    debounced_levels = button_pin_levels;
+    is_any_button_bouncing = false;
+    
+    for (button = 0; button < BUTTONS; button++)
+    {
+        pin_bit = 1 << (FIRST_BUTTON_PIN - PORTB_FIRST_PIN + button);
+        
+        if ((port_snapshot & pin_bit) != 0)
+        {
+            if (button_integrators[button] < BUTTON_DEBOUNCE_TICKS)
+            {
+                button_integrators[button]++;
+            }
+        }
+        else if (button_integrators[button] > 0)
+        {
+            button_integrators[button]--;
+        }
+        
+        if (button_integrators[button] == BUTTON_DEBOUNCE_TICKS)
+        {
+            debounced_levels = debounced_levels | pin_bit;
+        }
+        else if (button_integrators[button] == 0)
+        {
+            debounced_levels = debounced_levels & ~pin_bit;
+        }
+        else
+        {
+            is_any_button_bouncing = true;
+        }
+    }
+    
+    changed_pins = debounced_levels ^ button_pin_levels;
+    button_pin_levels = debounced_levels;
+    
+    for (button = 0; button < BUTTONS; button++)
+    {
+        pin_bit = 1 << (FIRST_BUTTON_PIN - PORTB_FIRST_PIN + button);
+        
+        if ((changed_pins & pin_bit) != 0)
+        {
+            if ((debounced_levels & pin_bit) != 0)
+            {
+                button_repeat_steps[button] = 0;
+                arm_timer(TIMER_BUTTON_HOLD + button, 
+                          timer_ticks + BUTTON_LONG_PRESS_TICKS);
+                push_button_event(FIRST_BUTTON_PIN + button, BUTTON_PRESSED);
+            }
+            else
+            {
+                long_pressed_buttons = long_pressed_buttons & ~pin_bit;
+                cancel_timer(TIMER_BUTTON_HOLD + button);
+                push_button_event(FIRST_BUTTON_PIN + button, BUTTON_RELEASED);
+            }
+        }
+    }
+    
+    is_button_debounce_active = (is_any_button_bouncing == true)
+                                || (debounced_levels != 0);
+    
+    if (is_button_debounce_active == true)
+    {
+        arm_timer(TIMER_DEBOUNCE, timer_ticks + 1);
+    }
 }
 
 
-void Beethduino::invert_bpm_modifier()
+void Beethduino::expire_debounce(byte /* timer */)
 {
-    bpm_modifier = bpm_modifier * -1;
+    debounce_buttons();
 }
 
 
-void Beethduino::update_bpm(int value)
+/*
+* Long pressing BUTTON_LONG_PRESS_TICKS after the pressing; then, only the 
+* buttons of BUTTON_REPEAT_PINS_MASK are repeated, every period of the 
+* acceleration curve (the last one is kept until the release).
+*/
+void Beethduino::expire_button_hold(byte timer)
 {
-    bpm = bpm + (bpm_modifier * value);
+    byte button = timer - TIMER_BUTTON_HOLD;
+    byte pin_bit = 1 << (FIRST_BUTTON_PIN - PORTB_FIRST_PIN + button);
+    byte repeat_step = button_repeat_steps[button];
     
-    if (bpm > BPM_UPPER_BOUND)
+    if ((BUTTON_REPEAT_PINS_MASK & pin_bit) != 0)
     {
-        bpm = BPM_UPPER_BOUND;
-    } 
-    else if (bpm < BPM_LOWER_BOUND)
+        arm_timer(timer, timer_ticks 
+                         + pgm_read_word(&BUTTON_REPEAT_PERIODS[repeat_step]));
+        
+        if (repeat_step < (BUTTON_REPEAT_STEPS - 1))
+        {
+            button_repeat_steps[button] = repeat_step + 1;
+        }
+    }
+    
+    if ((long_pressed_buttons & pin_bit) == 0)
     {
-        bpm = BPM_LOWER_BOUND;
+        long_pressed_buttons = long_pressed_buttons | pin_bit;
+        push_button_event(FIRST_BUTTON_PIN + button, BUTTON_LONG_PRESSED);
     }
-    else 
+    else
     {
-        /* No operation. */
+        push_button_event(FIRST_BUTTON_PIN + button, BUTTON_REPEATED);
     }
-    
-    calculate_required_iterations();
 }
 
 
-void Beethduino::calculate_required_iterations()
+void Beethduino::push_button_event(int pin_to_check, byte button_event)
 {
-    double temp_required_iterations;
+    byte next_head = (button_event_head + 1) & (BUTTON_EVENT_QUEUE_SIZE - 1);
     
-    temp_required_iterations 
-        = ((SECONDS_IN_MINUTE / bpm) * MILLISECONDS_IN_SECOND) - SOUND_DURATION;
-        
-    bpm_freq_req_iter = (unsigned int) temp_required_iterations;
+    if (next_head != button_event_tail)
+    {
+        button_event_pins[button_event_head] = pin_to_check;
+        button_event_types[button_event_head] = button_event;
+        button_event_head = next_head;
+    }
 }
 
 
-void Beethduino::change_mute_state()
+void Beethduino::exec_main_loop()
 {
-    is_buzzer_muted = !is_buzzer_muted;
+    check_button_pressing();
+    service_tempo_map();
+    service_lcd();
+    sleep_until_event();
 }
 
 
-void Beethduino::update_lcd()
-{    
-    lcd.clear();
+/*
+* Idle mode (Timer1 and the pin change interrupt wake the CPU), if 
+* is_sleep_enabled and the main loop has nothing to do; checked with the 
+* interrupts disabled.
+*/
+void Beethduino::sleep_until_event()
+{
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    noInterrupts();
     
-    lcd.setCursor(0, 0);
-    if (is_buzzer_muted == true)
+    if ((is_sleep_enabled == true)
+        && (button_event_tail == button_event_head)
+        && (is_tempo_map_changed == false)
+        && ((is_tempo_map_running == false) 
+            || (is_tempo_segment_staged == true))
+        && (lcd_next_cell == LCD_CELLS))
     {
-        lcd.print("MUTE_MUTE_MUTE_"); 
+        sleep_enable();
+        interrupts();
+        sleep_cpu();
+        sleep_disable();
     }
-    else if (is_buzzer_muted == false)
+    
+    interrupts();
+}
+
+
+void Beethduino::check_button_pressing()
+{
+    int pin_to_check;
+    byte button_event;
+    
+    while (button_event_tail != button_event_head)
     {
-        lcd.print("");
+        pin_to_check = button_event_pins[button_event_tail];
+        button_event = button_event_types[button_event_tail];
+        button_event_tail = (button_event_tail + 1) 
+                            & (BUTTON_EVENT_QUEUE_SIZE - 1);
+        
+        detect_single_pulsation(pin_to_check, button_event);
     }
-    else 
+}
+
+
+/*
+* Detect the button that, after being pressed, has been released.
+* The method allows to detect the pulsation of a button, and its release.
+* Actions are performed only in the releasing process of a button, not in
+* the pressings. This is done to avoid comples State Change Detection
+* methods, and to allow the user to control the modifications (start and stop).
+* The debouncer tracks every button, so a release always follows the 
+* pressing of the same button, even if other buttons were pressed meanwhile.
+* The held BPM buttons perform their operation in the long pressing and in
+* every repetition, and not again in the release. The buttons of 
+* BUTTON_LONG_PRESS_PINS_MASK perform their long pressing operation instead
+* of the short one.
+*/
+void Beethduino::detect_single_pulsation(int pin_to_check, byte button_event)
+{
+    byte pin_bit = 1 << (pin_to_check - PORTB_FIRST_PIN);
+    
+    /* Detect what button is pressed. */
+    if (button_event == BUTTON_PRESSED)
     {
-        /* No operation. */
+        last_pressed_button_pin = pin_to_check;
     }
     
-    String bpm_text_info;
-    lcd.setCursor(0, 1);
-    
-    if (bpm_modifier == -1)
+    /* Detect if the held button is repeated. */
+    if (((button_event == BUTTON_LONG_PRESSED) 
+         || (button_event == BUTTON_REPEATED))
+        && ((BUTTON_REPEAT_PINS_MASK & pin_bit) != 0))
     {
-        bpm_text_info = "SUB BPM: ";        
+        repeated_button_pins = repeated_button_pins | pin_bit;
+        perform_operation(pin_to_check, BUTTON_RELEASED);
     }
-    else if (bpm_modifier == 1)
+    else if ((button_event == BUTTON_LONG_PRESSED)
+             && ((BUTTON_LONG_PRESS_PINS_MASK & pin_bit) != 0))
     {
-        bpm_text_info = "ADD BPM: ";
+        repeated_button_pins = repeated_button_pins | pin_bit;
+        perform_operation(pin_to_check, BUTTON_LONG_PRESSED);
     }
     else
     {
         /* No operation. */
     }
     
-    bpm_text_info.concat(bpm);
-    lcd.print(bpm_text_info);
+    /* Detect if the pressed button is now released. */
+    if (button_event == BUTTON_RELEASED)
+    {
+        if (last_pressed_button_pin == pin_to_check)
+        {
+            last_pressed_button_pin = 0;
+        }
+        
+        if ((repeated_button_pins & pin_bit) == 0)
+        {
+            perform_operation(pin_to_check, BUTTON_RELEASED);
+        }
+        
+        repeated_button_pins = repeated_button_pins & ~pin_bit;
+    } 
 }
 
-void Beethduino::update_serial_monitor()
+
+/*
+* The operation of the pin and event is looked up in BUTTON_ACTIONS; the 
+* LCD (and the serial monitor text) is updated only if a part shown in it 
+* has changed.
+*/
+void Beethduino::perform_operation(int pin_to_check, byte button_event)
 {
-    bpm_text_info = "";
+    byte action;
+    byte changed_state = 0;
     
-    if (is_buzzer_muted == true)
-    {
-        bpm_text_info = "MUTE_MUTE_MUTE_LFCR";/*Line Feed and Carriage Return.*/
-    }
-    else if (is_buzzer_muted == false)
+    for (action = 0; action < BUTTON_ACTIONS_COUNT; action++)
     {
-        bpm_text_info = "LFCR";
+        if ((BUTTON_ACTIONS[action].pin == pin_to_check)
+            && (BUTTON_ACTIONS[action].button_event == button_event))
+        {
+            changed_state = changed_state 
+                            | (this->*BUTTON_ACTIONS[action].operation)();
+        }
     }
-    else 
+    
+    if ((changed_state & STATE_SHOWN_IN_LCD) != 0)
     {
-        /* No operation. */
+        update_lcd();
+        update_serial_monitor();
     }
+}
+
+
+byte Beethduino::reset_bpm()
+{
+    byte changed_state = stop_tempo_map();
     
-    if (bpm_modifier == -1)
+    if (bpm != 60)
     {
-        bpm_text_info.concat("SUB BPM: ");        
+        changed_state = changed_state | STATE_BPM;
     }
-    else if (bpm_modifier == 1)
+    
+    if (bpm_modifier != 1)
     {
-        bpm_text_info.concat("ADD BPM: ");  
+        changed_state = changed_state | STATE_BPM_MODIFIER;
     }
-    else
+    
+    if (is_buzzer_muted != true)
     {
-        /* No operation. */
+        changed_state = changed_state | STATE_MUTE;
     }
     
-    bpm_text_info.concat(bpm);
+    noInterrupts();
+    
+    bpm                 = 60;
+    bpm_modifier        = 1;
+    bpm_freq_req_iter   = 1000;
+    bpm_freq_remainder  = 0;
+    bpm_freq_divisor    = 60;
+    beat_error_accumulator = 0;
+    is_buzzer_muted     = true;
+    pending_subdivisions = 0;
+    active_voices       = 0;
+    arm_beat_timers();
+    restart_voices();
+    
+    interrupts();
+    
+    calculate_subdivision_step();
+    
+    return changed_state;
 }
 
-void Beethduino::process_bpm_frequency()
+
+byte Beethduino::invert_bpm_modifier()
 {
-    if (is_buzzer_muted == false)
-    {
-        delay(1);
-        iteration_counter++;
-        if (iteration_counter >= bpm_freq_req_iter)
-        {
-            play_buzzer();
-            iteration_counter = 0;
-        }
-    }
+    bpm_modifier = bpm_modifier * -1;
+    
+    return STATE_BPM_MODIFIER;
 }
 
 
-void Beethduino::play_buzzer()
+byte Beethduino::change_bpm_by_one()
+{
+    return update_bpm(1);
+}
+
+
+byte Beethduino::change_bpm_by_ten()
+{
+    return update_bpm(10);
+}
+
+
+/*
+* At the bounds, the BPM does not change: the period is not recalculated.
+*/
+byte Beethduino::update_bpm(int value)
 {
-    digitalWrite(ACTIVE_BUZZER_PIN, HIGH);
-    delay(SOUND_DURATION);
-    digitalWrite(ACTIVE_BUZZER_PIN, LOW);
+    byte changed_state = stop_tempo_map();
+    int previous_bpm = bpm;
     
-    buzzer_bips ++;
+    bpm = bpm + (bpm_modifier * value);
+    
+    if (bpm > BPM_UPPER_BOUND)
+    {
+        bpm = BPM_UPPER_BOUND;
+    } 
+    else if (bpm < BPM_LOWER_BOUND)
+    {
+        bpm = BPM_LOWER_BOUND;
+    }
+    else 
+    {
+        /* No operation. */
+    }
+    
+    if (bpm == previous_bpm)
+    {
+        return changed_state;
+    }
+    
+    calculate_required_iterations();
+    
+    return changed_state | STATE_BPM;
+}
+
+
+void Beethduino::calculate_required_iterations()
+{
+    unsigned int required_iterations;
+    unsigned int required_remainder;
+    
+    required_iterations = pgm_read_word(
+        &BeatPeriods::required_iterations[bpm - BPM_LOWER_BOUND]);
+    required_remainder  = MILLISECONDS_IN_MINUTE - (required_iterations * bpm);
+    
+    noInterrupts();
+    
+    beat_deadline_tick = beat_deadline_tick - bpm_freq_req_iter;
+    bpm_freq_req_iter = required_iterations;
+    beat_deadline_tick = beat_deadline_tick + bpm_freq_req_iter;
+    
+    bpm_freq_remainder = required_remainder;
+    bpm_freq_divisor = bpm;
+    beat_error_accumulator = 0;
+    pending_subdivisions = 0;
+    arm_beat_timers();
+    
+    interrupts();
+    
+    calculate_subdivision_step();
+}
+
+
+/*
+* With the interrupts disabled: the timer interrupt changes the base period
+* when a segment of the tempo map starts.
+*/
+void Beethduino::calculate_subdivision_step()
+{
+    noInterrupts();
+    
+    set_subdivision_step();
+    
+    interrupts();
+}
+
+
+/*
+* The step of the base period, floor(bpm_freq_req_iter / clicks_per_beat),
+* with the multiplier of the table (no division), and its remainder.
+* Executed with the interrupts disabled, or by the timer interrupt.
+*/
+void Beethduino::set_subdivision_step()
+{
+    unsigned long period_multiplier;
+    
+    period_multiplier = pgm_read_dword(
+        &SUBDIVISIONS[subdivision].period_multiplier);
+    
+    if (period_multiplier != 0)
+    {
+        subdivision_req_iter = (bpm_freq_req_iter * period_multiplier) 
+                               >> SUBDIVISION_PERIOD_SHIFT;
+        subdivision_remainder = bpm_freq_req_iter 
+                                - (subdivision_req_iter * clicks_per_beat);
+    }
+    else
+    {
+        subdivision_req_iter = 0;
+        subdivision_remainder = 0;
+    }
+}
+
+
+byte Beethduino::change_mute_state()
+{
+    byte changed_state = stop_tempo_map();
+    
+    noInterrupts();
+    
+    beat_deadline_tick = timer_ticks + bpm_freq_req_iter;
+    beat_in_bar = 0;
+    pending_subdivisions = 0;
+    is_buzzer_muted = !is_buzzer_muted;
+    arm_beat_timers();
+    restart_voices();
+    
+    interrupts();
+    
+    return changed_state | STATE_MUTE;
+}
+
+
+/*
+* Selects the next time signature (after the last one, the first again). 
+* The next beat starts a new bar (and new cycles of the voices); the tempo
+* is not changed.
+*/
+byte Beethduino::change_time_signature()
+{
+    byte changed_state = stop_tempo_map();
+    byte next_beats_per_bar;
+    
+    time_signature++;
+    
+    if (time_signature == TIME_SIGNATURES_COUNT)
+    {
+        time_signature = 0;
+    }
+    
+    next_beats_per_bar = pgm_read_byte(
+        &TIME_SIGNATURES[time_signature].beats_per_bar);
+    
+    noInterrupts();
+    
+    beats_per_bar = next_beats_per_bar;
+    beat_in_bar = 0;
+    restart_voices();
+    
+    interrupts();
+    
+    return changed_state | STATE_TIME_SIGNATURE;
+}
+
+
+/*
+* Selects the next subdivision (after the last one, only the beats again).
+* The sub-beats start in the next beat; the tempo is not changed.
+*/
+byte Beethduino::change_subdivision()
+{
+    subdivision++;
+    
+    if (subdivision == SUBDIVISIONS_COUNT)
+    {
+        subdivision = 0;
+    }
+    
+    noInterrupts();
+    
+    clicks_per_beat = pgm_read_byte(&SUBDIVISIONS[subdivision].clicks_per_beat);
+    pending_subdivisions = 0;
+    arm_beat_timers();
+    
+    interrupts();
+    
+    calculate_subdivision_step();
+    
+    return STATE_SUBDIVISION;
+}
+
+
+/*
+* Starts the tempo map from its first instruction, with the current BPM and
+* time signature: the first segment is applied at once, and the buzzer is 
+* unmuted (the first beat is the downbeat of its first bar). A program 
+* without bars does not start.
+*/
+byte Beethduino::start_tempo_map()
+{
+    byte changed_state = stop_tempo_map();
+    
+    tempo_map_pc = 0;
+    tempo_map_bpm = bpm;
+    tempo_map_time_signature = time_signature;
+    tempo_map_voices = 0;
+    stage_tempo_segment();
+    
+    if (staged_bars == 0)
+    {
+        is_tempo_segment_staged = false;
+        return changed_state;
+    }
+    
+    bpm = tempo_map_bpm;
+    time_signature = tempo_map_time_signature;
+    calculate_required_iterations();
+    
+    noInterrupts();
+    
+    beats_per_bar = staged_beats_per_bar;
+    beat_deadline_tick = timer_ticks + bpm_freq_req_iter;
+    beat_in_bar = 0;
+    pending_subdivisions = 0;
+    is_buzzer_muted = false;
+    arm_beat_timers();
+    active_voices = staged_voices;
+    restart_voices();
+    tempo_map_bars_left = 0;
+    is_tempo_map_running = true;
+    
+    interrupts();
+    
+    return STATE_BPM | STATE_MUTE | STATE_TIME_SIGNATURE | STATE_TEMPO_MAP;
+}
+
+
+/*
+* The current tempo is kept; a segment started by the timer interrupt, and
+* not shown yet, is taken as the current BPM and time signature.
+*/
+byte Beethduino::stop_tempo_map()
+{
+    byte changed_state = 0;
+    boolean is_ramp_stopped;
+    
+    noInterrupts();
+    
+    if (is_tempo_map_changed == true)
+    {
+        bpm = tempo_map_bpm;
+        time_signature = tempo_map_time_signature;
+        changed_state = STATE_TEMPO_MAP;
+    }
+    
+    if (is_tempo_map_running == true)
+    {
+        changed_state = STATE_TEMPO_MAP;
+    }
+    
+    is_ramp_stopped = (tempo_ramp != TEMPO_RAMP_NONE);
+    is_tempo_map_running = false;
+    is_tempo_segment_staged = false;
+    is_tempo_map_changed = false;
+    tempo_ramp = TEMPO_RAMP_NONE;
+    tempo_ramp_beats_left = 0;
+    
+    interrupts();
+    
+    if (is_ramp_stopped == true)
+    {
+        calculate_required_iterations();
+    }
+    
+    return changed_state;
+}
+
+
+/*
+* Shows the segment started by the timer interrupt, and then stages the 
+* next one; both flags are read at once.
+*/
+void Beethduino::service_tempo_map()
+{
+    boolean is_segment_started;
+    boolean is_staging_required;
+    
+    noInterrupts();
+    
+    is_segment_started = is_tempo_map_changed;
+    is_staging_required = (is_tempo_map_running == true) 
+                          && (is_tempo_segment_staged == false);
+    is_tempo_map_changed = false;
+    
+    interrupts();
+    
+    if (is_segment_started == true)
+    {
+        bpm = tempo_map_bpm;
+        time_signature = tempo_map_time_signature;
+        update_lcd();
+        update_serial_monitor();
+    }
+    
+    if (is_staging_required == true)
+    {
+        stage_tempo_segment();
+    }
+}
+
+
+/*
+* Interprets the tempo map up to the next segment, and stages it, with its
+* period read from the BeatPeriods table (no division); at the end of the 
+* program, the end is staged (no bars). At most tempo_map_size 
+* instructions are read.
+*/
+void Beethduino::stage_tempo_segment()
+{
+    unsigned int instructions = 0;
+    unsigned int required_iterations;
+    byte bars = 0;
+    
+    while ((bars == 0) && (tempo_map_pc < tempo_map_size)
+           && (instructions < tempo_map_size))
+    {
+        staged_ramp = TEMPO_RAMP_NONE;
+        bars = interpret_tempo_map();
+        instructions++;
+    }
+    
+    if (tempo_map_bpm > BPM_UPPER_BOUND)
+    {
+        tempo_map_bpm = BPM_UPPER_BOUND;
+    }
+    else if (tempo_map_bpm < BPM_LOWER_BOUND)
+    {
+        tempo_map_bpm = BPM_LOWER_BOUND;
+    }
+    else
+    {
+        /* No operation. */
+    }
+    
+    required_iterations = pgm_read_word(
+        &BeatPeriods::required_iterations[tempo_map_bpm - BPM_LOWER_BOUND]);
+    
+    staged_req_iter = required_iterations;
+    staged_remainder = MILLISECONDS_IN_MINUTE 
+                       - (required_iterations * tempo_map_bpm);
+    staged_divisor = tempo_map_bpm;
+    staged_beats_per_bar = pgm_read_byte(
+        &TIME_SIGNATURES[tempo_map_time_signature].beats_per_bar);
+    staged_bars = bars;
+    staged_voices = tempo_map_voices;
+    staged_ramp_beats = 0;
+    
+    /* A ramp without bars, or to its start BPM, is a plain segment. */
+    if ((bars == 0) || (ramp_start_bpm == tempo_map_bpm)
+        || (ramp_start_bpm > BPM_UPPER_BOUND)
+        || (ramp_start_bpm < BPM_LOWER_BOUND))
+    {
+        staged_ramp = TEMPO_RAMP_NONE;
+    }
+    
+    if (staged_ramp != TEMPO_RAMP_NONE)
+    {
+        stage_tempo_ramp();
+    }
+    
+    is_tempo_segment_staged = true;
+}
+
+
+/*
+* The period of the first beat of the ramp (the one of ramp_start_bpm), and
+* its delta (linear) or ratio (exponential); once per ramp, in the main loop.
+*/
+void Beethduino::stage_tempo_ramp()
+{
+    unsigned int start_iterations;
+    unsigned long start_remainder;
+    unsigned int beats = staged_bars * staged_beats_per_bar;
+    long delta;
+    long delta_iter;
+    
+    start_iterations = pgm_read_word(
+        &BeatPeriods::required_iterations[ramp_start_bpm - BPM_LOWER_BOUND]);
+    start_remainder = MILLISECONDS_IN_MINUTE 
+                      - (start_iterations * ramp_start_bpm);
+    
+    staged_req_iter = start_iterations;
+    staged_ramp_beats = beats;
+    
+    if (staged_ramp == TEMPO_RAMP_LINEAR)
+    {
+        staged_divisor = (unsigned long) ramp_start_bpm * tempo_map_bpm 
+                         * beats;
+        staged_remainder = start_remainder * tempo_map_bpm * beats;
+        
+        /* Floor of the delta: the remainder is never negative. */
+        delta = (long) MILLISECONDS_IN_MINUTE 
+                * (ramp_start_bpm - tempo_map_bpm);
+        delta_iter = delta / (long) staged_divisor;
+        delta = delta - (delta_iter * (long) staged_divisor);
+        
+        if (delta < 0)
+        {
+            delta = delta + staged_divisor;
+            delta_iter--;
+        }
+        
+        staged_delta_iter = delta_iter;
+        staged_delta_remainder = delta;
+    }
+    else
+    {
+        staged_divisor = RAMP_PERIOD_ONE;
+        staged_remainder = ((start_remainder << RAMP_PERIOD_SHIFT) 
+                            + (ramp_start_bpm / 2)) / ramp_start_bpm;
+        staged_ratio = calculate_ramp_ratio(beats);
+    }
+}
+
+
+/*
+* (ramp_start_bpm / tempo_map_bpm) ^ (1 / beats), with integer math only: 
+* 2 raised to the difference of the logarithms, divided by the beats.
+*/
+unsigned long Beethduino::calculate_ramp_ratio(unsigned int beats)
+{
+    long long exponent = calculate_log2(ramp_start_bpm) 
+                         - calculate_log2(tempo_map_bpm);
+    
+    if (exponent < 0)
+    {
+        exponent = -((-exponent + (beats / 2)) / beats);
+    }
+    else
+    {
+        exponent = (exponent + (beats / 2)) / beats;
+    }
+    
+    return calculate_exp2(exponent);
+}
+
+
+/*
+* The fractional bits, one by one: when the square of the mantissa reaches
+* 2, the bit is 1 and the square is halved.
+*/
+long long Beethduino::calculate_log2(unsigned int value)
+{
+    unsigned long long mantissa;
+    long long logarithm;
+    byte msb = 0;
+    byte bit;
+    
+    while ((value >> msb) > 1)
+    {
+        msb++;
+    }
+    
+    mantissa = (unsigned long long) value << (RAMP_MANTISSA_SHIFT - msb);
+    logarithm = (long long) msb << RAMP_LOG_SHIFT;
+    
+    for (bit = RAMP_LOG_SHIFT; bit > 0; bit--)
+    {
+        mantissa = (mantissa * mantissa) >> RAMP_MANTISSA_SHIFT;
+        
+        if (mantissa >= (2ULL << RAMP_MANTISSA_SHIFT))
+        {
+            mantissa = mantissa >> 1;
+            logarithm = logarithm | (1LL << (bit - 1));
+        }
+    }
+    
+    return logarithm;
+}
+
+
+/*
+* 2 ^ whole (a shift) times e ^ (fraction * ln(2)), by its Taylor series.
+*/
+unsigned long Beethduino::calculate_exp2(long long exponent)
+{
+    signed char whole = 0;
+    unsigned long long x;
+    unsigned long long term = RAMP_LOG_ONE;
+    unsigned long long power = term;
+    byte order = 1;
+    byte shift;
+    
+    while (exponent < 0)
+    {
+        exponent = exponent + RAMP_LOG_ONE;
+        whole--;
+    }
+    
+    while (exponent >= RAMP_LOG_ONE)
+    {
+        exponent = exponent - RAMP_LOG_ONE;
+        whole++;
+    }
+    
+    x = ((unsigned long long) exponent * RAMP_LN_2) >> RAMP_LOG_SHIFT;
+    
+    while (term != 0)
+    {
+        term = ((((term * x) + (RAMP_LOG_ONE >> 1)) >> RAMP_LOG_SHIFT) 
+                + (order / 2)) / order;
+        power = power + term;
+        order++;
+    }
+    
+    shift = RAMP_LOG_SHIFT - RAMP_RATIO_SHIFT - whole;
+    
+    return (power + (1ULL << (shift - 1))) >> shift;
+}
+
+
+/*
+* Executes the instruction of tempo_map_pc; returns the bars of the segment
+* it starts (0 if it does not start one). After TEMPO_MAP_END, or an 
+* unknown opcode, tempo_map_pc is tempo_map_size.
+*/
+byte Beethduino::interpret_tempo_map()
+{
+    const byte *instruction = &tempo_map[tempo_map_pc];
+    byte opcode = pgm_read_byte(instruction);
+    byte operand;
+    byte bars = 0;
+    
+    if (opcode == TEMPO_MAP_PLAY)
+    {
+        tempo_map_bpm = read_tempo_map_word(instruction + 1);
+        bars = pgm_read_byte(instruction + 3);
+        tempo_map_pc = tempo_map_pc + TEMPO_MAP_PLAY_SIZE;
+    }
+    else if (opcode == TEMPO_MAP_RAMP)
+    {
+        bars = ramp_tempo_map_bpm(instruction);
+    }
+    else if (opcode == TEMPO_MAP_TIME_SIGNATURE)
+    {
+        operand = pgm_read_byte(instruction + 1);
+        
+        if (operand < TIME_SIGNATURES_COUNT)
+        {
+            tempo_map_time_signature = operand;
+        }
+        
+        tempo_map_pc = tempo_map_pc + TEMPO_MAP_TIME_SIGNATURE_SIZE;
+    }
+    else if (opcode == TEMPO_MAP_REPEAT)
+    {
+        tempo_map_pc = 0;
+    }
+    else if ((opcode == TEMPO_MAP_LINEAR_RAMP) 
+             || (opcode == TEMPO_MAP_EXPONENTIAL_RAMP))
+    {
+        ramp_start_bpm = tempo_map_bpm;
+        bars = pgm_read_byte(instruction + 1);
+        tempo_map_bpm = read_tempo_map_word(instruction + 2);
+        staged_ramp = (opcode == TEMPO_MAP_LINEAR_RAMP) 
+                      ? TEMPO_RAMP_LINEAR : TEMPO_RAMP_EXPONENTIAL;
+        tempo_map_pc = tempo_map_pc + TEMPO_MAP_SMOOTH_RAMP_SIZE;
+    }
+    else if (opcode == TEMPO_MAP_VOICES)
+    {
+        tempo_map_voices = pgm_read_byte(instruction + 1) & ALL_VOICES_MASK;
+        tempo_map_pc = tempo_map_pc + TEMPO_MAP_VOICES_SIZE;
+    }
+    else
+    {
+        tempo_map_pc = tempo_map_size;
+    }
+    
+    return bars;
+}
+
+
+/*
+* The words of the program are little-endian, read byte by byte (they are 
+* not aligned).
+*/
+unsigned int Beethduino::read_tempo_map_word(const byte *address)
+{
+    return pgm_read_byte(address) | (pgm_read_byte(address + 1) << 8);
+}
+
+/*
+* One segment of a TEMPO_MAP_RAMP: the BPM moves one step towards the 
+* target, without passing it; then, the next instruction follows. Returns 
+* the bars of the segment (0 after the ramp).
+*/
+byte Beethduino::ramp_tempo_map_bpm(const byte *instruction)
+{
+    signed char step = (signed char) pgm_read_byte(instruction + 1);
+    byte bars = pgm_read_byte(instruction + 2);
+    int target_bpm = read_tempo_map_word(instruction + 3);
+    
+    if ((tempo_map_bpm == target_bpm) || (step == 0))
+    {
+        tempo_map_pc = tempo_map_pc + TEMPO_MAP_RAMP_SIZE;
+        return 0;
+    }
+    
+    tempo_map_bpm = tempo_map_bpm + step;
+    
+    if (((step > 0) && (tempo_map_bpm > target_bpm))
+        || ((step < 0) && (tempo_map_bpm < target_bpm)))
+    {
+        tempo_map_bpm = target_bpm;
+    }
+    
+    return bars;
+}
+
+
+/*
+* lcd.begin() leaves the display cleared (all characters are spaces).
+*/
+void Beethduino::init_lcd_frame()
+{
+    byte row;
+    byte column;
+    
+    for (row = 0; row < LCD_ROWS; row++)
+    {
+        for (column = 0; column < LCD_COLUMNS; column++)
+        {
+            lcd_shown_frame[row][column] = ' ';
+        }
+    }
+    
+    lcd_next_cell = LCD_CELLS;
+    lcd_address_cell = LCD_NO_CELL;
+}
+
+
+/*
+* The LCD is drawn in lcd_frame, and only the characters that differ from
+* lcd_shown_frame are sent, in slices, by service_lcd(); lcd.clear() is 
+* never called.
+*/
+void Beethduino::update_lcd()
+{    
+    byte row;
+    byte column;
+    char bpm_text[NUMBER_TEXT_SIZE];
+    
+    for (row = 0; row < LCD_ROWS; row++)
+    {
+        for (column = 0; column < LCD_COLUMNS; column++)
+        {
+            lcd_frame[row][column] = ' ';
+        }
+    }
+    
+    if (is_buzzer_muted == true)
+    {
+        print_lcd_frame_P(0, 0, MUTE_TEXT);
+    }
+    else if (is_tempo_map_running == true)
+    {
+        print_lcd_frame_P(0, 0, TEMPO_MAP_TEXT);
+    }
+    else
+    {
+        /* No operation: the row is blank. */
+    }
+    
+    print_lcd_frame_P(0, SUBDIVISION_COLUMN, SUBDIVISIONS[subdivision].text);
+    
+    column = 0;
+    
+    if (bpm_modifier == -1)
+    {
+        column = print_lcd_frame_P(1, column, SUB_BPM_TEXT);
+    }
+    else if (bpm_modifier == 1)
+    {
+        column = print_lcd_frame_P(1, column, ADD_BPM_TEXT);
+    }
+    else
+    {
+        /* No operation. */
+    }
+    
+    format_number(bpm, bpm_text);
+    print_lcd_frame(1, column, bpm_text);
+    
+    print_lcd_frame_P(1, TIME_SIGNATURE_COLUMN, 
+                      TIME_SIGNATURES[time_signature].text);
+    
+    lcd_next_cell = 0;  /* The new frame is sent by service_lcd(). */
+}
+
+
+/*
+* Returns the column after the text (the text is cut at the end of the row).
+*/
+byte Beethduino::print_lcd_frame(byte row, byte column, const char *text)
+{
+    while ((column < LCD_COLUMNS) && (*text != '\0'))
+    {
+        lcd_frame[row][column] = *text;
+        column++;
+        text++;
+    }
+    
+    return column;
+}
+
+
+/*
+* Same as print_lcd_frame, with a text stored in the flash memory.
+*/
+byte Beethduino::print_lcd_frame_P(byte row, byte column, const char *text)
+{
+    char character = pgm_read_byte(text);
+    
+    while ((column < LCD_COLUMNS) && (character != '\0'))
+    {
+        lcd_frame[row][column] = character;
+        column++;
+        text++;
+        character = pgm_read_byte(text);
+    }
+    
+    return column;
+}
+
+
+/*
+* Integer to ASCII (decimal), in a buffer of NUMBER_TEXT_SIZE characters. 
+* The digits are obtained from the lowest one, and written from the end of
+* the buffer; then, they are moved to its start.
+*/
+void Beethduino::format_number(unsigned int number, char *text)
+{
+    char digits[NUMBER_TEXT_SIZE];
+    byte first_digit = NUMBER_TEXT_SIZE - 1;
+    byte position = 0;
+    
+    digits[first_digit] = '\0';
+    
+    do
+    {
+        first_digit--;
+        digits[first_digit] = '0' + (number % 10);
+        number = number / 10;
+    } while (number != 0);
+    
+    do
+    {
+        text[position] = digits[first_digit];
+        position++;
+        first_digit++;
+    } while (digits[first_digit - 1] != '\0');
+}
+
+
+/*
+* At most LCD_BYTES_PER_SLICE bytes per call; the comparison goes on in the
+* next call. The cursor is only set at the start of every run of changed 
+* characters: the LCD increments its address after every character.
+*/
+void Beethduino::service_lcd()
+{
+    byte row;
+    byte column;
+    byte sent_bytes = 0;
+    
+    while ((lcd_next_cell < LCD_CELLS) && (sent_bytes < LCD_BYTES_PER_SLICE))
+    {
+        row = lcd_next_cell / LCD_COLUMNS;
+        column = lcd_next_cell % LCD_COLUMNS;
+        
+        if (lcd_frame[row][column] == lcd_shown_frame[row][column])
+        {
+            lcd_next_cell++;
+        }
+        else if (lcd_address_cell != lcd_next_cell)
+        {
+            lcd.setCursor(column, row);
+            lcd_address_cell = lcd_next_cell;
+            sent_bytes++;
+        }
+        else
+        {
+            lcd.write(lcd_frame[row][column]);
+            lcd_shown_frame[row][column] = lcd_frame[row][column];
+            sent_bytes++;
+            
+            /* The address of the next row is not the next one. */
+            lcd_next_cell++;
+            lcd_address_cell = (column < (LCD_COLUMNS - 1)) 
+                               ? lcd_next_cell : LCD_NO_CELL;
+        }
+    }
+}
+
+void Beethduino::update_serial_monitor()
+{
+    byte position = 0;
+    char bpm_text[NUMBER_TEXT_SIZE];
+    
+    if (is_buzzer_muted == true)
+    {
+        position = append_text_info_P(position, MUTE_TEXT);
+    }
+    else
+    {
+        /* No operation. */
+    }
+    
+    position = append_text_info_P(position, LFCR_TEXT);
+    
+    if (bpm_modifier == -1)
+    {
+        position = append_text_info_P(position, SUB_BPM_TEXT);
+    }
+    else if (bpm_modifier == 1)
+    {
+        position = append_text_info_P(position, ADD_BPM_TEXT);
+    }
+    else
+    {
+        /* No operation. */
+    }
+    
+    format_number(bpm, bpm_text);
+    append_text_info(position, bpm_text);
+}
+
+
+/*
+* Writes the text in bpm_text_info from the position, cut at 
+* BPM_TEXT_INFO_SIZE - 1 characters; returns the position after the text.
+*/
+byte Beethduino::append_text_info(byte position, const char *text)
+{
+    while ((position < (BPM_TEXT_INFO_SIZE - 1)) && (*text != '\0'))
+    {
+        bpm_text_info[position] = *text;
+        position++;
+        text++;
+    }
+    
+    bpm_text_info[position] = '\0';
+    return position;
+}
+
+
+/*
+* Same as append_text_info, with a text stored in the flash memory.
+*/
+byte Beethduino::append_text_info_P(byte position, const char *text)
+{
+    char character = pgm_read_byte(text);
+    
+    while ((position < (BPM_TEXT_INFO_SIZE - 1)) && (character != '\0'))
+    {
+        bpm_text_info[position] = character;
+        position++;
+        text++;
+        character = pgm_read_byte(text);
+    }
+    
+    bpm_text_info[position] = '\0';
+    return position;
+}
+
+void Beethduino::init_timer_wheel()
+{
+    byte slot;
+    byte timer;
+    
+    for (slot = 0; slot < (TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS); slot++)
+    {
+        timer_wheel_slots[slot] = NO_TIMER;
+    }
+    
+    for (timer = 0; timer < TIMERS; timer++)
+    {
+        timer_slots[timer] = TIMER_IDLE;
+    }
+    
+    due_timers = 0;
+    wheel_tick = timer_ticks;
+}
+
+
+/*
+* Every tick up to timer_ticks: the upper levels are cascaded when the 
+* first one wraps, and the timers of the slot of the tick expire, lowest
+* number first, with the ones armed for the same tick meanwhile.
+*/
+void Beethduino::serve_timer_wheel()
+{
+    byte timer;
+    
+    while (wheel_tick != timer_ticks)
+    {
+        wheel_tick++;
+        
+        if ((wheel_tick & (TIMER_WHEEL_SLOTS - 1)) == 0)
+        {
+            cascade_timer_wheel();
+        }
+        
+        collect_due_timers(wheel_tick & (TIMER_WHEEL_SLOTS - 1));
+        
+        while (due_timers != 0)
+        {
+            timer = 0;
+            
+            while ((due_timers & (1U << timer)) == 0)
+            {
+                timer++;
+            }
+            
+            due_timers = due_timers & ~(1U << timer);
+            timer_slots[timer] = TIMER_IDLE;
+            (this->*TIMER_HANDLERS[timer])(timer);
+        }
+    }
+}
+
+
+/*
+* The levels whose slots wrap in this tick, the highest first.
+*/
+void Beethduino::cascade_timer_wheel()
+{
+    byte level = 1;
+    unsigned long slot_ticks = wheel_tick >> TIMER_WHEEL_SLOT_BITS;
+    
+    while ((level < (TIMER_WHEEL_LEVELS - 1)) 
+           && ((slot_ticks & (TIMER_WHEEL_SLOTS - 1)) == 0))
+    {
+        slot_ticks = slot_ticks >> TIMER_WHEEL_SLOT_BITS;
+        level++;
+    }
+    
+    while (level != 0)
+    {
+        cascade_timer_slot((level * TIMER_WHEEL_SLOTS) 
+                           + ((wheel_tick >> (level * TIMER_WHEEL_SLOT_BITS))
+                              & (TIMER_WHEEL_SLOTS - 1)));
+        level--;
+    }
+}
+
+
+void Beethduino::cascade_timer_slot(byte slot)
+{
+    byte timer = timer_wheel_slots[slot];
+    byte next_timer;
+    
+    timer_wheel_slots[slot] = NO_TIMER;
+    
+    while (timer != NO_TIMER)
+    {
+        next_timer = next_timers[timer];
+        link_timer(timer);
+        timer = next_timer;
+    }
+}
+
+
+void Beethduino::collect_due_timers(byte slot)
+{
+    byte timer = timer_wheel_slots[slot];
+    
+    timer_wheel_slots[slot] = NO_TIMER;
+    
+    while (timer != NO_TIMER)
+    {
+        timer_slots[timer] = TIMER_DUE;
+        due_timers = due_timers | (1U << timer);
+        timer = next_timers[timer];
+    }
+}
+
+
+/*
+* A tick already served is due at once (in the timer interrupt), or in the
+* next tick (out of it).
+*/
+void Beethduino::arm_timer(byte timer, unsigned long tick)
+{
+    cancel_timer(timer);
+    timer_expiry_ticks[timer] = tick;
+    
+    if ((long) (tick - wheel_tick) <= 0)
+    {
+        timer_slots[timer] = TIMER_DUE;
+        due_timers = due_timers | (1U << timer);
+    }
+    else
+    {
+        link_timer(timer);
+    }
+}
+
+
+void Beethduino::cancel_timer(byte timer)
+{
+    byte slot = timer_slots[timer];
+    
+    if (slot == TIMER_IDLE)
+    {
+        return;
+    }
+    
+    if (slot == TIMER_DUE)
+    {
+        due_timers = due_timers & ~(1U << timer);
+    }
+    else
+    {
+        if (previous_timers[timer] == NO_TIMER)
+        {
+            timer_wheel_slots[slot] = next_timers[timer];
+        }
+        else
+        {
+            next_timers[previous_timers[timer]] = next_timers[timer];
+        }
+        
+        if (next_timers[timer] != NO_TIMER)
+        {
+            previous_timers[next_timers[timer]] = previous_timers[timer];
+        }
+    }
+    
+    timer_slots[timer] = TIMER_IDLE;
+}
+
+
+/*
+* The lowest level that holds the distance of the timer, in the slot of its
+* tick bits.
+*/
+void Beethduino::link_timer(byte timer)
+{
+    unsigned long tick = timer_expiry_ticks[timer];
+    unsigned long distance = (tick - wheel_tick) >> TIMER_WHEEL_SLOT_BITS;
+    byte level = 0;
+    byte slot;
+    
+    while (distance != 0)
+    {
+        distance = distance >> TIMER_WHEEL_SLOT_BITS;
+        tick = tick >> TIMER_WHEEL_SLOT_BITS;
+        level++;
+    }
+    
+    slot = (level * TIMER_WHEEL_SLOTS) + (tick & (TIMER_WHEEL_SLOTS - 1));
+    
+    timer_slots[timer] = slot;
+    previous_timers[timer] = NO_TIMER;
+    next_timers[timer] = timer_wheel_slots[slot];
+    
+    if (timer_wheel_slots[slot] != NO_TIMER)
+    {
+        previous_timers[timer_wheel_slots[slot]] = timer;
+    }
+    
+    timer_wheel_slots[slot] = timer;
+}
+
+
+/*
+* With the interrupts disabled, when the main loop changes the deadlines.
+*/
+void Beethduino::arm_beat_timers()
+{
+    if (is_buzzer_muted == false)
+    {
+        arm_timer(TIMER_BEAT, beat_deadline_tick);
+    }
+    else
+    {
+        cancel_timer(TIMER_BEAT);
+    }
+    
+    if (pending_subdivisions != 0)
+    {
+        arm_timer(TIMER_SUBDIVISION, subdivision_deadline_tick);
+    }
+    else
+    {
+        cancel_timer(TIMER_SUBDIVISION);
+    }
+}
+
+
+void Beethduino::expire_buzzer_off(byte /* timer */)
+{
+    stop_buzzer();
+}
+
+
+void Beethduino::expire_beat(byte /* timer */)
+{
+    unsigned long beat_tick = beat_deadline_tick;
+    
+    if ((beat_in_bar == 0) && (is_tempo_map_running == true))
+    {
+        advance_tempo_map();
+    }
+    
+    schedule_next_beat();
+    arm_timer(TIMER_BEAT, beat_deadline_tick);
+    schedule_subdivisions(beat_tick);
+    
+    if (active_voices != 0)
+    {
+        schedule_voices(beat_tick);
+    }
+    
+    if (tempo_ramp_beats_left != 0)
+    {
+        advance_tempo_ramp();
+    }
+    
+    play_buzzer();
+}
+
+
+void Beethduino::expire_subdivision(byte /* timer */)
+{
+    pending_subdivisions--;
+    schedule_next_subdivision();
+    play_subdivision();
+}
+
+
+void Beethduino::expire_voice_event(byte /* timer */)
+{
+    serve_voice_events();
+}
+
+
+/*
+* In every downbeat while the tempo map runs: when the bars of the current
+* segment end, the staged one starts (a few assignments, no division), and
+* the downbeat is the origin of its timeline (and of the cycles of new 
+* voices). Without staged segment, the current one goes on for one more 
+* bar.
+*/
+void Beethduino::advance_tempo_map()
+{
+    if (tempo_map_bars_left != 0)
+    {
+        tempo_map_bars_left--;
+        return;
+    }
+    
+    if (is_tempo_segment_staged == false)
+    {
+        return;
+    }
+    
+    beats_per_bar = staged_beats_per_bar;
+    
+    if (staged_bars == 0)
+    {
+        is_tempo_map_running = false;
+    }
+    else
+    {
+        tempo_map_bars_left = staged_bars - 1;
+    }
+    
+    /* After a smooth ramp, the end keeps its target (the staged period). */
+    if ((staged_bars != 0) || (tempo_ramp != TEMPO_RAMP_NONE))
+    {
+        bpm_freq_req_iter = staged_req_iter;
+        bpm_freq_remainder = staged_remainder;
+        bpm_freq_divisor = staged_divisor;
+        beat_error_accumulator = 0;
+        set_subdivision_step();
+    }
+    
+    if (staged_voices != active_voices)
+    {
+        active_voices = staged_voices;
+        restart_voices();
+    }
+    
+    tempo_ramp = staged_ramp;
+    tempo_ramp_beats_left = staged_ramp_beats;
+    ramp_delta_iter = staged_delta_iter;
+    ramp_delta_remainder = staged_delta_remainder;
+    ramp_ratio = staged_ratio;
+    is_tempo_segment_staged = false;
+    is_tempo_map_changed = true;
+}
+
+
+/*
+* After every beat of a smooth ramp: the period of the next beat, with 
+* additions (linear) or one fixed point multiplication (exponential).
+*/
+void Beethduino::advance_tempo_ramp()
+{
+    unsigned long long period;
+    
+    if (tempo_ramp == TEMPO_RAMP_LINEAR)
+    {
+        bpm_freq_req_iter = bpm_freq_req_iter + ramp_delta_iter;
+        bpm_freq_remainder = bpm_freq_remainder + ramp_delta_remainder;
+        
+        if (bpm_freq_remainder >= bpm_freq_divisor)
+        {
+            bpm_freq_remainder = bpm_freq_remainder - bpm_freq_divisor;
+            bpm_freq_req_iter++;
+        }
+    }
+    else
+    {
+        period = ((unsigned long) bpm_freq_req_iter << RAMP_PERIOD_SHIFT) 
+                 | bpm_freq_remainder;
+        period = ((period * ramp_ratio) + (RAMP_RATIO_ONE >> 1)) 
+                 >> RAMP_RATIO_SHIFT;
+        bpm_freq_req_iter = period >> RAMP_PERIOD_SHIFT;
+        bpm_freq_remainder = period & (RAMP_PERIOD_ONE - 1);
+    }
+    
+    tempo_ramp_beats_left--;
+    set_subdivision_step();
+}
+
+
+void Beethduino::schedule_next_beat()
+{
+    beat_deadline_tick = beat_deadline_tick + bpm_freq_req_iter;
+    beat_error_accumulator = beat_error_accumulator + bpm_freq_remainder;
+    
+    if (beat_error_accumulator >= bpm_freq_divisor)
+    {
+        beat_error_accumulator = beat_error_accumulator - bpm_freq_divisor;
+        beat_deadline_tick++;
+    }
+}
+
+
+/*
+* The step of the beat: the step of the base period, with one more unit of
+* remainder if the beat has one tick more (no division).
+*/
+void Beethduino::schedule_subdivisions(unsigned long beat_tick)
+{
+    beat_subdivision_iter = subdivision_req_iter;
+    beat_subdivision_remainder = subdivision_remainder;
+    
+    if ((beat_deadline_tick - beat_tick) != bpm_freq_req_iter)
+    {
+        beat_subdivision_remainder++;
+        
+        if (beat_subdivision_remainder == clicks_per_beat)
+        {
+            beat_subdivision_remainder = 0;
+            beat_subdivision_iter++;
+        }
+    }
+    
+    subdivision_deadline_tick = beat_tick;
+    subdivision_error_accumulator = 0;
+    pending_subdivisions = clicks_per_beat - 1;
+    schedule_next_subdivision();
+}
+
+
+/*
+* The sub-beat i of a beat is floor(i * period / clicks_per_beat) ticks 
+* after it (its timer is armed if the beat has sub-beats left).
+*/
+void Beethduino::schedule_next_subdivision()
+{
+    subdivision_deadline_tick = subdivision_deadline_tick 
+                                + beat_subdivision_iter;
+    subdivision_error_accumulator = subdivision_error_accumulator 
+                                    + beat_subdivision_remainder;
+    
+    if (subdivision_error_accumulator >= clicks_per_beat)
+    {
+        subdivision_error_accumulator = subdivision_error_accumulator 
+                                        - clicks_per_beat;
+        subdivision_deadline_tick++;
+    }
+    
+    if (pending_subdivisions != 0)
+    {
+        arm_timer(TIMER_SUBDIVISION, subdivision_deadline_tick);
+    }
+}
+
+
+/*
+* The downbeat of the bar sounds ACCENT_SOUND_DURATION.
+*/
+void Beethduino::play_buzzer()
+{
+    PortBPin<ACTIVE_BUZZER_PIN>::set_high();
+    
+    if (advance_beat_in_bar() == true)
+    {
+        buzzer_off_tick = timer_ticks + ACCENT_SOUND_DURATION;
+    }
+    else
+    {
+        buzzer_off_tick = timer_ticks + SOUND_DURATION;
+    }
+    
+    is_buzzer_sounding = true;
+    arm_timer(TIMER_BUZZER_OFF, buzzer_off_tick);
+    
+    buzzer_bips ++;
+}
+
+
+/*
+* Returns true if the beat is the downbeat, and moves to the next beat of 
+* the bar: one increment and one comparison (no division).
+*/
+boolean Beethduino::advance_beat_in_bar()
+{
+    boolean is_downbeat = (beat_in_bar == 0);
+    
+    beat_in_bar++;
+    
+    if (beat_in_bar == beats_per_bar)
+    {
+        beat_in_bar = 0;
+    }
+    
+    return is_downbeat;
+}
+
+
+void Beethduino::play_subdivision()
+{
+    PortBPin<ACTIVE_BUZZER_PIN>::set_high();
+    buzzer_off_tick = timer_ticks + SUBDIVISION_SOUND_DURATION;
+    is_buzzer_sounding = true;
+    arm_timer(TIMER_BUZZER_OFF, buzzer_off_tick);
+}
+
+
+void Beethduino::stop_buzzer()
+{
+    PortBPin<ACTIVE_BUZZER_PIN>::set_low();
+    is_buzzer_sounding = false;
+}
+
+
+/*
+* In every beat, once the next one is scheduled: the step of every active 
+* voice in the beat (period / pulses, with the multiplier and one 
+* correction), and its first pulse in the beat, if it has one.
+*/
+void Beethduino::schedule_voices(unsigned long beat_tick)
+{
+    unsigned long period = beat_deadline_tick - beat_tick;
+    unsigned long step;
+    byte voice;
+    byte pulses;
+    
+    voices_beat_tick = beat_tick;
+    
+    for (voice = 0; voice < VOICES_COUNT; voice++)
+    {
+        if ((active_voices & (1 << voice)) != 0)
+        {
+            pulses = pgm_read_byte(&VOICES[voice].pulses);
+            step = (period * pgm_read_dword(&VOICE_MULTIPLIERS[pulses])) 
+                   >> VOICE_MULTIPLIER_SHIFT;
+            
+            if ((step * pulses) > period)
+            {
+                step--;
+            }
+            
+            voice_step_iters[voice] = step;
+            voice_step_remainders[voice] = period - (step * pulses);
+            
+            if (voice_beats[voice] == 0)
+            {
+                voice_pulses[voice] = 0;
+                voice_positions[voice] = 0;
+            }
+            else
+            {
+                voice_positions[voice] = voice_positions[voice] - pulses;
+            }
+            
+            voice_beats[voice]++;
+            
+            if (voice_beats[voice] == pgm_read_byte(&VOICES[voice].beats))
+            {
+                voice_beats[voice] = 0;
+            }
+            
+            if (voice_positions[voice] < pulses)
+            {
+                push_voice_event(beat_tick 
+                                 + voice_pulse_offset(voice, pulses), voice);
+            }
+        }
+    }
+}
+
+
+/*
+* floor(position * period / pulses): position * step, plus the floor of 
+* position * remainder / pulses (exact with the multiplier).
+*/
+unsigned long Beethduino::voice_pulse_offset(byte voice, byte pulses)
+{
+    byte position = voice_positions[voice];
+    unsigned int fraction = position * voice_step_remainders[voice];
+    
+    return ((unsigned long) position * voice_step_iters[voice])
+           + ((fraction * pgm_read_dword(&VOICE_MULTIPLIERS[pulses])) 
+              >> VOICE_MULTIPLIER_SHIFT);
+}
+
+
+void Beethduino::serve_voice_events()
+{
+    byte code;
+    
+    while ((voice_event_count != 0)
+           && ((long) (timer_ticks - voice_event_ticks[0]) >= 0))
+    {
+        code = voice_event_codes[0];
+        pop_voice_event();
+        
+        if ((code & VOICE_EVENT_OFF) != 0)
+        {
+            code = code & ~VOICE_EVENT_OFF;
+            digitalWrite(pgm_read_byte(&VOICES[code].pin), LOW);
+            sounding_voice_pins = sounding_voice_pins & ~(1 << code);
+        }
+        else
+        {
+            play_voice(code);
+        }
+    }
+}
+
+
+/*
+* The pulse sounds in the output of the voice (in the buzzer, the sound of
+* a beat is not shortened), and the next pulse is pushed if it is in the 
+* same beat.
+*/
+void Beethduino::play_voice(byte voice)
+{
+    const Voice *entry = &VOICES[voice];
+    byte pulses = pgm_read_byte(&entry->pulses);
+    byte output = pgm_read_byte(&entry->output);
+    byte pin = pgm_read_byte(&entry->pin);
+    unsigned int duration;
+    
+    if (((pgm_read_byte(&entry->accents) >> voice_pulses[voice]) & 1) != 0)
+    {
+        duration = pgm_read_byte(&entry->accent_sound_duration);
+    }
+    else
+    {
+        duration = pgm_read_byte(&entry->sound_duration);
+    }
+    
+    if (output == VOICE_OUTPUT_BUZZER)
+    {
+        PortBPin<ACTIVE_BUZZER_PIN>::set_high();
+        
+        if ((is_buzzer_sounding == false)
+            || ((long) (timer_ticks + duration - buzzer_off_tick) > 0))
+        {
+            buzzer_off_tick = timer_ticks + duration;
+            arm_timer(TIMER_BUZZER_OFF, buzzer_off_tick);
+        }
+        
+        is_buzzer_sounding = true;
+    }
+    else if (output == VOICE_OUTPUT_PIN)
+    {
+        digitalWrite(pin, HIGH);
+        
+        if ((sounding_voice_pins & (1 << voice)) == 0)
+        {
+            sounding_voice_pins = sounding_voice_pins | (1 << voice);
+            push_voice_event(timer_ticks + duration, 
+                             voice | VOICE_EVENT_OFF);
+        }
+    }
+    else
+    {
+        tone(pin, pgm_read_word(&entry->tone_frequency), duration);
+    }
+    
+    voice_pulses[voice]++;
+    voice_positions[voice] = voice_positions[voice] 
+                             + pgm_read_byte(&entry->beats);
+    
+    if (voice_positions[voice] < pulses)
+    {
+        push_voice_event(voices_beat_tick 
+                         + voice_pulse_offset(voice, pulses), voice);
+    }
+}
+
+
+/*
+* The event goes up while its deadline is earlier than the one of its 
+* parent. A full heap loses it (one pulse and one end per voice at most).
+* A new first event arms the timer of the heap.
+*/
+void Beethduino::push_voice_event(unsigned long tick, byte code)
+{
+    byte entry = voice_event_count;
+    byte parent;
+    
+    if (entry == VOICE_EVENTS_SIZE)
+    {
+        return;
+    }
+    
+    voice_event_count++;
+    
+    while ((entry != 0) 
+           && ((long) (tick - voice_event_ticks[(entry - 1) >> 1]) < 0))
+    {
+        parent = (entry - 1) >> 1;
+        voice_event_ticks[entry] = voice_event_ticks[parent];
+        voice_event_codes[entry] = voice_event_codes[parent];
+        entry = parent;
+    }
+    
+    voice_event_ticks[entry] = tick;
+    voice_event_codes[entry] = code;
+    
+    if (entry == 0)
+    {
+        arm_timer(TIMER_VOICE_EVENT, tick);
+    }
+}
+
+
+/*
+* The last event takes the place of the first one, and goes down while the
+* earliest of its children has an earlier deadline.
+*/
+void Beethduino::pop_voice_event()
+{
+    byte entry = 0;
+    byte child = 1;
+    unsigned long tick;
+    byte code;
+    boolean is_placed = false;
+    
+    voice_event_count--;
+    tick = voice_event_ticks[voice_event_count];
+    code = voice_event_codes[voice_event_count];
+    
+    while ((is_placed == false) && (child < voice_event_count))
+    {
+        if (((child + 1) < voice_event_count)
+            && ((long) (voice_event_ticks[child + 1] 
+                        - voice_event_ticks[child]) < 0))
+        {
+            child++;
+        }
+        
+        if ((long) (voice_event_ticks[child] - tick) < 0)
+        {
+            voice_event_ticks[entry] = voice_event_ticks[child];
+            voice_event_codes[entry] = voice_event_codes[child];
+            entry = child;
+            child = (2 * entry) + 1;
+        }
+        else
+        {
+            is_placed = true;
+        }
+    }
+    
+    voice_event_ticks[entry] = tick;
+    voice_event_codes[entry] = code;
+    
+    if (voice_event_count != 0)
+    {
+        arm_timer(TIMER_VOICE_EVENT, voice_event_ticks[0]);
+    }
+    else
+    {
+        cancel_timer(TIMER_VOICE_EVENT);
+    }
+}
+
+
+/*
+* With the interrupts disabled: the events are dropped, the pins of the 
+* voices go low, and the cycles start again in the next beat.
+*/
+void Beethduino::restart_voices()
+{
+    byte voice;
+    
+    voice_event_count = 0;
+    cancel_timer(TIMER_VOICE_EVENT);
+    
+    for (voice = 0; voice < VOICES_COUNT; voice++)
+    {
+        voice_beats[voice] = 0;
+        
+        if ((sounding_voice_pins & (1 << voice)) != 0)
+        {
+            digitalWrite(pgm_read_byte(&VOICES[voice].pin), LOW);
+        }
+    }
+    
+    sounding_voice_pins = 0;
 }
\ No newline at end of file
@@ -33,6 +33,68 @@
 
 #include "Arduino.h"
 
+/*  Board configuration, fixed at compile time: pin layout (the buttons, 
+*   the buzzer, the LCD, the digital pins of the port B, and the outputs of
+*   the polyrhythm voices), BPM bounds and sound duration. A board variant 
+*   is one more configuration struct, selected by the BoardConfig typedef.
+*/
+struct UnoBoardConfig
+{
+    static const byte MUTE_BUZZER_BUTTON_PIN        = 13;
+    static const byte CHANGE_BPM_BY_TEN_BUTTON_PIN  = 12;
+    static const byte CHANGE_BPM_BY_ONE_BUTTON_PIN  = 11;
+    static const byte ADD_OR_SUB_BPM_BUTTON_PIN     = 10;
+    static const byte RESTART_BPM_BUTTON_PIN        = 9;
+    static const byte ACTIVE_BUZZER_PIN             = 8;
+    
+    static const byte LCD_RS_PIN                    = 2;
+    static const byte LCD_ENABLE_PIN                = 3;
+    static const byte LCD_D4_PIN                    = 4;
+    static const byte LCD_D5_PIN                    = 5;
+    static const byte LCD_D6_PIN                    = 6;
+    static const byte LCD_D7_PIN                    = 7;
+    
+    static const byte PORTB_FIRST_PIN               = 8;  /* Pin of PB0. */
+    static const byte PORTB_LAST_PIN                = 13; /* Pin of PB5. */
+    
+    static const byte FIRST_VOICE_PIN               = A0; /* LED. */
+    static const byte TONE_VOICE_PIN                = A1; /* Passive buzzer. */
+    static const byte SECOND_VOICE_PIN              = A2; /* LED. */
+    
+    static const int BPM_UPPER_BOUND                = 300;
+    static const int BPM_LOWER_BOUND                = 1;
+    
+    static const int SOUND_DURATION                 = 25; /* In Milliseconds. */
+    static const int ACCENT_SOUND_DURATION          = 40; /* In Milliseconds. */
+    static const int SUBDIVISION_SOUND_DURATION     = 10; /* In Milliseconds. */
+};
+
+typedef UnoBoardConfig BoardConfig;
+
+/*  Pin of the port B (from PORTB_FIRST_PIN to PORTB_LAST_PIN of the board),
+*   with its bit in PINB and PORTB; written with "sbi" and "cbi" instead of
+*   digitalWrite.
+*/
+template <int PIN>
+struct PortBPin
+{
+    static_assert((PIN >= BoardConfig::PORTB_FIRST_PIN) 
+                  && (PIN <= BoardConfig::PORTB_LAST_PIN),
+                  "The pin is not in the port B.");
+    
+    static const byte BIT = 1 << (PIN - BoardConfig::PORTB_FIRST_PIN);
+    
+    static void set_high()
+    {
+        PORTB |= BIT;
+    }
+    
+    static void set_low()
+    {
+        PORTB &= ~BIT;
+    }
+};
+
 class Beethduino
 {
     /* All variables and methods are public to made the integration
@@ -41,57 +103,408 @@ class Beethduino
     */
     public:
         /* VARIABLES */
-        const int MUTE_BUZZER_BUTTON_PIN        = 13;              
-        const int CHANGE_BPM_BY_TEN_BUTTON_PIN  = 12;                                             
-        const int CHANGE_BPM_BY_ONE_BUTTON_PIN  = 11;                                        
-        const int ADD_OR_SUB_BPM_BUTTON_PIN     = 10;       
-        const int RESTART_BPM_BUTTON_PIN        = 9;    
-        const int ACTIVE_BUZZER_PIN             = 8; 
-        
-        const int BPM_UPPER_BOUND               = 300;
-        const int BPM_LOWER_BOUND               = 1;
+        static const int MUTE_BUZZER_BUTTON_PIN 
+            = BoardConfig::MUTE_BUZZER_BUTTON_PIN;
+        static const int CHANGE_BPM_BY_TEN_BUTTON_PIN 
+            = BoardConfig::CHANGE_BPM_BY_TEN_BUTTON_PIN;
+        static const int CHANGE_BPM_BY_ONE_BUTTON_PIN 
+            = BoardConfig::CHANGE_BPM_BY_ONE_BUTTON_PIN;
+        static const int ADD_OR_SUB_BPM_BUTTON_PIN 
+            = BoardConfig::ADD_OR_SUB_BPM_BUTTON_PIN;
+        static const int RESTART_BPM_BUTTON_PIN 
+            = BoardConfig::RESTART_BPM_BUTTON_PIN;
+        static const int ACTIVE_BUZZER_PIN = BoardConfig::ACTIVE_BUZZER_PIN;
+        
+        static const int BPM_UPPER_BOUND = BoardConfig::BPM_UPPER_BOUND;
+        static const int BPM_LOWER_BOUND = BoardConfig::BPM_LOWER_BOUND;
 
-        const int SOUND_DURATION                = 25;
-        const int MILLISECONDS_IN_SECOND        = 1000; 
-          
-        const double SECONDS_IN_MINUTE = 60.00;
+        static const int SOUND_DURATION = BoardConfig::SOUND_DURATION;
+        static const int ACCENT_SOUND_DURATION 
+            = BoardConfig::ACCENT_SOUND_DURATION;
+        static const int SUBDIVISION_SOUND_DURATION 
+            = BoardConfig::SUBDIVISION_SOUND_DURATION;
+        
+        static const unsigned int MILLISECONDS_IN_MINUTE = 60000;
+        
+        static const unsigned int TIMER1_COMPARE_VALUE = 249; /* 1 KHz tick. */
+        
+        static const byte LCD_COLUMNS           = 16;
+        static const byte LCD_ROWS              = 2;
+        static const byte LCD_CELLS             = LCD_COLUMNS * LCD_ROWS;
+        static const byte LCD_NO_CELL           = 0xFF;
+        static const byte LCD_BYTES_PER_SLICE   = 2;
+        static const byte NUMBER_TEXT_SIZE      = 6;    /* 65535 and '\0'. */
+        static const byte BPM_TEXT_INFO_SIZE    = 32;
+        
+        char lcd_frame[LCD_ROWS][LCD_COLUMNS];
+        char lcd_shown_frame[LCD_ROWS][LCD_COLUMNS]; /* Shadow of the LCD. */
+        byte lcd_next_cell;
+        byte lcd_address_cell;
+        
+        static Beethduino *active_instance; /* Instance served by the Timer1
+                                            * and pin change interrupts.
+                                            */
+        
+        static const byte BUTTON_EVENT_QUEUE_SIZE = 16; /* Power of two. */
+        static const byte BUTTONS               = 5;
+        static const int FIRST_BUTTON_PIN       = RESTART_BPM_BUTTON_PIN;
+        static const int LAST_BUTTON_PIN  = FIRST_BUTTON_PIN + BUTTONS - 1;
+        static const int PORTB_FIRST_PIN = BoardConfig::PORTB_FIRST_PIN;
+        static const byte BUTTON_PINS_MASK 
+            = PortBPin<MUTE_BUZZER_BUTTON_PIN>::BIT
+              | PortBPin<CHANGE_BPM_BY_TEN_BUTTON_PIN>::BIT
+              | PortBPin<CHANGE_BPM_BY_ONE_BUTTON_PIN>::BIT
+              | PortBPin<ADD_OR_SUB_BPM_BUTTON_PIN>::BIT
+              | PortBPin<RESTART_BPM_BUTTON_PIN>::BIT;
+        
+        static const byte BUTTON_PRESSED        = 1;
+        static const byte BUTTON_RELEASED       = 2;
+        static const byte BUTTON_LONG_PRESSED   = 3;
+        static const byte BUTTON_REPEATED       = 4;
+        
+        static const byte BUTTON_DEBOUNCE_TICKS = 5;
+        static const unsigned int BUTTON_LONG_PRESS_TICKS = 500;
+        
+        static const byte BUTTON_REPEAT_PINS_MASK 
+            = PortBPin<CHANGE_BPM_BY_ONE_BUTTON_PIN>::BIT
+              | PortBPin<CHANGE_BPM_BY_TEN_BUTTON_PIN>::BIT;
+        static const unsigned int BUTTON_REPEAT_PERIODS[];
+        static const byte BUTTON_REPEAT_STEPS;    /* By sizeof. */
+        static const byte BUTTON_LONG_PRESS_PINS_MASK 
+            = PortBPin<RESTART_BPM_BUTTON_PIN>::BIT
+              | PortBPin<ADD_OR_SUB_BPM_BUTTON_PIN>::BIT
+              | PortBPin<MUTE_BUZZER_BUTTON_PIN>::BIT;
+        
+        static const byte STATE_BPM             = 1 << 0;
+        static const byte STATE_BPM_MODIFIER    = 1 << 1;
+        static const byte STATE_MUTE            = 1 << 2;
+        static const byte STATE_TIME_SIGNATURE  = 1 << 3;
+        static const byte STATE_SUBDIVISION     = 1 << 4;
+        static const byte STATE_TEMPO_MAP       = 1 << 5;
+        static const byte STATE_SHOWN_IN_LCD    = STATE_BPM | STATE_BPM_MODIFIER
+                                                  | STATE_MUTE 
+                                                  | STATE_TIME_SIGNATURE
+                                                  | STATE_SUBDIVISION
+                                                  | STATE_TEMPO_MAP;
+        
+        typedef byte (Beethduino::*ButtonOperation)();
+        
+        struct ButtonAction
+        {
+            byte pin;
+            byte button_event;  /* BUTTON_RELEASED or BUTTON_LONG_PRESSED. */
+            ButtonOperation operation;
+        };
+        
+        static const ButtonAction BUTTON_ACTIONS[];
+        static const byte BUTTON_ACTIONS_COUNT;   /* By sizeof. */
+        
+        static const byte TIMER_WHEEL_SLOT_BITS = 4;
+        static const byte TIMER_WHEEL_SLOTS     = 1 << TIMER_WHEEL_SLOT_BITS;
+        static const byte TIMER_WHEEL_LEVELS    = 4;
+        static const unsigned long TIMER_WHEEL_RANGE 
+            = 1UL << (TIMER_WHEEL_SLOT_BITS * TIMER_WHEEL_LEVELS);
+        static const byte NO_TIMER              = 0xFF;
+        static const byte TIMER_IDLE            = 0xFF;
+        static const byte TIMER_DUE             = 0xFE;
+        
+        static const byte TIMER_BUZZER_OFF      = 0;
+        static const byte TIMER_BEAT            = 1;
+        static const byte TIMER_SUBDIVISION     = 2;
+        static const byte TIMER_VOICE_EVENT     = 3;
+        static const byte TIMER_DEBOUNCE        = 4;
+        static const byte TIMER_BUTTON_HOLD     = 5;    /* One per button. */
+        static const byte TIMERS                = TIMER_BUTTON_HOLD + BUTTONS;
+        
+        typedef void (Beethduino::*TimerHandler)(byte timer);
+        
+        static const TimerHandler TIMER_HANDLERS[TIMERS];
+        
+        volatile byte button_event_pins[BUTTON_EVENT_QUEUE_SIZE];
+        volatile byte button_event_types[BUTTON_EVENT_QUEUE_SIZE];
+        volatile byte button_event_head;
+        volatile byte button_event_tail;
+        
+        volatile byte button_integrators[BUTTONS];
+        volatile byte button_repeat_steps[BUTTONS];
+        volatile byte button_pin_levels;
+        volatile byte long_pressed_buttons;
+        volatile boolean is_button_debounce_active;
         
         int last_pressed_button_pin;
+        byte repeated_button_pins;
         int bpm;
         int bpm_modifier;
-        int iteration_counter;
         
-        int buzzer_bips;    /* Count number of times buzzer has "bip" while 
-                            * it was unmuted. Variable used only in testing; 
-                            * it shall not appear in the final software.
-                            */
+        struct TimeSignature
+        {
+            byte beats_per_bar;
+            char text[4];   /* i.e: "4/4" and '\0'. */
+        };
+        
+        static const TimeSignature TIME_SIGNATURES[];
+        static const byte TIME_SIGNATURES_COUNT;  /* By sizeof. */
+        static const byte DEFAULT_TIME_SIGNATURE = 2;   /* 4/4. */
+        static const byte TIME_SIGNATURE_COLUMN = LCD_COLUMNS - 3;
+        
+        byte time_signature;
+        volatile byte beats_per_bar;
+        volatile byte beat_in_bar;  /* 0 is the downbeat (accented). */
+        
+        struct Subdivision
+        {
+            byte clicks_per_beat;
+            unsigned long period_multiplier;    /* 0 without subdivision. */
+            char text[2];   /* i.e: "3" (triplets) and '\0'. */
+        };
+        
+        static const Subdivision SUBDIVISIONS[];
+        static const byte SUBDIVISIONS_COUNT;     /* By sizeof. */
+        static const byte DEFAULT_SUBDIVISION   = 0;    /* Only the beats. */
+        static const byte MAX_CLICKS_PER_BEAT   = 4;
+        static const byte SUBDIVISION_PERIOD_SHIFT = 17;
+        static const byte SUBDIVISION_COLUMN    = LCD_COLUMNS - 1;
+        
+        byte subdivision;
+        volatile byte clicks_per_beat;
+        volatile unsigned int subdivision_req_iter;
+        volatile byte subdivision_remainder;
+        volatile unsigned int beat_subdivision_iter;
+        volatile byte beat_subdivision_remainder;
+        volatile byte subdivision_error_accumulator;
+        volatile unsigned long subdivision_deadline_tick;
+        volatile byte pending_subdivisions;
+        
+        static const byte TEMPO_MAP_END         = 0;
+        static const byte TEMPO_MAP_PLAY        = 1;
+        static const byte TEMPO_MAP_RAMP        = 2;
+        static const byte TEMPO_MAP_TIME_SIGNATURE = 3;
+        static const byte TEMPO_MAP_REPEAT      = 4;
+        static const byte TEMPO_MAP_LINEAR_RAMP = 5;
+        static const byte TEMPO_MAP_EXPONENTIAL_RAMP = 6;
+        static const byte TEMPO_MAP_VOICES      = 7;
+        
+        static const byte TEMPO_MAP_PLAY_SIZE   = 4;
+        static const byte TEMPO_MAP_RAMP_SIZE   = 5;
+        static const byte TEMPO_MAP_TIME_SIGNATURE_SIZE = 2;
+        static const byte TEMPO_MAP_SMOOTH_RAMP_SIZE = 4;
+        static const byte TEMPO_MAP_VOICES_SIZE = 2;
+        
+        static const byte TEMPO_RAMP_NONE       = 0;
+        static const byte TEMPO_RAMP_LINEAR     = 1;
+        static const byte TEMPO_RAMP_EXPONENTIAL = 2;
+        static const byte RAMP_PERIOD_SHIFT     = 16;
+        static const unsigned long RAMP_PERIOD_ONE = 1UL << RAMP_PERIOD_SHIFT;
+        static const byte RAMP_RATIO_SHIFT      = 27;
+        static const unsigned long RAMP_RATIO_ONE = 1UL << RAMP_RATIO_SHIFT;
+        static const byte RAMP_LOG_SHIFT        = 32;
+        static const long long RAMP_LOG_ONE     = 1LL << RAMP_LOG_SHIFT;
+        static const byte RAMP_MANTISSA_SHIFT   = 31;
+        static const unsigned long long RAMP_LN_2 = 2977044472ULL;
+        
+        static const byte TEMPO_MAP[];
+        static const unsigned int TEMPO_MAP_SIZE;  /* By sizeof. */
+        
+        const byte *tempo_map;      /* TEMPO_MAP, or a program of the test. 
+                                    * Variable used only in testing; it 
+                                    * shall not appear in the final software.
+                                    */
+        unsigned int tempo_map_size;
+        
+        unsigned int tempo_map_pc;
+        int tempo_map_bpm;
+        byte tempo_map_time_signature;
+        volatile boolean is_tempo_map_running;
+        volatile boolean is_tempo_segment_staged;
+        volatile boolean is_tempo_map_changed;
+        volatile byte tempo_map_bars_left;
+        volatile unsigned int staged_req_iter;
+        volatile unsigned long staged_remainder;
+        volatile unsigned long staged_divisor;
+        volatile byte staged_beats_per_bar;
+        volatile byte staged_bars;
+        
+        int ramp_start_bpm;
+        volatile byte tempo_ramp;
+        volatile unsigned int tempo_ramp_beats_left;
+        volatile int ramp_delta_iter;
+        volatile unsigned long ramp_delta_remainder;
+        volatile unsigned long ramp_ratio;  /* RAMP_RATIO_SHIFT bits. */
+        volatile byte staged_ramp;
+        volatile unsigned int staged_ramp_beats;
+        volatile int staged_delta_iter;
+        volatile unsigned long staged_delta_remainder;
+        volatile unsigned long staged_ratio;
+        
+        static const byte VOICE_OUTPUT_BUZZER   = 0;
+        static const byte VOICE_OUTPUT_PIN      = 1;
+        static const byte VOICE_OUTPUT_TONE     = 2;
+        
+        struct Voice
+        {
+            byte pulses;            /* Against beats, 1 to MAX_VOICE_PULSES. */
+            byte beats;
+            byte accents;           /* Bit i: the pulse i is accented. */
+            byte output;            /* VOICE_OUTPUT_BUZZER, _PIN or _TONE. */
+            byte pin;
+            byte sound_duration;
+            byte accent_sound_duration;
+            unsigned int tone_frequency;    /* In Hz (VOICE_OUTPUT_TONE). */
+        };
+        
+        /* Polyrhythm voices (stored in PROGMEM), selected by 
+        * TEMPO_MAP_VOICES. Defined here, so VOICES_COUNT (sizeof) is a 
+        * constant expression for the arrays of the voices.
+        */
+        static constexpr Voice VOICES[] PROGMEM = 
+        {
+            {3, 4, 0x01, VOICE_OUTPUT_PIN, BoardConfig::FIRST_VOICE_PIN, 
+             20, 40, 0},                                    /* 3 against 4. */
+            {5, 7, 0x01, VOICE_OUTPUT_TONE, BoardConfig::TONE_VOICE_PIN, 
+             20, 40, 880},                                  /* 5 against 7. */
+            {2, 3, 0x01, VOICE_OUTPUT_BUZZER, 0, 15, 15, 0}, /* 2 against 3. */
+            {7, 4, 0x09, VOICE_OUTPUT_PIN, BoardConfig::SECOND_VOICE_PIN, 
+             10, 20, 0}                                     /* 7 (3 + 4). */
+        };
+        static const byte VOICES_COUNT = sizeof(VOICES) / sizeof(VOICES[0]);
+        static const byte ALL_VOICES_MASK       = (1 << VOICES_COUNT) - 1;
+        static const byte MAX_VOICE_PULSES      = 8;
+        static const byte VOICE_MULTIPLIER_SHIFT = 16;
+        static const unsigned long VOICE_MULTIPLIERS[MAX_VOICE_PULSES + 1];
+        static const byte VOICE_EVENTS_SIZE     = 2 * VOICES_COUNT;
+        static const byte VOICE_EVENT_OFF       = 0x80;
+        
+        byte tempo_map_voices;
+        volatile byte staged_voices;
+        volatile byte active_voices;    /* Bit v: VOICES[v]. */
+        volatile byte voice_beats[VOICES_COUNT];
+        volatile byte voice_pulses[VOICES_COUNT];
+        volatile byte voice_positions[VOICES_COUNT]; /* In 1 / pulses beats. */
+        volatile unsigned int voice_step_iters[VOICES_COUNT];
+        volatile byte voice_step_remainders[VOICES_COUNT];
+        volatile unsigned long voices_beat_tick;
+        volatile byte sounding_voice_pins;
+        volatile unsigned long voice_event_ticks[VOICE_EVENTS_SIZE]; /* Heap. */
+        volatile byte voice_event_codes[VOICE_EVENTS_SIZE];
+        volatile byte voice_event_count;
+        
+        volatile unsigned long wheel_tick;  /* Last tick served. */
+        volatile byte timer_wheel_slots[TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS];
+        volatile unsigned long timer_expiry_ticks[TIMERS];
+        volatile byte timer_slots[TIMERS];
+        volatile byte next_timers[TIMERS];
+        volatile byte previous_timers[TIMERS];
+        volatile unsigned int due_timers;   /* Bit t: the timer t is due. */
+        
+        volatile int buzzer_bips;   /* Count number of times buzzer has "bip"
+                                    * while it was unmuted. Variable used only
+                                    * in testing; it shall not appear in the
+                                    * final software.
+                                    */
+        
+        boolean is_sleep_enabled;   /* The main loop sleeps between the 
+                                    * events (false by default: a sleep 
+                                    * ends in the next interrupt, after the 
+                                    * end time of a test). Variable used only
+                                    * in testing; it shall not appear in the
+                                    * final software.
+                                    */
 
-        unsigned int bpm_freq_req_iter;
+        volatile unsigned int bpm_freq_req_iter;
+        volatile unsigned long bpm_freq_remainder;
+        volatile unsigned long bpm_freq_divisor;
+        volatile unsigned long beat_error_accumulator;
+        
+        volatile unsigned long timer_ticks;
+        volatile unsigned long beat_deadline_tick;
+        volatile unsigned long buzzer_off_tick;
+        volatile boolean is_buzzer_sounding;
         
-        String bpm_text_info;   /* Text to be shown in the LCD, loaded in a 
+        char bpm_text_info[BPM_TEXT_INFO_SIZE]; 
+                                /* Text to be shown in the LCD, loaded in a 
                                 * string to allow testing operations.
                                 * Variable used only in testing; 
                                 * it shall not appear in the final software.
                                 */
                                                    
-        boolean is_buzzer_muted;
+        volatile boolean is_buzzer_muted;
 
         
         /* METHODS */
         Beethduino();
         void exec_main_loop();
+        void sleep_until_event(); /* Executed by exec_main_loop(). */
+        void configure_voice_pins();
+        void configure_beat_timer();
+        void timer_compare_isr(); /* Body of the Timer1 interrupt. */
+        void configure_button_interrupts();
+        void debounce_buttons();
+        void expire_debounce(byte timer);
+        void expire_button_hold(byte timer);
+        void push_button_event(int pin_to_check, byte button_event);
         void check_button_pressing();
-        void detect_single_pulsation(int pin_to_check);
-        void perform_operation(int pin_to_check);
-        void reset_bpm();
-        void invert_bpm_modifier();
-        void update_bpm(int value);
+        void detect_single_pulsation(int pin_to_check, byte button_event);
+        void perform_operation(int pin_to_check, byte button_event);
+        byte reset_bpm();
+        byte invert_bpm_modifier();
+        byte change_bpm_by_one();
+        byte change_bpm_by_ten();
+        byte update_bpm(int value);
         void calculate_required_iterations();
-        void change_mute_state();
+        byte change_mute_state();
+        byte change_time_signature();
+        byte change_subdivision();
+        void calculate_subdivision_step();
+        void set_subdivision_step();
+        byte start_tempo_map();
+        byte stop_tempo_map();
+        void service_tempo_map(); /* Executed by exec_main_loop(). */
+        void stage_tempo_segment();
+        void stage_tempo_ramp();
+        unsigned long calculate_ramp_ratio(unsigned int beats);
+        long long calculate_log2(unsigned int value);
+        unsigned long calculate_exp2(long long exponent);
+        byte interpret_tempo_map();
+        unsigned int read_tempo_map_word(const byte *address);
+        byte ramp_tempo_map_bpm(const byte *instruction);
+        void init_lcd_frame();
         void update_lcd();
+        byte print_lcd_frame(byte row, byte column, const char *text);
+        byte print_lcd_frame_P(byte row, byte column, const char *text);
+        void format_number(unsigned int number, char *text);
+        void service_lcd(); /* Executed by exec_main_loop(). */
         void update_serial_monitor(); /* Simulation of LCD operations. */
-        void process_bpm_frequency();
+        byte append_text_info(byte position, const char *text);
+        byte append_text_info_P(byte position, const char *text);
+        void init_timer_wheel();
+        void serve_timer_wheel();
+        void cascade_timer_wheel();
+        void cascade_timer_slot(byte slot);
+        void collect_due_timers(byte slot);
+        void arm_timer(byte timer, unsigned long tick);
+        void cancel_timer(byte timer);
+        void link_timer(byte timer);
+        void arm_beat_timers();
+        void expire_buzzer_off(byte timer);
+        void expire_beat(byte timer);
+        void expire_subdivision(byte timer);
+        void expire_voice_event(byte timer);
+        void advance_tempo_map();
+        void advance_tempo_ramp();
+        void schedule_next_beat();
+        void schedule_subdivisions(unsigned long beat_tick);
+        void schedule_next_subdivision();
         void play_buzzer();
+        boolean advance_beat_in_bar();
+        void play_subdivision();
+        void stop_buzzer();
+        void schedule_voices(unsigned long beat_tick);
+        unsigned long voice_pulse_offset(byte voice, byte pulses);
+        void serve_voice_events();
+        void play_voice(byte voice);
+        void push_voice_event(unsigned long tick, byte code);
+        void pop_voice_event();
+        void restart_voices();
 };
 
 #endif
\ No newline at end of file
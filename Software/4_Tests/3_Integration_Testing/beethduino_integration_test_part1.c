@@ -31,6 +31,8 @@
 #include <assert.h>
 #include <Beethduino.h>
 
+const unsigned long BUTTON_LEVEL_DURATION = 50;   /* In Milliseconds. */
+
 Beethduino beethduino;
 boolean is_unit_testing_done;
 
@@ -41,6 +43,9 @@ void setup()
 {
     is_unit_testing_done = false;
     
+    beethduino.configure_beat_timer();
+    beethduino.configure_button_interrupts();
+    
     Serial.begin(9600); /* Start serial port at 9600 bits per second. */
     Serial.println("INTEGRATION TESTING part 1 STARTED\n*********************");
 }
@@ -84,13 +89,14 @@ void test_initial_condition()
     assert (beethduino.is_buzzer_muted == true);
     
     assert (beethduino.buzzer_bips == 0);
-    assert (beethduino.iteration_counter == 0);
+    assert (beethduino.is_buzzer_sounding == false);
    
     assert (beethduino.bpm == 60);
     assert (beethduino.bpm_modifier == 1);
-    assert (beethduino.bpm_freq_req_iter == 975);
+    assert (beethduino.bpm_freq_req_iter == 1000);
     
-    assert (beethduino.bpm_text_info == "MUTE_MUTE_MUTE_LFCRADD BPM: 60");
+    assert (strcmp(beethduino.bpm_text_info, 
+                   "MUTE_MUTE_MUTE_LFCRADD BPM: 60") == 0);
 }
 
 
@@ -98,31 +104,23 @@ void test_increase_bpm_by_one()
 {
     Serial.println("test_increase_bpm_by_one");
     
-    digitalWrite(beethduino.CHANGE_BPM_BY_ONE_BUTTON_PIN, HIGH);
-    
-    /* Arbitrary number of iterations. */
-    for (int i = 0; i < 10; i++)
-    {
-        beethduino.exec_main_loop();
-        if (i == 8)
-        {
-            digitalWrite(beethduino.CHANGE_BPM_BY_ONE_BUTTON_PIN, LOW);
-        }
-    }
+    simulate_button_pulsation(beethduino.CHANGE_BPM_BY_ONE_BUTTON_PIN);
     
     assert (beethduino.last_pressed_button_pin == 0);
     
     assert (beethduino.is_buzzer_muted == true);
     
     assert (beethduino.buzzer_bips == 0);
-    assert (beethduino.iteration_counter == 0);
+    assert (beethduino.is_buzzer_sounding == false);
    
     assert (beethduino.bpm == 61); /* Changed from 60 to 61. */
     assert (beethduino.bpm_modifier == 1);
-    assert (beethduino.bpm_freq_req_iter == 958); /* Previously was 975.*/
+    assert (beethduino.bpm_freq_req_iter == 983); /* Previously was 1000.*/
+    assert (beethduino.bpm_freq_remainder == 37); /* 60000 = 61*983 + 37 */
     
     /* Changed from 60 to 61. */
-    assert (beethduino.bpm_text_info == "MUTE_MUTE_MUTE_LFCRADD BPM: 61");
+    assert (strcmp(beethduino.bpm_text_info, 
+                   "MUTE_MUTE_MUTE_LFCRADD BPM: 61") == 0);
 }
 
 
@@ -130,31 +128,23 @@ void test_increase_bpm_by_ten()
 {
     Serial.println("test_increase_bpm_by_ten");
     
-    digitalWrite(beethduino.CHANGE_BPM_BY_TEN_BUTTON_PIN, HIGH);
-    
-    /* Arbitrary number of iterations. */
-    for (int i = 0; i < 10; i++)
-    {
-        beethduino.exec_main_loop();
-        if (i == 8)
-        {
-            digitalWrite(beethduino.CHANGE_BPM_BY_TEN_BUTTON_PIN, LOW);
-        }
-    }
+    simulate_button_pulsation(beethduino.CHANGE_BPM_BY_TEN_BUTTON_PIN);
     
     assert (beethduino.last_pressed_button_pin == 0);
     
     assert (beethduino.is_buzzer_muted == true);
     
     assert (beethduino.buzzer_bips == 0);
-    assert (beethduino.iteration_counter == 0);
+    assert (beethduino.is_buzzer_sounding == false);
    
     assert (beethduino.bpm == 71); /* Changed from 61 to 71. */
     assert (beethduino.bpm_modifier == 1);
-    assert (beethduino.bpm_freq_req_iter == 820); /* Previously was 958.*/
+    assert (beethduino.bpm_freq_req_iter == 845); /* Previously was 983.*/
+    assert (beethduino.bpm_freq_remainder == 5); /* 60000 = 71*845 + 5 */
     
     /* Changed from 61 to 71. */
-    assert (beethduino.bpm_text_info == "MUTE_MUTE_MUTE_LFCRADD BPM: 71");
+    assert (strcmp(beethduino.bpm_text_info, 
+                   "MUTE_MUTE_MUTE_LFCRADD BPM: 71") == 0);
 }
 
 
@@ -162,31 +152,22 @@ void test_change_mod()
 {
     Serial.println("test_change_mod");
     
-    digitalWrite(beethduino.ADD_OR_SUB_BPM_BUTTON_PIN, HIGH);
-    
-    /* Arbitrary number of iterations. */
-    for (int i = 0; i < 10; i++)
-    {
-        beethduino.exec_main_loop();
-        if (i == 8)
-        {
-            digitalWrite(beethduino.ADD_OR_SUB_BPM_BUTTON_PIN, LOW);
-        }
-    }
+    simulate_button_pulsation(beethduino.ADD_OR_SUB_BPM_BUTTON_PIN);
     
     assert (beethduino.last_pressed_button_pin == 0);
     
     assert (beethduino.is_buzzer_muted == true);
     
     assert (beethduino.buzzer_bips == 0);
-    assert (beethduino.iteration_counter == 0);
+    assert (beethduino.is_buzzer_sounding == false);
    
     assert (beethduino.bpm == 71);
     assert (beethduino.bpm_modifier == -1); /* Changed from 1 to -1. */
-    assert (beethduino.bpm_freq_req_iter == 820);
+    assert (beethduino.bpm_freq_req_iter == 845);
     
     /* Changed from ADD to SUB. */
-    assert (beethduino.bpm_text_info == "MUTE_MUTE_MUTE_LFCRSUB BPM: 71");
+    assert (strcmp(beethduino.bpm_text_info, 
+                   "MUTE_MUTE_MUTE_LFCRSUB BPM: 71") == 0);
 }
 
 
@@ -194,31 +175,23 @@ void test_decrease_bpm_by_one()
 {
     Serial.println("test_decrease_bpm_by_one");
     
-    digitalWrite(beethduino.CHANGE_BPM_BY_ONE_BUTTON_PIN, HIGH);
-    
-    /* Arbitrary number of iterations. */
-    for (int i = 0; i < 10; i++)
-    {
-        beethduino.exec_main_loop();
-        if (i == 8)
-        {
-            digitalWrite(beethduino.CHANGE_BPM_BY_ONE_BUTTON_PIN, LOW);
-        }
-    }
+    simulate_button_pulsation(beethduino.CHANGE_BPM_BY_ONE_BUTTON_PIN);
     
     assert (beethduino.last_pressed_button_pin == 0);
     
     assert (beethduino.is_buzzer_muted == true);
     
     assert (beethduino.buzzer_bips == 0);
-    assert (beethduino.iteration_counter == 0);
+    assert (beethduino.is_buzzer_sounding == false);
    
     assert (beethduino.bpm == 70); /* Changed from 71 to 70. */
     assert (beethduino.bpm_modifier == -1);
-    assert (beethduino.bpm_freq_req_iter == 832); /* Previously was 820.*/
+    assert (beethduino.bpm_freq_req_iter == 857); /* Previously was 845.*/
+    assert (beethduino.bpm_freq_remainder == 10); /* 60000 = 70*857 + 10 */
     
     /* Changed from 71 to 70. */
-    assert (beethduino.bpm_text_info == "MUTE_MUTE_MUTE_LFCRSUB BPM: 70");
+    assert (strcmp(beethduino.bpm_text_info, 
+                   "MUTE_MUTE_MUTE_LFCRSUB BPM: 70") == 0);
 }
 
 
@@ -226,31 +199,22 @@ void test_decrease_bpm_by_ten()
 {
     Serial.println("test_decrease_bpm_by_ten");
     
-    digitalWrite(beethduino.CHANGE_BPM_BY_TEN_BUTTON_PIN, HIGH);
-    
-    /* Arbitrary number of iterations. */
-    for (int i = 0; i < 10; i++)
-    {
-        beethduino.exec_main_loop();
-        if (i == 8)
-        {
-            digitalWrite(beethduino.CHANGE_BPM_BY_TEN_BUTTON_PIN, LOW);
-        }
-    }
+    simulate_button_pulsation(beethduino.CHANGE_BPM_BY_TEN_BUTTON_PIN);
     
     assert (beethduino.last_pressed_button_pin == 0);
     
     assert (beethduino.is_buzzer_muted == true);
     
     assert (beethduino.buzzer_bips == 0);
-    assert (beethduino.iteration_counter == 0);
+    assert (beethduino.is_buzzer_sounding == false);
    
     assert (beethduino.bpm == 60); /* Changed from 70 to 60. */
     assert (beethduino.bpm_modifier == -1);
-    assert (beethduino.bpm_freq_req_iter == 975); /* Previously was 832.*/
+    assert (beethduino.bpm_freq_req_iter == 1000); /* Previously was 857.*/
     
     /* Changed from 70 to 60. */
-    assert (beethduino.bpm_text_info == "MUTE_MUTE_MUTE_LFCRSUB BPM: 60");
+    assert (strcmp(beethduino.bpm_text_info, 
+                   "MUTE_MUTE_MUTE_LFCRSUB BPM: 60") == 0);
 }
 
 
@@ -258,17 +222,7 @@ void test_restart_state()
 {
     Serial.println("test_restart_state");
 
-    digitalWrite(beethduino.RESTART_BPM_BUTTON_PIN, HIGH);
-    
-    /* Arbitrary number of iterations. */
-    for (int i = 0; i < 10; i++)
-    {
-        beethduino.exec_main_loop();
-        if (i == 8)
-        {
-            digitalWrite(beethduino.RESTART_BPM_BUTTON_PIN, LOW);
-        }
-    }
+    simulate_button_pulsation(beethduino.RESTART_BPM_BUTTON_PIN);
     
     assert (beethduino.last_pressed_button_pin == 0);
     
@@ -276,9 +230,39 @@ void test_restart_state()
    
     assert (beethduino.bpm == 60);
     assert (beethduino.bpm_modifier == 1);
-    assert (beethduino.bpm_freq_req_iter == 975);
+    assert (beethduino.bpm_freq_req_iter == 1000);
+    
+    assert (strcmp(beethduino.bpm_text_info, 
+                   "MUTE_MUTE_MUTE_LFCRADD BPM: 60") == 0);
+}
+
+
+/**
+* Press and release a button, while the main loop is executed. Every level is
+* held BUTTON_LEVEL_DURATION, longer than the debounce window.
+*/
+void simulate_button_pulsation(int pin)
+{
+    digitalWrite(pin, HIGH);
+    exec_main_loop_during(BUTTON_LEVEL_DURATION);
+    digitalWrite(pin, LOW);
+    exec_main_loop_during(BUTTON_LEVEL_DURATION);
+}
+
+
+/**
+* The main loop only attends the button events: each iteration waits one
+* tick, so the debouncer (timer interrupt) can run.
+*/
+void exec_main_loop_during(unsigned long duration)
+{
+    unsigned long start_time = millis();
     
-    assert (beethduino.bpm_text_info == "MUTE_MUTE_MUTE_LFCRADD BPM: 60");
+    while ((millis() - start_time) < duration)
+    {
+        beethduino.exec_main_loop();
+        delay(1);
+    }
 }
 
 
@@ -31,6 +31,8 @@
 #include <assert.h>
 #include <Beethduino.h>
 
+const unsigned long BUTTON_LEVEL_DURATION = 50;   /* In Milliseconds. */
+
 Beethduino beethduino;
 boolean is_unit_testing_done;
 
@@ -41,6 +43,9 @@ void setup()
 {
     is_unit_testing_done = false;
     
+    beethduino.configure_beat_timer();
+    beethduino.configure_button_interrupts();
+    
     Serial.begin(9600); /* Start serial port at 9600 bits per second. */
     Serial.println("INTEGRATION TESTING part 2 STARTED\n*********************");
 }
@@ -61,7 +66,9 @@ void execute_tests()
 {
     test_initial_condition();
     test_unmute_buzzer();
-    test_bpm_frequency();                      
+    test_bpm_frequency();
+    test_main_loop_not_blocked_by_buzzer();
+    test_bpm_frequency_under_lcd_load();
     test_restart_state();
     test_bpm_upper_limit();
     test_bpm_lower_limit();
@@ -83,13 +90,14 @@ void test_initial_condition()
     assert (beethduino.is_buzzer_muted == true);
     
     assert (beethduino.buzzer_bips == 0);
-    assert (beethduino.iteration_counter == 0);
+    assert (beethduino.is_buzzer_sounding == false);
    
     assert (beethduino.bpm == 60);
     assert (beethduino.bpm_modifier == 1);
-    assert (beethduino.bpm_freq_req_iter == 975);
+    assert (beethduino.bpm_freq_req_iter == 1000);
     
-    assert (beethduino.bpm_text_info == "MUTE_MUTE_MUTE_LFCRADD BPM: 60");
+    assert (strcmp(beethduino.bpm_text_info, 
+                   "MUTE_MUTE_MUTE_LFCRADD BPM: 60") == 0);
 }
 
 
@@ -97,35 +105,25 @@ void test_unmute_buzzer()
 {
     Serial.println("test_unmute_buzzer");
     
-    digitalWrite(beethduino.MUTE_BUZZER_BUTTON_PIN, HIGH);
-    
-    /* Arbitrary number of iterations. */
-    for (int i = 0; i < 10; i++)
-    {
-        beethduino.exec_main_loop();
-        if (i == 8)
-        {
-            digitalWrite(beethduino.MUTE_BUZZER_BUTTON_PIN, LOW);
-        }
-    }
+    simulate_button_pulsation(beethduino.MUTE_BUZZER_BUTTON_PIN);
     
     assert (beethduino.last_pressed_button_pin == 0);
     
     assert (beethduino.is_buzzer_muted == false);
     
     assert (beethduino.buzzer_bips == 0);
-    assert (beethduino.iteration_counter == 1); /* Iteration counter now shall 
-                                                * be one, because the software 
-                                                * has entered in the 
-                                                * process_bpm_frequency.
-                                                */
+    
+    /* First beat is now scheduled, at most one period later. */
+    assert ((beethduino.beat_deadline_tick - beethduino.timer_ticks) 
+            <= beethduino.bpm_freq_req_iter);
    
     assert (beethduino.bpm == 60);
     assert (beethduino.bpm_modifier == 1);
-    assert (beethduino.bpm_freq_req_iter == 975);
+    assert (beethduino.bpm_freq_req_iter == 1000);
     
     /* First line now has no characters. */
-    assert (beethduino.bpm_text_info == "LFCRADD BPM: 60");
+    assert (strcmp(beethduino.bpm_text_info, 
+                   "LFCRADD BPM: 60") == 0);
 }
 
 
@@ -133,58 +131,108 @@ void test_bpm_frequency()
 {
     Serial.println("test_bpm_frequency");
     
-    /* bpm_freq_req_iter is now 975. The previous test (test_unmute_buzzer)
-    * executed the process_bpm_frequency one time, so iteration_counter is
-    * now '1'. This for loop will increase its value up to 974.
+    unsigned long first_beat_deadline = beethduino.beat_deadline_tick;
+    
+    /* bpm_freq_req_iter is now 1000. The Timer1 interrupt starts the beat
+    * once the deadline is reached; the main loop only attends the button 
+    * events (none here), so each iteration waits one tick.
     */
-    for (int i = 0; i <= 972; i++)
+    while (beethduino.buzzer_bips == 0)
     {
         beethduino.exec_main_loop();
+        delay(1);
     }
     
-    assert (beethduino.buzzer_bips == 0);
-    assert (beethduino.iteration_counter == 974);
+    assert (beethduino.timer_ticks >= first_beat_deadline);
     
-    /* Fulfil the required iterations, and make the buzzer "bip" once. */
-    beethduino.exec_main_loop();
-    assert (beethduino.buzzer_bips == 1);
-    assert (beethduino.iteration_counter == 0);
+    /* Next deadline is absolute: exactly one period after the first one. */
+    assert (beethduino.beat_deadline_tick 
+            == first_beat_deadline + beethduino.bpm_freq_req_iter);
 }
 
 
-void test_restart_state()
+void test_main_loop_not_blocked_by_buzzer()
 {
-    Serial.println("test_restart_state");
+    Serial.println("test_main_loop_not_blocked_by_buzzer");
+    
+    int main_loop_iterations = 0;
+    
+    /* Wait for the beginning of the next beat. */
+    while (beethduino.buzzer_bips < 2)
+    {
+        beethduino.exec_main_loop();
+        delay(1);
+    }
+    
+    while (beethduino.is_buzzer_sounding == true)
+    {
+        beethduino.exec_main_loop();
+        delay(1);
+        main_loop_iterations++;
+    }
+    
+    /* The buttons were attended while the buzzer was sounding. */
+    assert (main_loop_iterations > 1);
+    
+    /* The sound lasted SOUND_DURATION ticks from the beat deadline. */
+    assert (beethduino.buzzer_off_tick 
+            == beethduino.beat_deadline_tick - beethduino.bpm_freq_req_iter
+               + beethduino.SOUND_DURATION);
+}
 
-    digitalWrite(beethduino.RESTART_BPM_BUTTON_PIN, HIGH);
+
+void test_bpm_frequency_under_lcd_load()
+{
+    Serial.println("test_bpm_frequency_under_lcd_load");
     
-    /* Arbitrary number of iterations. */
-    for (int i = 0; i < 10; i++)
+    unsigned long first_beat_deadline = beethduino.beat_deadline_tick;
+    int first_buzzer_bips = beethduino.buzzer_bips;
+    
+    /* Redraw the LCD in every iteration; with the old iteration counting, 
+    * each redraw delayed all the following beats. Only the changed 
+    * characters are sent (in slices, by the main loop), so the modifier 
+    * is inverted (twice) to redraw.
+    */
+    while (beethduino.buzzer_bips < (first_buzzer_bips + 3))
     {
+        beethduino.invert_bpm_modifier();
+        beethduino.update_lcd();
+        beethduino.exec_main_loop();
+        beethduino.invert_bpm_modifier();
+        beethduino.update_lcd();
         beethduino.exec_main_loop();
-        if (i == 8)
-        {
-            digitalWrite(beethduino.RESTART_BPM_BUTTON_PIN, LOW);
-        }
     }
     
+    /* Three beats later, the deadline has not drifted. */
+    assert (beethduino.beat_deadline_tick 
+            == first_beat_deadline + (3 * beethduino.bpm_freq_req_iter));
+}
+
+
+void test_restart_state()
+{
+    Serial.println("test_restart_state");
+
+    simulate_button_pulsation(beethduino.RESTART_BPM_BUTTON_PIN);
+    
     assert (beethduino.last_pressed_button_pin == 0);
     
     assert (beethduino.is_buzzer_muted == true);
 
     /* buzzer_bips is a variable with testing purposes; no need to check here.*/
     
-    assert (beethduino.iteration_counter == 9); /* Because buzzer is not muted
-                                                * iteration_counter still
-                                                * being updated in the previous
-                                                * for loop.
-                                                */
+    /* Muted, so the timer interrupt does not start more beats; the last 
+    * sound, if any, ends after SOUND_DURATION.
+    */
+    delay(2 * beethduino.SOUND_DURATION);
+    assert (beethduino.is_buzzer_sounding == false);
    
     assert (beethduino.bpm == 60);
     assert (beethduino.bpm_modifier == 1);
-    assert (beethduino.bpm_freq_req_iter == 975);
+    assert (beethduino.bpm_freq_req_iter == 1000);
     
-    assert (beethduino.bpm_text_info == "MUTE_MUTE_MUTE_LFCRADD BPM: 60");
+    assert (strcmp(beethduino.bpm_text_info, 
+                   "MUTE_MUTE_MUTE_LFCRADD BPM: 60") == 0);
 }
 
 
@@ -195,22 +243,15 @@ void test_bpm_upper_limit()
     /* Increase BPM enough times to force the bound checkings 
     * inside update_bpm process. In this case, the button is pressed 50 times.
     */    
-    for (int i = 0; i < 99; i++)
+    for (int i = 0; i < 50; i++)
     {
-        if (i%2 == 0)
-        {
-            digitalWrite(beethduino.CHANGE_BPM_BY_TEN_BUTTON_PIN, HIGH);
-        }
-        else
-        {
-            digitalWrite(beethduino.CHANGE_BPM_BY_TEN_BUTTON_PIN, LOW);
-        }
-        beethduino.exec_main_loop();
+        simulate_button_pulsation(beethduino.CHANGE_BPM_BY_TEN_BUTTON_PIN);
     }
     
     assert (beethduino.bpm == 300);
-    assert (beethduino.bpm_freq_req_iter == 175);
-    assert (beethduino.bpm_text_info == "MUTE_MUTE_MUTE_LFCRADD BPM: 300");
+    assert (beethduino.bpm_freq_req_iter == 200);
+    assert (strcmp(beethduino.bpm_text_info, 
+                   "MUTE_MUTE_MUTE_LFCRADD BPM: 300") == 0);
     
 }
 
@@ -222,22 +263,44 @@ void test_bpm_lower_limit()
     /* Button pressing is simulated to simplify test. */
     beethduino.bpm_modifier = -1;
     
-    for (int j = 0; j < 199; j++)
+    for (int j = 0; j < 100; j++)
     {
-        if (j%2 == 0)
-        {
-            digitalWrite(beethduino.CHANGE_BPM_BY_TEN_BUTTON_PIN, HIGH);
-        }
-        else
-        {
-            digitalWrite(beethduino.CHANGE_BPM_BY_TEN_BUTTON_PIN, LOW);
-        }
-        beethduino.exec_main_loop();
+        simulate_button_pulsation(beethduino.CHANGE_BPM_BY_TEN_BUTTON_PIN);
     }
     
     assert (beethduino.bpm == 1);
-    assert (beethduino.bpm_freq_req_iter == 59975);
-    assert (beethduino.bpm_text_info == "MUTE_MUTE_MUTE_LFCRSUB BPM: 1");
+    assert (beethduino.bpm_freq_req_iter == 60000);
+    assert (strcmp(beethduino.bpm_text_info, 
+                   "MUTE_MUTE_MUTE_LFCRSUB BPM: 1") == 0);
+}
+
+
+/**
+* Press and release a button, while the main loop is executed. Every level is
+* held BUTTON_LEVEL_DURATION, longer than the debounce window.
+*/
+void simulate_button_pulsation(int pin)
+{
+    digitalWrite(pin, HIGH);
+    exec_main_loop_during(BUTTON_LEVEL_DURATION);
+    digitalWrite(pin, LOW);
+    exec_main_loop_during(BUTTON_LEVEL_DURATION);
+}
+
+
+/**
+* The main loop only attends the button events: each iteration waits one
+* tick, so the debouncer (timer interrupt) can run.
+*/
+void exec_main_loop_during(unsigned long duration)
+{
+    unsigned long start_time = millis();
+    
+    while ((millis() - start_time) < duration)
+    {
+        beethduino.exec_main_loop();
+        delay(1);
+    }
 }
 
 
@@ -0,0 +1,97 @@
+/*******************************************************************************
+*   Project:        Beethduino, an Arduino Do-it-yourself electronic metronome.
+*
+*   File:           Arduino.h
+*
+*   Description:    Host (PC) replacement of the Arduino core header. Declares
+*                   the subset of the Arduino API used by Beethduino (digital
+*                   pins, tones, time, interrupts, String, Serial),
+*                   implemented over the virtual clock of
+*                   Arduino_simulator.h. In this way the main code, the
+*                   Beethduino library and the tests are compiled without
+*                   changes as Linux executables.
+*
+*   Language:       C++ (host, g++).
+*
+*   Dependencies:   math.h
+*                   stdint.h
+*                   stdlib.h
+*                   string.h
+*                   avr/io.h
+*                   avr/interrupt.h
+*                   avr/pgmspace.h
+*                   WString.h
+*                   HardwareSerial.h
+*
+*   Notes:          BPM - Beats Per Minute.
+*                   LCD - Liquid Crystal Display.
+*                   Only the Arduino UNO (ATmega328 at 16 MHz) is simulated.
+*
+*   Author:         Alberto Martin Cajal
+*                   amartin.glimpse23@gmail.com
+*                   amartin<DOT>glimpse23<AT>gmail<DOT>.com
+*
+*   License:        GNU GPL v3.0
+*
+*   URL:            https://github.com/amcajal/beethduino
+*
+*******************************************************************************/
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "avr/io.h"
+#include "avr/interrupt.h"
+#include "avr/pgmspace.h"
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define HIGH                0x1
+#define LOW                 0x0
+
+#define INPUT               0x0
+#define OUTPUT              0x1
+#define INPUT_PULLUP        0x2
+
+#define NUM_DIGITAL_PINS    20
+
+/* Analog pins of the Arduino UNO, used as digital pins. */
+static const uint8_t A0     = 14;
+static const uint8_t A1     = 15;
+static const uint8_t A2     = 16;
+static const uint8_t A3     = 17;
+static const uint8_t A4     = 18;
+static const uint8_t A5     = 19;
+
+#define interrupts()        sei()
+#define noInterrupts()      cli()
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+
+void tone(uint8_t pin, unsigned int frequency, unsigned long duration = 0);
+void noTone(uint8_t pin);
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+/* Arduino core initialization, executed after the global constructors. */
+void init();
+
+/* Defined by the sketch. */
+void setup();
+void loop();
+
+#include "WString.h"
+#include "HardwareSerial.h"
+
+#endif
@@ -0,0 +1,747 @@
+/*******************************************************************************
+*   Project:        Beethduino, an Arduino Do-it-yourself electronic metronome.
+*
+*   File:           Arduino_simulator.cpp
+*
+*   Description:    Body file of the host (PC) simulation of the Arduino UNO:
+*                   virtual clock (discrete event simulation), digital pins
+*                   and their scheduled changes, tones, global interrupt 
+*                   flag, pin change interrupt 0, Timer1 compare 
+*                   interrupt and idle sleep mode.
+*
+*   Language:       C++ (host, g++).
+*
+*   Dependencies:   stdlib.h
+*                   map
+*                   Arduino_simulator.h
+*
+*   Notes:          The Timer1 registers are read every time the clock
+*                   advances; when its configuration is changed, the counter
+*                   starts again from zero (as after "TCNT1 = 0").
+*                   As in the AVR, a pin change interrupt is triggered by
+*                   the enabled pins also in OUTPUT mode (the integration
+*                   tests write the button pins).
+*
+*   Author:         Alberto Martin Cajal
+*                   amartin.glimpse23@gmail.com
+*                   amartin<DOT>glimpse23<AT>gmail<DOT>.com
+*
+*   License:        GNU GPL v3.0
+*
+*   URL:            https://github.com/amcajal/beethduino
+*
+*******************************************************************************/
+
+#include <stdlib.h>
+#include <map>
+
+#include "Arduino_simulator.h"
+
+volatile uint8_t  TCCR1A;
+volatile uint8_t  TCCR1B;
+volatile uint16_t TCNT1;
+volatile uint16_t OCR1A;
+volatile uint8_t  TIMSK1;
+volatile uint8_t  PCICR;
+volatile uint8_t  PCMSK0;
+volatile uint8_t  SMCR;
+SimPortB PORTB;
+
+static unsigned long long current_time_ns;
+
+static boolean are_interrupts_enabled = true;
+static boolean is_in_interrupt;
+static boolean has_interrupt_run;  /* Since the last cli(). */
+
+static uint8_t pin_levels[NUM_DIGITAL_PINS];
+static uint8_t pin_modes[NUM_DIGITAL_PINS];
+
+struct PinEvent
+{
+    uint8_t pin;
+    int level;
+};
+
+/* Scheduled pin changes, ordered by time; the ones of the same time are
+*  kept in the order they were scheduled.
+*/
+static std::multimap<unsigned long long, PinEvent> pin_events;
+
+static const unsigned long long NO_EVENT_NS = ~0ULL;
+
+static SimPinListener pin_listener;
+
+static uint8_t timer1_tccr1b;
+static uint16_t timer1_ocr1a;
+static uint8_t timer1_timsk1;
+static unsigned long long timer1_period_ns;
+static unsigned long long timer1_next_compare_ns;
+static boolean is_timer1_pending;
+static unsigned long timer1_interrupts;
+
+static const uint8_t PORTB_FIRST_PIN = 8;   /* PB0 to PB5: pins 8 to 13. */
+static const uint8_t PORTB_LAST_PIN = 13;
+static boolean is_pcint0_pending;
+static uint8_t portb_latch;
+static unsigned long pcint0_interrupts;
+
+static const uint8_t NO_TONE_PIN = 0xFF;
+static uint8_t tone_pin = NO_TONE_PIN;
+static unsigned int tone_frequency;
+
+static unsigned long long slept_ns;
+static unsigned long sleeps;
+
+/******************************************************************************/
+
+
+static unsigned long timer1_prescaler(uint8_t clock_select)
+{
+    switch (clock_select)
+    {
+        case 1:
+            return 1;
+        case 2:
+            return 8;
+        case 3:
+            return 64;
+        case 4:
+            return 256;
+        case 5:
+            return 1024;
+        default:
+            return 0; /* Stopped, or external clock (not simulated). */
+    }
+}
+
+
+static void update_timer1_configuration()
+{
+    if ((TCCR1B == timer1_tccr1b) && (OCR1A == timer1_ocr1a)
+        && (TIMSK1 == timer1_timsk1))
+    {
+        return;
+    }
+    
+    timer1_tccr1b = TCCR1B;
+    timer1_ocr1a = OCR1A;
+    timer1_timsk1 = TIMSK1;
+    
+    unsigned long prescaler = timer1_prescaler(timer1_tccr1b & 0x07);
+    
+    if ((prescaler == 0)
+        || ((timer1_tccr1b & (1 << WGM12)) == 0)
+        || ((timer1_timsk1 & (1 << OCIE1A)) == 0)
+        || (TIMER1_COMPA_vect == 0))
+    {
+        timer1_period_ns = 0;
+        return;
+    }
+    
+    timer1_period_ns = ((timer1_ocr1a + 1ULL) * prescaler * SIM_NS_IN_US) 
+                       / SIM_CPU_CYCLES_IN_US;
+    timer1_next_compare_ns = current_time_ns + timer1_period_ns;
+}
+
+
+/*
+* Executes the pending and enabled interrupts, in the priority order of the
+* AVR vector table (PCINT0 before TIMER1_COMPA), and returns the simulated
+* time spent on them.
+*/
+static unsigned long long serve_pending_interrupt()
+{
+    unsigned long long interrupt_start_ns = current_time_ns;
+    
+    while ((are_interrupts_enabled == true) && (is_in_interrupt == false))
+    {
+        /* Flags cleared when the vector is executed. */
+        is_in_interrupt = true;
+        
+        if ((is_pcint0_pending == true) && ((PCICR & (1 << PCIE0)) != 0)
+            && (PCINT0_vect != 0))
+        {
+            is_pcint0_pending = false;
+            PCINT0_vect();
+            pcint0_interrupts++;
+            has_interrupt_run = true;
+        }
+        else if (is_timer1_pending == true)
+        {
+            is_timer1_pending = false;
+            TIMER1_COMPA_vect();
+            timer1_interrupts++;
+            has_interrupt_run = true;
+        }
+        else
+        {
+            is_in_interrupt = false;
+            break;
+        }
+        
+        is_in_interrupt = false;
+        update_timer1_configuration();
+    }
+    
+    return current_time_ns - interrupt_start_ns;
+}
+
+
+static unsigned long long next_event_ns()
+{
+    unsigned long long event_ns = NO_EVENT_NS;
+    
+    if (timer1_period_ns != 0)
+    {
+        event_ns = timer1_next_compare_ns;
+    }
+    
+    if ((pin_events.empty() == false) 
+        && (pin_events.begin()->first < event_ns))
+    {
+        event_ns = pin_events.begin()->first;
+    }
+    
+    return event_ns;
+}
+
+
+/*
+* Executes all the events of the given time: first the pin changes (in
+* the order they were scheduled), then the Timer1 compare match.
+*/
+static void process_events(unsigned long long event_ns)
+{
+    while ((pin_events.empty() == false) 
+           && (pin_events.begin()->first == event_ns))
+    {
+        sim_set_pin_level(pin_events.begin()->second.pin, 
+                          pin_events.begin()->second.level);
+        pin_events.erase(pin_events.begin());
+    }
+    
+    if ((timer1_period_ns != 0) && (timer1_next_compare_ns == event_ns))
+    {
+        timer1_next_compare_ns = timer1_next_compare_ns + timer1_period_ns;
+        is_timer1_pending = true;
+    }
+}
+
+
+/*
+* Discrete event simulation: the clock jumps from event to event, so the
+* cost does not depend on the simulated time but on the number of events.
+* The interrupts triggered while they are disabled (or while other interrupt
+* is executed) are executed when they are enabled again. As in the AVR, only
+* one is kept pending: the interrupt flag is set or not. When the code is
+* executed by the CPU (is_cpu_busy), the time spent in an interrupt delays
+* it; when it waits for a time (delay), it does not.
+*/
+static void advance_to_ns(unsigned long long target_ns, boolean is_cpu_busy)
+{
+    update_timer1_configuration();
+    
+    for (;;)
+    {
+        unsigned long long interrupt_ns = serve_pending_interrupt();
+        
+        if (is_cpu_busy == true)
+        {
+            target_ns = target_ns + interrupt_ns;
+        }
+        
+        unsigned long long event_ns = next_event_ns();
+        
+        if (event_ns > target_ns)
+        {
+            break;
+        }
+        
+        if (current_time_ns < event_ns)
+        {
+            current_time_ns = event_ns;
+        }
+        
+        process_events(event_ns);
+    }
+    
+    if (current_time_ns < target_ns)
+    {
+        current_time_ns = target_ns;
+    }
+}
+
+
+void sim_advance_ns(unsigned long long duration_ns)
+{
+    advance_to_ns(current_time_ns + duration_ns, true);
+}
+
+
+void sim_wait_until_ns(unsigned long long time_ns)
+{
+    advance_to_ns(time_ns, false);
+}
+
+
+/*
+* Advances the clock to the next event, or to limit_ns if it is earlier.
+*/
+void sim_idle_until_ns(unsigned long long limit_ns)
+{
+    unsigned long long event_ns;
+    
+    update_timer1_configuration();
+    
+    event_ns = next_event_ns();
+    if (event_ns > limit_ns)
+    {
+        event_ns = limit_ns;
+    }
+    
+    sim_wait_until_ns(event_ns);
+}
+
+
+/*
+* A loop without calls to the Arduino core (i.e: the main loop without
+* button events) does the same until the next interrupt, so the clock jumps
+* to it. Otherwise, the overhead of the loop is added.
+*/
+void sim_finish_loop(unsigned long long loop_start_ns, 
+                     unsigned long long limit_ns)
+{
+    if (current_time_ns == loop_start_ns)
+    {
+        sim_idle_until_ns(limit_ns);
+    }
+    else
+    {
+        sim_advance_ns(SIM_LOOP_OVERHEAD_NS);
+    }
+}
+
+
+/*
+* The sleep instruction (idle mode): the clock jumps from event to event 
+* until one triggers an enabled interrupt, which wakes the CPU and is 
+* executed. As in the AVR, the instruction after sei() is executed before a
+* pending interrupt, so "cli(); <check>; sei(); sleep_cpu();" never misses
+* an event: here sei() has executed it, and the CPU does not sleep if an
+* interrupt has run since the last cli(). Without the sleep enable bit, or
+* without events (nothing would wake the CPU), it does nothing.
+*/
+void sleep_cpu()
+{
+    unsigned long long sleep_start_ns = current_time_ns;
+    unsigned long long event_ns;
+    unsigned long long sleep_ns;
+    
+    if (((SMCR & (1 << SE)) == 0) || (has_interrupt_run == true))
+    {
+        return;
+    }
+    
+    update_timer1_configuration();
+    
+    while ((is_timer1_pending == false)
+           && ((is_pcint0_pending == false) || ((PCICR & (1 << PCIE0)) == 0)
+               || (PCINT0_vect == 0)))
+    {
+        event_ns = next_event_ns();
+        
+        if (event_ns == NO_EVENT_NS)
+        {
+            break;
+        }
+        
+        if (current_time_ns < event_ns)
+        {
+            current_time_ns = event_ns;
+        }
+        
+        process_events(event_ns);
+    }
+    
+    sleep_ns = current_time_ns - sleep_start_ns;
+    
+    if (sleep_ns > SIM_WAKE_UP_NS)
+    {
+        slept_ns = slept_ns + (sleep_ns - SIM_WAKE_UP_NS);
+        sleeps++;
+    }
+    
+    sim_advance_ns(0); /* The interrupt that wakes the CPU. */
+}
+
+
+void sim_schedule_pin_level(uint8_t pin, int level, unsigned long long time_ns)
+{
+    PinEvent event;
+    
+    event.pin = pin;
+    event.level = level;
+    
+    if (time_ns < current_time_ns)
+    {
+        time_ns = current_time_ns; /* The past can not be changed. */
+    }
+    
+    pin_events.insert(std::make_pair(time_ns, event));
+}
+
+
+unsigned int sim_scheduled_pin_events()
+{
+    return pin_events.size();
+}
+
+
+unsigned long long sim_time_ns()
+{
+    return current_time_ns;
+}
+
+
+void sim_reset()
+{
+    current_time_ns = 0;
+    are_interrupts_enabled = true;
+    is_in_interrupt = false;
+    has_interrupt_run = false;
+    
+    for (int pin = 0; pin < NUM_DIGITAL_PINS; pin++)
+    {
+        pin_levels[pin] = LOW;
+        pin_modes[pin] = INPUT;
+    }
+    
+    TCCR1A = 0;
+    TCCR1B = 0;
+    TCNT1 = 0;
+    OCR1A = 0;
+    TIMSK1 = 0;
+    timer1_tccr1b = 0;
+    timer1_ocr1a = 0;
+    timer1_timsk1 = 0;
+    timer1_period_ns = 0;
+    timer1_next_compare_ns = 0;
+    is_timer1_pending = false;
+    timer1_interrupts = 0;
+    
+    PCICR = 0;
+    PCMSK0 = 0;
+    is_pcint0_pending = false;
+    portb_latch = 0;
+    pcint0_interrupts = 0;
+    
+    SMCR = 0;
+    slept_ns = 0;
+    sleeps = 0;
+    
+    tone_pin = NO_TONE_PIN;
+    tone_frequency = 0;
+    
+    pin_events.clear();
+    pin_listener = 0;
+}
+
+
+int sim_pin_level(uint8_t pin)
+{
+    return (pin < NUM_DIGITAL_PINS) ? pin_levels[pin] : LOW;
+}
+
+
+int sim_pin_mode(uint8_t pin)
+{
+    return (pin < NUM_DIGITAL_PINS) ? pin_modes[pin] : INPUT;
+}
+
+
+void sim_set_pin_level(uint8_t pin, int level)
+{
+    if (pin < NUM_DIGITAL_PINS)
+    {
+        uint8_t old_level = pin_levels[pin];
+        
+        pin_levels[pin] = (level == LOW) ? LOW : HIGH;
+        
+        if (pin_levels[pin] == old_level)
+        {
+            return;
+        }
+        
+        /* Served at the next advance of the clock. */
+        if ((pin >= PORTB_FIRST_PIN) && (pin <= PORTB_LAST_PIN)
+            && ((PCMSK0 & (1 << (pin - PORTB_FIRST_PIN))) != 0)
+            && ((PCICR & (1 << PCIE0)) != 0))
+        {
+            is_pcint0_pending = true;
+        }
+        
+        if (pin_listener != 0)
+        {
+            pin_listener(pin, pin_levels[pin], current_time_ns);
+        }
+    }
+}
+
+
+void sim_set_pin_listener(SimPinListener listener)
+{
+    pin_listener = listener;
+}
+
+
+unsigned int sim_tone_frequency()
+{
+    return tone_frequency;
+}
+
+
+uint8_t sim_tone_pin()
+{
+    return tone_pin;
+}
+
+
+unsigned long long sim_timer1_period_ns()
+{
+    update_timer1_configuration();
+    return timer1_period_ns;
+}
+
+
+unsigned long sim_timer1_interrupts()
+{
+    return timer1_interrupts;
+}
+
+
+unsigned long sim_pin_change_interrupts()
+{
+    return pcint0_interrupts;
+}
+
+
+unsigned long long sim_sleep_ns()
+{
+    return slept_ns;
+}
+
+
+unsigned long sim_sleeps()
+{
+    return sleeps;
+}
+
+
+unsigned long long sim_run_time_limit_ns()
+{
+    unsigned long run_time_ms = SIM_DEFAULT_RUN_TIME_MS;
+    const char *run_time_text = getenv("BEETHDUINO_SIM_RUN_TIME_MS");
+    
+    if (run_time_text != 0)
+    {
+        run_time_ms = strtoul(run_time_text, 0, 10);
+    }
+    
+    return run_time_ms * SIM_NS_IN_MS;
+}
+
+/******************************************************************************/
+
+
+/*
+* As the Arduino core, Timer1 is configured for the PWM of pins 9 and 10
+* (phase correct, 8 bits, prescaler 64); this is why the sketches configure
+* their Timer1 mode in setup(), and not in the global constructors.
+*/
+void init()
+{
+    TCCR1A = (1 << WGM10);
+    TCCR1B = (1 << CS11) | (1 << CS10);
+    
+    sei();
+}
+
+
+void cli()
+{
+    are_interrupts_enabled = false;
+    has_interrupt_run = false;
+}
+
+
+void sei()
+{
+    are_interrupts_enabled = true;
+    sim_advance_ns(0); /* Pending interrupt. */
+}
+
+
+/*
+* In the tests, the button pins are configured as OUTPUT and written by the
+* test itself; so the level written is the level read, in any pin mode.
+*/
+void pinMode(uint8_t pin, uint8_t mode)
+{
+    sim_advance_ns(SIM_PIN_MODE_NS);
+    
+    if (pin < NUM_DIGITAL_PINS)
+    {
+        pin_modes[pin] = mode;
+        if (mode == INPUT_PULLUP)
+        {
+            pin_levels[pin] = HIGH;
+        }
+    }
+}
+
+
+/*
+* As in the Arduino core, the pins of the port B are written through PORTB.
+*/
+void digitalWrite(uint8_t pin, uint8_t value)
+{
+    sim_advance_ns(SIM_DIGITAL_WRITE_NS);
+    
+    if ((pin >= PORTB_FIRST_PIN) && (pin <= PORTB_LAST_PIN))
+    {
+        portb_latch = (value == LOW) 
+                      ? (portb_latch & ~(1 << (pin - PORTB_FIRST_PIN)))
+                      : (portb_latch | (1 << (pin - PORTB_FIRST_PIN)));
+    }
+    
+    sim_set_pin_level(pin, value);
+    sim_advance_ns(0); /* Pin change interrupt. */
+}
+
+
+/*
+* The tone (square wave of Timer2 in the Arduino core) is simulated by its
+* envelope: the pin is HIGH while it sounds, and LOW at its end (a pin 
+* event), so the pin listener records it as a pulse. As in the core, one 
+* tone sounds at a time: a tone in other pin is ignored while one sounds.
+*/
+void tone(uint8_t pin, unsigned int frequency, unsigned long duration)
+{
+    sim_advance_ns(SIM_TONE_NS);
+    
+    if ((pin >= NUM_DIGITAL_PINS) 
+        || ((tone_pin != NO_TONE_PIN) && (tone_pin != pin) 
+            && (pin_levels[tone_pin] == HIGH)))
+    {
+        return;
+    }
+    
+    tone_pin = pin;
+    tone_frequency = frequency;
+    sim_set_pin_level(pin, HIGH);
+    
+    if (duration != 0)
+    {
+        sim_schedule_pin_level(pin, LOW, 
+                               current_time_ns + (duration * SIM_NS_IN_MS));
+    }
+}
+
+
+void noTone(uint8_t pin)
+{
+    sim_advance_ns(SIM_DIGITAL_WRITE_NS);
+    
+    if (pin == tone_pin)
+    {
+        sim_set_pin_level(pin, LOW);
+        tone_pin = NO_TONE_PIN;
+        tone_frequency = 0;
+    }
+}
+
+
+int digitalRead(uint8_t pin)
+{
+    sim_advance_ns(SIM_DIGITAL_READ_NS);
+    return sim_pin_level(pin);
+}
+
+
+/*
+* PB6 and PB7 are the crystal pins of the Arduino UNO: always read as 0.
+*/
+uint8_t sim_read_pinb()
+{
+    uint8_t port_levels = 0;
+    
+    sim_advance_ns(SIM_PORT_READ_NS);
+    
+    for (uint8_t pin = PORTB_FIRST_PIN; pin <= PORTB_LAST_PIN; pin++)
+    {
+        if (pin_levels[pin] == HIGH)
+        {
+            port_levels = port_levels | (1 << (pin - PORTB_FIRST_PIN));
+        }
+    }
+    
+    return port_levels;
+}
+
+
+uint8_t sim_read_portb()
+{
+    return portb_latch;
+}
+
+
+/*
+* Only the pins of the changed bits are driven, so the button pins written
+* by the tests are not overwritten.
+*/
+void sim_write_portb(uint8_t levels)
+{
+    uint8_t changed_bits = levels ^ portb_latch;
+    
+    sim_advance_ns(SIM_PORT_WRITE_NS);
+    portb_latch = levels;
+    
+    for (uint8_t pin = PORTB_FIRST_PIN; pin <= PORTB_LAST_PIN; pin++)
+    {
+        if ((changed_bits & (1 << (pin - PORTB_FIRST_PIN))) != 0)
+        {
+            sim_set_pin_level(pin, 
+                ((levels & (1 << (pin - PORTB_FIRST_PIN))) != 0) ? HIGH : LOW);
+        }
+    }
+    
+    sim_advance_ns(0); /* Pin change interrupt. */
+}
+
+
+unsigned long millis()
+{
+    return (unsigned long) (current_time_ns / SIM_NS_IN_MS);
+}
+
+
+unsigned long micros()
+{
+    return (unsigned long) (current_time_ns / SIM_NS_IN_US);
+}
+
+
+/*
+* delay() counts the time with micros(), so the interrupts do not extend it;
+* delayMicroseconds() counts CPU cycles, so they do.
+*/
+void delay(unsigned long ms)
+{
+    sim_wait_until_ns(current_time_ns + (ms * SIM_NS_IN_MS));
+}
+
+
+void delayMicroseconds(unsigned int us)
+{
+    sim_advance_ns(us * SIM_NS_IN_US);
+}
@@ -0,0 +1,110 @@
+/*******************************************************************************
+*   Project:        Beethduino, an Arduino Do-it-yourself electronic metronome.
+*
+*   File:           Arduino_simulator.h
+*
+*   Description:    Host (PC) simulation of the Arduino UNO. The simulated
+*                   time is kept in a virtual clock, in nanoseconds, that only
+*                   advances when the sketch calls the Arduino core: every
+*                   call costs the time it takes in the ATmega328
+*                   (sim_advance_ns), and delay() advances the clock without
+*                   waiting (sim_wait_until_ns). The Timer1 compare
+*                   interrupt (CTC mode), the pin changes scheduled by the
+*                   tests (i.e: button pressings) and the pin change
+*                   interrupts they trigger are executed at their exact
+*                   simulated time. The clock jumps from event to event, so
+*                   the tests run thousands of times faster than in the
+*                   board, and always with the same timing.
+*                   The time the CPU sleeps (sleep_cpu) is counted, for the
+*                   estimation of the energy: the CPU is active the rest of
+*                   the time (a main loop that spins is always active).
+*
+*   Language:       C++ (host, g++).
+*
+*   Dependencies:   Arduino.h
+*
+*   Notes:          BPM - Beats Per Minute.
+*                   LCD - Liquid Crystal Display.
+*                   The costs are approximations of the Arduino IDE 1.6.13
+*                   core at 16 MHz; they shall be updated if the core is
+*                   changed.
+*
+*   Author:         Alberto Martin Cajal
+*                   amartin.glimpse23@gmail.com
+*                   amartin<DOT>glimpse23<AT>gmail<DOT>.com
+*
+*   License:        GNU GPL v3.0
+*
+*   URL:            https://github.com/amcajal/beethduino
+*
+*******************************************************************************/
+
+#ifndef Arduino_simulator_h
+#define Arduino_simulator_h
+
+#include "Arduino.h"
+
+const unsigned long long SIM_NS_IN_US           = 1000ULL;
+const unsigned long long SIM_NS_IN_MS           = 1000000ULL;
+const unsigned long long SIM_NS_IN_S            = 1000000000ULL;
+
+const unsigned long long SIM_CPU_CYCLES_IN_US   = 16;  /* 16 MHz. */
+
+/* Cost of the Arduino core calls (about 56 CPU cycles each). */
+const unsigned long long SIM_DIGITAL_READ_NS    = 3500;
+const unsigned long long SIM_DIGITAL_WRITE_NS   = 3500;
+const unsigned long long SIM_PIN_MODE_NS        = 4000;
+const unsigned long long SIM_TONE_NS            = 20000;  /*  Prescaler and 
+                                                          *   compare value of
+                                                          *   Timer2 (32-bit
+                                                          *   divisions).
+                                                          */
+const unsigned long long SIM_PORT_READ_NS       = 63;   /* One "in" (1 cycle). */
+const unsigned long long SIM_PORT_WRITE_NS      = 125;  /* One "sbi" (2 cycles). */
+const unsigned long long SIM_LOOP_OVERHEAD_NS   = 500;  /* main() of the core. */
+const unsigned long long SIM_WAKE_UP_NS         = 4000; /*  Wake-up and the 
+                                                        *   interrupt that 
+                                                        *   wakes the CPU 
+                                                        *   (not advanced in
+                                                        *   the clock: only 
+                                                        *   counted as active
+                                                        *   time).
+                                                        */
+
+/* Simulated time of a sketch, if BEETHDUINO_SIM_RUN_TIME_MS is not set. */
+const unsigned long SIM_DEFAULT_RUN_TIME_MS     = 60000;
+
+unsigned long long sim_time_ns();
+void sim_advance_ns(unsigned long long duration_ns);
+void sim_wait_until_ns(unsigned long long time_ns);
+void sim_idle_until_ns(unsigned long long limit_ns);
+void sim_finish_loop(unsigned long long loop_start_ns, 
+                     unsigned long long limit_ns);
+void sim_reset();
+
+int sim_pin_level(uint8_t pin);
+int sim_pin_mode(uint8_t pin);
+void sim_set_pin_level(uint8_t pin, int level);
+void sim_schedule_pin_level(uint8_t pin, int level, unsigned long long time_ns);
+
+/* Called every time a pin changes its level (i.e: to record the beats). */
+typedef void (*SimPinListener)(uint8_t pin, int level, 
+                               unsigned long long time_ns);
+void sim_set_pin_listener(SimPinListener listener);
+unsigned int sim_scheduled_pin_events();
+
+/* Frequency of the last tone() (0 after noTone()), and its pin. */
+unsigned int sim_tone_frequency();
+uint8_t sim_tone_pin();
+
+unsigned long long sim_timer1_period_ns();
+unsigned long sim_timer1_interrupts();
+unsigned long sim_pin_change_interrupts();
+
+/* Energy accounting: time slept (without the wake-ups), and sleeps. */
+unsigned long long sim_sleep_ns();
+unsigned long sim_sleeps();
+
+unsigned long long sim_run_time_limit_ns();
+
+#endif
@@ -0,0 +1,92 @@
+/*******************************************************************************
+*   Project:        Beethduino, an Arduino Do-it-yourself electronic metronome.
+*
+*   File:           HardwareSerial.cpp
+*
+*   Description:    Body file of the host (PC) Serial object.
+*
+*   Language:       C++ (host, g++).
+*
+*   Dependencies:   stdio.h
+*                   Arduino_simulator.h
+*                   HardwareSerial.h
+*
+*   Notes:          None.
+*
+*   Author:         Alberto Martin Cajal
+*                   amartin.glimpse23@gmail.com
+*                   amartin<DOT>glimpse23<AT>gmail<DOT>.com
+*
+*   License:        GNU GPL v3.0
+*
+*   URL:            https://github.com/amcajal/beethduino
+*
+*******************************************************************************/
+
+#include <stdio.h>
+
+#include "Arduino_simulator.h"
+#include "HardwareSerial.h"
+
+HardwareSerial Serial;
+
+void HardwareSerial::begin(unsigned long baud)
+{
+    byte_duration_ns = (BITS_PER_BYTE * SIM_NS_IN_S) / baud;
+    line_busy_until_ns = sim_time_ns();
+}
+
+
+void HardwareSerial::end()
+{
+    flush();
+    byte_duration_ns = 0;
+}
+
+
+int HardwareSerial::available()
+{
+    return 0;
+}
+
+
+int HardwareSerial::read()
+{
+    return -1;
+}
+
+
+void HardwareSerial::flush()
+{
+    if (line_busy_until_ns > sim_time_ns())
+    {
+        sim_advance_ns(line_busy_until_ns - sim_time_ns());
+    }
+    
+    fflush(stdout);
+}
+
+
+size_t HardwareSerial::write(uint8_t value)
+{
+    if (byte_duration_ns != 0)
+    {
+        unsigned long long full_buffer_ns 
+            = TX_BUFFER_SIZE * byte_duration_ns;
+        
+        /* Wait until there is space in the buffer. */
+        if (line_busy_until_ns > sim_time_ns() + full_buffer_ns)
+        {
+            sim_advance_ns(line_busy_until_ns - full_buffer_ns - sim_time_ns());
+        }
+        
+        if (line_busy_until_ns < sim_time_ns())
+        {
+            line_busy_until_ns = sim_time_ns();
+        }
+        line_busy_until_ns = line_busy_until_ns + byte_duration_ns;
+    }
+    
+    putchar(value);
+    return 1;
+}
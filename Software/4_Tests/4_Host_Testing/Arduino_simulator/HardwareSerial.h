@@ -0,0 +1,66 @@
+/*******************************************************************************
+*   Project:        Beethduino, an Arduino Do-it-yourself electronic metronome.
+*
+*   File:           HardwareSerial.h
+*
+*   Description:    Host (PC) replacement of the Arduino Serial object. The
+*                   bytes are printed in the standard output of the PC, and
+*                   the transmission is simulated in the virtual clock: the
+*                   bytes are queued in a 64 bytes buffer, emptied at the
+*                   configured baud rate; write waits when the buffer is full
+*                   and flush waits until the last byte is sent.
+*
+*   Language:       C++ (host, g++).
+*
+*   Dependencies:   Print.h
+*
+*   Notes:          Only the transmission is simulated; nothing is received.
+*
+*   Author:         Alberto Martin Cajal
+*                   amartin.glimpse23@gmail.com
+*                   amartin<DOT>glimpse23<AT>gmail<DOT>.com
+*
+*   License:        GNU GPL v3.0
+*
+*   URL:            https://github.com/amcajal/beethduino
+*
+*******************************************************************************/
+
+#ifndef HardwareSerial_h
+#define HardwareSerial_h
+
+#include "Print.h"
+
+class HardwareSerial : public Print
+{
+    public:
+        static const unsigned int TX_BUFFER_SIZE = 64;
+        static const unsigned int BITS_PER_BYTE  = 10; /* Start, 8, stop. */
+        
+        constexpr HardwareSerial()
+            : byte_duration_ns(0), line_busy_until_ns(0)
+        {
+        }
+        
+        void begin(unsigned long baud);
+        void end();
+        int available();
+        int read();
+        void flush();
+        
+        virtual size_t write(uint8_t value);
+        using Print::write;
+        
+        operator bool()
+        {
+            return true;
+        }
+        
+    private:
+        unsigned long long byte_duration_ns;
+        unsigned long long line_busy_until_ns;
+};
+
+extern HardwareSerial Serial;
+
+#endif
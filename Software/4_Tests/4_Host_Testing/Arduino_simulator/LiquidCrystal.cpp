@@ -0,0 +1,178 @@
+/*******************************************************************************
+*   Project:        Beethduino, an Arduino Do-it-yourself electronic metronome.
+*
+*   File:           LiquidCrystal.cpp
+*
+*   Description:    Body file of the host (PC) LiquidCrystal library.
+*
+*   Language:       C++ (host, g++).
+*
+*   Dependencies:   Arduino_simulator.h
+*                   LiquidCrystal.h
+*
+*   Notes:          LCD - Liquid Crystal Display.
+*
+*   Author:         Alberto Martin Cajal
+*                   amartin.glimpse23@gmail.com
+*                   amartin<DOT>glimpse23<AT>gmail<DOT>.com
+*
+*   License:        GNU GPL v3.0
+*
+*   URL:            https://github.com/amcajal/beethduino
+*
+*******************************************************************************/
+
+#include "Arduino_simulator.h"
+#include "LiquidCrystal.h"
+
+/* Cost of one nibble: 7 digitalWrite (4 data, 3 enable) and the delays
+*  of pulseEnable (1 + 1 + 100 microseconds).
+*/
+static const unsigned long long NIBBLE_NS 
+    = (7 * SIM_DIGITAL_WRITE_NS) + (102 * SIM_NS_IN_US);
+
+/* One byte: RS pin and two nibbles. */
+static const unsigned long long BYTE_NS 
+    = SIM_DIGITAL_WRITE_NS + (2 * NIBBLE_NS);
+
+static const unsigned long long CLEAR_DELAY_NS      = 2000 * SIM_NS_IN_US;
+static const unsigned long long POWER_UP_DELAY_NS   = 50000 * SIM_NS_IN_US;
+static const unsigned long long INIT_DELAY_NS       = 4500 * SIM_NS_IN_US;
+static const unsigned long long LAST_INIT_DELAY_NS  = 150 * SIM_NS_IN_US;
+
+static const uint8_t ROW_OFFSETS[4] = {0x00, 0x40, 0x14, 0x54};
+
+
+void LiquidCrystal::begin(uint8_t cols, uint8_t lines, uint8_t dotsize)
+{
+    (void) dotsize;
+    
+    columns = (cols < MAX_COLUMNS) ? cols : MAX_COLUMNS;
+    rows = (lines < 4) ? lines : 4;
+    
+    /* Pins configuration, and initialization by instruction (three 
+    *  nibbles, and the one that selects the 4 bits mode).
+    */
+    sim_advance_ns((3 + 4) * SIM_PIN_MODE_NS);
+    sim_advance_ns(POWER_UP_DELAY_NS);
+    sim_advance_ns(NIBBLE_NS + INIT_DELAY_NS);
+    sim_advance_ns(NIBBLE_NS + INIT_DELAY_NS);
+    sim_advance_ns(NIBBLE_NS + LAST_INIT_DELAY_NS);
+    sim_advance_ns(NIBBLE_NS);
+    
+    command(LCD_FUNCTIONSET | ((rows > 1) ? 0x08 : 0x00));
+    command(LCD_DISPLAYCONTROL | 0x04);
+    clear();
+    command(LCD_ENTRYMODESET | 0x02);
+}
+
+
+void LiquidCrystal::clear()
+{
+    command(LCD_CLEARDISPLAY);
+    sim_advance_ns(CLEAR_DELAY_NS);
+}
+
+
+void LiquidCrystal::home()
+{
+    command(LCD_RETURNHOME);
+    sim_advance_ns(CLEAR_DELAY_NS);
+}
+
+
+void LiquidCrystal::setCursor(uint8_t col, uint8_t row)
+{
+    if ((rows > 0) && (row >= rows))
+    {
+        row = rows - 1;
+    }
+    
+    command(LCD_SETDDRAMADDR | (col + row_address(row)));
+}
+
+
+void LiquidCrystal::command(uint8_t value)
+{
+    send(value, false);
+}
+
+
+size_t LiquidCrystal::write(uint8_t value)
+{
+    send(value, true);
+    return 1;
+}
+
+
+void LiquidCrystal::sim_read_row(uint8_t row, char *text) const
+{
+    uint8_t column;
+    
+    for (column = 0; column < columns; column++)
+    {
+        char character = display_memory[(row_address(row) + column) 
+                                        % DDRAM_SIZE];
+        text[column] = (character == '\0') ? ' ' : character;
+    }
+    
+    text[column] = '\0';
+}
+
+
+unsigned long LiquidCrystal::sim_bytes_sent() const
+{
+    return bytes_sent;
+}
+
+
+void LiquidCrystal::send(uint8_t value, bool is_data)
+{
+    sim_advance_ns(BYTE_NS);
+    bytes_sent++;
+    
+    if (is_data == true)
+    {
+        display_memory[address_counter] = (char) value;
+        address_counter = (address_counter + 1) % DDRAM_SIZE;
+    }
+    else
+    {
+        execute_command(value);
+    }
+}
+
+
+/*
+* Only the commands used by the LiquidCrystal library are simulated; the
+* display is always on, and the entry mode always "left to right".
+*/
+void LiquidCrystal::execute_command(uint8_t value)
+{
+    if ((value & LCD_SETDDRAMADDR) != 0)
+    {
+        address_counter = value & (DDRAM_SIZE - 1);
+    }
+    else if (value == LCD_CLEARDISPLAY)
+    {
+        for (uint8_t address = 0; address < DDRAM_SIZE; address++)
+        {
+            display_memory[address] = ' ';
+        }
+        address_counter = 0;
+    }
+    else if ((value & 0xFE) == LCD_RETURNHOME)
+    {
+        address_counter = 0;
+    }
+    else
+    {
+        /* No operation. */
+    }
+}
+
+
+uint8_t LiquidCrystal::row_address(uint8_t row) const
+{
+    return ROW_OFFSETS[row % 4];
+}
@@ -0,0 +1,96 @@
+/*******************************************************************************
+*   Project:        Beethduino, an Arduino Do-it-yourself electronic metronome.
+*
+*   File:           LiquidCrystal.h
+*
+*   Description:    Host (PC) replacement of the Arduino LiquidCrystal library
+*                   (HD44780 controller in 4 bits mode). The commands and the
+*                   characters are executed in a model of the display memory
+*                   of the controller, so the tests can read the text shown
+*                   in the LCD, and every byte costs in the virtual clock the
+*                   same time than in the board.
+*
+*   Language:       C++ (host, g++).
+*
+*   Dependencies:   stdint.h
+*                   Print.h
+*
+*   Notes:          LCD - Liquid Crystal Display.
+*                   Costs of the LiquidCrystal library of the Arduino IDE
+*                   1.6.13: every byte is sent in two nibbles, each one with
+*                   7 digitalWrite and 102 microseconds of delays; clear and
+*                   home wait 2 additional milliseconds.
+*
+*   Author:         Alberto Martin Cajal
+*                   amartin.glimpse23@gmail.com
+*                   amartin<DOT>glimpse23<AT>gmail<DOT>.com
+*
+*   License:        GNU GPL v3.0
+*
+*   URL:            https://github.com/amcajal/beethduino
+*
+*******************************************************************************/
+
+#ifndef LiquidCrystal_h
+#define LiquidCrystal_h
+
+#include <stdint.h>
+
+#include "Print.h"
+
+#define LCD_CLEARDISPLAY    0x01
+#define LCD_RETURNHOME      0x02
+#define LCD_ENTRYMODESET    0x04
+#define LCD_DISPLAYCONTROL  0x08
+#define LCD_CURSORSHIFT     0x10
+#define LCD_FUNCTIONSET     0x20
+#define LCD_SETCGRAMADDR    0x40
+#define LCD_SETDDRAMADDR    0x80
+
+class LiquidCrystal : public Print
+{
+    public:
+        static const uint8_t DDRAM_SIZE = 0x80;
+        static const uint8_t MAX_COLUMNS = 40;
+        
+        constexpr LiquidCrystal(uint8_t rs, uint8_t enable, 
+                                uint8_t d0, uint8_t d1, 
+                                uint8_t d2, uint8_t d3)
+            : rs_pin(rs), enable_pin(enable), 
+              data_pins{d0, d1, d2, d3}, 
+              columns(0), rows(0), address_counter(0),
+              display_memory{}, bytes_sent(0)
+        {
+        }
+        
+        void begin(uint8_t cols, uint8_t lines, uint8_t dotsize = 0);
+        void clear();
+        void home();
+        void setCursor(uint8_t col, uint8_t row);
+        void command(uint8_t value);
+        
+        virtual size_t write(uint8_t value);
+        using Print::write;
+        
+        /* Simulator only: text shown in a row, and bytes sent to the LCD. */
+        void sim_read_row(uint8_t row, char *text) const;
+        unsigned long sim_bytes_sent() const;
+        
+    private:
+        void send(uint8_t value, bool is_data);
+        void execute_command(uint8_t value);
+        uint8_t row_address(uint8_t row) const;
+        
+        uint8_t rs_pin;
+        uint8_t enable_pin;
+        uint8_t data_pins[4];
+        
+        uint8_t columns;
+        uint8_t rows;
+        uint8_t address_counter;
+        char display_memory[DDRAM_SIZE];
+        
+        unsigned long bytes_sent;
+};
+
+#endif
@@ -0,0 +1,199 @@
+/*******************************************************************************
+*   Project:        Beethduino, an Arduino Do-it-yourself electronic metronome.
+*
+*   File:           Print.cpp
+*
+*   Description:    Body file of the host (PC) Print class.
+*
+*   Language:       C++ (host, g++).
+*
+*   Dependencies:   stdio.h
+*                   Print.h
+*                   WString.h
+*
+*   Notes:          None.
+*
+*   Author:         Alberto Martin Cajal
+*                   amartin.glimpse23@gmail.com
+*                   amartin<DOT>glimpse23<AT>gmail<DOT>.com
+*
+*   License:        GNU GPL v3.0
+*
+*   URL:            https://github.com/amcajal/beethduino
+*
+*******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "Print.h"
+#include "WString.h"
+
+size_t Print::write(const char *text)
+{
+    if (text == 0)
+    {
+        return 0;
+    }
+    
+    return write((const uint8_t *) text, strlen(text));
+}
+
+
+size_t Print::write(const uint8_t *buffer, size_t size)
+{
+    size_t written = 0;
+    
+    while (written < size)
+    {
+        written = written + write(buffer[written]);
+    }
+    
+    return written;
+}
+
+
+size_t Print::print(const char text[])
+{
+    return write(text);
+}
+
+
+size_t Print::print(char value)
+{
+    return write((uint8_t) value);
+}
+
+
+size_t Print::print(const String &text)
+{
+    return write((const uint8_t *) text.c_str(), text.length());
+}
+
+
+size_t Print::print(unsigned char value, int base)
+{
+    return print((unsigned long) value, base);
+}
+
+
+size_t Print::print(int value, int base)
+{
+    return print((long) value, base);
+}
+
+
+size_t Print::print(unsigned int value, int base)
+{
+    return print((unsigned long) value, base);
+}
+
+
+size_t Print::print(long value, int base)
+{
+    if ((base == DEC) && (value < 0))
+    {
+        return print('-') + print_number(0UL - (unsigned long) value, DEC);
+    }
+    
+    return print_number((unsigned long) value, base);
+}
+
+
+size_t Print::print(unsigned long value, int base)
+{
+    return print_number(value, base);
+}
+
+
+size_t Print::print(double value, int digits)
+{
+    char text[64];
+    
+    snprintf(text, sizeof(text), "%.*f", digits, value);
+    return write(text);
+}
+
+
+size_t Print::println(const char text[])
+{
+    return print(text) + println();
+}
+
+
+size_t Print::println(char value)
+{
+    return print(value) + println();
+}
+
+
+size_t Print::println(const String &text)
+{
+    return print(text) + println();
+}
+
+
+size_t Print::println(unsigned char value, int base)
+{
+    return print(value, base) + println();
+}
+
+
+size_t Print::println(int value, int base)
+{
+    return print(value, base) + println();
+}
+
+
+size_t Print::println(unsigned int value, int base)
+{
+    return print(value, base) + println();
+}
+
+
+size_t Print::println(long value, int base)
+{
+    return print(value, base) + println();
+}
+
+
+size_t Print::println(unsigned long value, int base)
+{
+    return print(value, base) + println();
+}
+
+
+size_t Print::println(double value, int digits)
+{
+    return print(value, digits) + println();
+}
+
+
+size_t Print::println()
+{
+    return write("\r\n");
+}
+
+
+size_t Print::print_number(unsigned long value, int base)
+{
+    char text[8 * sizeof(unsigned long) + 1];
+    char *digit = &text[sizeof(text) - 1];
+    
+    if (base < 2)
+    {
+        base = DEC;
+    }
+    
+    *digit = '\0';
+    do
+    {
+        unsigned long remainder = value % base;
+        value = value / base;
+        
+        digit--;
+        *digit = (remainder < 10) ? ('0' + remainder) : ('A' + remainder - 10);
+    } while (value != 0);
+    
+    return write(digit);
+}
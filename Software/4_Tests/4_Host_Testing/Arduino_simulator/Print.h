@@ -0,0 +1,76 @@
+/*******************************************************************************
+*   Project:        Beethduino, an Arduino Do-it-yourself electronic metronome.
+*
+*   File:           Print.h
+*
+*   Description:    Host (PC) replacement of the Arduino Print class, base of
+*                   Serial and LiquidCrystal: converts texts and numbers into
+*                   bytes, sent with the write method of the derived class.
+*
+*   Language:       C++ (host, g++).
+*
+*   Dependencies:   stddef.h
+*                   stdint.h
+*
+*   Notes:          The constructor is constexpr, so the objects derived from
+*                   Print are initialized before any global constructor
+*                   (the Beethduino constructor writes in the LCD).
+*
+*   Author:         Alberto Martin Cajal
+*                   amartin.glimpse23@gmail.com
+*                   amartin<DOT>glimpse23<AT>gmail<DOT>.com
+*
+*   License:        GNU GPL v3.0
+*
+*   URL:            https://github.com/amcajal/beethduino
+*
+*******************************************************************************/
+
+#ifndef Print_h
+#define Print_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+class String;
+
+class Print
+{
+    public:
+        constexpr Print() {}
+        
+        virtual size_t write(uint8_t value) = 0;
+        size_t write(const char *text);
+        size_t write(const uint8_t *buffer, size_t size);
+        
+        size_t print(const char text[]);
+        size_t print(char value);
+        size_t print(const String &text);
+        size_t print(unsigned char value, int base = DEC);
+        size_t print(int value, int base = DEC);
+        size_t print(unsigned int value, int base = DEC);
+        size_t print(long value, int base = DEC);
+        size_t print(unsigned long value, int base = DEC);
+        size_t print(double value, int digits = 2);
+        
+        size_t println(const char text[]);
+        size_t println(char value);
+        size_t println(const String &text);
+        size_t println(unsigned char value, int base = DEC);
+        size_t println(int value, int base = DEC);
+        size_t println(unsigned int value, int base = DEC);
+        size_t println(long value, int base = DEC);
+        size_t println(unsigned long value, int base = DEC);
+        size_t println(double value, int digits = 2);
+        size_t println();
+        
+    private:
+        size_t print_number(unsigned long value, int base);
+};
+
+#endif
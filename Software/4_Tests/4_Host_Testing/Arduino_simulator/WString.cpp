@@ -0,0 +1,188 @@
+/*******************************************************************************
+*   Project:        Beethduino, an Arduino Do-it-yourself electronic metronome.
+*
+*   File:           WString.cpp
+*
+*   Description:    Body file of the host (PC) String class.
+*
+*   Language:       C++ (host, g++).
+*
+*   Dependencies:   stdio.h
+*                   WString.h
+*
+*   Notes:          None.
+*
+*   Author:         Alberto Martin Cajal
+*                   amartin.glimpse23@gmail.com
+*                   amartin<DOT>glimpse23<AT>gmail<DOT>.com
+*
+*   License:        GNU GPL v3.0
+*
+*   URL:            https://github.com/amcajal/beethduino
+*
+*******************************************************************************/
+
+#include <stdio.h>
+
+#include "WString.h"
+
+static std::string number_to_text(unsigned long value, bool is_negative,
+                                  unsigned char base)
+{
+    char text[8 * sizeof(unsigned long) + 2];
+    char *digit = &text[sizeof(text) - 1];
+    
+    if (base < 2)
+    {
+        base = 10;
+    }
+    
+    *digit = '\0';
+    do
+    {
+        unsigned long remainder = value % base;
+        value = value / base;
+        
+        digit--;
+        *digit = (remainder < 10) ? ('0' + remainder) : ('a' + remainder - 10);
+    } while (value != 0);
+    
+    if (is_negative == true)
+    {
+        digit--;
+        *digit = '-';
+    }
+    
+    return std::string(digit);
+}
+
+
+static std::string signed_to_text(long value, unsigned char base)
+{
+    if ((base == 10) && (value < 0))
+    {
+        return number_to_text(0UL - (unsigned long) value, true, base);
+    }
+    
+    return number_to_text((unsigned long) value, false, base);
+}
+
+
+String::String(const char *text)
+    : text_buffer((text != 0) ? text : "")
+{
+}
+
+
+String::String(char value)
+    : text_buffer(1, value)
+{
+}
+
+
+String::String(int value, unsigned char base)
+    : text_buffer(signed_to_text(value, base))
+{
+}
+
+
+String::String(unsigned int value, unsigned char base)
+    : text_buffer(number_to_text(value, false, base))
+{
+}
+
+
+String::String(long value, unsigned char base)
+    : text_buffer(signed_to_text(value, base))
+{
+}
+
+
+String::String(unsigned long value, unsigned char base)
+    : text_buffer(number_to_text(value, false, base))
+{
+}
+
+
+String &String::operator=(const char *text)
+{
+    text_buffer = (text != 0) ? text : "";
+    return *this;
+}
+
+
+unsigned char String::concat(const String &text)
+{
+    text_buffer.append(text.text_buffer);
+    return 1;
+}
+
+
+unsigned char String::concat(const char *text)
+{
+    if (text == 0)
+    {
+        return 0;
+    }
+    
+    text_buffer.append(text);
+    return 1;
+}
+
+
+unsigned char String::concat(char value)
+{
+    text_buffer.push_back(value);
+    return 1;
+}
+
+
+unsigned char String::concat(int value)
+{
+    text_buffer.append(signed_to_text(value, 10));
+    return 1;
+}
+
+
+unsigned char String::concat(unsigned int value)
+{
+    text_buffer.append(number_to_text(value, false, 10));
+    return 1;
+}
+
+
+unsigned char String::concat(long value)
+{
+    text_buffer.append(signed_to_text(value, 10));
+    return 1;
+}
+
+
+unsigned char String::concat(unsigned long value)
+{
+    text_buffer.append(number_to_text(value, false, 10));
+    return 1;
+}
+
+
+unsigned char String::equals(const String &text) const
+{
+    return text_buffer == text.text_buffer;
+}
+
+
+unsigned char String::equals(const char *text) const
+{
+    return text_buffer == ((text != 0) ? text : "");
+}
+
+
+char String::charAt(unsigned int index) const
+{
+    if (index >= text_buffer.length())
+    {
+        return '\0';
+    }
+    
+    return text_buffer[index];
+}
@@ -0,0 +1,97 @@
+/*******************************************************************************
+*   Project:        Beethduino, an Arduino Do-it-yourself electronic metronome.
+*
+*   File:           WString.h
+*
+*   Description:    Host (PC) replacement of the Arduino String class, with
+*                   the constructors, concatenations and comparisons used
+*                   by Beethduino and its tests.
+*
+*   Language:       C++ (host, g++).
+*
+*   Dependencies:   string
+*
+*   Notes:          The text is kept in a std::string; as in the board, it is
+*                   stored in the heap.
+*
+*   Author:         Alberto Martin Cajal
+*                   amartin.glimpse23@gmail.com
+*                   amartin<DOT>glimpse23<AT>gmail<DOT>.com
+*
+*   License:        GNU GPL v3.0
+*
+*   URL:            https://github.com/amcajal/beethduino
+*
+*******************************************************************************/
+
+#ifndef WString_h
+#define WString_h
+
+#include <string>
+
+class String
+{
+    public:
+        String(const char *text = "");
+        String(char value);
+        String(int value, unsigned char base = 10);
+        String(unsigned int value, unsigned char base = 10);
+        String(long value, unsigned char base = 10);
+        String(unsigned long value, unsigned char base = 10);
+        
+        String &operator=(const char *text);
+        
+        unsigned char concat(const String &text);
+        unsigned char concat(const char *text);
+        unsigned char concat(char value);
+        unsigned char concat(int value);
+        unsigned char concat(unsigned int value);
+        unsigned char concat(long value);
+        unsigned char concat(unsigned long value);
+        
+        template <typename T>
+        String &operator+=(const T &value)
+        {
+            concat(value);
+            return *this;
+        }
+        
+        unsigned char equals(const String &text) const;
+        unsigned char equals(const char *text) const;
+        unsigned char operator==(const String &text) const
+        {
+            return equals(text);
+        }
+        unsigned char operator==(const char *text) const
+        {
+            return equals(text);
+        }
+        unsigned char operator!=(const String &text) const
+        {
+            return !equals(text);
+        }
+        unsigned char operator!=(const char *text) const
+        {
+            return !equals(text);
+        }
+        
+        char charAt(unsigned int index) const;
+        char operator[](unsigned int index) const
+        {
+            return charAt(index);
+        }
+        
+        unsigned int length() const
+        {
+            return text_buffer.length();
+        }
+        const char *c_str() const
+        {
+            return text_buffer.c_str();
+        }
+        
+    private:
+        std::string text_buffer;
+};
+
+#endif
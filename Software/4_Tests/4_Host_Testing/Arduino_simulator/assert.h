@@ -0,0 +1,46 @@
+/*******************************************************************************
+*   Project:        Beethduino, an Arduino Do-it-yourself electronic metronome.
+*
+*   File:           assert.h
+*
+*   Description:    Host (PC) replacement of the avr-libc assert.h. As in the
+*                   board, when __ASSERT_USE_STDERR is defined a failed
+*                   assertion calls the __assert function of the test (which
+*                   prints TEST_FAILED in the serial monitor); otherwise the
+*                   program is aborted.
+*
+*   Language:       C++ (host, g++).
+*
+*   Dependencies:   stdlib.h
+*
+*   Notes:          It shall be found before the assert.h of the host, so
+*                   the Arduino_simulator folder is the first include path
+*                   of the sketches.
+*
+*   Author:         Alberto Martin Cajal
+*                   amartin.glimpse23@gmail.com
+*                   amartin<DOT>glimpse23<AT>gmail<DOT>.com
+*
+*   License:        GNU GPL v3.0
+*
+*   URL:            https://github.com/amcajal/beethduino
+*
+*******************************************************************************/
+
+/* No include guard: assert.h can be included again after changing NDEBUG. */
+
+#include <stdlib.h>
+
+#undef assert
+
+#if defined(NDEBUG)
+#   define assert(e)    ((void) 0)
+#elif defined(__ASSERT_USE_STDERR)
+#   define assert(e)    ((e) ? (void) 0 \
+                             : __assert(__func__, __FILE__, __LINE__, #e))
+#else
+#   define assert(e)    ((e) ? (void) 0 : abort())
+#endif
+
+void __assert(const char *__func, const char *__file,
+              int __lineno, const char *__sexp);
@@ -0,0 +1,38 @@
+/*******************************************************************************
+*   Project:        Beethduino, an Arduino Do-it-yourself electronic metronome.
+*
+*   File:           avr/interrupt.h
+*
+*   Description:    Host (PC) replacement of the avr-libc interrupt.h. An ISR
+*                   is a plain function, called by the simulator when its
+*                   interrupt is triggered in the virtual clock. cli() and
+*                   sei() disable and enable the simulated interrupts.
+*
+*   Language:       C++ (host, g++).
+*
+*   Dependencies:   None.
+*
+*   Notes:          The vectors are weak: a sketch without ISR is valid.
+*
+*   Author:         Alberto Martin Cajal
+*                   amartin.glimpse23@gmail.com
+*                   amartin<DOT>glimpse23<AT>gmail<DOT>.com
+*
+*   License:        GNU GPL v3.0
+*
+*   URL:            https://github.com/amcajal/beethduino
+*
+*******************************************************************************/
+
+#ifndef avr_interrupt_h
+#define avr_interrupt_h
+
+#define ISR(vector)     extern "C" void vector(void)
+
+extern "C" void PCINT0_vect(void) __attribute__((weak));
+extern "C" void TIMER1_COMPA_vect(void) __attribute__((weak));
+
+void cli();
+void sei();
+
+#endif
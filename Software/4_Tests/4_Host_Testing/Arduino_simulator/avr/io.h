@@ -0,0 +1,139 @@
+/*******************************************************************************
+*   Project:        Beethduino, an Arduino Do-it-yourself electronic metronome.
+*
+*   File:           avr/io.h
+*
+*   Description:    Host (PC) replacement of the avr-libc io.h. The Timer1
+*                   and pin change interrupt registers of the ATmega328 are
+*                   plain variables, read by the simulator every time the
+*                   virtual clock advances or a pin changes. PINB (input
+*                   pins of the port B) is read from the simulated pins;
+*                   PORTB (output latch of the port B) drives the simulated
+*                   pins of the changed bits, as digitalWrite does.
+*                   SMCR (sleep mode control) is read by sleep_cpu().
+*
+*   Language:       C++ (host, g++).
+*
+*   Dependencies:   stdint.h
+*
+*   Notes:          Only the Timer1 CTC mode with the compare A interrupt,
+*                   and the pin change interrupt 0 (port B, digital pins 8
+*                   to 13), are simulated (the ones used by Beethduino).
+*
+*   Author:         Alberto Martin Cajal
+*                   amartin.glimpse23@gmail.com
+*                   amartin<DOT>glimpse23<AT>gmail<DOT>.com
+*
+*   License:        GNU GPL v3.0
+*
+*   URL:            https://github.com/amcajal/beethduino
+*
+*******************************************************************************/
+
+#ifndef avr_io_h
+#define avr_io_h
+
+#include <stdint.h>
+
+extern volatile uint8_t  TCCR1A;
+extern volatile uint8_t  TCCR1B;
+extern volatile uint16_t TCNT1;
+extern volatile uint16_t OCR1A;
+extern volatile uint8_t  TIMSK1;
+extern volatile uint8_t  PCICR;
+extern volatile uint8_t  PCMSK0;
+extern volatile uint8_t  SMCR;
+
+uint8_t sim_read_pinb();
+#define PINB    (sim_read_pinb())
+
+uint8_t sim_read_portb();
+void sim_write_portb(uint8_t levels);
+
+class SimPortB
+{
+    public:
+        operator uint8_t() const
+        {
+            return sim_read_portb();
+        }
+        
+        SimPortB &operator=(uint8_t levels)
+        {
+            sim_write_portb(levels);
+            return *this;
+        }
+        
+        SimPortB &operator|=(uint8_t bits)
+        {
+            sim_write_portb(sim_read_portb() | bits);
+            return *this;
+        }
+        
+        SimPortB &operator&=(uint8_t bits)
+        {
+            sim_write_portb(sim_read_portb() & bits);
+            return *this;
+        }
+};
+
+extern SimPortB PORTB;
+
+/* TCCR1A */
+#define WGM10   0
+#define WGM11   1
+
+/* TCCR1B */
+#define CS10    0
+#define CS11    1
+#define CS12    2
+#define WGM12   3
+#define WGM13   4
+
+/* TIMSK1 */
+#define TOIE1   0
+#define OCIE1A  1
+#define OCIE1B  2
+
+/* PINB (PB0 to PB5 are the digital pins 8 to 13) */
+#define PINB0   0
+#define PINB1   1
+#define PINB2   2
+#define PINB3   3
+#define PINB4   4
+#define PINB5   5
+#define PINB6   6
+#define PINB7   7
+
+/* PORTB */
+#define PORTB0  0
+#define PORTB1  1
+#define PORTB2  2
+#define PORTB3  3
+#define PORTB4  4
+#define PORTB5  5
+#define PORTB6  6
+#define PORTB7  7
+
+/* PCICR */
+#define PCIE0   0
+#define PCIE1   1
+#define PCIE2   2
+
+/* PCMSK0 (PCINT0 to PCINT5 are the digital pins 8 to 13) */
+#define PCINT0  0
+#define PCINT1  1
+#define PCINT2  2
+#define PCINT3  3
+#define PCINT4  4
+#define PCINT5  5
+#define PCINT6  6
+#define PCINT7  7
+
+/* SMCR */
+#define SE      0
+#define SM0     1
+#define SM1     2
+#define SM2     3
+
+#endif
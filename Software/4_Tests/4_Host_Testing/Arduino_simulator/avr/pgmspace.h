@@ -0,0 +1,36 @@
+/*******************************************************************************
+*   Project:        Beethduino, an Arduino Do-it-yourself electronic metronome.
+*
+*   File:           avr/pgmspace.h
+*
+*   Description:    Host (PC) replacement of the avr-libc pgmspace.h. The PC
+*                   has no separated flash memory, so PROGMEM data is stored
+*                   in the normal memory and read directly.
+*
+*   Language:       C++ (host, g++).
+*
+*   Dependencies:   None.
+*
+*   Notes:          None.
+*
+*   Author:         Alberto Martin Cajal
+*                   amartin.glimpse23@gmail.com
+*                   amartin<DOT>glimpse23<AT>gmail<DOT>.com
+*
+*   License:        GNU GPL v3.0
+*
+*   URL:            https://github.com/amcajal/beethduino
+*
+*******************************************************************************/
+
+#ifndef avr_pgmspace_h
+#define avr_pgmspace_h
+
+#define PROGMEM
+
+#define pgm_read_byte(address)  (*(address))
+#define pgm_read_word(address)  (*(address))
+#define pgm_read_dword(address) (*(address))
+#define pgm_read_ptr(address)   ((void *) *(address))
+
+#endif
@@ -0,0 +1,50 @@
+/*******************************************************************************
+*   Project:        Beethduino, an Arduino Do-it-yourself electronic metronome.
+*
+*   File:           avr/sleep.h
+*
+*   Description:    Host (PC) replacement of the avr-libc sleep.h. The sleep
+*                   mode and the sleep enable bit are written in SMCR, as
+*                   in the AVR; sleep_cpu() (the sleep instruction) jumps
+*                   the virtual clock to the interrupt that wakes the CPU,
+*                   and the simulator counts the time it sleeps.
+*
+*   Language:       C++ (host, g++).
+*
+*   Dependencies:   avr/io.h
+*
+*   Notes:          Only the idle mode is simulated (the one used by
+*                   Beethduino): the Timer1 and the pin change interrupts
+*                   wake the CPU. In the other modes Timer1 is stopped in
+*                   the AVR, and it is not here.
+*
+*   Author:         Alberto Martin Cajal
+*                   amartin.glimpse23@gmail.com
+*                   amartin<DOT>glimpse23<AT>gmail<DOT>.com
+*
+*   License:        GNU GPL v3.0
+*
+*   URL:            https://github.com/amcajal/beethduino
+*
+*******************************************************************************/
+
+#ifndef avr_sleep_h
+#define avr_sleep_h
+
+#include "avr/io.h"
+
+#define SLEEP_MODE_IDLE         0
+#define SLEEP_MODE_ADC          (1 << SM0)
+#define SLEEP_MODE_PWR_DOWN     (1 << SM1)
+#define SLEEP_MODE_PWR_SAVE     ((1 << SM0) | (1 << SM1))
+#define SLEEP_MODE_STANDBY      ((1 << SM1) | (1 << SM2))
+#define SLEEP_MODE_EXT_STANDBY  ((1 << SM0) | (1 << SM1) | (1 << SM2))
+
+#define set_sleep_mode(mode)    \
+    (SMCR = (SMCR & ~((1 << SM0) | (1 << SM1) | (1 << SM2))) | (mode))
+#define sleep_enable()          (SMCR = SMCR | (1 << SE))
+#define sleep_disable()         (SMCR = SMCR & ~(1 << SE))
+
+void sleep_cpu();
+
+#endif
@@ -0,0 +1,69 @@
+/*******************************************************************************
+*   Project:        Beethduino, an Arduino Do-it-yourself electronic metronome.
+*
+*   File:           main.cpp
+*
+*   Description:    Host (PC) replacement of the main function of the Arduino
+*                   core: executes init() and setup() once, and loop() until
+*                   the simulated run time is reached (environment variable
+*                   BEETHDUINO_SIM_RUN_TIME_MS, or SIM_DEFAULT_RUN_TIME_MS).
+*                   At the end, reports the simulated and the real elapsed
+*                   time, and the estimated fraction of the simulated time
+*                   the CPU has been active (not sleeping).
+*
+*   Language:       C++ (host, g++).
+*
+*   Dependencies:   stdio.h
+*                   chrono
+*                   Arduino_simulator.h
+*
+*   Notes:          None.
+*
+*   Author:         Alberto Martin Cajal
+*                   amartin.glimpse23@gmail.com
+*                   amartin<DOT>glimpse23<AT>gmail<DOT>.com
+*
+*   License:        GNU GPL v3.0
+*
+*   URL:            https://github.com/amcajal/beethduino
+*
+*******************************************************************************/
+
+#include <stdio.h>
+#include <chrono>
+
+#include "Arduino_simulator.h"
+
+int main()
+{
+    std::chrono::steady_clock::time_point start 
+        = std::chrono::steady_clock::now();
+    unsigned long long run_time_limit_ns = sim_run_time_limit_ns();
+    
+    init();
+    setup();
+    
+    do
+    {
+        unsigned long long loop_start_ns = sim_time_ns();
+        
+        loop();
+        sim_finish_loop(loop_start_ns, run_time_limit_ns);
+    } while (sim_time_ns() < run_time_limit_ns);
+    
+    Serial.flush();
+    
+    std::chrono::duration<double> elapsed 
+        = std::chrono::steady_clock::now() - start;
+    double simulated_s = (double) sim_time_ns() / SIM_NS_IN_S;
+    
+    printf("\nSIMULATION FINISHED: %.3f s simulated in %.3f s "
+           "(%.0f times faster than real time)\n",
+           simulated_s, elapsed.count(), 
+           simulated_s / elapsed.count());
+    printf("CPU ACTIVE: %.2f %% of the simulated time (%lu sleeps)\n",
+           100.0 * (1.0 - ((double) sim_sleep_ns() / sim_time_ns())),
+           sim_sleeps());
+    
+    return 0;
+}
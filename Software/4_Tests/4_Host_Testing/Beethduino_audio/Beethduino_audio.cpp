@@ -0,0 +1,261 @@
+/*******************************************************************************
+*   Project:        Beethduino, an Arduino Do-it-yourself electronic metronome.
+*
+*   File:           Beethduino_audio.cpp
+*
+*   Description:    Body file of the host (PC) audio engine of Beethduino.
+*
+*   Language:       C++ (host, g++).
+*
+*   Dependencies:   string.h
+*                   Beethduino_audio.h
+*
+*   Notes:          BPM - Beats Per Minute.
+*                   PCM - Pulse Code Modulation.
+*                   WAV - RIFF file with PCM samples (little endian).
+*
+*   Author:         Alberto Martin Cajal
+*                   amartin.glimpse23@gmail.com
+*                   amartin<DOT>glimpse23<AT>gmail<DOT>.com
+*
+*   License:        GNU GPL v3.0
+*
+*   URL:            https://github.com/amcajal/beethduino
+*
+*******************************************************************************/
+
+#include <string.h>
+
+#include "Beethduino_audio.h"
+
+static const unsigned long US_IN_SECOND = 1000000;
+static const unsigned long WAV_MAX_DATA_BYTES = 0xFFFFFFFFUL - 36;
+static const unsigned int WRITE_CHUNK_SAMPLES = 4096;
+
+static void write_le16(FILE *output, uint16_t value);
+static void write_le32(FILE *output, uint32_t value);
+
+
+BeethduinoAudio::BeethduinoAudio(Beethduino &metronome,
+                                 unsigned long sample_rate,
+                                 const AudioKernels *kernels)
+    : metronome(metronome), sample_rate(sample_rate), kernels(kernels)
+{
+    synthesize_click();
+
+    start_tick              = 0;
+    rendered_samples        = 0;
+    next_click_sample       = 0;
+    active_click_count      = 0;
+    rendered_clicks         = 0;
+}
+
+
+/**
+* Unmutes the metronome (the first beat is one period later, as when the
+* buzzer button is pressed) and starts the PCM stream at the current tick.
+*/
+void BeethduinoAudio::start()
+{
+    if (metronome.is_buzzer_muted == true)
+    {
+        metronome.change_mute_state();
+    }
+
+    start_tick = metronome.timer_ticks;
+    rendered_samples = 0;
+    active_click_count = 0;
+    rendered_clicks = 0;
+    next_click_sample = tick_to_sample(metronome.beat_deadline_tick);
+}
+
+
+/**
+* Renders the next count samples. The clicks that start in the block are
+* taken from the beat schedule; the ones that started in a previous block
+* and still sound are kept in active_clicks, so a click is the same for any
+* size of the blocks.
+*/
+void BeethduinoAudio::render(int16_t *samples, unsigned long count)
+{
+    unsigned long long block_end = rendered_samples + count;
+    byte click;
+    byte kept_clicks;
+
+    memset(samples, 0, count * sizeof(samples[0]));
+
+    while (next_click_sample < block_end)
+    {
+        if (active_click_count < MAX_ACTIVE_CLICKS)
+        {
+            active_clicks[active_click_count] = next_click_sample;
+            active_click_count++;
+            rendered_clicks++;
+        }
+
+        schedule_next_click();
+    }
+
+    kept_clicks = 0;
+
+    for (click = 0; click < active_click_count; click++)
+    {
+        mix_click(samples, count, active_clicks[click]);
+
+        if ((active_clicks[click] + click_samples) > block_end)
+        {
+            active_clicks[kept_clicks] = active_clicks[click];
+            kept_clicks++;
+        }
+    }
+
+    active_click_count = kept_clicks;
+    rendered_samples = block_end;
+}
+
+
+/**
+* Nearest sample of a tick (millisecond), counted from the start tick.
+*/
+unsigned long long BeethduinoAudio::tick_to_sample(unsigned long tick)
+{
+    unsigned long long elapsed_ticks = tick - start_tick;
+
+    return ((elapsed_ticks * sample_rate) + (MILLISECONDS_IN_SECOND / 2))
+           / MILLISECONDS_IN_SECOND;
+}
+
+
+/**
+* Same call than the Timer1 interrupt when a beat is played: the next
+* deadline, with the accumulated fraction of tick.
+*/
+void BeethduinoAudio::schedule_next_click()
+{
+    metronome.schedule_next_beat();
+    next_click_sample = tick_to_sample(metronome.beat_deadline_tick);
+}
+
+
+/**
+* Adds the part of the click that falls in the block, with saturation.
+*/
+void BeethduinoAudio::mix_click(int16_t *samples, unsigned long count,
+                                unsigned long long click_start)
+{
+    unsigned long long first_sample = click_start;
+    unsigned long long last_sample = click_start + click_samples;
+
+    if (first_sample < rendered_samples)
+    {
+        first_sample = rendered_samples;
+    }
+
+    if (last_sample > (rendered_samples + count))
+    {
+        last_sample = rendered_samples + count;
+    }
+
+    if (first_sample < last_sample)
+    {
+        kernels->mix_pcm(&samples[first_sample - rendered_samples],
+                         &click[first_sample - click_start],
+                         last_sample - first_sample);
+    }
+}
+
+
+/**
+* Sine burst with linear attack and release ramps of CLICK_RAMP_US.
+*/
+void BeethduinoAudio::synthesize_click()
+{
+    float wave[MAX_CLICK_SAMPLES];
+    unsigned int ramp_samples;
+
+    click_samples = (Beethduino::SOUND_DURATION * sample_rate)
+                    / MILLISECONDS_IN_SECOND;
+    ramp_samples = (CLICK_RAMP_US * sample_rate) / US_IN_SECOND;
+
+    kernels->synthesize_sine(wave, click_samples,
+                             (float) CLICK_FREQUENCY / sample_rate,
+                             CLICK_AMPLITUDE);
+    kernels->apply_envelope(wave, ramp_samples, 0.0f, 1.0f / ramp_samples);
+    kernels->apply_envelope(&wave[click_samples - ramp_samples], ramp_samples,
+                            1.0f, -1.0f / ramp_samples);
+    kernels->convert_to_pcm(click, wave, click_samples);
+}
+
+
+/**
+* Canonical 44 bytes header (PCM, mono, 16 bits). The sizes of a stream
+* longer than the 4 GB of the format are saturated, as most tools do.
+*/
+void BeethduinoAudio::write_wav_header(FILE *output, unsigned long sample_rate,
+                                       unsigned long long samples)
+{
+    unsigned long long data_bytes = samples * sizeof(int16_t);
+
+    if (data_bytes > WAV_MAX_DATA_BYTES)
+    {
+        data_bytes = WAV_MAX_DATA_BYTES;
+    }
+
+    fwrite("RIFF", 1, 4, output);
+    write_le32(output, 36 + data_bytes);
+    fwrite("WAVE", 1, 4, output);
+
+    fwrite("fmt ", 1, 4, output);
+    write_le32(output, 16);                         /* Size of the chunk. */
+    write_le16(output, 1);                          /* PCM. */
+    write_le16(output, 1);                          /* Mono. */
+    write_le32(output, sample_rate);
+    write_le32(output, sample_rate * sizeof(int16_t)); /* Bytes per second. */
+    write_le16(output, sizeof(int16_t));            /* Bytes per sample. */
+    write_le16(output, 16);                         /* Bits per sample. */
+
+    fwrite("data", 1, 4, output);
+    write_le32(output, data_bytes);
+}
+
+
+void BeethduinoAudio::write_samples(FILE *output, const int16_t *samples,
+                                    unsigned long count)
+{
+    uint8_t bytes[WRITE_CHUNK_SAMPLES * sizeof(int16_t)];
+    unsigned long sample;
+    unsigned int chunk_sample;
+
+    for (sample = 0; sample < count; sample += WRITE_CHUNK_SAMPLES)
+    {
+        for (chunk_sample = 0; (chunk_sample < WRITE_CHUNK_SAMPLES)
+             && ((sample + chunk_sample) < count); chunk_sample++)
+        {
+            uint16_t value = (uint16_t) samples[sample + chunk_sample];
+
+            bytes[2 * chunk_sample] = value & 0xFF;
+            bytes[(2 * chunk_sample) + 1] = value >> 8;
+        }
+
+        fwrite(bytes, sizeof(int16_t), chunk_sample, output);
+    }
+}
+
+
+static void write_le16(FILE *output, uint16_t value)
+{
+    uint8_t bytes[2] = {(uint8_t) (value & 0xFF), (uint8_t) (value >> 8)};
+
+    fwrite(bytes, 1, sizeof(bytes), output);
+}
+
+
+static void write_le32(FILE *output, uint32_t value)
+{
+    uint8_t bytes[4] = {(uint8_t) (value & 0xFF),
+                        (uint8_t) ((value >> 8) & 0xFF),
+                        (uint8_t) ((value >> 16) & 0xFF),
+                        (uint8_t) (value >> 24)};
+
+    fwrite(bytes, 1, sizeof(bytes), output);
+}
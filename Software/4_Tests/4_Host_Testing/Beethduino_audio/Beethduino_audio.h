@@ -0,0 +1,106 @@
+/*******************************************************************************
+*   Project:        Beethduino, an Arduino Do-it-yourself electronic metronome.
+*
+*   File:           Beethduino_audio.h
+*
+*   Description:    Host (PC) audio engine of Beethduino. Renders the beats of
+*                   the Beethduino library into a PCM buffer (16 bits, mono),
+*                   at 44.1 or 48 KHz, and writes it as a WAV file or as raw
+*                   samples (to a file or to the standard output).
+*                   The beat deadlines are obtained from the library itself
+*                   (calculate_required_iterations and schedule_next_beat,
+*                   the same arithmetic executed in the Timer1 interrupt),
+*                   and every click is placed at the sample of its deadline:
+*                   the result does not depend on the main loop timing, nor
+*                   on the size of the rendered blocks.
+*                   The click is synthesized, and mixed in the blocks, with
+*                   the fastest kernels (scalar, SSE2 or AVX2) supported by
+*                   the CPU (Beethduino_audio_kernels.h).
+*
+*   Language:       C++ (host, g++).
+*
+*   Dependencies:   stdint.h
+*                   stdio.h
+*                   Beethduino.h
+*                   Beethduino_audio_kernels.h
+*
+*   Notes:          BPM - Beats Per Minute.
+*                   PCM - Pulse Code Modulation.
+*                   The click is a sine burst of CLICK_FREQUENCY Hz that lasts
+*                   SOUND_DURATION milliseconds (the sound of the buzzer),
+*                   with short attack and release ramps, so there are no
+*                   audible steps.
+*                   A beat at tick t (milliseconds) starts at the sample
+*                   round(t * sample_rate / 1000): exact at 48 KHz, and at
+*                   most half a sample (11 microseconds) away at 44.1 KHz.
+*
+*   Author:         Alberto Martin Cajal
+*                   amartin.glimpse23@gmail.com
+*                   amartin<DOT>glimpse23<AT>gmail<DOT>.com
+*
+*   License:        GNU GPL v3.0
+*
+*   URL:            https://github.com/amcajal/beethduino
+*
+*******************************************************************************/
+
+#ifndef Beethduino_audio_h
+#define Beethduino_audio_h
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "Beethduino.h"
+#include "Beethduino_audio_kernels.h"
+
+class BeethduinoAudio
+{
+    public:
+        /* VARIABLES */
+        static const unsigned long SAMPLE_RATE_44K      = 44100;
+        static const unsigned long SAMPLE_RATE_48K      = 48000;
+        static const unsigned long MILLISECONDS_IN_SECOND = 1000;
+        static const unsigned int CLICK_FREQUENCY       = 2000;  /* In Hz. */
+        static const unsigned int CLICK_RAMP_US         = 1000;
+        static const int16_t CLICK_AMPLITUDE            = 16384; /* -6 dBFS. */
+        static const unsigned int MAX_CLICK_SAMPLES
+            = (Beethduino::SOUND_DURATION * SAMPLE_RATE_48K)
+              / MILLISECONDS_IN_SECOND;
+        static const byte MAX_ACTIVE_CLICKS             = 8;
+        static const byte WAV_HEADER_SIZE               = 44;
+
+        Beethduino &metronome;
+        unsigned long sample_rate;
+        const AudioKernels *kernels;
+
+        int16_t click[MAX_CLICK_SAMPLES];   /* Waveform of one click. */
+        unsigned int click_samples;
+
+        unsigned long start_tick;               /* Tick of the sample 0. */
+        unsigned long long rendered_samples;    /* Start of the next block. */
+        unsigned long long next_click_sample;
+        unsigned long long active_clicks[MAX_ACTIVE_CLICKS]; /* First sample
+                                                            * of the clicks
+                                                            * still sounding.
+                                                            */
+        byte active_click_count;
+        unsigned long rendered_clicks;
+
+        /* METHODS */
+        BeethduinoAudio(Beethduino &metronome, unsigned long sample_rate,
+                        const AudioKernels *kernels = select_audio_kernels());
+        void start();
+        void render(int16_t *samples, unsigned long count);
+        unsigned long long tick_to_sample(unsigned long tick);
+        void schedule_next_click();
+        void mix_click(int16_t *samples, unsigned long count,
+                       unsigned long long click_start);
+        void synthesize_click();
+
+        static void write_wav_header(FILE *output, unsigned long sample_rate,
+                                     unsigned long long samples);
+        static void write_samples(FILE *output, const int16_t *samples,
+                                  unsigned long count);
+};
+
+#endif
@@ -0,0 +1,501 @@
+/*******************************************************************************
+*   Project:        Beethduino, an Arduino Do-it-yourself electronic metronome.
+*
+*   File:           Beethduino_audio_kernels.cpp
+*
+*   Description:    Body file of the sample kernels of the host (PC) audio
+*                   engine of Beethduino (scalar, SSE2 and AVX2 versions).
+*
+*   Language:       C++ (host, g++).
+*                   Compiled with -ffp-contract=off (no fused multiply-adds)
+*                   and -fno-tree-vectorize (the scalar kernels stay scalar,
+*                   so the benchmark compares them with the SIMD ones).
+*
+*   Dependencies:   math.h
+*                   immintrin.h (x86 hosts)
+*                   Beethduino_audio_kernels.h
+*
+*   Notes:          PCM - Pulse Code Modulation.
+*                   SIMD - Single Instruction Multiple Data.
+*                   The SIMD kernels are compiled with the target attribute
+*                   of their instruction set, so the rest of the build does
+*                   not require it; they are executed only if
+*                   __builtin_cpu_supports reports it.
+*                   The samples are loaded and stored unaligned: the buffers
+*                   of the engine are at any offset of a block.
+*
+*   Author:         Alberto Martin Cajal
+*                   amartin.glimpse23@gmail.com
+*                   amartin<DOT>glimpse23<AT>gmail<DOT>.com
+*
+*   License:        GNU GPL v3.0
+*
+*   URL:            https://github.com/amcajal/beethduino
+*
+*******************************************************************************/
+
+#include <math.h>
+
+#include "Beethduino_audio_kernels.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BEETHDUINO_AUDIO_X86
+#include <immintrin.h>
+#endif
+
+static const float TWO_PI       = 6.28318530717958647692f;
+static const float SINE_C3      = -1.0f / 6.0f;
+static const float SINE_C5      = 1.0f / 120.0f;
+static const float SINE_C7      = -1.0f / 5040.0f;
+static const float SINE_C9      = 1.0f / 362880.0f;
+static const float PCM_MAXIMUM  = 32767.0f;
+static const float PCM_MINIMUM  = -32768.0f;
+
+static bool is_always_supported();
+static void scalar_synthesize_sine(float *samples, unsigned long count,
+                                   float cycles_per_sample, float amplitude);
+static void scalar_apply_envelope(float *samples, unsigned long count,
+                                  float start_gain, float gain_step);
+static void scalar_convert_to_pcm(int16_t *samples, const float *wave,
+                                  unsigned long count);
+static void scalar_mix_pcm(int16_t *samples, const int16_t *added_samples,
+                           unsigned long count);
+static inline float sine_of_cycles(float cycles);
+
+#ifdef BEETHDUINO_AUDIO_X86
+static bool is_sse2_supported();
+static void sse2_synthesize_sine(float *samples, unsigned long count,
+                                 float cycles_per_sample, float amplitude);
+static void sse2_apply_envelope(float *samples, unsigned long count,
+                                float start_gain, float gain_step);
+static void sse2_convert_to_pcm(int16_t *samples, const float *wave,
+                                unsigned long count);
+static void sse2_mix_pcm(int16_t *samples, const int16_t *added_samples,
+                         unsigned long count);
+
+static bool is_avx2_supported();
+static void avx2_synthesize_sine(float *samples, unsigned long count,
+                                 float cycles_per_sample, float amplitude);
+static void avx2_apply_envelope(float *samples, unsigned long count,
+                                float start_gain, float gain_step);
+static void avx2_convert_to_pcm(int16_t *samples, const float *wave,
+                                unsigned long count);
+static void avx2_mix_pcm(int16_t *samples, const int16_t *added_samples,
+                         unsigned long count);
+#endif
+
+extern const AudioKernels AUDIO_KERNELS[] = {
+    {"scalar", is_always_supported, scalar_synthesize_sine,
+     scalar_apply_envelope, scalar_convert_to_pcm, scalar_mix_pcm},
+#ifdef BEETHDUINO_AUDIO_X86
+    {"sse2", is_sse2_supported, sse2_synthesize_sine,
+     sse2_apply_envelope, sse2_convert_to_pcm, sse2_mix_pcm},
+    {"avx2", is_avx2_supported, avx2_synthesize_sine,
+     avx2_apply_envelope, avx2_convert_to_pcm, avx2_mix_pcm},
+#endif
+};
+
+extern const int AUDIO_KERNELS_COUNT = sizeof(AUDIO_KERNELS)
+                                       / sizeof(AUDIO_KERNELS[0]);
+
+
+const AudioKernels *select_audio_kernels()
+{
+    int kernels = AUDIO_KERNELS_COUNT - 1;
+
+    while (AUDIO_KERNELS[kernels].is_supported() == false)
+    {
+        kernels--;
+    }
+
+    return &AUDIO_KERNELS[kernels];
+}
+
+
+/******************************************************************************/
+/* SCALAR */
+
+
+static bool is_always_supported()
+{
+    return true;
+}
+
+
+static void scalar_synthesize_sine(float *samples, unsigned long count,
+                                   float cycles_per_sample, float amplitude)
+{
+    unsigned long sample;
+
+    for (sample = 0; sample < count; sample++)
+    {
+        samples[sample] = amplitude
+                          * sine_of_cycles((float) sample * cycles_per_sample);
+    }
+}
+
+
+static void scalar_apply_envelope(float *samples, unsigned long count,
+                                  float start_gain, float gain_step)
+{
+    unsigned long sample;
+
+    for (sample = 0; sample < count; sample++)
+    {
+        samples[sample] = samples[sample]
+                          * (start_gain + ((float) sample * gain_step));
+    }
+}
+
+
+static void scalar_convert_to_pcm(int16_t *samples, const float *wave,
+                                  unsigned long count)
+{
+    unsigned long sample;
+    float value;
+
+    for (sample = 0; sample < count; sample++)
+    {
+        value = wave[sample];
+        value = (value < PCM_MAXIMUM) ? value : PCM_MAXIMUM;
+        value = (value > PCM_MINIMUM) ? value : PCM_MINIMUM;
+
+        samples[sample] = (int16_t) rintf(value);
+    }
+}
+
+
+static void scalar_mix_pcm(int16_t *samples, const int16_t *added_samples,
+                           unsigned long count)
+{
+    unsigned long sample;
+    int mixed_value;
+
+    for (sample = 0; sample < count; sample++)
+    {
+        mixed_value = samples[sample] + added_samples[sample];
+
+        if (mixed_value > INT16_MAX)
+        {
+            mixed_value = INT16_MAX;
+        }
+        else if (mixed_value < INT16_MIN)
+        {
+            mixed_value = INT16_MIN;
+        }
+        else
+        {
+            /* No operation. */
+        }
+
+        samples[sample] = mixed_value;
+    }
+}
+
+
+/**
+* sin(2 * PI * cycles): the cycles are reduced to [-0.5, 0.5], folded to
+* [-0.25, 0.25] (sin(PI - x) = sin(x)) and the polynomial is evaluated by
+* Horner. The SIMD kernels repeat these steps with min and max.
+*/
+static inline float sine_of_cycles(float cycles)
+{
+    float reduced = cycles - rintf(cycles);
+    float folded;
+    float angle;
+    float squared;
+
+    folded = 0.5f - reduced;
+    reduced = (reduced < folded) ? reduced : folded;
+    folded = -0.5f - reduced;
+    reduced = (reduced > folded) ? reduced : folded;
+
+    angle = reduced * TWO_PI;
+    squared = angle * angle;
+
+    return angle * (1.0f + squared * (SINE_C3 + squared * (SINE_C5
+                   + squared * (SINE_C7 + squared * SINE_C9))));
+}
+
+
+#ifdef BEETHDUINO_AUDIO_X86
+/******************************************************************************/
+/* SSE2 (4 floats, 8 samples of 16 bits) */
+
+
+static bool is_sse2_supported()
+{
+    return __builtin_cpu_supports("sse2");
+}
+
+
+__attribute__((target("sse2")))
+static inline __m128 sse2_sine_of_cycles(__m128 cycles)
+{
+    __m128 reduced = _mm_sub_ps(cycles,
+                                _mm_cvtepi32_ps(_mm_cvtps_epi32(cycles)));
+    __m128 angle;
+    __m128 squared;
+    __m128 polynomial;
+
+    reduced = _mm_min_ps(reduced, _mm_sub_ps(_mm_set1_ps(0.5f), reduced));
+    reduced = _mm_max_ps(reduced, _mm_sub_ps(_mm_set1_ps(-0.5f), reduced));
+
+    angle = _mm_mul_ps(reduced, _mm_set1_ps(TWO_PI));
+    squared = _mm_mul_ps(angle, angle);
+
+    polynomial = _mm_add_ps(_mm_set1_ps(SINE_C7),
+                            _mm_mul_ps(squared, _mm_set1_ps(SINE_C9)));
+    polynomial = _mm_add_ps(_mm_set1_ps(SINE_C5),
+                            _mm_mul_ps(squared, polynomial));
+    polynomial = _mm_add_ps(_mm_set1_ps(SINE_C3),
+                            _mm_mul_ps(squared, polynomial));
+    polynomial = _mm_add_ps(_mm_set1_ps(1.0f),
+                            _mm_mul_ps(squared, polynomial));
+
+    return _mm_mul_ps(angle, polynomial);
+}
+
+
+__attribute__((target("sse2")))
+static void sse2_synthesize_sine(float *samples, unsigned long count,
+                                 float cycles_per_sample, float amplitude)
+{
+    __m128 indexes = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+    __m128 step = _mm_set1_ps(cycles_per_sample);
+    __m128 gain = _mm_set1_ps(amplitude);
+    unsigned long sample;
+
+    for (sample = 0; (sample + 4) <= count; sample += 4)
+    {
+        __m128 cycles = _mm_mul_ps(_mm_add_ps(_mm_set1_ps((float) sample),
+                                              indexes), step);
+
+        _mm_storeu_ps(&samples[sample],
+                      _mm_mul_ps(gain, sse2_sine_of_cycles(cycles)));
+    }
+
+    for (; sample < count; sample++)
+    {
+        samples[sample] = amplitude
+                          * sine_of_cycles((float) sample * cycles_per_sample);
+    }
+}
+
+
+__attribute__((target("sse2")))
+static void sse2_apply_envelope(float *samples, unsigned long count,
+                                float start_gain, float gain_step)
+{
+    __m128 indexes = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+    __m128 start = _mm_set1_ps(start_gain);
+    __m128 step = _mm_set1_ps(gain_step);
+    unsigned long sample;
+
+    for (sample = 0; (sample + 4) <= count; sample += 4)
+    {
+        __m128 offsets = _mm_add_ps(_mm_set1_ps((float) sample), indexes);
+        __m128 gain = _mm_add_ps(start, _mm_mul_ps(offsets, step));
+
+        _mm_storeu_ps(&samples[sample],
+                      _mm_mul_ps(_mm_loadu_ps(&samples[sample]), gain));
+    }
+
+    for (; sample < count; sample++)
+    {
+        samples[sample] = samples[sample]
+                          * (start_gain + ((float) sample * gain_step));
+    }
+}
+
+
+__attribute__((target("sse2")))
+static void sse2_convert_to_pcm(int16_t *samples, const float *wave,
+                                unsigned long count)
+{
+    __m128 maximum = _mm_set1_ps(PCM_MAXIMUM);
+    __m128 minimum = _mm_set1_ps(PCM_MINIMUM);
+    unsigned long sample;
+
+    for (sample = 0; (sample + 8) <= count; sample += 8)
+    {
+        __m128 low = _mm_loadu_ps(&wave[sample]);
+        __m128 high = _mm_loadu_ps(&wave[sample + 4]);
+
+        low = _mm_max_ps(_mm_min_ps(low, maximum), minimum);
+        high = _mm_max_ps(_mm_min_ps(high, maximum), minimum);
+
+        _mm_storeu_si128((__m128i *) &samples[sample],
+                         _mm_packs_epi32(_mm_cvtps_epi32(low),
+                                         _mm_cvtps_epi32(high)));
+    }
+
+    scalar_convert_to_pcm(&samples[sample], &wave[sample], count - sample);
+}
+
+
+__attribute__((target("sse2")))
+static void sse2_mix_pcm(int16_t *samples, const int16_t *added_samples,
+                         unsigned long count)
+{
+    unsigned long sample;
+
+    for (sample = 0; (sample + 8) <= count; sample += 8)
+    {
+        __m128i mixed = _mm_adds_epi16(
+            _mm_loadu_si128((const __m128i *) &samples[sample]),
+            _mm_loadu_si128((const __m128i *) &added_samples[sample]));
+
+        _mm_storeu_si128((__m128i *) &samples[sample], mixed);
+    }
+
+    scalar_mix_pcm(&samples[sample], &added_samples[sample], count - sample);
+}
+
+
+/******************************************************************************/
+/* AVX2 (8 floats, 16 samples of 16 bits) */
+
+
+static bool is_avx2_supported()
+{
+    return __builtin_cpu_supports("avx2");
+}
+
+
+__attribute__((target("avx2")))
+static inline __m256 avx2_sine_of_cycles(__m256 cycles)
+{
+    __m256 reduced = _mm256_sub_ps(cycles, _mm256_round_ps(cycles,
+        _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC));
+    __m256 angle;
+    __m256 squared;
+    __m256 polynomial;
+
+    reduced = _mm256_min_ps(reduced,
+                            _mm256_sub_ps(_mm256_set1_ps(0.5f), reduced));
+    reduced = _mm256_max_ps(reduced,
+                            _mm256_sub_ps(_mm256_set1_ps(-0.5f), reduced));
+
+    angle = _mm256_mul_ps(reduced, _mm256_set1_ps(TWO_PI));
+    squared = _mm256_mul_ps(angle, angle);
+
+    polynomial = _mm256_add_ps(_mm256_set1_ps(SINE_C7),
+                               _mm256_mul_ps(squared,
+                                             _mm256_set1_ps(SINE_C9)));
+    polynomial = _mm256_add_ps(_mm256_set1_ps(SINE_C5),
+                               _mm256_mul_ps(squared, polynomial));
+    polynomial = _mm256_add_ps(_mm256_set1_ps(SINE_C3),
+                               _mm256_mul_ps(squared, polynomial));
+    polynomial = _mm256_add_ps(_mm256_set1_ps(1.0f),
+                               _mm256_mul_ps(squared, polynomial));
+
+    return _mm256_mul_ps(angle, polynomial);
+}
+
+
+__attribute__((target("avx2")))
+static void avx2_synthesize_sine(float *samples, unsigned long count,
+                                 float cycles_per_sample, float amplitude)
+{
+    __m256 indexes = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f,
+                                    4.0f, 5.0f, 6.0f, 7.0f);
+    __m256 step = _mm256_set1_ps(cycles_per_sample);
+    __m256 gain = _mm256_set1_ps(amplitude);
+    unsigned long sample;
+
+    for (sample = 0; (sample + 8) <= count; sample += 8)
+    {
+        __m256 cycles = _mm256_mul_ps(
+            _mm256_add_ps(_mm256_set1_ps((float) sample), indexes), step);
+
+        _mm256_storeu_ps(&samples[sample],
+                         _mm256_mul_ps(gain, avx2_sine_of_cycles(cycles)));
+    }
+
+    for (; sample < count; sample++)
+    {
+        samples[sample] = amplitude
+                          * sine_of_cycles((float) sample * cycles_per_sample);
+    }
+}
+
+
+__attribute__((target("avx2")))
+static void avx2_apply_envelope(float *samples, unsigned long count,
+                                float start_gain, float gain_step)
+{
+    __m256 indexes = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f,
+                                    4.0f, 5.0f, 6.0f, 7.0f);
+    __m256 start = _mm256_set1_ps(start_gain);
+    __m256 step = _mm256_set1_ps(gain_step);
+    unsigned long sample;
+
+    for (sample = 0; (sample + 8) <= count; sample += 8)
+    {
+        __m256 offsets = _mm256_add_ps(_mm256_set1_ps((float) sample),
+                                       indexes);
+        __m256 gain = _mm256_add_ps(start, _mm256_mul_ps(offsets, step));
+
+        _mm256_storeu_ps(&samples[sample],
+                         _mm256_mul_ps(_mm256_loadu_ps(&samples[sample]),
+                                       gain));
+    }
+
+    for (; sample < count; sample++)
+    {
+        samples[sample] = samples[sample]
+                          * (start_gain + ((float) sample * gain_step));
+    }
+}
+
+
+/**
+* _mm256_packs_epi32 packs every 128 bits lane apart: the permutation puts
+* the 64 bits quarters back in order.
+*/
+__attribute__((target("avx2")))
+static void avx2_convert_to_pcm(int16_t *samples, const float *wave,
+                                unsigned long count)
+{
+    __m256 maximum = _mm256_set1_ps(PCM_MAXIMUM);
+    __m256 minimum = _mm256_set1_ps(PCM_MINIMUM);
+    unsigned long sample;
+
+    for (sample = 0; (sample + 16) <= count; sample += 16)
+    {
+        __m256 low = _mm256_loadu_ps(&wave[sample]);
+        __m256 high = _mm256_loadu_ps(&wave[sample + 8]);
+        __m256i packed;
+
+        low = _mm256_max_ps(_mm256_min_ps(low, maximum), minimum);
+        high = _mm256_max_ps(_mm256_min_ps(high, maximum), minimum);
+
+        packed = _mm256_packs_epi32(_mm256_cvtps_epi32(low),
+                                    _mm256_cvtps_epi32(high));
+        _mm256_storeu_si256((__m256i *) &samples[sample],
+                            _mm256_permute4x64_epi64(packed, 0xD8));
+    }
+
+    scalar_convert_to_pcm(&samples[sample], &wave[sample], count - sample);
+}
+
+
+__attribute__((target("avx2")))
+static void avx2_mix_pcm(int16_t *samples, const int16_t *added_samples,
+                         unsigned long count)
+{
+    unsigned long sample;
+
+    for (sample = 0; (sample + 16) <= count; sample += 16)
+    {
+        __m256i mixed = _mm256_adds_epi16(
+            _mm256_loadu_si256((const __m256i *) &samples[sample]),
+            _mm256_loadu_si256((const __m256i *) &added_samples[sample]));
+
+        _mm256_storeu_si256((__m256i *) &samples[sample], mixed);
+    }
+
+    scalar_mix_pcm(&samples[sample], &added_samples[sample], count - sample);
+}
+#endif
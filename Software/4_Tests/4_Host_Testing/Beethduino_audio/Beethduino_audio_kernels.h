@@ -0,0 +1,71 @@
+/*******************************************************************************
+*   Project:        Beethduino, an Arduino Do-it-yourself electronic metronome.
+*
+*   File:           Beethduino_audio_kernels.h
+*
+*   Description:    Sample kernels of the host (PC) audio engine of
+*                   Beethduino: oscillator (sine) synthesis, envelope
+*                   application, conversion to PCM and mixing. Every kernel
+*                   is implemented three times: scalar (any host), SSE2 and
+*                   AVX2 (x86 hosts). The SIMD versions are selected at run
+*                   time, only if the CPU supports them.
+*
+*   Language:       C++ (host, g++).
+*
+*   Dependencies:   stdint.h
+*
+*   Notes:          PCM - Pulse Code Modulation.
+*                   The three versions execute the same float operations, in
+*                   the same order, for every sample (there are no fused
+*                   multiply-adds nor approximated reciprocals), so their
+*                   results are identical, bit by bit.
+*                   The sine is a polynomial of degree 9 over a quarter of
+*                   the period (error below 4e-6, a tenth of the 16 bits
+*                   step at full scale).
+*
+*   Author:         Alberto Martin Cajal
+*                   amartin.glimpse23@gmail.com
+*                   amartin<DOT>glimpse23<AT>gmail<DOT>.com
+*
+*   License:        GNU GPL v3.0
+*
+*   URL:            https://github.com/amcajal/beethduino
+*
+*******************************************************************************/
+
+#ifndef Beethduino_audio_kernels_h
+#define Beethduino_audio_kernels_h
+
+#include <stdint.h>
+
+/**
+* Set of kernels of one instruction set.
+* - synthesize_sine: samples[i] = amplitude * sin(2 * PI * i * cycles_per_sample).
+* - apply_envelope: samples[i] *= start_gain + i * gain_step.
+* - convert_to_pcm: rounds to the nearest integer, with saturation.
+* - mix_pcm: samples[i] += added_samples[i], with saturation.
+*/
+struct AudioKernels
+{
+    const char *name;
+    bool (*is_supported)();
+    void (*synthesize_sine)(float *samples, unsigned long count,
+                            float cycles_per_sample, float amplitude);
+    void (*apply_envelope)(float *samples, unsigned long count,
+                           float start_gain, float gain_step);
+    void (*convert_to_pcm)(int16_t *samples, const float *wave,
+                           unsigned long count);
+    void (*mix_pcm)(int16_t *samples, const int16_t *added_samples,
+                    unsigned long count);
+};
+
+/* Ordered from the slowest (scalar, always supported) to the fastest. */
+extern const AudioKernels AUDIO_KERNELS[];
+extern const int AUDIO_KERNELS_COUNT;
+
+/**
+* Fastest set supported by the CPU.
+*/
+const AudioKernels *select_audio_kernels();
+
+#endif
@@ -0,0 +1,512 @@
+/*******************************************************************************
+*   Project:        Beethduino, an Arduino Do-it-yourself electronic metronome.
+*
+*   File:           Beethduino_tempo_map.cpp
+*
+*   Description:    Body file of the host (PC) compiler of the tempo maps of
+*                   Beethduino.
+*
+*   Language:       C++ (host, g++).
+*
+*   Dependencies:   math.h
+*                   stdlib.h
+*                   string.h
+*                   Beethduino_tempo_map.h
+*
+*   Notes:          BPM - Beats Per Minute.
+*
+*   Author:         Alberto Martin Cajal
+*                   amartin.glimpse23@gmail.com
+*                   amartin<DOT>glimpse23<AT>gmail<DOT>.com
+*
+*   License:        GNU GPL v3.0
+*
+*   URL:            https://github.com/amcajal/beethduino
+*
+*******************************************************************************/
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Beethduino_tempo_map.h"
+
+static const char *TOKEN_SEPARATORS = " \t\r";
+static const byte MAX_OPERANDS = Beethduino::VOICES_COUNT;
+
+
+BeethduinoTempoMap::BeethduinoTempoMap()
+{
+    last_opcode = Beethduino::TEMPO_MAP_END;
+    has_bars = false;
+    error_line = 0;
+}
+
+
+/**
+* Compiles the source, one line after another. Returns false at the first
+* error (error_line and error_message); the program is then incomplete.
+*/
+bool BeethduinoTempoMap::compile(const char *source)
+{
+    const char *line_start = source;
+    const char *line_end;
+    std::vector<char> line;
+
+    program.clear();
+    last_opcode = Beethduino::TEMPO_MAP_END;
+    has_bars = false;
+    error_line = 0;
+    error_message.clear();
+
+    while (*line_start != '\0')
+    {
+        line_end = strchr(line_start, '\n');
+
+        if (line_end == 0)
+        {
+            line_end = line_start + strlen(line_start);
+        }
+
+        line.assign(line_start, line_end);
+        line.push_back('\0');
+        error_line++;
+
+        if (compile_line(&line[0]) == false)
+        {
+            return false;
+        }
+
+        line_start = (*line_end == '\n') ? (line_end + 1) : line_end;
+    }
+
+    if (has_bars == false)
+    {
+        return fail("the program has no bars (no play nor ramp)");
+    }
+
+    if ((last_opcode != Beethduino::TEMPO_MAP_END)
+        && (last_opcode != Beethduino::TEMPO_MAP_REPEAT))
+    {
+        program.push_back((byte) Beethduino::TEMPO_MAP_END);
+    }
+
+    error_line = 0;
+    return true;
+}
+
+
+/**
+* The line is split in words (the comment is removed first): the keyword of
+* the instruction and its operands.
+*/
+bool BeethduinoTempoMap::compile_line(char *line)
+{
+    char *comment = strchr(line, '#');
+    char *saved_position;
+    char *keyword;
+    char *operands[MAX_OPERANDS + 1];
+    byte operand_count = 0;
+    byte opcode;
+    long bpm;
+    long bars;
+    long step;
+    long voice;
+    byte signature;
+    byte voices = 0;
+    byte operand;
+
+    if (comment != 0)
+    {
+        *comment = '\0';
+    }
+
+    keyword = strtok_r(line, TOKEN_SEPARATORS, &saved_position);
+
+    if (keyword == 0)
+    {
+        return true;
+    }
+
+    while ((operand_count <= MAX_OPERANDS)
+           && ((operands[operand_count] = strtok_r(0, TOKEN_SEPARATORS,
+                                                   &saved_position)) != 0))
+    {
+        operand_count++;
+    }
+
+    if (strcmp(keyword, "play") == 0)
+    {
+        if ((operand_count != 2)
+            || (parse_number(operands[0], Beethduino::BPM_LOWER_BOUND,
+                             Beethduino::BPM_UPPER_BOUND, &bpm) == false)
+            || (parse_number(operands[1], 1, MAX_BARS, &bars) == false))
+        {
+            return fail("expected: play <bpm 1-300> <bars 1-255>");
+        }
+
+        opcode = Beethduino::TEMPO_MAP_PLAY;
+        program.push_back(opcode);
+        append_word(bpm);
+        program.push_back(bars);
+        has_bars = true;
+    }
+    else if (strcmp(keyword, "ramp") == 0)
+    {
+        if ((operand_count != 3)
+            || (parse_number(operands[0], MIN_STEP, MAX_STEP, &step) == false)
+            || (step == 0)
+            || (parse_number(operands[1], 1, MAX_BARS, &bars) == false)
+            || (parse_number(operands[2], Beethduino::BPM_LOWER_BOUND,
+                             Beethduino::BPM_UPPER_BOUND, &bpm) == false))
+        {
+            return fail("expected: ramp <step -128-127, not 0> <bars 1-255> "
+                        "<bpm 1-300>");
+        }
+
+        opcode = Beethduino::TEMPO_MAP_RAMP;
+        program.push_back(opcode);
+        program.push_back((byte) (signed char) step);
+        program.push_back(bars);
+        append_word(bpm);
+        has_bars = true;
+    }
+    else if (strcmp(keyword, "time") == 0)
+    {
+        signature = 0;
+
+        while ((operand_count == 1)
+               && (signature < Beethduino::TIME_SIGNATURES_COUNT)
+               && (strcmp(operands[0],
+                          Beethduino::TIME_SIGNATURES[signature].text) != 0))
+        {
+            signature++;
+        }
+
+        if ((operand_count != 1)
+            || (signature == Beethduino::TIME_SIGNATURES_COUNT))
+        {
+            return fail("expected: time <2/4 | 3/4 | 4/4 | 6/8 | 7/8>");
+        }
+
+        opcode = Beethduino::TEMPO_MAP_TIME_SIGNATURE;
+        program.push_back(opcode);
+        program.push_back(signature);
+    }
+    else if ((strcmp(keyword, "linear") == 0)
+             || (strcmp(keyword, "exponential") == 0))
+    {
+        if ((operand_count != 2)
+            || (parse_number(operands[0], 1, MAX_BARS, &bars) == false)
+            || (parse_number(operands[1], Beethduino::BPM_LOWER_BOUND,
+                             Beethduino::BPM_UPPER_BOUND, &bpm) == false))
+        {
+            return fail("expected: linear | exponential <bars 1-255> "
+                        "<bpm 1-300>");
+        }
+
+        opcode = (strcmp(keyword, "linear") == 0)
+                 ? Beethduino::TEMPO_MAP_LINEAR_RAMP
+                 : Beethduino::TEMPO_MAP_EXPONENTIAL_RAMP;
+        program.push_back(opcode);
+        program.push_back(bars);
+        append_word(bpm);
+        has_bars = true;
+    }
+    else if (strcmp(keyword, "voices") == 0)
+    {
+        for (operand = 0; operand < operand_count; operand++)
+        {
+            if ((operand_count > Beethduino::VOICES_COUNT)
+                || (parse_number(operands[operand], 1,
+                                 Beethduino::VOICES_COUNT, &voice) == false))
+            {
+                return fail("expected: voices [<voice 1-4>...]");
+            }
+
+            voices = voices | (1 << (voice - 1));
+        }
+
+        opcode = Beethduino::TEMPO_MAP_VOICES;
+        program.push_back(opcode);
+        program.push_back(voices);
+    }
+    else if ((strcmp(keyword, "repeat") == 0) && (operand_count == 0))
+    {
+        opcode = Beethduino::TEMPO_MAP_REPEAT;
+        program.push_back(opcode);
+    }
+    else if ((strcmp(keyword, "end") == 0) && (operand_count == 0))
+    {
+        opcode = Beethduino::TEMPO_MAP_END;
+        program.push_back(opcode);
+    }
+    else
+    {
+        return fail("unknown instruction (play, ramp, time, linear, "
+                    "exponential, voices, repeat, end)");
+    }
+
+    last_opcode = opcode;
+    return true;
+}
+
+
+bool BeethduinoTempoMap::fail(const char *message)
+{
+    error_message = message;
+    return false;
+}
+
+
+/**
+* Little-endian, as the words are read by the main code.
+*/
+void BeethduinoTempoMap::append_word(unsigned int word)
+{
+    program.push_back(word & 0xFF);
+    program.push_back((word >> 8) & 0xFF);
+}
+
+
+unsigned int BeethduinoTempoMap::read_word(unsigned int address) const
+{
+    return program[address] | (program[address + 1] << 8);
+}
+
+
+/**
+* Decimal number (with optional sign), in [minimum, maximum].
+*/
+bool BeethduinoTempoMap::parse_number(const char *text, long minimum,
+                                      long maximum, long *number)
+{
+    char *text_end;
+
+    *number = strtol(text, &text_end, 10);
+
+    return (text_end != text) && (*text_end == '\0') && (*number >= minimum)
+           && (*number <= maximum);
+}
+
+
+/**
+* Expands the compiled program into its segments, at most max_segments (a
+* program with "repeat" never ends), from the BPM and time signature of the
+* metronome. This is the reference of the interpreter of the main code,
+* written apart from it.
+*/
+void BeethduinoTempoMap::expand(int bpm, byte time_signature,
+                                unsigned int max_segments,
+                                std::vector<TempoSegment> &segments) const
+{
+    unsigned int pc = 0;
+    size_t segments_at_repeat = 0;
+    int target_bpm;
+    int step;
+    byte ramp;
+    byte voices = 0;    /* A program starts without voices. */
+    size_t first_segment;
+
+    segments.clear();
+
+    while ((segments.size() < max_segments) && (pc < program.size()))
+    {
+        first_segment = segments.size();
+
+        if (program[pc] == Beethduino::TEMPO_MAP_PLAY)
+        {
+            bpm = read_word(pc + 1);
+            append_segment(bpm, bpm, Beethduino::TEMPO_RAMP_NONE,
+                           time_signature, program[pc + 3], segments);
+            pc = pc + Beethduino::TEMPO_MAP_PLAY_SIZE;
+        }
+        else if (program[pc] == Beethduino::TEMPO_MAP_RAMP)
+        {
+            step = (signed char) program[pc + 1];
+            target_bpm = read_word(pc + 3);
+
+            while ((bpm != target_bpm) && (segments.size() < max_segments))
+            {
+                bpm = bpm + step;
+
+                if (((step > 0) && (bpm > target_bpm))
+                    || ((step < 0) && (bpm < target_bpm)))
+                {
+                    bpm = target_bpm;
+                }
+
+                append_segment(bpm, bpm, Beethduino::TEMPO_RAMP_NONE,
+                               time_signature, program[pc + 2], segments);
+            }
+
+            pc = pc + Beethduino::TEMPO_MAP_RAMP_SIZE;
+        }
+        else if ((program[pc] == Beethduino::TEMPO_MAP_LINEAR_RAMP)
+                 || (program[pc] == Beethduino::TEMPO_MAP_EXPONENTIAL_RAMP))
+        {
+            target_bpm = read_word(pc + 2);
+            ramp = (program[pc] == Beethduino::TEMPO_MAP_LINEAR_RAMP)
+                   ? Beethduino::TEMPO_RAMP_LINEAR
+                   : Beethduino::TEMPO_RAMP_EXPONENTIAL;
+
+            /* A ramp to its start BPM is a plain segment. */
+            if (bpm == target_bpm)
+            {
+                ramp = Beethduino::TEMPO_RAMP_NONE;
+            }
+
+            append_segment(bpm, target_bpm, ramp, time_signature,
+                           program[pc + 1], segments);
+            bpm = target_bpm;
+            pc = pc + Beethduino::TEMPO_MAP_SMOOTH_RAMP_SIZE;
+        }
+        else if (program[pc] == Beethduino::TEMPO_MAP_TIME_SIGNATURE)
+        {
+            time_signature = program[pc + 1];
+            pc = pc + Beethduino::TEMPO_MAP_TIME_SIGNATURE_SIZE;
+        }
+        else if (program[pc] == Beethduino::TEMPO_MAP_VOICES)
+        {
+            voices = program[pc + 1];
+            pc = pc + Beethduino::TEMPO_MAP_VOICES_SIZE;
+        }
+        else if ((program[pc] == Beethduino::TEMPO_MAP_REPEAT)
+                 && (segments.size() > segments_at_repeat))
+        {
+            segments_at_repeat = segments.size();
+            pc = 0;
+        }
+        else
+        {
+            break;  /* End, or a repetition without bars. */
+        }
+
+        for (size_t segment = first_segment; segment < segments.size();
+             segment++)
+        {
+            segments[segment].voices = voices;
+        }
+    }
+}
+
+
+void BeethduinoTempoMap::append_segment(int start_bpm, int bpm, byte ramp,
+                                        byte time_signature,
+                                        unsigned int bars,
+                                        std::vector<TempoSegment> &segments)
+{
+    TempoSegment segment;
+    const TempoSegment *previous;
+
+    segment.bpm = bpm;
+    segment.start_bpm = start_bpm;
+    segment.ramp = ramp;
+    segment.time_signature = time_signature;
+    segment.bars = bars;
+    segment.voices = 0;
+    segment.start_tick = 0;
+
+    if (segments.empty() == false)
+    {
+        previous = &segments.back();
+        segment.start_tick = previous->start_tick
+            + (unsigned long) floorl(beat_time(*previous,
+                                               segment_beats(*previous)));
+    }
+
+    segments.push_back(segment);
+}
+
+
+/**
+* Exact time of the beat, in ticks from the first downbeat of the segment.
+* At one BPM and in a linear ramp, it is a fraction of integers, divided
+* once: its floor is exact. In a linear ramp, the sum of the beat periods
+* 60000 / start_bpm + i * delta, with delta = 60000 * (start_bpm - bpm) /
+* (start_bpm * bpm * beats), is
+* 60000 * (2 * beat * bpm * beats + (start_bpm - bpm) * beat * (beat - 1))
+* / (2 * start_bpm * bpm * beats). In an exponential ramp, it is the sum of
+* the geometric series of the periods (irrational in general).
+*/
+long double BeethduinoTempoMap::beat_time(const TempoSegment &segment,
+                                          unsigned long beat)
+{
+    const long long MILLISECONDS = Beethduino::MILLISECONDS_IN_MINUTE;
+    long long start_bpm = segment.start_bpm;
+    long long bpm = segment.bpm;
+    long long beats = segment_beats(segment);
+    long long k = beat;
+    long double ratio;
+
+    if (segment.ramp == Beethduino::TEMPO_RAMP_LINEAR)
+    {
+        return (long double) (MILLISECONDS
+                              * ((2 * k * bpm * beats)
+                                 + ((start_bpm - bpm) * k * (k - 1))))
+               / (long double) (2 * start_bpm * bpm * beats);
+    }
+
+    if (segment.ramp == Beethduino::TEMPO_RAMP_EXPONENTIAL)
+    {
+        ratio = powl((long double) start_bpm / bpm, 1.0L / beats);
+        return ((long double) MILLISECONDS / start_bpm)
+               * ((powl(ratio, k) - 1.0L) / (ratio - 1.0L));
+    }
+
+    return (long double) (k * MILLISECONDS) / bpm;
+}
+
+
+unsigned long BeethduinoTempoMap::segment_beats(const TempoSegment &segment)
+{
+    return segment.bars
+           * Beethduino::TIME_SIGNATURES[segment.time_signature].beats_per_bar;
+}
+
+
+/**
+* Writes the program as the initializer of TEMPO_MAP in the main code, one
+* instruction per line.
+*/
+void BeethduinoTempoMap::write_array(FILE *output) const
+{
+    static const char *OPCODE_NAMES[] = {"TEMPO_MAP_END", "TEMPO_MAP_PLAY",
+                                         "TEMPO_MAP_RAMP",
+                                         "TEMPO_MAP_TIME_SIGNATURE",
+                                         "TEMPO_MAP_REPEAT",
+                                         "TEMPO_MAP_LINEAR_RAMP",
+                                         "TEMPO_MAP_EXPONENTIAL_RAMP",
+                                         "TEMPO_MAP_VOICES"};
+    static const byte OPCODE_SIZES[] = {
+        1, Beethduino::TEMPO_MAP_PLAY_SIZE, Beethduino::TEMPO_MAP_RAMP_SIZE,
+        Beethduino::TEMPO_MAP_TIME_SIGNATURE_SIZE, 1,
+        Beethduino::TEMPO_MAP_SMOOTH_RAMP_SIZE,
+        Beethduino::TEMPO_MAP_SMOOTH_RAMP_SIZE,
+        Beethduino::TEMPO_MAP_VOICES_SIZE};
+    unsigned int pc = 0;
+    unsigned int operand;
+
+    fprintf(output, "const byte TEMPO_MAP[] PROGMEM = \n{\n");
+
+    while (pc < program.size())
+    {
+        fprintf(output, "    %s", OPCODE_NAMES[program[pc]]);
+
+        for (operand = 1; operand < OPCODE_SIZES[program[pc]]; operand++)
+        {
+            fprintf(output, ", %u", program[pc + operand]);
+        }
+
+        pc = pc + OPCODE_SIZES[program[pc]];
+        fprintf(output, "%s\n", (pc < program.size()) ? "," : "");
+    }
+
+    fprintf(output, "};\n");
+}
+
+
+void BeethduinoTempoMap::write_binary(FILE *output) const
+{
+    fwrite(&program[0], 1, program.size(), output);
+}
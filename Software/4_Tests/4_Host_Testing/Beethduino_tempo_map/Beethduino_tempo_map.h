@@ -0,0 +1,120 @@
+/*******************************************************************************
+*   Project:        Beethduino, an Arduino Do-it-yourself electronic metronome.
+*
+*   File:           Beethduino_tempo_map.h
+*
+*   Description:    Host (PC) compiler of the tempo maps of Beethduino. A
+*                   tempo map is written as text, one instruction per line:
+*                       play <bpm> <bars>           i.e: play 80 4
+*                       ramp <step> <bars> <bpm>    i.e: ramp +5 8 140
+*                       time <time signature>       i.e: time 6/8
+*                       linear <bars> <bpm>         i.e: linear 8 140
+*                       exponential <bars> <bpm>    i.e: exponential 4 60
+*                       voices [<voice>...]         i.e: voices 1 3
+*                       repeat
+*                       end
+*                   and compiled into the binary program interpreted by the
+*                   main code (TEMPO_MAP, in the flash memory): one opcode
+*                   byte and its operands, with little-endian words. The
+*                   compiler also expands the program into its segments
+*                   (bars at one BPM) and its timeline (tick of the first
+*                   downbeat of every segment), the reference of the tests.
+*
+*   Language:       C++ (host, g++).
+*
+*   Dependencies:   stdio.h
+*                   string
+*                   vector
+*                   Beethduino.h
+*
+*   Notes:          BPM - Beats Per Minute.
+*                   The text after '#' is a comment. A program without
+*                   "end" nor "repeat" at its end is ended by the compiler.
+*                   A ramp starts from the BPM of the previous segment (the
+*                   BPM of the metronome, if it is the first instruction),
+*                   and its last segment is at the target BPM.
+*                   linear and exponential are smooth ramps from the BPM of
+*                   the previous segment to the target, beat by beat: the 
+*                   period changes by the same ticks (linear) or by the same
+*                   ratio (exponential) in every beat, and the target is 
+*                   reached in the next downbeat.
+*                   The beat k of a segment is floor(t(k)) ticks after its 
+*                   first downbeat, where t(k) is the exact time of the beat
+*                   (beat_time): k * 60000 / bpm at one BPM; the sum of the 
+*                   k first periods in a ramp, 60000 / start_bpm + i * 60000
+*                   * (1 / bpm - 1 / start_bpm) / beats for the linear one 
+*                   (a fraction, computed with integers), and 60000 / 
+*                   start_bpm * r ^ i, with r = (start_bpm / bpm) ^ (1 /
+*                   beats), for the exponential one. The segment j starts 
+*                   floor(t(bars * beats_per_bar)) ticks after the segment 
+*                   j - 1.
+*                   voices selects the polyrhythm voices of the next bars
+*                   (numbers 1 to VOICES_COUNT of Beethduino::VOICES; none
+*                   without operands).
+*
+*   Author:         Alberto Martin Cajal
+*                   amartin.glimpse23@gmail.com
+*                   amartin<DOT>glimpse23<AT>gmail<DOT>.com
+*
+*   License:        GNU GPL v3.0
+*
+*   URL:            https://github.com/amcajal/beethduino
+*
+*******************************************************************************/
+
+#ifndef Beethduino_tempo_map_h
+#define Beethduino_tempo_map_h
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "Beethduino.h"
+
+struct TempoSegment
+{
+    int bpm;                        /* Target BPM, in a ramp. */
+    int start_bpm;                  /* BPM of the first beat. */
+    byte ramp;                      /* Beethduino::TEMPO_RAMP_NONE... */
+    byte time_signature;            /* Index of TIME_SIGNATURES. */
+    unsigned int bars;
+    byte voices;                    /* Bit v: Beethduino::VOICES[v]. */
+    unsigned long start_tick;       /* First downbeat, from the first one. */
+};
+
+class BeethduinoTempoMap
+{
+    public:
+        /* VARIABLES */
+        static const unsigned int MAX_BARS      = 255;
+        static const int MAX_STEP               = 127;
+        static const int MIN_STEP               = -128;
+
+        std::vector<byte> program;
+        byte last_opcode;
+        bool has_bars;              /* A play or a ramp has been compiled. */
+        unsigned int error_line;    /* 0 without error. */
+        std::string error_message;
+
+        /* METHODS */
+        BeethduinoTempoMap();
+        bool compile(const char *source);
+        void expand(int bpm, byte time_signature, unsigned int max_segments,
+                    std::vector<TempoSegment> &segments) const;
+        void write_array(FILE *output) const;
+        void write_binary(FILE *output) const;
+        bool compile_line(char *line);
+        bool fail(const char *message);
+        void append_word(unsigned int word);
+        unsigned int read_word(unsigned int address) const;
+        static bool parse_number(const char *text, long minimum,
+                                 long maximum, long *number);
+        static void append_segment(int start_bpm, int bpm, byte ramp,
+                                   byte time_signature, unsigned int bars,
+                                   std::vector<TempoSegment> &segments);
+        static long double beat_time(const TempoSegment &segment,
+                                     unsigned long beat);
+        static unsigned long segment_beats(const TempoSegment &segment);
+};
+
+#endif
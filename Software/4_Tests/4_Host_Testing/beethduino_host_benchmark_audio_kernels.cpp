@@ -0,0 +1,274 @@
+/*******************************************************************************
+*   Project:        Beethduino, an Arduino Do-it-yourself electronic metronome.
+*
+*   File:           beethduino_host_benchmark_audio_kernels.cpp
+*
+*   Description:    Host (PC) benchmark of the sample kernels of the audio
+*                   engine of Beethduino (Beethduino_audio folder). For every
+*                   kernel set supported by the CPU (scalar, SSE2, AVX2),
+*                   reports the samples per host second of every kernel
+*                   (oscillator, envelope, conversion to PCM and mixing) and
+*                   of the whole engine rendering a session at the highest
+*                   BPM, and the speedup over the scalar set. The samples of
+*                   every set are checked against the scalar ones in
+*                   beethduino_host_test_audio_render.
+*
+*   Language:       C++ (host, g++).
+*                   Compiled with CMake (target of the same name), with the
+*                   Arduino_simulator folder, Beethduino.cpp and the
+*                   Beethduino_audio folder.
+*
+*   Dependencies:   assert.h
+*                   stdio.h
+*                   stdlib.h
+*                   chrono
+*                   vector
+*                   Arduino_simulator.h
+*                   Beethduino.h
+*                   Beethduino_audio.h
+*                   Beethduino_audio_kernels.h
+*
+*   Notes:          BPM - Beats Per Minute.
+*                   PCM - Pulse Code Modulation.
+*                   Usage: beethduino_host_benchmark_audio_kernels [seconds]
+*                   (3600 by default: a session of one hour at 48 KHz).
+*                   The engine synthesizes the click once, so a session is
+*                   dominated by the clearing and the mixing of the blocks;
+*                   the oscillator and envelope kernels are measured apart.
+*
+*   Author:         Alberto Martin Cajal
+*                   amartin.glimpse23@gmail.com
+*                   amartin<DOT>glimpse23<AT>gmail<DOT>.com
+*
+*   License:        GNU GPL v3.0
+*
+*   URL:            https://github.com/amcajal/beethduino
+*
+*******************************************************************************/
+#define __ASSERT_USE_STDERR
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <vector>
+
+#include "Arduino_simulator.h"
+#include "Beethduino.h"
+#include "Beethduino_audio.h"
+#include "Beethduino_audio_kernels.h"
+
+const unsigned long DEFAULT_SECONDS = 3600;
+const unsigned long KERNEL_SAMPLES  = 4096;
+const unsigned long BLOCK_SAMPLES   = 4096;
+
+enum Measure
+{
+    SYNTHESIZE_SINE,
+    APPLY_ENVELOPE,
+    CONVERT_TO_PCM,
+    MIX_PCM,
+    RENDER_SESSION,
+    MEASURES
+};
+
+const char *MEASURE_NAMES[MEASURES] = {"synthesize_sine", "apply_envelope",
+                                       "convert_to_pcm", "mix_pcm",
+                                       "render_session"};
+
+/******************************************************************************/
+
+
+void execute_benchmark(unsigned long seconds);
+void measure_kernels(const AudioKernels *kernels, unsigned long seconds,
+                     double *samples_per_second);
+double measure_kernel(const AudioKernels *kernels, Measure measure,
+                      unsigned long samples);
+double measure_session(const AudioKernels *kernels, unsigned long seconds);
+double elapsed_seconds(std::chrono::steady_clock::time_point start);
+
+
+int main(int argc, char *argv[])
+{
+    unsigned long seconds = (argc > 1) ? strtoul(argv[1], 0, 10)
+                                       : DEFAULT_SECONDS;
+
+    if (seconds == 0)
+    {
+        printf("Usage: %s [seconds >= 1]\n", argv[0]);
+        return 1;
+    }
+
+    printf("HOST BENCHMARK STARTED\n******************************\n");
+    printf("%%%%%%Benchmarking: audio kernels (scalar and SIMD)\n");
+
+    execute_benchmark(seconds);
+
+    printf("HOST BENCHMARK FINISHED\n******************************\n");
+    return 0;
+}
+
+
+void execute_benchmark(unsigned long seconds)
+{
+    double scalar_results[MEASURES];
+    double results[MEASURES];
+
+    printf("    %lu seconds at %d BPM, %lu Hz; selected kernels: %s\n",
+           seconds, Beethduino::BPM_UPPER_BOUND,
+           BeethduinoAudio::SAMPLE_RATE_48K, select_audio_kernels()->name);
+    printf("    %-8s %-16s %16s %9s\n", "kernels", "measure",
+           "samples/host s", "speedup");
+
+    for (int set = 0; set < AUDIO_KERNELS_COUNT; set++)
+    {
+        if (AUDIO_KERNELS[set].is_supported() == false)
+        {
+            printf("    %-8s not supported by the CPU\n",
+                   AUDIO_KERNELS[set].name);
+            continue;
+        }
+
+        measure_kernels(&AUDIO_KERNELS[set], seconds, results);
+
+        for (int measure = 0; measure < MEASURES; measure++)
+        {
+            if (set == 0)
+            {
+                scalar_results[measure] = results[measure];
+            }
+
+            printf("    %-8s %-16s %16.3e %8.2fx\n", AUDIO_KERNELS[set].name,
+                   MEASURE_NAMES[measure], results[measure],
+                   results[measure] / scalar_results[measure]);
+        }
+    }
+
+    printf("\n");
+}
+
+
+void measure_kernels(const AudioKernels *kernels, unsigned long seconds,
+                     double *samples_per_second)
+{
+    unsigned long samples = seconds * BeethduinoAudio::SAMPLE_RATE_48K;
+
+    for (int measure = 0; measure < RENDER_SESSION; measure++)
+    {
+        samples_per_second[measure] = samples
+            / measure_kernel(kernels, (Measure) measure, samples);
+    }
+
+    samples_per_second[RENDER_SESSION] = samples
+        / measure_session(kernels, seconds);
+}
+
+
+/**
+* Returns the host seconds spent processing the samples, in blocks of
+* KERNEL_SAMPLES.
+*/
+double measure_kernel(const AudioKernels *kernels, Measure measure,
+                      unsigned long samples)
+{
+    std::vector<float> wave(KERNEL_SAMPLES);
+    std::vector<int16_t> pcm(KERNEL_SAMPLES, 1000);
+    std::vector<int16_t> added_pcm(KERNEL_SAMPLES, -3);
+    unsigned long sample;
+
+    kernels->synthesize_sine(&wave[0], KERNEL_SAMPLES, 0.0417f, 16384.0f);
+
+    std::chrono::steady_clock::time_point start
+        = std::chrono::steady_clock::now();
+
+    for (sample = 0; sample < samples; sample += KERNEL_SAMPLES)
+    {
+        switch (measure)
+        {
+            case SYNTHESIZE_SINE:
+                kernels->synthesize_sine(&wave[0], KERNEL_SAMPLES, 0.0417f,
+                                         16384.0f);
+                break;
+
+            case APPLY_ENVELOPE:
+                /* Unity gain: the wave does not decay to denormals. */
+                kernels->apply_envelope(&wave[0], KERNEL_SAMPLES, 1.0f, 0.0f);
+                break;
+
+            case CONVERT_TO_PCM:
+                kernels->convert_to_pcm(&pcm[0], &wave[0], KERNEL_SAMPLES);
+                break;
+
+            case MIX_PCM:
+                kernels->mix_pcm(&pcm[0], &added_pcm[0], KERNEL_SAMPLES);
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    return elapsed_seconds(start);
+}
+
+
+/**
+* Renders a session and returns the host seconds spent.
+*/
+double measure_session(const AudioKernels *kernels, unsigned long seconds)
+{
+    std::vector<int16_t> samples(BLOCK_SAMPLES);
+    unsigned long long total_samples = (unsigned long long) seconds
+                                       * BeethduinoAudio::SAMPLE_RATE_48K;
+    unsigned long long sample;
+    unsigned long count;
+
+    sim_reset();
+    Beethduino metronome;
+    metronome.bpm = Beethduino::BPM_UPPER_BOUND;
+    metronome.calculate_required_iterations();
+    BeethduinoAudio audio(metronome, BeethduinoAudio::SAMPLE_RATE_48K,
+                          kernels);
+    audio.start();
+
+    std::chrono::steady_clock::time_point start
+        = std::chrono::steady_clock::now();
+
+    for (sample = 0; sample < total_samples; sample += count)
+    {
+        count = BLOCK_SAMPLES;
+
+        if ((sample + count) > total_samples)
+        {
+            count = total_samples - sample;
+        }
+
+        audio.render(&samples[0], count);
+    }
+
+    /* One click every 200 ms, from 200 ms (the last one is not rendered). */
+    assert (audio.rendered_clicks
+            == ((seconds * Beethduino::BPM_UPPER_BOUND) / 60) - 1);
+
+    return elapsed_seconds(start);
+}
+
+
+double elapsed_seconds(std::chrono::steady_clock::time_point start)
+{
+    std::chrono::steady_clock::time_point end
+        = std::chrono::steady_clock::now();
+
+    return std::chrono::duration_cast<std::chrono::duration<double> >(
+               end - start).count();
+}
+
+
+void __assert(const char *__func, const char *__file,
+              int __lineno, const char *__sexp)
+{
+    printf("TEST_FAILED\n%s\n%s\n%d\n%s\n", __file, __func, __lineno, __sexp);
+    fflush(stdout);
+
+    abort();
+}
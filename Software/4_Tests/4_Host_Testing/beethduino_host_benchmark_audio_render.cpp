@@ -0,0 +1,165 @@
+/*******************************************************************************
+*   Project:        Beethduino, an Arduino Do-it-yourself electronic metronome.
+*
+*   File:           beethduino_host_benchmark_audio_render.cpp
+*
+*   Description:    Host (PC) benchmark of the audio engine of Beethduino
+*                   (Beethduino_audio folder). Renders the clicks of the
+*                   highest BPM (the most clicks per second) at 44.1 and
+*                   48 KHz, in blocks of several sizes, and reports the
+*                   rendered audio seconds per host second (real time
+*                   factor) and the samples per host second.
+*
+*   Language:       C++ (host, g++).
+*                   Compiled with CMake (target of the same name), with the
+*                   Arduino_simulator folder, Beethduino.cpp and
+*                   Beethduino_audio.cpp.
+*
+*   Dependencies:   assert.h
+*                   stdio.h
+*                   stdlib.h
+*                   chrono
+*                   vector
+*                   Arduino_simulator.h
+*                   Beethduino.h
+*                   Beethduino_audio.h
+*
+*   Notes:          BPM - Beats Per Minute.
+*                   Usage: beethduino_host_benchmark_audio_render [seconds]
+*                   (3600 by default: one hour of clicks per measure).
+*
+*   Author:         Alberto Martin Cajal
+*                   amartin.glimpse23@gmail.com
+*                   amartin<DOT>glimpse23<AT>gmail<DOT>.com
+*
+*   License:        GNU GPL v3.0
+*
+*   URL:            https://github.com/amcajal/beethduino
+*
+*******************************************************************************/
+#define __ASSERT_USE_STDERR
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <vector>
+
+#include "Arduino_simulator.h"
+#include "Beethduino.h"
+#include "Beethduino_audio.h"
+
+const unsigned long DEFAULT_SECONDS = 3600;
+const unsigned long SAMPLE_RATES[]  = {BeethduinoAudio::SAMPLE_RATE_44K,
+                                       BeethduinoAudio::SAMPLE_RATE_48K};
+const int SAMPLE_RATES_COUNT        = 2;
+const unsigned long BLOCK_SIZES[]   = {64, 512, 4096};
+const int BLOCK_SIZES_COUNT         = 3;
+
+/******************************************************************************/
+
+
+void execute_benchmark(unsigned long seconds);
+double measure_render(unsigned long seconds, unsigned long sample_rate,
+                      unsigned long block_size);
+
+
+int main(int argc, char *argv[])
+{
+    unsigned long seconds = (argc > 1) ? strtoul(argv[1], 0, 10)
+                                       : DEFAULT_SECONDS;
+
+    if (seconds == 0)
+    {
+        printf("Usage: %s [seconds >= 1]\n", argv[0]);
+        return 1;
+    }
+
+    printf("HOST BENCHMARK STARTED\n******************************\n");
+    printf("%%%%%%Benchmarking: audio rendering\n");
+
+    execute_benchmark(seconds);
+
+    printf("HOST BENCHMARK FINISHED\n******************************\n");
+    return 0;
+}
+
+
+void execute_benchmark(unsigned long seconds)
+{
+    printf("    %lu audio seconds at %d BPM\n", seconds,
+           Beethduino::BPM_UPPER_BOUND);
+    printf("    %-8s %8s %16s %18s\n", "rate", "block", "real time factor",
+           "samples/host s");
+
+    for (int rate = 0; rate < SAMPLE_RATES_COUNT; rate++)
+    {
+        for (int size = 0; size < BLOCK_SIZES_COUNT; size++)
+        {
+            double host_seconds = measure_render(seconds, SAMPLE_RATES[rate],
+                                                 BLOCK_SIZES[size]);
+
+            printf("    %-8lu %8lu %16.0f %18.3e\n", SAMPLE_RATES[rate],
+                   BLOCK_SIZES[size], seconds / host_seconds,
+                   seconds * SAMPLE_RATES[rate] / host_seconds);
+        }
+    }
+
+    printf("\n");
+}
+
+
+/**
+* Returns the host seconds spent rendering.
+*/
+double measure_render(unsigned long seconds, unsigned long sample_rate,
+                      unsigned long block_size)
+{
+    std::vector<int16_t> samples(block_size);
+    unsigned long long total_samples = (unsigned long long) seconds
+                                       * sample_rate;
+    unsigned long long sample;
+    unsigned long count;
+
+    sim_reset();
+    Beethduino metronome;
+    metronome.bpm = Beethduino::BPM_UPPER_BOUND;
+    metronome.calculate_required_iterations();
+    BeethduinoAudio audio(metronome, sample_rate);
+    audio.start();
+
+    std::chrono::steady_clock::time_point start
+        = std::chrono::steady_clock::now();
+
+    for (sample = 0; sample < total_samples; sample += count)
+    {
+        count = block_size;
+
+        if ((sample + count) > total_samples)
+        {
+            count = total_samples - sample;
+        }
+
+        audio.render(&samples[0], count);
+    }
+
+    std::chrono::steady_clock::time_point end
+        = std::chrono::steady_clock::now();
+
+    /* One click every 200 ms, from 200 ms (the last one is not rendered). */
+    assert (audio.rendered_clicks
+            == ((seconds * Beethduino::BPM_UPPER_BOUND) / 60) - 1);
+
+    return std::chrono::duration_cast<std::chrono::duration<double> >(
+               end - start).count();
+}
+
+
+void __assert(const char *__func, const char *__file,
+              int __lineno, const char *__sexp)
+{
+    printf("TEST_FAILED\n%s\n%s\n%d\n%s\n", __file, __func, __lineno, __sexp);
+    fflush(stdout);
+
+    abort();
+}
@@ -0,0 +1,311 @@
+/*******************************************************************************
+*   Project:        Beethduino, an Arduino Do-it-yourself electronic metronome.
+*
+*   File:           beethduino_host_benchmark_beat_period_table.cpp
+*
+*   Description:    Host (PC) benchmark of "calculate_required_iterations".
+*                   Compares the three versions of the BPM to period
+*                   conversion: the first one (double division), the exact
+*                   integer division, and the compile time BeatPeriods table.
+*                   Checks that the table gives the same values as the
+*                   integer division for every BPM, and reports the time
+*                   per conversion in the host, and the flash and cycles of
+*                   every version in the AVR (cost model).
+*
+*   Language:       C++ (host, g++).
+*                   Compiled with: g++ -std=c++11 -O2 -o beat_period_benchmark
+*                                  beethduino_host_benchmark_beat_period_table.cpp
+*
+*   Dependencies:   assert.h
+*                   stdio.h
+*                   chrono
+*
+*   Notes:          BPM - Beats Per Minute.
+*                   LCD - Liquid Crystal Display.
+*                   The PC has a FPU and a hardware divider, so the measured
+*                   times are only relative; in the AVR (no FPU, no divider)
+*                   the difference is bigger.
+*                   AVR cost model (ATmega328P at 16 MHz, avr-gcc -Os): there
+*                   is no AVR compiler in the host build, so the flash and
+*                   the cycles are not measured with avr-size or a
+*                   simulator; they are estimated from the code every
+*                   version links only for the conversion:
+*                   - Double division: the avr-libc float routines
+*                     __floatsisf, __divsf3, __mulsf3 and __fixunssfsi, and
+*                     their shared helpers. Assumed about 1100 bytes and 770
+*                     cycles (order of magnitude of the avr-libc libm).
+*                     beethduino_host_check_no_float checks that no float
+*                     code is linked any more, so the whole size is saved.
+*                   - Integer division: the libgcc __udivmodhi4 (quotient
+*                     and remainder in one call), 22 instructions (44 bytes)
+*                     and 16 turns of a loop of about 12 cycles: 210 cycles
+*                     with the call and the arguments.
+*                   - Table: the address (6 cycles), two lpm (7 cycles with
+*                     the Z register) and the 16 bit product by mul (10
+*                     cycles) and the subtraction (4 cycles): about 27
+*                     cycles, and the 600 bytes of the table.
+*                   The instructions of the call site, and the stores of the
+*                   results, are about the same in the three versions, so
+*                   they are not counted.
+*
+*   Author:         Alberto Martin Cajal
+*                   amartin.glimpse23@gmail.com
+*                   amartin<DOT>glimpse23<AT>gmail<DOT>.com
+*
+*   License:        GNU GPL v3.0
+*
+*   URL:            https://github.com/amcajal/beethduino
+*
+*******************************************************************************/
+
+#include <assert.h>
+#include <stdio.h>
+#include <chrono>
+
+#define PROGMEM                         /* No flash memory in the PC. */
+#define pgm_read_word(address)          (*(address))
+
+const int BPM_UPPER_BOUND           = 300;
+const int BPM_LOWER_BOUND           = 1;
+
+const unsigned int MILLISECONDS_IN_MINUTE = 60000;
+
+const double SECONDS_IN_MINUTE      = 60.00;
+const int MILLISECONDS_IN_SECOND    = 1000;
+
+const long BENCHMARK_CONVERSIONS    = 30000000;
+const int AVR_UNSIGNED_INT_BYTES    = 2;
+const double AVR_CYCLES_IN_US       = 16.00;    /* 16 MHz. */
+
+/* AVR cost model of every version (see the notes). */
+const int AVR_DOUBLE_FLASH_BYTES    = 1100;
+const int AVR_DOUBLE_CYCLES         = 770;
+const int AVR_DIVISION_FLASH_BYTES  = 44;
+const int AVR_DIVISION_CYCLES       = 210;
+const int AVR_TABLE_CYCLES          = 27;
+
+struct AvrCost
+{
+    const char *version;
+    int flash_bytes;
+    int cycles;
+};
+
+template <unsigned int... BPM_VALUES>
+struct BpmSequence
+{
+};
+
+template <unsigned int FIRST_BPM, unsigned int LAST_BPM,
+          unsigned int... BPM_VALUES>
+struct MakeBpmSequence
+    : MakeBpmSequence<FIRST_BPM, LAST_BPM - 1, LAST_BPM, BPM_VALUES...>
+{
+};
+
+template <unsigned int FIRST_BPM, unsigned int... BPM_VALUES>
+struct MakeBpmSequence<FIRST_BPM, FIRST_BPM, BPM_VALUES...>
+{
+    typedef BpmSequence<FIRST_BPM, BPM_VALUES...> type;
+};
+
+template <typename BPM_SEQUENCE>
+struct BeatPeriodTable;
+
+template <unsigned int... BPM_VALUES>
+struct BeatPeriodTable< BpmSequence<BPM_VALUES...> >
+{
+    static const unsigned int required_iterations[sizeof...(BPM_VALUES)];
+};
+
+template <unsigned int... BPM_VALUES>
+const unsigned int BeatPeriodTable< BpmSequence<BPM_VALUES...> >
+    ::required_iterations[sizeof...(BPM_VALUES)] PROGMEM =
+{
+    (MILLISECONDS_IN_MINUTE / BPM_VALUES)...
+};
+
+typedef BeatPeriodTable<
+            MakeBpmSequence<BPM_LOWER_BOUND, BPM_UPPER_BOUND>::type >
+        BeatPeriods;
+
+volatile int bpm;   /* volatile: the compiler shall not precompute results. */
+
+unsigned int bpm_freq_req_iter;
+unsigned int bpm_freq_remainder;
+
+/******************************************************************************/
+
+
+void execute_tests();
+void test_table_values();
+void benchmark_conversions();
+void report_avr_cost_model();
+double measure_ns_per_conversion(void (*conversion)());
+void double_required_iterations();
+void division_required_iterations();
+void table_required_iterations();
+
+
+int main()
+{
+    printf("HOST BENCHMARK STARTED\n******************************\n");
+    printf("%%%%%%Benchmarking function: calculate_required_iterations\n");
+
+    execute_tests();
+
+    printf("HOST BENCHMARK FINISHED\n******************************\n");
+    return 0;
+}
+
+
+void execute_tests()
+{
+    test_table_values();
+    benchmark_conversions();
+    report_avr_cost_model();
+}
+
+
+void test_table_values()
+{
+    printf("test_table_values\n");
+
+    assert ((sizeof(BeatPeriods::required_iterations)
+             / sizeof(BeatPeriods::required_iterations[0]))
+            == (unsigned int) (BPM_UPPER_BOUND - BPM_LOWER_BOUND + 1));
+
+    for (bpm = BPM_LOWER_BOUND; bpm <= BPM_UPPER_BOUND; bpm++)
+    {
+        division_required_iterations();
+        unsigned int division_iterations = bpm_freq_req_iter;
+        unsigned int division_remainder = bpm_freq_remainder;
+
+        table_required_iterations();
+        assert (bpm_freq_req_iter == division_iterations);
+        assert (bpm_freq_remainder == division_remainder);
+    }
+    printf("\n");
+}
+
+
+void benchmark_conversions()
+{
+    printf("benchmark_conversions\n");
+
+    double double_ns = measure_ns_per_conversion(double_required_iterations);
+    double division_ns
+        = measure_ns_per_conversion(division_required_iterations);
+    double table_ns = measure_ns_per_conversion(table_required_iterations);
+
+    printf("    double division:  %6.2f ns per conversion\n", double_ns);
+    printf("    integer division: %6.2f ns per conversion\n", division_ns);
+    printf("    BeatPeriods table: %5.2f ns per conversion\n", table_ns);
+    printf("\n");
+}
+
+
+/**
+* Flash and cycles of every version in the AVR, estimated (see the notes),
+* and the difference of the table with the other versions (negative, a
+* saving).
+*/
+void report_avr_cost_model()
+{
+    printf("report_avr_cost_model (estimated, not measured)\n");
+
+    const AvrCost costs[] =
+    {
+        {"double division", AVR_DOUBLE_FLASH_BYTES, AVR_DOUBLE_CYCLES},
+        {"integer division", AVR_DIVISION_FLASH_BYTES, AVR_DIVISION_CYCLES},
+        {"BeatPeriods table",
+         (BPM_UPPER_BOUND - BPM_LOWER_BOUND + 1) * AVR_UNSIGNED_INT_BYTES,
+         AVR_TABLE_CYCLES}
+    };
+    const int costs_count = sizeof(costs) / sizeof(costs[0]);
+    const AvrCost &table = costs[costs_count - 1];
+
+    printf("    %-18s %13s %8s %10s\n", "version", "flash (bytes)", "cycles",
+           "us (16MHz)");
+
+    for (int cost = 0; cost < costs_count; cost++)
+    {
+        printf("    %-18s %13d %8d %10.2f\n", costs[cost].version,
+               costs[cost].flash_bytes, costs[cost].cycles,
+               costs[cost].cycles / AVR_CYCLES_IN_US);
+    }
+
+    for (int cost = 0; cost < costs_count - 1; cost++)
+    {
+        printf("    table vs %-17s %+5d bytes of flash, %+4d cycles\n",
+               costs[cost].version,
+               table.flash_bytes - costs[cost].flash_bytes,
+               table.cycles - costs[cost].cycles);
+    }
+
+    printf("\n");
+}
+
+
+double measure_ns_per_conversion(void (*conversion)())
+{
+    std::chrono::steady_clock::time_point start
+        = std::chrono::steady_clock::now();
+
+    int next_bpm = BPM_LOWER_BOUND;
+
+    for (long i = 0; i < BENCHMARK_CONVERSIONS; i++)
+    {
+        bpm = next_bpm;
+        conversion();
+
+        if (next_bpm == BPM_UPPER_BOUND)
+        {
+            next_bpm = BPM_LOWER_BOUND;
+        }
+        else
+        {
+            next_bpm++;
+        }
+    }
+
+    std::chrono::duration<double, std::nano> elapsed
+        = std::chrono::steady_clock::now() - start;
+
+    return elapsed.count() / BENCHMARK_CONVERSIONS;
+}
+
+
+/**
+* First version: double division (software floating point in the AVR).
+*/
+void double_required_iterations()
+{
+    double temp_required_iterations;
+
+    temp_required_iterations
+        = (SECONDS_IN_MINUTE / bpm) * MILLISECONDS_IN_SECOND;
+
+    bpm_freq_req_iter = (unsigned int) temp_required_iterations;
+}
+
+
+/**
+* Second version: exact integer division (software division in the AVR).
+*/
+void division_required_iterations()
+{
+    bpm_freq_req_iter  = MILLISECONDS_IN_MINUTE / bpm;
+    bpm_freq_remainder = MILLISECONDS_IN_MINUTE % bpm;
+}
+
+
+/**
+* Current version: compile time table and one multiplication.
+*/
+void table_required_iterations()
+{
+    bpm_freq_req_iter = pgm_read_word(
+        &BeatPeriods::required_iterations[bpm - BPM_LOWER_BOUND]);
+    bpm_freq_remainder = MILLISECONDS_IN_MINUTE - (bpm_freq_req_iter * bpm);
+}
@@ -0,0 +1,472 @@
+/*******************************************************************************
+*   Project:        Beethduino, an Arduino Do-it-yourself electronic metronome.
+*
+*   File:           beethduino_host_benchmark_beat_timing.cpp
+*
+*   Description:    Host (PC) benchmark of the beat timing accuracy, with the
+*                   Beethduino library over the Arduino simulator. Records
+*                   the time of every rising edge of ACTIVE_BUZZER_PIN, for
+*                   every BPM value, in three scenarios: idle CPU, main loop
+*                   without pressings, and main loop with a button pressed
+*                   every 250 milliseconds (LCD redrawn in every release).
+*                   Reports, per BPM and per scenario:
+*                   - Mean period error: mean of (period - ideal period).
+*                   - Jitter: |period - ideal period|; p50, p99 and max.
+*                   - Drift: time of the last beat minus its ideal time.
+*                   - Latency: time from the Timer1 tick of the beat to the
+*                     rising edge; p50, p99 and max.
+*                   and the histograms of jitter and latency. The results are
+*                   written in a JSON file, to compare firmware revisions.
+*                   The program fails if the drift of any BPM reaches one
+*                   tick.
+*
+*   Language:       C++ (host, g++).
+*                   Compiled with CMake (target of the same name), with the
+*                   Arduino_simulator folder and Beethduino.cpp.
+*                   Usage: beethduino_host_benchmark_beat_timing
+*                          [json_file] [beats_per_bpm] [bpm_step]
+*
+*   Dependencies:   stdio.h
+*                   stdlib.h
+*                   algorithm
+*                   vector
+*                   Arduino_simulator.h
+*                   Beethduino.h
+*
+*   Notes:          BPM - Beats Per Minute.
+*                   LCD - Liquid Crystal Display.
+*                   All the times are in simulated nanoseconds. The ideal
+*                   period (60 / bpm seconds) is not a whole number of ticks
+*                   for most BPM values, so a jitter lower than one tick
+*                   (1 ms) is expected; the drift shall stay below one tick.
+*
+*   Author:         Alberto Martin Cajal
+*                   amartin.glimpse23@gmail.com
+*                   amartin<DOT>glimpse23<AT>gmail<DOT>.com
+*
+*   License:        GNU GPL v3.0
+*
+*   URL:            https://github.com/amcajal/beethduino
+*
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+
+#include "Arduino_simulator.h"
+#include "Beethduino.h"
+
+const char *DEFAULT_JSON_FILE               = "beethduino_beat_timing.json";
+const int DEFAULT_BEATS_PER_BPM             = 8;
+const int DEFAULT_BPM_STEP                  = 1;
+
+const unsigned long long TICK_NS            = SIM_NS_IN_MS;
+const double NS_IN_MINUTE                   = 60.0 * SIM_NS_IN_S;
+
+const unsigned long long BUTTON_PRESS_NS    = 100 * SIM_NS_IN_MS;
+const unsigned long long BUTTON_INTERVAL_NS = 250 * SIM_NS_IN_MS;
+
+/* Upper limits of the histogram buckets; the last one has no limit. */
+const long long HISTOGRAM_LIMITS_NS[]       = {0, 1000, 10000, 100000,
+                                               1000000, 10000000};
+const int HISTOGRAM_BUCKETS                 = 7;
+
+enum Scenario
+{
+    IDLE_CPU,
+    MAIN_LOOP,
+    BUTTONS_AND_LCD,
+    SCENARIOS
+};
+
+const char *SCENARIO_NAMES[SCENARIOS]       = {"idle_cpu", "main_loop",
+                                               "buttons_and_lcd"};
+
+struct BeatEdge
+{
+    unsigned long long time_ns;
+    unsigned long tick;
+};
+
+struct BpmResult
+{
+    int bpm;
+    int beats;
+    double mean_period_error_ns;
+    long long jitter_p50_ns;
+    long long jitter_p99_ns;
+    long long jitter_max_ns;
+    long long drift_ns;
+    long long latency_p50_ns;
+    long long latency_p99_ns;
+    long long latency_max_ns;
+};
+
+struct ScenarioResult
+{
+    std::vector<BpmResult> bpm_results;
+    std::vector<long long> all_jitters_ns;
+    std::vector<long long> all_latencies_ns;
+    long long max_abs_drift_ns;
+};
+
+Beethduino *beethduino;
+std::vector<BeatEdge> beat_edges;
+
+/******************************************************************************/
+
+
+/**
+* Returns false if the drift of any BPM reaches one tick (accumulated error).
+*/
+bool execute_benchmark(const char *json_file, int beats_per_bpm, int bpm_step);
+BpmResult measure_bpm(Scenario scenario, int bpm, int beats,
+                      ScenarioResult &scenario_result);
+void run_scenario(Scenario scenario, int beats, unsigned long long period_ns);
+void record_beat_edge(uint8_t pin, int level, unsigned long long time_ns);
+long long percentile(std::vector<long long> values, int percent);
+void fill_histogram(const std::vector<long long> &values, long *counts);
+void print_summary(Scenario scenario, const ScenarioResult &result);
+void write_json(const char *json_file, int beats_per_bpm, int bpm_step,
+                const ScenarioResult *results);
+void write_histogram(FILE *json, const char *name,
+                     const std::vector<long long> &values);
+
+
+int main(int argc, char *argv[])
+{
+    const char *json_file = (argc > 1) ? argv[1] : DEFAULT_JSON_FILE;
+    int beats_per_bpm = (argc > 2) ? atoi(argv[2]) : DEFAULT_BEATS_PER_BPM;
+    int bpm_step = (argc > 3) ? atoi(argv[3]) : DEFAULT_BPM_STEP;
+
+    if ((beats_per_bpm < 2) || (bpm_step < 1))
+    {
+        printf("Usage: %s [json_file] [beats_per_bpm >= 2] [bpm_step >= 1]\n",
+               argv[0]);
+        return 1;
+    }
+
+    printf("HOST BENCHMARK STARTED\n******************************\n");
+    printf("%%%%%%Benchmarking: beat timing accuracy\n");
+
+    bool is_drift_bounded = execute_benchmark(json_file, beats_per_bpm,
+                                              bpm_step);
+
+    printf("HOST BENCHMARK FINISHED\n******************************\n");
+    return (is_drift_bounded == true) ? 0 : 1;
+}
+
+
+bool execute_benchmark(const char *json_file, int beats_per_bpm, int bpm_step)
+{
+    ScenarioResult results[SCENARIOS];
+
+    for (int scenario = 0; scenario < SCENARIOS; scenario++)
+    {
+        results[scenario].max_abs_drift_ns = 0;
+
+        for (int bpm = Beethduino::BPM_LOWER_BOUND;
+             bpm <= Beethduino::BPM_UPPER_BOUND; bpm = bpm + bpm_step)
+        {
+            results[scenario].bpm_results.push_back(
+                measure_bpm((Scenario) scenario, bpm, beats_per_bpm,
+                            results[scenario]));
+        }
+
+        print_summary((Scenario) scenario, results[scenario]);
+    }
+
+    write_json(json_file, beats_per_bpm, bpm_step, results);
+    printf("    Results written in %s\n\n", json_file);
+
+    for (int scenario = 0; scenario < SCENARIOS; scenario++)
+    {
+        if (results[scenario].max_abs_drift_ns >= (long long) TICK_NS)
+        {
+            printf("BENCHMARK_FAILED: %s drift reaches one tick\n\n",
+                   SCENARIO_NAMES[scenario]);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+BpmResult measure_bpm(Scenario scenario, int bpm, int beats,
+                      ScenarioResult &scenario_result)
+{
+    BpmResult result;
+    std::vector<long long> jitters_ns;
+    std::vector<long long> latencies_ns;
+    double ideal_period_ns = NS_IN_MINUTE / bpm;
+
+    sim_reset();
+    Beethduino metronome;
+    beethduino = &metronome;
+    metronome.configure_button_interrupts();
+    metronome.configure_beat_timer();
+    unsigned long long timer_start_ns = sim_time_ns();
+
+    metronome.bpm = bpm;
+    metronome.calculate_required_iterations();
+    metronome.change_mute_state();
+
+    beat_edges.clear();
+    sim_set_pin_listener(record_beat_edge);
+    run_scenario(scenario, beats, (unsigned long long) ideal_period_ns);
+    sim_set_pin_listener(0);
+
+    double period_error_sum_ns = 0;
+    for (int beat = 0; beat < beats; beat++)
+    {
+        latencies_ns.push_back(beat_edges[beat].time_ns - timer_start_ns
+                               - beat_edges[beat].tick * TICK_NS);
+
+        if (beat > 0)
+        {
+            double period_error_ns = (double) (beat_edges[beat].time_ns
+                                     - beat_edges[beat - 1].time_ns)
+                                     - ideal_period_ns;
+            period_error_sum_ns = period_error_sum_ns + period_error_ns;
+            jitters_ns.push_back((long long) (period_error_ns < 0
+                                              ? -period_error_ns
+                                              : period_error_ns));
+        }
+    }
+
+    result.bpm = bpm;
+    result.beats = beats;
+    result.mean_period_error_ns = period_error_sum_ns / (beats - 1);
+    result.jitter_p50_ns = percentile(jitters_ns, 50);
+    result.jitter_p99_ns = percentile(jitters_ns, 99);
+    result.jitter_max_ns = percentile(jitters_ns, 100);
+    result.drift_ns = (long long) ((double) (beat_edges[beats - 1].time_ns
+                                   - beat_edges[0].time_ns)
+                                   - (beats - 1) * ideal_period_ns);
+    result.latency_p50_ns = percentile(latencies_ns, 50);
+    result.latency_p99_ns = percentile(latencies_ns, 99);
+    result.latency_max_ns = percentile(latencies_ns, 100);
+
+    scenario_result.all_jitters_ns.insert(scenario_result.all_jitters_ns.end(),
+                                          jitters_ns.begin(), jitters_ns.end());
+    scenario_result.all_latencies_ns.insert(
+        scenario_result.all_latencies_ns.end(),
+        latencies_ns.begin(), latencies_ns.end());
+    if (llabs(result.drift_ns) > scenario_result.max_abs_drift_ns)
+    {
+        scenario_result.max_abs_drift_ns = llabs(result.drift_ns);
+    }
+
+    beethduino = 0;
+    return result;
+}
+
+
+/**
+* Runs the simulation until the given number of beats is recorded.
+*/
+void run_scenario(Scenario scenario, int beats, unsigned long long period_ns)
+{
+    if (scenario == BUTTONS_AND_LCD)
+    {
+        /* ADD_OR_SUB does not change the tempo, but redraws the LCD. */
+        unsigned long long end_ns = sim_time_ns() + (beats + 1) * period_ns;
+
+        for (unsigned long long press_ns = sim_time_ns() + BUTTON_INTERVAL_NS;
+             press_ns < end_ns; press_ns = press_ns + BUTTON_INTERVAL_NS)
+        {
+            sim_schedule_pin_level(beethduino->ADD_OR_SUB_BPM_BUTTON_PIN,
+                                   HIGH, press_ns);
+            sim_schedule_pin_level(beethduino->ADD_OR_SUB_BPM_BUTTON_PIN,
+                                   LOW, press_ns + BUTTON_PRESS_NS);
+        }
+    }
+
+    while (beat_edges.size() < (unsigned int) beats)
+    {
+        if (scenario == IDLE_CPU)
+        {
+            sim_idle_until_ns(~0ULL);
+        }
+        else
+        {
+            unsigned long long loop_start_ns = sim_time_ns();
+
+            beethduino->exec_main_loop();
+            sim_finish_loop(loop_start_ns, ~0ULL);
+        }
+    }
+}
+
+
+void record_beat_edge(uint8_t pin, int level, unsigned long long time_ns)
+{
+    if ((pin == beethduino->ACTIVE_BUZZER_PIN) && (level == HIGH))
+    {
+        BeatEdge edge;
+
+        edge.time_ns = time_ns;
+        edge.tick = beethduino->timer_ticks;
+        beat_edges.push_back(edge);
+    }
+}
+
+
+/**
+* Nearest rank percentile (100 is the maximum).
+*/
+long long percentile(std::vector<long long> values, int percent)
+{
+    if (values.empty() == true)
+    {
+        return 0;
+    }
+
+    std::sort(values.begin(), values.end());
+
+    size_t rank = (values.size() * percent + 99) / 100;
+    if (rank == 0)
+    {
+        rank = 1;
+    }
+
+    return values[rank - 1];
+}
+
+
+void fill_histogram(const std::vector<long long> &values, long *counts)
+{
+    for (int bucket = 0; bucket < HISTOGRAM_BUCKETS; bucket++)
+    {
+        counts[bucket] = 0;
+    }
+
+    for (size_t i = 0; i < values.size(); i++)
+    {
+        int bucket = 0;
+
+        while ((bucket < HISTOGRAM_BUCKETS - 1)
+               && (values[i] > HISTOGRAM_LIMITS_NS[bucket]))
+        {
+            bucket++;
+        }
+        counts[bucket]++;
+    }
+}
+
+
+void print_summary(Scenario scenario, const ScenarioResult &result)
+{
+    printf("%s\n", SCENARIO_NAMES[scenario]);
+    printf("    %u BPM values, %u beats\n",
+           (unsigned int) result.bpm_results.size(),
+           (unsigned int) result.all_latencies_ns.size());
+    printf("    jitter   p50 %8lld ns, p99 %8lld ns, max %8lld ns\n",
+           percentile(result.all_jitters_ns, 50),
+           percentile(result.all_jitters_ns, 99),
+           percentile(result.all_jitters_ns, 100));
+    printf("    latency  p50 %8lld ns, p99 %8lld ns, max %8lld ns\n",
+           percentile(result.all_latencies_ns, 50),
+           percentile(result.all_latencies_ns, 99),
+           percentile(result.all_latencies_ns, 100));
+    printf("    max |drift| %lld ns\n", result.max_abs_drift_ns);
+    printf("\n");
+}
+
+
+void write_json(const char *json_file, int beats_per_bpm, int bpm_step,
+                const ScenarioResult *results)
+{
+    FILE *json = fopen(json_file, "w");
+
+    if (json == 0)
+    {
+        printf("    Error: %s can not be written\n", json_file);
+        exit(1);
+    }
+
+    fprintf(json, "{\n");
+    fprintf(json, "  \"benchmark\": \"beethduino_beat_timing\",\n");
+    fprintf(json, "  \"format_version\": 1,\n");
+    fprintf(json, "  \"time_unit\": \"ns\",\n");
+    fprintf(json, "  \"beats_per_bpm\": %d,\n", beats_per_bpm);
+    fprintf(json, "  \"bpm_step\": %d,\n", bpm_step);
+    fprintf(json, "  \"scenarios\": [\n");
+
+    for (int scenario = 0; scenario < SCENARIOS; scenario++)
+    {
+        const ScenarioResult &result = results[scenario];
+
+        fprintf(json, "    {\n");
+        fprintf(json, "      \"name\": \"%s\",\n", SCENARIO_NAMES[scenario]);
+        fprintf(json, "      \"summary\": {\"jitter_p50\": %lld, "
+                "\"jitter_p99\": %lld, \"jitter_max\": %lld, "
+                "\"latency_p50\": %lld, \"latency_p99\": %lld, "
+                "\"latency_max\": %lld, \"max_abs_drift\": %lld},\n",
+                percentile(result.all_jitters_ns, 50),
+                percentile(result.all_jitters_ns, 99),
+                percentile(result.all_jitters_ns, 100),
+                percentile(result.all_latencies_ns, 50),
+                percentile(result.all_latencies_ns, 99),
+                percentile(result.all_latencies_ns, 100),
+                result.max_abs_drift_ns);
+        write_histogram(json, "jitter_histogram", result.all_jitters_ns);
+        write_histogram(json, "latency_histogram", result.all_latencies_ns);
+        fprintf(json, "      \"bpm\": [\n");
+
+        for (size_t i = 0; i < result.bpm_results.size(); i++)
+        {
+            const BpmResult &bpm_result = result.bpm_results[i];
+
+            fprintf(json, "        {\"bpm\": %d, \"beats\": %d, "
+                    "\"mean_period_error\": %.1f, \"jitter_p50\": %lld, "
+                    "\"jitter_p99\": %lld, \"jitter_max\": %lld, "
+                    "\"drift\": %lld, \"latency_p50\": %lld, "
+                    "\"latency_p99\": %lld, \"latency_max\": %lld}%s\n",
+                    bpm_result.bpm, bpm_result.beats,
+                    bpm_result.mean_period_error_ns,
+                    bpm_result.jitter_p50_ns, bpm_result.jitter_p99_ns,
+                    bpm_result.jitter_max_ns, bpm_result.drift_ns,
+                    bpm_result.latency_p50_ns, bpm_result.latency_p99_ns,
+                    bpm_result.latency_max_ns,
+                    (i + 1 < result.bpm_results.size()) ? "," : "");
+        }
+
+        fprintf(json, "      ]\n");
+        fprintf(json, "    }%s\n", (scenario + 1 < SCENARIOS) ? "," : "");
+    }
+
+    fprintf(json, "  ]\n");
+    fprintf(json, "}\n");
+    fclose(json);
+}
+
+
+/**
+* Buckets as {"le": upper limit, "count": values}; "le": null is the last.
+*/
+void write_histogram(FILE *json, const char *name,
+                     const std::vector<long long> &values)
+{
+    long counts[HISTOGRAM_BUCKETS];
+
+    fill_histogram(values, counts);
+
+    fprintf(json, "      \"%s\": [", name);
+    for (int bucket = 0; bucket < HISTOGRAM_BUCKETS; bucket++)
+    {
+        if (bucket < HISTOGRAM_BUCKETS - 1)
+        {
+            fprintf(json, "{\"le\": %lld, \"count\": %ld}, ",
+                    HISTOGRAM_LIMITS_NS[bucket], counts[bucket]);
+        }
+        else
+        {
+            fprintf(json, "{\"le\": null, \"count\": %ld}", counts[bucket]);
+        }
+    }
+    fprintf(json, "],\n");
+}
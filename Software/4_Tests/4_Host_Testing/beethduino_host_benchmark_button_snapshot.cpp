@@ -0,0 +1,297 @@
+/*******************************************************************************
+*   Project:        Beethduino, an Arduino Do-it-yourself electronic metronome.
+*
+*   File:           beethduino_host_benchmark_button_snapshot.cpp
+*
+*   Description:    Host (PC) benchmark of the button input path, over the
+*                   Arduino simulator. Compares the three versions:
+*                   - Polling: the first "check_button_pressing", executed
+*                     in every main loop (two digitalRead per button).
+*                   - Pin by pin latch: pin change interrupt that reads
+*                     every button with digitalRead.
+*                   - Port snapshot latch: pin change interrupt that reads
+*                     PINB once and detects the edges with a XOR against
+*                     the previous snapshot (current version).
+*                   Checks that both latches detect the same events for
+*                   every transition of the five buttons, and reports the
+*                   CPU cycles of every version in the simulator.
+*
+*   Language:       C++ (host, g++).
+*                   Compiled with CMake (target of the same name), with the
+*                   Arduino_simulator folder.
+*
+*   Dependencies:   assert.h
+*                   stdio.h
+*                   vector
+*                   Arduino_simulator.h
+*
+*   Notes:          BPM - Beats Per Minute.
+*                   LCD - Liquid Crystal Display.
+*                   The cycles are the ones of the cost model of the
+*                   simulator (Arduino core calls and port reads; the rest
+*                   of the code takes no simulated time). The measurement
+*                   in the board is done by the sketch
+*                   1_Component_Testing/buttons_read_benchmark.c.
+*
+*   Author:         Alberto Martin Cajal
+*                   amartin.glimpse23@gmail.com
+*                   amartin<DOT>glimpse23<AT>gmail<DOT>.com
+*
+*   License:        GNU GPL v3.0
+*
+*   URL:            https://github.com/amcajal/beethduino
+*
+*******************************************************************************/
+#define __ASSERT_USE_STDERR
+
+#include <assert.h>
+#include <stdio.h>
+#include <vector>
+
+#include "Arduino_simulator.h"
+
+const int FIRST_BUTTON_PIN          = 9;
+const int LAST_BUTTON_PIN           = 13;
+const int BUTTONS                   = 5;
+const int PORTB_FIRST_PIN           = 8;
+const byte BUTTON_PINS_MASK         = (1 << PINB1) | (1 << PINB2)
+                                      | (1 << PINB3) | (1 << PINB4)
+                                      | (1 << PINB5);
+
+struct ButtonEvent
+{
+    int pin;
+    int level;
+};
+
+int last_pressed_button_pin;
+int performed_operations;
+
+byte pin_by_pin_levels;     /* Bit 0 is pin 9. */
+byte button_pin_levels;     /* PINB bits. */
+std::vector<ButtonEvent> pin_by_pin_events;
+std::vector<ButtonEvent> port_snapshot_events;
+
+/******************************************************************************/
+
+
+void execute_tests();
+void test_same_events();
+void benchmark_cycles();
+double measure_cycles(void (*input_path)(), byte button_levels);
+void set_button_levels(byte button_levels);
+void polling_check_button_pressing();
+void polling_detect_single_pulsation(int pin_to_check);
+void pin_by_pin_latch_button_events();
+void port_snapshot_latch_button_events();
+
+
+int main()
+{
+    printf("HOST BENCHMARK STARTED\n******************************\n");
+    printf("%%%%%%Benchmarking function: latch_button_events\n");
+
+    execute_tests();
+
+    printf("HOST BENCHMARK FINISHED\n******************************\n");
+    return 0;
+}
+
+
+void execute_tests()
+{
+    test_same_events();
+    benchmark_cycles();
+}
+
+
+/**
+* Every transition between two levels of the five buttons (32 x 32) gives
+* the same events, in the same order, with both latches.
+*/
+void test_same_events()
+{
+    printf("test_same_events\n");
+    sim_reset();
+
+    for (int from_levels = 0; from_levels < (1 << BUTTONS); from_levels++)
+    {
+        for (int to_levels = 0; to_levels < (1 << BUTTONS); to_levels++)
+        {
+            set_button_levels(from_levels);
+            pin_by_pin_levels = from_levels;
+            button_pin_levels = from_levels << 1;
+
+            set_button_levels(to_levels);
+            pin_by_pin_events.clear();
+            port_snapshot_events.clear();
+            pin_by_pin_latch_button_events();
+            port_snapshot_latch_button_events();
+
+            assert (pin_by_pin_levels == to_levels);
+            assert (button_pin_levels == (to_levels << 1));
+            assert (pin_by_pin_events.size() == port_snapshot_events.size());
+
+            for (size_t i = 0; i < pin_by_pin_events.size(); i++)
+            {
+                assert (pin_by_pin_events[i].pin
+                        == port_snapshot_events[i].pin);
+                assert (pin_by_pin_events[i].level
+                        == port_snapshot_events[i].level);
+            }
+        }
+    }
+    printf("\n");
+}
+
+
+/**
+* The polling is executed in every main loop; the latches only in the pin
+* change interrupts (one per edge).
+*/
+void benchmark_cycles()
+{
+    printf("benchmark_cycles\n");
+    sim_reset();
+
+    printf("    %-34s %10s %10s\n", "", "no change", "one edge");
+    printf("    %-34s %10.0f %10s\n", "polling (every main loop)",
+           measure_cycles(polling_check_button_pressing, 0), "-");
+    printf("    %-34s %10.0f %10.0f\n", "pin by pin latch (every edge)",
+           measure_cycles(pin_by_pin_latch_button_events, 0),
+           measure_cycles(pin_by_pin_latch_button_events, 1));
+    printf("    %-34s %10.0f %10.0f\n", "port snapshot latch (every edge)",
+           measure_cycles(port_snapshot_latch_button_events, 0),
+           measure_cycles(port_snapshot_latch_button_events, 1));
+
+    /* The snapshot reads the port once, whatever the number of buttons. */
+    assert (measure_cycles(port_snapshot_latch_button_events, 0)
+            < measure_cycles(pin_by_pin_latch_button_events, 0));
+    printf("\n");
+}
+
+
+/**
+* Simulated CPU cycles of one execution, with the buttons set from all
+* released to button_levels.
+*/
+double measure_cycles(void (*input_path)(), byte button_levels)
+{
+    set_button_levels(0);
+    pin_by_pin_levels = 0;
+    button_pin_levels = 0;
+    last_pressed_button_pin = 0;
+    set_button_levels(button_levels);
+
+    unsigned long long start_ns = sim_time_ns();
+    input_path();
+    unsigned long long elapsed_ns = sim_time_ns() - start_ns;
+
+    return (double) (elapsed_ns * SIM_CPU_CYCLES_IN_US) / SIM_NS_IN_US;
+}
+
+
+/**
+* Bit 0 of button_levels is pin 9.
+*/
+void set_button_levels(byte button_levels)
+{
+    for (int button = 0; button < BUTTONS; button++)
+    {
+        sim_set_pin_level(FIRST_BUTTON_PIN + button,
+                          ((button_levels & (1 << button)) != 0) ? HIGH : LOW);
+    }
+}
+
+/******************************************************************************/
+
+
+void polling_check_button_pressing()
+{
+    int pin_to_check;
+
+    for (pin_to_check = 9; pin_to_check <= 13; pin_to_check++)
+    {
+        polling_detect_single_pulsation(pin_to_check);
+    }
+}
+
+
+void polling_detect_single_pulsation(int pin_to_check)
+{
+    /* Detect what button is pressed. */
+    if (digitalRead(pin_to_check) == HIGH)
+    {
+        last_pressed_button_pin = pin_to_check;
+    }
+
+    /* Detect if the pressed button is now released. */
+    if ((digitalRead(pin_to_check) == LOW)
+        && (last_pressed_button_pin == pin_to_check))
+    {
+        last_pressed_button_pin = 0;
+        performed_operations++;
+    }
+}
+
+
+void pin_by_pin_latch_button_events()
+{
+    int pin_to_check;
+    byte pin_bit;
+    byte pin_level;
+
+    for (pin_to_check = FIRST_BUTTON_PIN; pin_to_check <= LAST_BUTTON_PIN;
+         pin_to_check++)
+    {
+        pin_bit = 1 << (pin_to_check - FIRST_BUTTON_PIN);
+        pin_level = digitalRead(pin_to_check);
+
+        if ((pin_level == HIGH) != ((pin_by_pin_levels & pin_bit) != 0))
+        {
+            ButtonEvent event = {pin_to_check, pin_level};
+
+            pin_by_pin_levels = pin_by_pin_levels ^ pin_bit;
+            pin_by_pin_events.push_back(event);
+        }
+    }
+}
+
+
+void port_snapshot_latch_button_events()
+{
+    int pin_to_check;
+    byte pin_bit;
+    byte port_snapshot;
+    byte changed_pins;
+
+    port_snapshot = PINB & BUTTON_PINS_MASK;
+    changed_pins = port_snapshot ^ button_pin_levels;
+    button_pin_levels = port_snapshot;
+
+    for (pin_to_check = FIRST_BUTTON_PIN;
+         (pin_to_check <= LAST_BUTTON_PIN) && (changed_pins != 0);
+         pin_to_check++)
+    {
+        pin_bit = 1 << (pin_to_check - PORTB_FIRST_PIN);
+
+        if ((changed_pins & pin_bit) != 0)
+        {
+            ButtonEvent event = {pin_to_check,
+                                 ((port_snapshot & pin_bit) != 0) ? HIGH : LOW};
+
+            changed_pins = changed_pins ^ pin_bit;
+            port_snapshot_events.push_back(event);
+        }
+    }
+}
+
+
+void __assert(const char *__func, const char *__file,
+              int __lineno, const char *__sexp)
+{
+    printf("TEST_FAILED\n%s\n%s\n%d\n%s\n", __file, __func, __lineno, __sexp);
+    fflush(stdout);
+
+    abort();
+}
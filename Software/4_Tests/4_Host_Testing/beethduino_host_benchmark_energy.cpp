@@ -0,0 +1,239 @@
+/*******************************************************************************
+*   Project:        Beethduino, an Arduino Do-it-yourself electronic metronome.
+*
+*   File:           beethduino_host_benchmark_energy.cpp
+*
+*   Description:    Host (PC) benchmark of the sleep between events of the
+*                   Beethduino library, over the Arduino simulator. Plays a
+*                   typical session (the tempo is set with the buttons, the
+*                   metronome plays with sub-beats, the tempo map runs, and
+*                   the metronome is left muted) with the main loop spinning
+*                   and sleeping. Checks that the beats are the same, and
+*                   reports the estimated fraction of the time the CPU is
+*                   active in every part of the session.
+*
+*   Language:       C++ (host, g++).
+*                   Compiled with CMake (target of the same name), with the
+*                   Arduino_simulator folder and Beethduino.cpp.
+*
+*   Dependencies:   assert.h
+*                   stdio.h
+*                   vector
+*                   Arduino_simulator.h
+*                   Beethduino.h
+*                   beethduino_host_test_helpers.h
+*
+*   Notes:          BPM - Beats Per Minute.
+*                   LCD - Liquid Crystal Display.
+*                   The active time is the simulated time not slept: the
+*                   Arduino core calls, the main loop overhead, and
+*                   SIM_WAKE_UP_NS per wake-up (the code of the interrupts
+*                   takes no simulated time). A main loop that spins is
+*                   always active.
+*
+*   Author:         Alberto Martin Cajal
+*                   amartin.glimpse23@gmail.com
+*                   amartin<DOT>glimpse23<AT>gmail<DOT>.com
+*
+*   License:        GNU GPL v3.0
+*
+*   URL:            https://github.com/amcajal/beethduino
+*
+*******************************************************************************/
+#define __ASSERT_USE_STDERR
+
+#include <assert.h>
+#include <stdio.h>
+#include <vector>
+
+#include "Arduino_simulator.h"
+#include "Beethduino.h"
+#include "beethduino_host_test_helpers.h"
+
+const unsigned long long SHORT_PRESS_NS     = 100 * SIM_NS_IN_MS;
+const unsigned long long LONG_PRESS_NS      = 1 * SIM_NS_IN_S;
+const unsigned long long HOLD_NS            = 3 * SIM_NS_IN_S;
+const double MAX_ACTIVE_FRACTION            = 0.05;
+
+struct SessionPart
+{
+    const char *name;
+    unsigned long long end_ns;
+};
+
+/* The session, from the power on: a short press of the mute button ends
+*  the playing (and the tempo map).
+*/
+const SessionPart SESSION_PARTS[] =
+{
+    {"setting the tempo (buttons)", 15 * SIM_NS_IN_S},
+    {"playing, 2 sub-beats", 255 * SIM_NS_IN_S},
+    {"muted", 260 * SIM_NS_IN_S},
+    {"tempo map", 380 * SIM_NS_IN_S},
+    {"muted", 600 * SIM_NS_IN_S}
+};
+const int SESSION_PARTS_COUNT = sizeof(SESSION_PARTS)
+                                / sizeof(SESSION_PARTS[0]);
+
+unsigned long long part_active_ns[SESSION_PARTS_COUNT];
+unsigned long part_sleeps[SESSION_PARTS_COUNT];
+
+/******************************************************************************/
+
+
+void execute_tests();
+void benchmark_session();
+void play_session(bool is_sleep_enabled);
+void schedule_session(Beethduino &metronome);
+void press_button(int pin, unsigned long long press_ns,
+                  unsigned long long duration_ns);
+
+
+int main()
+{
+    printf("HOST BENCHMARK STARTED\n******************************\n");
+    printf("%%%%%%Benchmarking function: sleep_until_event\n");
+
+    execute_tests();
+
+    printf("HOST BENCHMARK FINISHED\n******************************\n");
+    return 0;
+}
+
+
+void execute_tests()
+{
+    benchmark_session();
+}
+
+
+/**
+* The same session with the main loop spinning and sleeping: the beats
+* (buzzer edges) are the same, and the CPU only wakes up for the events.
+*/
+void benchmark_session()
+{
+    printf("benchmark_session\n");
+
+    play_session(false);
+    std::vector<unsigned long long> spinning_edges_ns = beat_edges_ns;
+
+    for (int part = 0; part < SESSION_PARTS_COUNT; part++)
+    {
+        assert (part_sleeps[part] == 0);
+    }
+
+    play_session(true);
+    assert (beat_edges_ns.size() > 0);
+    assert (beat_edges_ns == spinning_edges_ns);
+
+    unsigned long long previous_end_ns = 0;
+    unsigned long long session_active_ns = 0;
+
+    printf("    %-28s %8s %11s %9s\n", "part of the session", "time (s)",
+           "active (%)", "sleeps");
+
+    for (int part = 0; part < SESSION_PARTS_COUNT; part++)
+    {
+        unsigned long long part_ns = SESSION_PARTS[part].end_ns
+                                     - previous_end_ns;
+
+        printf("    %-28s %8.0f %11.2f %9lu\n", SESSION_PARTS[part].name,
+               (double) part_ns / SIM_NS_IN_S,
+               100.0 * part_active_ns[part] / part_ns, part_sleeps[part]);
+
+        session_active_ns = session_active_ns + part_active_ns[part];
+        previous_end_ns = SESSION_PARTS[part].end_ns;
+    }
+
+    double active_fraction = (double) session_active_ns / previous_end_ns;
+
+    printf("    %-28s %8.0f %11.2f (spinning: 100.00)\n", "whole session",
+           (double) previous_end_ns / SIM_NS_IN_S, 100.0 * active_fraction);
+    assert (active_fraction < MAX_ACTIVE_FRACTION);
+    printf("\n");
+}
+
+
+/**
+* Plays the session, and counts the active time and the sleeps of every
+* part of it.
+*/
+void play_session(bool is_sleep_enabled)
+{
+    sim_reset();
+    Beethduino metronome;
+    beethduino = &metronome;
+    metronome.configure_beat_timer();
+    metronome.configure_button_interrupts();
+    metronome.is_sleep_enabled = is_sleep_enabled;
+
+    beat_edges_ns.clear();
+    sim_set_pin_listener(record_beat_edge);
+    schedule_session(metronome);
+
+    for (int part = 0; part < SESSION_PARTS_COUNT; part++)
+    {
+        unsigned long long start_ns = sim_time_ns();
+        unsigned long long start_sleep_ns = sim_sleep_ns();
+        unsigned long start_sleeps = sim_sleeps();
+
+        run_main_loop_until(metronome, SESSION_PARTS[part].end_ns);
+
+        part_active_ns[part] = (sim_time_ns() - start_ns)
+                               - (sim_sleep_ns() - start_sleep_ns);
+        part_sleeps[part] = sim_sleeps() - start_sleeps;
+    }
+
+    assert (metronome.is_buzzer_muted == true);
+    sim_set_pin_listener(0);
+    beethduino = 0;
+}
+
+
+/**
+* The BPM by ten button is held, the BPM by one button is pressed three
+* times, the modifier button (long pressing) selects the eighths, and the
+* mute button unmutes, mutes, starts the tempo map (long pressing) and
+* stops it.
+*/
+void schedule_session(Beethduino &metronome)
+{
+    press_button(metronome.CHANGE_BPM_BY_TEN_BUTTON_PIN, 2 * SIM_NS_IN_S,
+                 HOLD_NS);
+
+    for (int press = 0; press < 3; press++)
+    {
+        press_button(metronome.CHANGE_BPM_BY_ONE_BUTTON_PIN,
+                     (8 + press) * SIM_NS_IN_S, SHORT_PRESS_NS);
+    }
+
+    press_button(metronome.ADD_OR_SUB_BPM_BUTTON_PIN, 12 * SIM_NS_IN_S,
+                 LONG_PRESS_NS);
+    press_button(metronome.MUTE_BUZZER_BUTTON_PIN,
+                 SESSION_PARTS[0].end_ns - SHORT_PRESS_NS, SHORT_PRESS_NS);
+    press_button(metronome.MUTE_BUZZER_BUTTON_PIN,
+                 SESSION_PARTS[1].end_ns - SHORT_PRESS_NS, SHORT_PRESS_NS);
+    press_button(metronome.MUTE_BUZZER_BUTTON_PIN,
+                 SESSION_PARTS[2].end_ns - LONG_PRESS_NS, LONG_PRESS_NS);
+    press_button(metronome.MUTE_BUZZER_BUTTON_PIN,
+                 SESSION_PARTS[3].end_ns - SHORT_PRESS_NS, SHORT_PRESS_NS);
+}
+
+
+void press_button(int pin, unsigned long long press_ns,
+                  unsigned long long duration_ns)
+{
+    sim_schedule_pin_level(pin, HIGH, press_ns);
+    sim_schedule_pin_level(pin, LOW, press_ns + duration_ns);
+}
+
+
+void __assert(const char *__func, const char *__file,
+              int __lineno, const char *__sexp)
+{
+    printf("TEST_FAILED\n%s\n%s\n%d\n%s\n", __file, __func, __lineno, __sexp);
+    fflush(stdout);
+
+    abort();
+}
@@ -0,0 +1,464 @@
+/*******************************************************************************
+*   Project:        Beethduino, an Arduino Do-it-yourself electronic metronome.
+*
+*   File:           beethduino_host_benchmark_lcd_update.cpp
+*
+*   Description:    Host (PC) benchmark of the LCD update of the Beethduino
+*                   library, over the Arduino simulator. Compares the two
+*                   versions:
+*                   - Clear and redraw: the first "update_lcd", that calls
+*                     lcd.clear() and prints both rows.
+*                   - Incremental: the shadow frame of the display is
+*                     compared with the new frame, and only the changed
+*                     characters are sent (current version).
+*                   Checks that both versions show the same text for every
+*                   operation, and reports the bytes sent to the LCD and the
+*                   simulated time of every update.
+*                   Under a user interface load (modifier button pressed
+*                   every 100 ms, with the buzzer sounding), compares the
+*                   frame sent in one main loop iteration with the frame
+*                   sent in slices (current version): longest iteration of
+*                   the main loop, and worst beat jitter.
+*
+*   Language:       C++ (host, g++).
+*                   Compiled with CMake (target of the same name), with the
+*                   Arduino_simulator folder and Beethduino.cpp.
+*
+*   Dependencies:   assert.h
+*                   stdio.h
+*                   string.h
+*                   vector
+*                   Arduino_simulator.h
+*                   LiquidCrystal.h
+*                   Beethduino.h
+*                   beethduino_host_test_helpers.h
+*
+*   Notes:          BPM - Beats Per Minute.
+*                   LCD - Liquid Crystal Display.
+*                   The time is the one of the cost model of the simulated
+*                   LiquidCrystal library (two nibbles per byte, and 2
+*                   milliseconds of lcd.clear()).
+*
+*   Author:         Alberto Martin Cajal
+*                   amartin.glimpse23@gmail.com
+*                   amartin<DOT>glimpse23<AT>gmail<DOT>.com
+*
+*   License:        GNU GPL v3.0
+*
+*   URL:            https://github.com/amcajal/beethduino
+*
+*******************************************************************************/
+#define __ASSERT_USE_STDERR
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "Arduino_simulator.h"
+#include "LiquidCrystal.h"
+#include "Beethduino.h"
+#include "beethduino_host_test_helpers.h"
+
+extern LiquidCrystal lcd;   /* Defined in Beethduino.cpp. */
+
+struct LcdState
+{
+    int bpm;
+    int bpm_modifier;
+    bool is_buzzer_muted;
+};
+
+struct LcdOperation
+{
+    const char *name;
+    LcdState from_state;
+    LcdState to_state;
+};
+
+struct LcdCost
+{
+    unsigned long bytes;
+    unsigned long long time_ns;
+    char rows[Beethduino::LCD_ROWS][LiquidCrystal::MAX_COLUMNS + 1];
+};
+
+const LcdOperation LCD_OPERATIONS[] =
+{
+    {"no change",               {60, 1, true},   {60, 1, true}},
+    {"BPM 60 to 61",            {60, 1, true},   {61, 1, true}},
+    {"BPM 60 to 70",            {60, 1, true},   {70, 1, true}},
+    {"BPM 95 to 105",           {95, 1, true},   {105, 1, true}},
+    {"BPM 100 to 99",           {100, -1, true}, {99, -1, true}},
+    {"modifier ADD to SUB",     {60, 1, true},   {60, -1, true}},
+    {"mute to unmute",          {60, 1, true},   {60, 1, false}},
+    {"unmute to mute",          {60, 1, false},  {60, 1, true}},
+};
+const int LCD_OPERATIONS_COUNT = sizeof(LCD_OPERATIONS)
+                                 / sizeof(LCD_OPERATIONS[0]);
+
+const int UI_LOAD_BPM                       = 240;
+const unsigned long long UI_LOAD_NS         = 10 * SIM_NS_IN_S;
+const unsigned long long BUTTON_INTERVAL_NS = 100 * SIM_NS_IN_MS;
+const unsigned long long BUTTON_PRESS_NS    = 50 * SIM_NS_IN_MS;
+const unsigned long long NS_IN_MINUTE       = 60 * SIM_NS_IN_S;
+
+/******************************************************************************/
+
+
+void execute_tests();
+void benchmark_operations();
+void benchmark_bpm_sweep();
+void benchmark_ui_load();
+void measure_ui_load(bool is_frame_sliced, unsigned long long &max_loop_ns,
+                     long long &max_jitter_ns);
+void flush_lcd();
+LcdCost measure_update(void (*update)(), const LcdState &from_state,
+                       const LcdState &to_state);
+void show_state(const LcdState &state);
+void set_state(const LcdState &state);
+void incremental_update_lcd();
+void clear_and_redraw_update_lcd();
+
+
+int main()
+{
+    printf("HOST BENCHMARK STARTED\n******************************\n");
+    printf("%%%%%%Benchmarking function: update_lcd\n");
+
+    execute_tests();
+
+    printf("HOST BENCHMARK FINISHED\n******************************\n");
+    return 0;
+}
+
+
+void execute_tests()
+{
+    sim_reset();
+    Beethduino metronome;
+    beethduino = &metronome;
+
+    benchmark_operations();
+    benchmark_bpm_sweep();
+
+    beethduino = 0;
+
+    benchmark_ui_load();
+}
+
+
+/**
+* One update per operation of the buttons. Both versions show the same text,
+* and the incremental one is always faster. Erasing the mute row sends more
+* bytes (15 spaces) than clearing it, but without the 2 ms of lcd.clear().
+*/
+void benchmark_operations()
+{
+    printf("benchmark_operations\n");
+    printf("    %-22s %21s %21s\n", "", "clear and redraw", "incremental");
+    printf("    %-22s %10s %10s %10s %10s\n", "operation",
+           "bytes", "us", "bytes", "us");
+
+    for (int operation = 0; operation < LCD_OPERATIONS_COUNT; operation++)
+    {
+        const LcdOperation &lcd_operation = LCD_OPERATIONS[operation];
+        LcdCost redraw = measure_update(clear_and_redraw_update_lcd,
+                                        lcd_operation.from_state,
+                                        lcd_operation.to_state);
+        LcdCost incremental = measure_update(incremental_update_lcd,
+                                             lcd_operation.from_state,
+                                             lcd_operation.to_state);
+
+        for (int row = 0; row < Beethduino::LCD_ROWS; row++)
+        {
+            assert (strcmp(redraw.rows[row], incremental.rows[row]) == 0);
+        }
+        assert (incremental.time_ns < redraw.time_ns);
+
+        printf("    %-22s %10lu %10.1f %10lu %10.1f\n", lcd_operation.name,
+               redraw.bytes, (double) redraw.time_ns / SIM_NS_IN_US,
+               incremental.bytes, (double) incremental.time_ns / SIM_NS_IN_US);
+    }
+    printf("\n");
+}
+
+
+/**
+* Every BPM value, from BPM_LOWER_BOUND to BPM_UPPER_BOUND and back, as
+* with the BPM buttons held (auto-repeat).
+*/
+void benchmark_bpm_sweep()
+{
+    printf("benchmark_bpm_sweep\n");
+
+    unsigned long redraw_bytes = 0;
+    unsigned long long redraw_time_ns = 0;
+    unsigned long incremental_bytes = 0;
+    unsigned long long incremental_time_ns = 0;
+    int updates = 0;
+
+    for (int modifier = 1; modifier >= -1; modifier = modifier - 2)
+    {
+        for (int step = 0;
+             step < Beethduino::BPM_UPPER_BOUND - Beethduino::BPM_LOWER_BOUND;
+             step++)
+        {
+            int bpm = (modifier == 1)
+                      ? (Beethduino::BPM_LOWER_BOUND + step)
+                      : (Beethduino::BPM_UPPER_BOUND - step);
+            LcdState from_state = {bpm, modifier, false};
+            LcdState to_state = {bpm + modifier, modifier, false};
+
+            LcdCost redraw = measure_update(clear_and_redraw_update_lcd,
+                                            from_state, to_state);
+            LcdCost incremental = measure_update(incremental_update_lcd,
+                                                 from_state, to_state);
+
+            for (int row = 0; row < Beethduino::LCD_ROWS; row++)
+            {
+                assert (strcmp(redraw.rows[row], incremental.rows[row]) == 0);
+            }
+
+            redraw_bytes = redraw_bytes + redraw.bytes;
+            redraw_time_ns = redraw_time_ns + redraw.time_ns;
+            incremental_bytes = incremental_bytes + incremental.bytes;
+            incremental_time_ns = incremental_time_ns + incremental.time_ns;
+            updates++;
+        }
+    }
+
+    printf("    %d updates; mean per update:\n", updates);
+    printf("    %-22s %10.1f bytes %10.1f us\n", "clear and redraw",
+           (double) redraw_bytes / updates,
+           (double) redraw_time_ns / updates / SIM_NS_IN_US);
+    printf("    %-22s %10.1f bytes %10.1f us\n", "incremental",
+           (double) incremental_bytes / updates,
+           (double) incremental_time_ns / updates / SIM_NS_IN_US);
+    printf("\n");
+}
+
+
+/**
+* The beats are generated by the timer interrupt, so the LCD does not delay
+* them in any version; sending the frame in slices bounds the iteration of
+* the main loop (the attention of the buttons) to LCD_BYTES_PER_SLICE bytes.
+*/
+void benchmark_ui_load()
+{
+    printf("benchmark_ui_load\n");
+
+    unsigned long long whole_max_loop_ns;
+    long long whole_max_jitter_ns;
+    unsigned long long sliced_max_loop_ns;
+    long long sliced_max_jitter_ns;
+
+    measure_ui_load(false, whole_max_loop_ns, whole_max_jitter_ns);
+    measure_ui_load(true, sliced_max_loop_ns, sliced_max_jitter_ns);
+
+    printf("    %-22s %16s %16s\n", "frame sent", "max loop (us)",
+           "max jitter (ns)");
+    printf("    %-22s %16.1f %16lld\n", "in one iteration",
+           (double) whole_max_loop_ns / SIM_NS_IN_US, whole_max_jitter_ns);
+    printf("    %-22s %16.1f %16lld\n", "in slices",
+           (double) sliced_max_loop_ns / SIM_NS_IN_US, sliced_max_jitter_ns);
+
+    assert (sliced_max_loop_ns < whole_max_loop_ns);
+    assert (sliced_max_loop_ns < SIM_NS_IN_MS);
+    assert (sliced_max_jitter_ns <= whole_max_jitter_ns);
+    printf("\n");
+}
+
+
+/**
+* UI_LOAD_NS at UI_LOAD_BPM, with the modifier button pressed every
+* BUTTON_INTERVAL_NS; every pressing redraws three characters.
+*/
+void measure_ui_load(bool is_frame_sliced, unsigned long long &max_loop_ns,
+                     long long &max_jitter_ns)
+{
+    sim_reset();
+    Beethduino metronome;
+    beethduino = &metronome;
+    metronome.configure_beat_timer();
+    metronome.configure_button_interrupts();
+
+    metronome.bpm = UI_LOAD_BPM;
+    metronome.calculate_required_iterations();
+    metronome.change_mute_state();
+    metronome.update_lcd();
+    flush_lcd();
+
+    unsigned long long end_ns = sim_time_ns() + UI_LOAD_NS;
+
+    for (unsigned long long press_ns = sim_time_ns() + BUTTON_INTERVAL_NS;
+         press_ns < end_ns; press_ns = press_ns + BUTTON_INTERVAL_NS)
+    {
+        sim_schedule_pin_level(metronome.ADD_OR_SUB_BPM_BUTTON_PIN, HIGH,
+                               press_ns);
+        sim_schedule_pin_level(metronome.ADD_OR_SUB_BPM_BUTTON_PIN, LOW,
+                               press_ns + BUTTON_PRESS_NS);
+    }
+
+    beat_edges_ns.clear();
+    sim_set_pin_listener(record_beat_edge);
+    max_loop_ns = 0;
+
+    while (sim_time_ns() < end_ns)
+    {
+        unsigned long long loop_start_ns = sim_time_ns();
+
+        metronome.exec_main_loop();
+        if (is_frame_sliced == false)
+        {
+            flush_lcd();
+        }
+
+        if (sim_time_ns() - loop_start_ns > max_loop_ns)
+        {
+            max_loop_ns = sim_time_ns() - loop_start_ns;
+        }
+        sim_finish_loop(loop_start_ns, end_ns);
+    }
+
+    sim_set_pin_listener(0);
+
+    max_jitter_ns = 0;
+    for (size_t beat = 1; beat < beat_edges_ns.size(); beat++)
+    {
+        long long jitter_ns = (long long) (beat_edges_ns[beat]
+                                           - beat_edges_ns[beat - 1])
+                              - (long long) (NS_IN_MINUTE / UI_LOAD_BPM);
+
+        if (llabs(jitter_ns) > max_jitter_ns)
+        {
+            max_jitter_ns = llabs(jitter_ns);
+        }
+    }
+
+    assert (beat_edges_ns.size() >= (UI_LOAD_NS / (NS_IN_MINUTE / UI_LOAD_BPM))
+                                     - 1);
+    beethduino = 0;
+}
+
+
+/**
+* The LCD shows from_state (drawn from a cleared display); the cost is the
+* one of the update to to_state.
+*/
+LcdCost measure_update(void (*update)(), const LcdState &from_state,
+                       const LcdState &to_state)
+{
+    LcdCost cost;
+
+    show_state(from_state);
+    set_state(to_state);
+
+    unsigned long start_bytes = lcd.sim_bytes_sent();
+    unsigned long long start_ns = sim_time_ns();
+    update();
+    cost.time_ns = sim_time_ns() - start_ns;
+    cost.bytes = lcd.sim_bytes_sent() - start_bytes;
+
+    for (int row = 0; row < Beethduino::LCD_ROWS; row++)
+    {
+        lcd.sim_read_row(row, cost.rows[row]);
+    }
+
+    return cost;
+}
+
+
+void show_state(const LcdState &state)
+{
+    lcd.clear();
+    beethduino->init_lcd_frame();
+    set_state(state);
+    beethduino->update_lcd();
+    flush_lcd();
+}
+
+
+void set_state(const LcdState &state)
+{
+    beethduino->bpm = state.bpm;
+    beethduino->bpm_modifier = state.bpm_modifier;
+    beethduino->is_buzzer_muted = state.is_buzzer_muted;
+}
+
+
+void incremental_update_lcd()
+{
+    beethduino->update_lcd();
+    flush_lcd();
+}
+
+
+/**
+* All the slices of the frame, in a row.
+*/
+void flush_lcd()
+{
+    while (beethduino->lcd_next_cell < Beethduino::LCD_CELLS)
+    {
+        beethduino->service_lcd();
+    }
+}
+
+/******************************************************************************/
+
+
+void clear_and_redraw_update_lcd()
+{
+    lcd.clear();
+
+    lcd.setCursor(0, 0);
+    if (beethduino->is_buzzer_muted == true)
+    {
+        lcd.print("MUTE_MUTE_MUTE_");
+    }
+    else if (beethduino->is_buzzer_muted == false)
+    {
+        lcd.print("");
+    }
+    else
+    {
+        /* No operation. */
+    }
+
+    String bpm_text_info;
+    lcd.setCursor(0, 1);
+
+    if (beethduino->bpm_modifier == -1)
+    {
+        bpm_text_info = "SUB BPM: ";
+    }
+    else if (beethduino->bpm_modifier == 1)
+    {
+        bpm_text_info = "ADD BPM: ";
+    }
+    else
+    {
+        /* No operation. */
+    }
+
+    bpm_text_info.concat(beethduino->bpm);
+    lcd.print(bpm_text_info);
+
+    /* Host build: the PROGMEM tables are in RAM. */
+    lcd.setCursor(Beethduino::SUBDIVISION_COLUMN, 0);
+    lcd.print(Beethduino::SUBDIVISIONS[beethduino->subdivision].text);
+
+    lcd.setCursor(Beethduino::TIME_SIGNATURE_COLUMN, 1);
+    lcd.print(Beethduino::TIME_SIGNATURES[beethduino->time_signature].text);
+}
+
+
+void __assert(const char *__func, const char *__file,
+              int __lineno, const char *__sexp)
+{
+    printf("TEST_FAILED\n%s\n%s\n%d\n%s\n", __file, __func, __lineno, __sexp);
+    fflush(stdout);
+
+    abort();
+}
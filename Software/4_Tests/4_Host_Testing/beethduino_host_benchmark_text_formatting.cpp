@@ -0,0 +1,372 @@
+/*******************************************************************************
+*   Project:        Beethduino, an Arduino Do-it-yourself electronic metronome.
+*
+*   File:           beethduino_host_benchmark_text_formatting.cpp
+*
+*   Description:    Host (PC) benchmark of the text formatting of the
+*                   Beethduino library, over the Arduino simulator. Compares
+*                   the two versions:
+*                   - String: the first "update_serial_monitor", that builds
+*                     the text concatenating a local String, as the first
+*                     "update_lcd" did.
+*                   - Buffers: texts in the flash memory (PROGMEM), and the
+*                     BPM formatted by format_number in a stack buffer
+*                     (current version).
+*                   Checks that format_number gives the same digits as
+*                   snprintf for every unsigned int of 16 bits, and that both
+*                   versions give the same text for every state; reports the
+*                   heap allocations and the host time of every text, and the
+*                   RAM, flash and cycles of both versions in the firmware
+*                   (cost model).
+*
+*   Language:       C++ (host, g++).
+*                   Compiled with CMake (target of the same name), with the
+*                   Arduino_simulator folder and Beethduino.cpp.
+*
+*   Dependencies:   assert.h
+*                   stdio.h
+*                   string.h
+*                   chrono
+*                   new
+*                   Arduino_simulator.h
+*                   Beethduino.h
+*
+*   Notes:          BPM - Beats Per Minute.
+*                   LCD - Liquid Crystal Display.
+*                   The heap allocations are counted replacing the global
+*                   operator new (the String of the simulator is built over
+*                   std::string); the AVR String allocates with malloc in
+*                   every concatenation that grows the text.
+*                   The host time is only a reference: there is no AVR
+*                   compiler in the host, so the cycles in the Arduino are
+*                   not measured.
+*                   AVR cost model (ATmega328P at 16 MHz, avr-gcc -Os, the
+*                   text of 300 BPM, unmuted): estimated from the code every
+*                   version links, not measured with avr-size:
+*                   - String: the members of the core String used (about 500
+*                     bytes), itoa (about 150 bytes) and the avr-libc
+*                     malloc, realloc and free (about 800 bytes, and 10
+*                     bytes of RAM for their state). The text makes three
+*                     heap blocks grow and frees one (about 180 cycles each)
+*                     and copies about 40 characters (6 cycles each).
+*                   - Buffers: format_number, print_lcd_frame_P and
+*                     append_text_info_P (about 150 bytes). The label is
+*                     read from the flash (about 10 cycles per character).
+*                   Both versions divide by 10 for every digit: one libgcc
+*                   __udivmodhi4 (about 210 cycles), the same cost in both.
+*                   No other code of the firmware uses String, so its code
+*                   and malloc are not linked any more. The literals take
+*                   the same flash in both versions (the initial values of
+*                   the RAM are in the flash too).
+*
+*   Author:         Alberto Martin Cajal
+*                   amartin.glimpse23@gmail.com
+*                   amartin<DOT>glimpse23<AT>gmail<DOT>.com
+*
+*   License:        GNU GPL v3.0
+*
+*   URL:            https://github.com/amcajal/beethduino
+*
+*******************************************************************************/
+#define __ASSERT_USE_STDERR
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <new>
+
+#include "Arduino_simulator.h"
+#include "Beethduino.h"
+
+const unsigned long NUMBER_RANGE    = 65536;
+const int TIMING_ROUNDS             = 200;
+const int AVR_STRING_OBJECT_SIZE    = 6;    /* Buffer, capacity and length. */
+const int AVR_MALLOC_HEADER_SIZE    = 2;    /* Size of every heap block. */
+const int AVR_MALLOC_STATE_SIZE     = 10;   /* __brkval, __flp, margins. */
+
+/* AVR cost model of both versions (see the notes). */
+const double AVR_CYCLES_IN_US       = 16.00;    /* 16 MHz. */
+const int AVR_STRING_FLASH_BYTES    = 500 + 150 + 800;
+const int AVR_BUFFERS_FLASH_BYTES   = 150;
+const int AVR_HEAP_OPERATION_CYCLES = 180;
+const int AVR_STRING_HEAP_OPERATIONS = 4;
+const int AVR_STRING_COPIED_CHARACTERS = 40;
+const int AVR_RAM_COPY_CYCLES       = 6;    /* ld, st, test and branch. */
+const int AVR_FLASH_COPY_CYCLES     = 10;   /* lpm, st, test and branch. */
+const int AVR_DIGIT_CYCLES          = 210;  /* __udivmodhi4 by 10. */
+const int AVR_DIGITS                = 3;    /* 300 BPM. */
+
+unsigned long heap_allocations = 0;
+String string_text_info;
+
+/******************************************************************************/
+
+
+void execute_tests();
+void test_format_number();
+void benchmark_texts(Beethduino &metronome);
+void report_ram_usage();
+void report_avr_cost_model();
+void set_state(Beethduino &metronome, int bpm, int bpm_modifier,
+               bool is_buzzer_muted);
+void string_update_serial_monitor(Beethduino &metronome);
+double measure_ns_per_text(Beethduino &metronome, bool is_string_used);
+
+
+void *operator new(size_t size)
+{
+    void *block = malloc(size);
+
+    if (block == 0)
+    {
+        throw std::bad_alloc();
+    }
+
+    heap_allocations++;
+    return block;
+}
+
+
+void operator delete(void *block) noexcept
+{
+    free(block);
+}
+
+
+void operator delete(void *block, size_t size) noexcept
+{
+    (void) size;
+    free(block);
+}
+
+
+int main()
+{
+    printf("HOST BENCHMARK STARTED\n******************************\n");
+    printf("%%%%%%Benchmarking function: update_serial_monitor\n");
+
+    execute_tests();
+
+    printf("HOST BENCHMARK FINISHED\n******************************\n");
+    return 0;
+}
+
+
+void execute_tests()
+{
+    sim_reset();
+    Beethduino metronome;
+
+    test_format_number();
+    benchmark_texts(metronome);
+    report_ram_usage();
+    report_avr_cost_model();
+}
+
+
+void test_format_number()
+{
+    printf("test_format_number\n");
+    Beethduino metronome;
+    char text[Beethduino::NUMBER_TEXT_SIZE];
+    char expected_text[Beethduino::NUMBER_TEXT_SIZE];
+
+    for (unsigned long number = 0; number < NUMBER_RANGE; number++)
+    {
+        memset(text, 'X', sizeof(text));
+        metronome.format_number(number, text);
+        snprintf(expected_text, sizeof(expected_text), "%lu", number);
+
+        assert (strcmp(text, expected_text) == 0);
+    }
+
+    printf("    %lu numbers, same digits as snprintf\n", NUMBER_RANGE);
+    printf("\n");
+}
+
+
+/**
+* Every BPM, with both modifiers, muted and unmuted: both versions give the
+* same text, and the buffers version never uses the heap.
+*/
+void benchmark_texts(Beethduino &metronome)
+{
+    printf("benchmark_texts\n");
+    unsigned long texts = 0;
+    unsigned long string_allocations = 0;
+    unsigned long buffer_allocations = 0;
+
+    for (int bpm = Beethduino::BPM_LOWER_BOUND;
+         bpm <= Beethduino::BPM_UPPER_BOUND; bpm++)
+    {
+        for (int bpm_modifier = -1; bpm_modifier <= 1; bpm_modifier += 2)
+        {
+            for (int is_muted = 0; is_muted <= 1; is_muted++)
+            {
+                set_state(metronome, bpm, bpm_modifier, is_muted == 1);
+
+                unsigned long start_allocations = heap_allocations;
+                string_update_serial_monitor(metronome);
+                string_allocations += heap_allocations - start_allocations;
+
+                start_allocations = heap_allocations;
+                metronome.update_serial_monitor();
+                metronome.update_lcd();
+                buffer_allocations += heap_allocations - start_allocations;
+
+                assert (string_text_info == metronome.bpm_text_info);
+                texts++;
+            }
+        }
+    }
+
+    assert (buffer_allocations == 0);
+
+    set_state(metronome, Beethduino::BPM_UPPER_BOUND, 1, true);
+    double string_ns = measure_ns_per_text(metronome, true);
+    double buffer_ns = measure_ns_per_text(metronome, false);
+
+    printf("    %lu texts, same text in both versions\n", texts);
+    printf("    %-10s %20s %14s\n", "version", "heap allocs/text",
+           "host ns/text");
+    printf("    %-10s %20.2f %14.1f\n", "String",
+           (double) string_allocations / texts, string_ns);
+    printf("    %-10s %20.2f %14.1f\n", "buffers",
+           (double) buffer_allocations / texts, buffer_ns);
+    printf("\n");
+}
+
+
+/**
+* In the AVR, every string literal is copied to the RAM at start-up, unless
+* it is in PROGMEM; the String also keeps its object and a heap block.
+*/
+void report_ram_usage()
+{
+    printf("report_ram_usage\n");
+    int literals_size = sizeof("MUTE_MUTE_MUTE_") + sizeof("")
+                        + sizeof("SUB BPM: ") + sizeof("ADD BPM: ");
+    int string_size = AVR_STRING_OBJECT_SIZE + AVR_MALLOC_HEADER_SIZE
+                      + sizeof("SUB BPM: 300");
+    int buffer_size = Beethduino::NUMBER_TEXT_SIZE;
+
+    printf("    texts moved from RAM to flash:      %3d bytes\n", literals_size);
+    printf("    String of update_lcd (stack, heap): %3d bytes\n", string_size);
+    printf("    buffer of update_lcd (stack):       %3d bytes\n", buffer_size);
+    printf("    state of malloc (not linked now):   %3d bytes\n",
+           AVR_MALLOC_STATE_SIZE);
+    printf("\n");
+}
+
+
+/**
+* Flash and cycles of the text of 300 BPM in the AVR, estimated (see the
+* notes).
+*/
+void report_avr_cost_model()
+{
+    printf("report_avr_cost_model (estimated, not measured)\n");
+    int label_size = sizeof("ADD BPM: ") - 1;
+    int digits_cycles = AVR_DIGITS * AVR_DIGIT_CYCLES;
+    int string_cycles = AVR_STRING_HEAP_OPERATIONS * AVR_HEAP_OPERATION_CYCLES
+                        + AVR_STRING_COPIED_CHARACTERS * AVR_RAM_COPY_CYCLES
+                        + digits_cycles;
+    int buffer_cycles = label_size * AVR_FLASH_COPY_CYCLES
+                        + AVR_DIGITS * AVR_RAM_COPY_CYCLES + digits_cycles;
+
+    printf("    %-10s %13s %12s %10s\n", "version", "flash (bytes)",
+           "cycles/text", "us (16MHz)");
+    printf("    %-10s %13d %12d %10.2f\n", "String", AVR_STRING_FLASH_BYTES,
+           string_cycles, string_cycles / AVR_CYCLES_IN_US);
+    printf("    %-10s %13d %12d %10.2f\n", "buffers", AVR_BUFFERS_FLASH_BYTES,
+           buffer_cycles, buffer_cycles / AVR_CYCLES_IN_US);
+    printf("    buffers vs String: %+d bytes of flash, %+d cycles per text\n",
+           AVR_BUFFERS_FLASH_BYTES - AVR_STRING_FLASH_BYTES,
+           buffer_cycles - string_cycles);
+    printf("\n");
+}
+
+
+void set_state(Beethduino &metronome, int bpm, int bpm_modifier,
+               bool is_buzzer_muted)
+{
+    metronome.bpm = bpm;
+    metronome.bpm_modifier = bpm_modifier;
+    metronome.is_buzzer_muted = is_buzzer_muted;
+}
+
+
+/**
+* Copy of the first update_serial_monitor (String version), with the text
+* built in a local String, as the first update_lcd did.
+*/
+void string_update_serial_monitor(Beethduino &metronome)
+{
+    String bpm_text_info;
+
+    if (metronome.is_buzzer_muted == true)
+    {
+        bpm_text_info = "MUTE_MUTE_MUTE_LFCR";
+    }
+    else if (metronome.is_buzzer_muted == false)
+    {
+        bpm_text_info = "LFCR";
+    }
+    else
+    {
+        /* No operation. */
+    }
+
+    if (metronome.bpm_modifier == -1)
+    {
+        bpm_text_info.concat("SUB BPM: ");
+    }
+    else if (metronome.bpm_modifier == 1)
+    {
+        bpm_text_info.concat("ADD BPM: ");
+    }
+    else
+    {
+        /* No operation. */
+    }
+
+    bpm_text_info.concat(metronome.bpm);
+    string_text_info = bpm_text_info;
+}
+
+
+double measure_ns_per_text(Beethduino &metronome, bool is_string_used)
+{
+    unsigned long rounds = TIMING_ROUNDS * NUMBER_RANGE / 64;
+    std::chrono::steady_clock::time_point start
+        = std::chrono::steady_clock::now();
+
+    for (unsigned long round = 0; round < rounds; round++)
+    {
+        if (is_string_used == true)
+        {
+            string_update_serial_monitor(metronome);
+        }
+        else
+        {
+            metronome.update_serial_monitor();
+        }
+    }
+
+    std::chrono::steady_clock::time_point end
+        = std::chrono::steady_clock::now();
+
+    return (double) std::chrono::duration_cast<std::chrono::nanoseconds>(
+               end - start).count() / rounds;
+}
+
+
+void __assert(const char *__func, const char *__file,
+              int __lineno, const char *__sexp)
+{
+    printf("TEST_FAILED\n%s\n%s\n%d\n%s\n", __file, __func, __lineno, __sexp);
+    fflush(stdout);
+
+    abort();
+}
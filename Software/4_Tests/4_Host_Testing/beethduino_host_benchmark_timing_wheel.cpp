@@ -0,0 +1,579 @@
+/*******************************************************************************
+*   Project:        Beethduino, an Arduino Do-it-yourself electronic metronome.
+*
+*   File:           beethduino_host_benchmark_timing_wheel.cpp
+*
+*   Description:    Host (PC) benchmark of the timer interrupt scheduler.
+*                   Compares the two versions:
+*                   - Deadline polling: the first "process_bpm_frequency",
+*                     that compares the deadline of every timed event with
+*                     the tick, in every tick.
+*                   - Timing wheel: "serve_timer_wheel" and "arm_timer"
+*                     (current version), that only look at the slot of the
+*                     tick.
+*                   Checks that both expire the same timers at the same
+*                   ticks (periodic timers, armed and cancelled at random,
+*                   across the overflow of the ticks), and reports the time
+*                   per tick with 1, 10 and 100 concurrent timers.
+*
+*   Language:       C++ (host, g++).
+*                   Compiled with: g++ -std=c++11 -O2 -o timing_wheel_benchmark
+*                                  beethduino_host_benchmark_timing_wheel.cpp
+*
+*   Dependencies:   assert.h
+*                   stdint.h
+*                   stdio.h
+*                   chrono
+*                   vector
+*
+*   Notes:          The main code has TIMERS (10) timers, and its due timers
+*                   are the bits of one unsigned int; here they are words of
+*                   DUE_WORD_BITS bits, for up to MAX_TIMERS timers.
+*                   The ticks are 32 bits, as the unsigned long of the AVR.
+*                   The PC has caches and a branch predictor, so the
+*                   measured times are only relative.
+*
+*   Author:         Alberto Martin Cajal
+*                   amartin.glimpse23@gmail.com
+*                   amartin<DOT>glimpse23<AT>gmail<DOT>.com
+*
+*   License:        GNU GPL v3.0
+*
+*   URL:            https://github.com/amcajal/beethduino
+*
+*******************************************************************************/
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <chrono>
+#include <vector>
+
+typedef unsigned char byte;
+typedef uint32_t tick_t;    /* unsigned long of the AVR. */
+
+const byte TIMER_WHEEL_SLOT_BITS    = 4;
+const byte TIMER_WHEEL_SLOTS        = 1 << TIMER_WHEEL_SLOT_BITS;
+const byte TIMER_WHEEL_LEVELS       = 4;
+const tick_t TIMER_WHEEL_RANGE
+    = 1UL << (TIMER_WHEEL_SLOT_BITS * TIMER_WHEEL_LEVELS);
+const byte NO_TIMER                 = 0xFF;
+const byte TIMER_IDLE               = 0xFF;
+const byte TIMER_DUE                = 0xFE;
+
+const byte MAX_TIMERS               = 100;
+const byte DUE_WORD_BITS            = 16;   /* unsigned int of the AVR. */
+const byte DUE_WORDS = (MAX_TIMERS + DUE_WORD_BITS - 1) / DUE_WORD_BITS;
+
+const int TESTED_TIMERS[]           = {1, 10, 100};
+const int TESTED_TIMERS_COUNT       = sizeof(TESTED_TIMERS)
+                                      / sizeof(TESTED_TIMERS[0]);
+
+const tick_t FIRST_TICK             = 0xFFFFFFFFUL - 200000; /* Overflow. */
+const tick_t TESTED_TICKS           = 400000;
+const tick_t BENCHMARK_TICKS        = 2000000;
+const unsigned long CHURN_PERIOD    = 32;   /* Main loop changes, in ticks. */
+
+struct ExpiredTimer
+{
+    tick_t tick;
+    byte timer;
+};
+
+int timers;                 /* Concurrent timers of the run. */
+unsigned long random_state;
+bool is_recording;
+std::vector<ExpiredTimer> expired_timers;
+unsigned long expired_count;
+
+tick_t timer_ticks;
+
+/* Deadline polling. */
+bool polled_armed[MAX_TIMERS];
+tick_t polled_deadlines[MAX_TIMERS];
+
+/* Timing wheel. */
+tick_t wheel_tick;
+byte timer_wheel_slots[TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS];
+tick_t timer_expiry_ticks[MAX_TIMERS];
+byte timer_slots[MAX_TIMERS];
+byte next_timers[MAX_TIMERS];
+byte previous_timers[MAX_TIMERS];
+unsigned int due_timers[DUE_WORDS];
+
+struct Scheduler
+{
+    void (*init)();
+    void (*serve)();
+    void (*arm)(byte timer, tick_t tick);
+    void (*cancel)(byte timer);
+};
+
+void polled_init();
+void polled_serve();
+void polled_arm(byte timer, tick_t tick);
+void polled_cancel(byte timer);
+void init_timer_wheel();
+void serve_timer_wheel();
+void wheel_arm_timer(byte timer, tick_t tick);
+void cancel_timer(byte timer);
+
+const Scheduler POLLING     = {polled_init, polled_serve, polled_arm,
+                               polled_cancel};
+const Scheduler WHEEL       = {init_timer_wheel, serve_timer_wheel,
+                               wheel_arm_timer, cancel_timer};
+
+const Scheduler *scheduler; /* The one of the run (re-armed on expiry). */
+
+/******************************************************************************/
+
+
+void execute_tests();
+void test_same_expiries();
+void benchmark_ticks();
+void run_scheduler(const Scheduler &run_with, int run_timers,
+                   tick_t ticks, bool is_churned);
+double measure_ns_per_tick(const Scheduler &run_with, int run_timers);
+unsigned long next_random();
+tick_t random_period();
+void expire_timer(byte timer);
+void cascade_timer_wheel();
+void cascade_timer_slot(byte slot);
+void collect_due_timers(byte slot);
+void link_timer(byte timer);
+
+
+int main()
+{
+    printf("HOST BENCHMARK STARTED\n******************************\n");
+    printf("%%%%%%Benchmarking function: serve_timer_wheel\n");
+
+    execute_tests();
+
+    printf("HOST BENCHMARK FINISHED\n******************************\n");
+    return 0;
+}
+
+
+void execute_tests()
+{
+    test_same_expiries();
+    benchmark_ticks();
+}
+
+
+/**
+* Both schedulers, with the same random arming and cancelling, expire the
+* same timers, in the same ticks and in the same order (lowest number
+* first in a tick).
+*/
+void test_same_expiries()
+{
+    printf("test_same_expiries\n");
+
+    for (int test = 0; test < TESTED_TIMERS_COUNT; test++)
+    {
+        is_recording = true;
+
+        run_scheduler(POLLING, TESTED_TIMERS[test], TESTED_TICKS, true);
+        std::vector<ExpiredTimer> polled_timers = expired_timers;
+
+        run_scheduler(WHEEL, TESTED_TIMERS[test], TESTED_TICKS, true);
+
+        assert (polled_timers.size() > (size_t) TESTED_TIMERS[test]);
+        assert (expired_timers.size() == polled_timers.size());
+
+        for (size_t i = 0; i < expired_timers.size(); i++)
+        {
+            assert (expired_timers[i].tick == polled_timers[i].tick);
+            assert (expired_timers[i].timer == polled_timers[i].timer);
+        }
+
+        printf("    %3d timers: %lu expiries\n", TESTED_TIMERS[test],
+               (unsigned long) expired_timers.size());
+    }
+
+    is_recording = false;
+    printf("\n");
+}
+
+
+/**
+* Periodic timers (as beats, sounds and auto-repeats): the polling cost
+* grows with the timers, the wheel cost with the expiries.
+*/
+void benchmark_ticks()
+{
+    printf("benchmark_ticks\n");
+    printf("    %-10s %18s %18s\n", "timers", "polling (ns/tick)",
+           "wheel (ns/tick)");
+
+    for (int test = 0; test < TESTED_TIMERS_COUNT; test++)
+    {
+        double polled_ns = measure_ns_per_tick(POLLING, TESTED_TIMERS[test]);
+        unsigned long polled_count = expired_count;
+        double wheel_ns = measure_ns_per_tick(WHEEL, TESTED_TIMERS[test]);
+
+        assert (expired_count == polled_count);
+        printf("    %-10d %18.2f %18.2f\n", TESTED_TIMERS[test], polled_ns,
+               wheel_ns);
+    }
+
+    printf("\n");
+}
+
+
+/**
+* Every timer is armed at a random period; an expired timer is armed again
+* at a new one. With churn, every CHURN_PERIOD ticks the main loop arms or
+* cancels a random timer (as the buttons do with the beats and holds).
+*/
+void run_scheduler(const Scheduler &run_with, int run_timers,
+                   tick_t ticks, bool is_churned)
+{
+    scheduler = &run_with;
+    timers = run_timers;
+    random_state = 1;
+    expired_timers.clear();
+    expired_count = 0;
+    timer_ticks = FIRST_TICK;
+    scheduler->init();
+
+    for (int timer = 0; timer < timers; timer++)
+    {
+        scheduler->arm(timer, timer_ticks + random_period());
+    }
+
+    for (tick_t tick = 0; tick < ticks; tick++)
+    {
+        timer_ticks++;
+        scheduler->serve();
+
+        if ((is_churned == true) && ((tick % CHURN_PERIOD) == 0))
+        {
+            byte timer = next_random() % timers;
+
+            if ((next_random() & 3) == 0)
+            {
+                scheduler->cancel(timer);
+            }
+            else
+            {
+                scheduler->arm(timer, timer_ticks + random_period());
+            }
+        }
+    }
+}
+
+
+double measure_ns_per_tick(const Scheduler &run_with, int run_timers)
+{
+    std::chrono::steady_clock::time_point start
+        = std::chrono::steady_clock::now();
+
+    run_scheduler(run_with, run_timers, BENCHMARK_TICKS, false);
+
+    std::chrono::duration<double, std::nano> elapsed
+        = std::chrono::steady_clock::now() - start;
+
+    return elapsed.count() / BENCHMARK_TICKS;
+}
+
+
+/**
+* Linear congruential generator (the same sequence for both schedulers).
+*/
+unsigned long next_random()
+{
+    random_state = (random_state * 1103515245UL + 12345UL) & 0x7FFFFFFFUL;
+    return random_state >> 8;
+}
+
+
+/**
+* Mostly short periods (sounds, debouncing, sub-beats), some up to the
+* longest beat period (every level of the wheel is used). At least 1 tick.
+*/
+tick_t random_period()
+{
+    unsigned long selector = next_random() & 7;
+
+    if (selector < 4)
+    {
+        return 1 + (next_random() % 64);
+    }
+    else if (selector < 7)
+    {
+        return 1 + (next_random() % 2000);
+    }
+    else
+    {
+        return 1 + (next_random() % (TIMER_WHEEL_RANGE - 1));
+    }
+}
+
+
+void expire_timer(byte timer)
+{
+    if (is_recording == true)
+    {
+        ExpiredTimer expired = {timer_ticks, timer};
+        expired_timers.push_back(expired);
+    }
+
+    expired_count++;
+    scheduler->arm(timer, timer_ticks + random_period());
+}
+
+/******************************************************************************/
+
+
+void polled_init()
+{
+    for (int timer = 0; timer < MAX_TIMERS; timer++)
+    {
+        polled_armed[timer] = false;
+    }
+}
+
+
+/**
+* First version: every deadline is compared with the tick, in every tick.
+*/
+void polled_serve()
+{
+    for (int timer = 0; timer < timers; timer++)
+    {
+        if ((polled_armed[timer] == true)
+            && ((int32_t) (timer_ticks - polled_deadlines[timer]) >= 0))
+        {
+            polled_armed[timer] = false;
+            expire_timer(timer);
+        }
+    }
+}
+
+
+void polled_arm(byte timer, tick_t tick)
+{
+    polled_armed[timer] = true;
+    polled_deadlines[timer] = tick;
+}
+
+
+void polled_cancel(byte timer)
+{
+    polled_armed[timer] = false;
+}
+
+/******************************************************************************/
+
+
+/**
+* Current version (Beethduino.c), with the due timers in DUE_WORDS words.
+*/
+void init_timer_wheel()
+{
+    byte slot;
+    byte timer;
+    byte word;
+
+    for (slot = 0; slot < (TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS); slot++)
+    {
+        timer_wheel_slots[slot] = NO_TIMER;
+    }
+
+    for (timer = 0; timer < MAX_TIMERS; timer++)
+    {
+        timer_slots[timer] = TIMER_IDLE;
+    }
+
+    for (word = 0; word < DUE_WORDS; word++)
+    {
+        due_timers[word] = 0;
+    }
+
+    wheel_tick = timer_ticks;
+}
+
+
+void serve_timer_wheel()
+{
+    byte timer;
+    byte word;
+
+    while (wheel_tick != timer_ticks)
+    {
+        wheel_tick++;
+
+        if ((wheel_tick & (TIMER_WHEEL_SLOTS - 1)) == 0)
+        {
+            cascade_timer_wheel();
+        }
+
+        collect_due_timers(wheel_tick & (TIMER_WHEEL_SLOTS - 1));
+        word = 0;
+
+        while (word < DUE_WORDS)
+        {
+            if (due_timers[word] == 0)
+            {
+                word++;
+                continue;
+            }
+
+            timer = 0;
+
+            while ((due_timers[word] & (1U << timer)) == 0)
+            {
+                timer++;
+            }
+
+            due_timers[word] = due_timers[word] & ~(1U << timer);
+            timer = (word * DUE_WORD_BITS) + timer;
+            timer_slots[timer] = TIMER_IDLE;
+            expire_timer(timer);
+            word = 0;   /* A lower timer can be due again. */
+        }
+    }
+}
+
+
+void cascade_timer_wheel()
+{
+    byte level = 1;
+    tick_t slot_ticks = wheel_tick >> TIMER_WHEEL_SLOT_BITS;
+
+    while ((level < (TIMER_WHEEL_LEVELS - 1))
+           && ((slot_ticks & (TIMER_WHEEL_SLOTS - 1)) == 0))
+    {
+        slot_ticks = slot_ticks >> TIMER_WHEEL_SLOT_BITS;
+        level++;
+    }
+
+    while (level != 0)
+    {
+        cascade_timer_slot((level * TIMER_WHEEL_SLOTS)
+                           + ((wheel_tick >> (level * TIMER_WHEEL_SLOT_BITS))
+                              & (TIMER_WHEEL_SLOTS - 1)));
+        level--;
+    }
+}
+
+
+void cascade_timer_slot(byte slot)
+{
+    byte timer = timer_wheel_slots[slot];
+    byte next_timer;
+
+    timer_wheel_slots[slot] = NO_TIMER;
+
+    while (timer != NO_TIMER)
+    {
+        next_timer = next_timers[timer];
+        link_timer(timer);
+        timer = next_timer;
+    }
+}
+
+
+void collect_due_timers(byte slot)
+{
+    byte timer = timer_wheel_slots[slot];
+
+    timer_wheel_slots[slot] = NO_TIMER;
+
+    while (timer != NO_TIMER)
+    {
+        timer_slots[timer] = TIMER_DUE;
+        due_timers[timer / DUE_WORD_BITS] = due_timers[timer / DUE_WORD_BITS]
+                                            | (1U << (timer % DUE_WORD_BITS));
+        timer = next_timers[timer];
+    }
+}
+
+
+/**
+* arm_timer of the main code.
+*/
+void wheel_arm_timer(byte timer, tick_t tick)
+{
+    cancel_timer(timer);
+    timer_expiry_ticks[timer] = tick;
+
+    if ((int32_t) (tick - wheel_tick) <= 0)
+    {
+        timer_slots[timer] = TIMER_DUE;
+        due_timers[timer / DUE_WORD_BITS] = due_timers[timer / DUE_WORD_BITS]
+                                            | (1U << (timer % DUE_WORD_BITS));
+    }
+    else
+    {
+        link_timer(timer);
+    }
+}
+
+
+void cancel_timer(byte timer)
+{
+    byte slot = timer_slots[timer];
+
+    if (slot == TIMER_IDLE)
+    {
+        return;
+    }
+
+    if (slot == TIMER_DUE)
+    {
+        due_timers[timer / DUE_WORD_BITS] = due_timers[timer / DUE_WORD_BITS]
+                                            & ~(1U << (timer % DUE_WORD_BITS));
+    }
+    else
+    {
+        if (previous_timers[timer] == NO_TIMER)
+        {
+            timer_wheel_slots[slot] = next_timers[timer];
+        }
+        else
+        {
+            next_timers[previous_timers[timer]] = next_timers[timer];
+        }
+
+        if (next_timers[timer] != NO_TIMER)
+        {
+            previous_timers[next_timers[timer]] = previous_timers[timer];
+        }
+    }
+
+    timer_slots[timer] = TIMER_IDLE;
+}
+
+
+void link_timer(byte timer)
+{
+    tick_t tick = timer_expiry_ticks[timer];
+    tick_t distance = (tick - wheel_tick) >> TIMER_WHEEL_SLOT_BITS;
+    byte level = 0;
+    byte slot;
+
+    while (distance != 0)
+    {
+        distance = distance >> TIMER_WHEEL_SLOT_BITS;
+        tick = tick >> TIMER_WHEEL_SLOT_BITS;
+        level++;
+    }
+
+    assert (level < TIMER_WHEEL_LEVELS);
+    slot = (level * TIMER_WHEEL_SLOTS) + (tick & (TIMER_WHEEL_SLOTS - 1));
+
+    timer_slots[timer] = slot;
+    previous_timers[timer] = NO_TIMER;
+    next_timers[timer] = timer_wheel_slots[slot];
+
+    if (timer_wheel_slots[slot] != NO_TIMER)
+    {
+        previous_timers[timer_wheel_slots[slot]] = timer;
+    }
+
+    timer_wheel_slots[slot] = timer;
+}
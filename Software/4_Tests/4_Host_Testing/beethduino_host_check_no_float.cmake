@@ -0,0 +1,42 @@
+# Beethduino, an Arduino Do-it-yourself electronic metronome.
+#
+# Checks that the code of the Arduino (the main code and the Beethduino
+# library) has no floating point math: the AVR has no FPU, and every float
+# or double operation links the soft float library (and pow() and the like,
+# the math library). The object files compiled for the host are
+# disassembled; the check fails on any floating point instruction (x86-64
+# SSE and x87, AArch64), and on any call to the math library or to the soft
+# float functions (as in an avr-objdump of the AVR build).
+#
+#   cmake -DOBJDUMP=<objdump> -DOBJECTS=<object files> -P <this script>
+
+set(FLOAT_INSTRUCTIONS
+    "[ \t](cvt[a-z0-9]*|(add|sub|mul|div|sqrt|min|max|u?comi)s[sd]|f(add|sub|mul|div|sqrt|ld|st|i?mul)[a-z]*|[su]cvtf|fcvtz[su])[ \t]")
+set(FLOAT_FUNCTIONS
+    "<(pow|exp|exp2|log|log2|sqrt|round|floor|ceil|fmod)f?[@>+-]|__[a-z]+[sd]f[0-9]?[@>+-]|R_[A-Z0-9_]+[ \t]+(pow|exp|exp2|log|log2|sqrt|round|floor|ceil|fmod|__[a-z]+[sd]f[0-9]?)f?[@+-]")
+
+set(failed FALSE)
+
+foreach(object IN LISTS OBJECTS)
+    execute_process(COMMAND ${OBJDUMP} -dr --no-show-raw-insn ${object}
+                    OUTPUT_VARIABLE disassembly
+                    RESULT_VARIABLE result)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "${OBJDUMP} failed on ${object}")
+    endif()
+
+    string(REGEX MATCHALL "[^\n]*(${FLOAT_INSTRUCTIONS}|${FLOAT_FUNCTIONS})[^\n]*"
+           float_lines "${disassembly}")
+    if(float_lines)
+        get_filename_component(name ${object} NAME)
+        string(REPLACE ";" "\n" float_lines "${float_lines}")
+        message("Floating point code in ${name}:\n${float_lines}")
+        set(failed TRUE)
+    endif()
+endforeach()
+
+if(failed)
+    message(FATAL_ERROR "TEST_FAILED")
+endif()
+
+message("NO FLOATING POINT CODE")
@@ -0,0 +1,185 @@
+/*******************************************************************************
+*   Project:        Beethduino, an Arduino Do-it-yourself electronic metronome.
+*
+*   File:           beethduino_host_compile_tempo_map.cpp
+*
+*   Description:    Host (PC) tool that compiles a tempo map (text) into the
+*                   binary program of the main code. It writes, to the
+*                   standard output, the initializer of TEMPO_MAP (to be
+*                   pasted in Beethduino.c), the raw bytes of the program, or
+*                   its timeline: the first downbeat, BPM, time signature,
+*                   bars, voices and ramp of every segment.
+*
+*   Language:       C++ (host, g++).
+*                   Compiled with CMake (target of the same name), with the
+*                   Beethduino_tempo_map folder and Beethduino.cpp.
+*
+*   Dependencies:   stdio.h
+*                   string.h
+*                   string
+*                   Beethduino.h
+*                   Beethduino_tempo_map.h
+*
+*   Notes:          BPM - Beats Per Minute.
+*                   Usage: beethduino_host_compile_tempo_map
+*                          <source file | -> [array | binary | timeline]
+*                   (array by default). i.e:
+*                       printf "play 80 4\nramp +5 8 140\n" |
+*                       beethduino_host_compile_tempo_map - timeline
+*                   The timeline starts at the restart values of the
+*                   metronome (60 BPM, 4/4), and shows at most
+*                   TIMELINE_SEGMENTS segments (a repeated program never
+*                   ends).
+*
+*   Author:         Alberto Martin Cajal
+*                   amartin.glimpse23@gmail.com
+*                   amartin<DOT>glimpse23<AT>gmail<DOT>.com
+*
+*   License:        GNU GPL v3.0
+*
+*   URL:            https://github.com/amcajal/beethduino
+*
+*******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+#include "Beethduino.h"
+#include "Beethduino_tempo_map.h"
+
+const unsigned int TIMELINE_SEGMENTS = 256;
+const int RESTART_BPM = 60;
+
+/******************************************************************************/
+
+
+bool read_source(const char *path, std::string &source);
+void write_timeline(const BeethduinoTempoMap &tempo_map);
+void format_voices(byte voices, char *text);
+
+
+int main(int argc, char *argv[])
+{
+    const char *format = (argc > 2) ? argv[2] : "array";
+    std::string source;
+    BeethduinoTempoMap tempo_map;
+
+    if ((argc < 2) || (argc > 3)
+        || ((strcmp(format, "array") != 0) && (strcmp(format, "binary") != 0)
+            && (strcmp(format, "timeline") != 0)))
+    {
+        fprintf(stderr, "Usage: %s <source file | -> "
+                "[array | binary | timeline]\n", argv[0]);
+        return 1;
+    }
+
+    if (read_source(argv[1], source) == false)
+    {
+        fprintf(stderr, "Cannot read %s\n", argv[1]);
+        return 1;
+    }
+
+    if (tempo_map.compile(source.c_str()) == false)
+    {
+        fprintf(stderr, "%s:%u: %s\n", argv[1], tempo_map.error_line,
+                tempo_map.error_message.c_str());
+        return 1;
+    }
+
+    if (strcmp(format, "binary") == 0)
+    {
+        tempo_map.write_binary(stdout);
+    }
+    else if (strcmp(format, "timeline") == 0)
+    {
+        write_timeline(tempo_map);
+    }
+    else
+    {
+        printf("/* %u bytes. */\n", (unsigned int) tempo_map.program.size());
+        tempo_map.write_array(stdout);
+    }
+
+    return 0;
+}
+
+
+bool read_source(const char *path, std::string &source)
+{
+    FILE *input = (strcmp(path, "-") == 0) ? stdin : fopen(path, "r");
+    char buffer[256];
+    size_t count;
+
+    if (input == 0)
+    {
+        return false;
+    }
+
+    while ((count = fread(buffer, 1, sizeof(buffer), input)) != 0)
+    {
+        source.append(buffer, count);
+    }
+
+    if (input != stdin)
+    {
+        fclose(input);
+    }
+
+    return true;
+}
+
+
+void write_timeline(const BeethduinoTempoMap &tempo_map)
+{
+    static const char *RAMP_NAMES[] = {"-", "linear", "exponential"};
+    std::vector<TempoSegment> segments;
+    unsigned long bar = 1;
+    char voices[2 * Beethduino::VOICES_COUNT + 1];
+
+    tempo_map.expand(RESTART_BPM, Beethduino::DEFAULT_TIME_SIGNATURE,
+                     TIMELINE_SEGMENTS, segments);
+
+    printf("%8s %12s %5s %5s %5s %8s  %s\n", "bar", "start (ms)", "bpm",
+           "time", "bars", "voices", "ramp");
+
+    for (size_t segment = 0; segment < segments.size(); segment++)
+    {
+        format_voices(segments[segment].voices, voices);
+        printf("%8lu %12lu %5d %5s %5u %8s  %s", bar,
+               segments[segment].start_tick, segments[segment].bpm,
+               Beethduino::TIME_SIGNATURES[segments[segment].time_signature]
+                   .text,
+               segments[segment].bars, voices,
+               RAMP_NAMES[segments[segment].ramp]);
+
+        if (segments[segment].ramp != Beethduino::TEMPO_RAMP_NONE)
+        {
+            printf(" from %d", segments[segment].start_bpm);
+        }
+
+        printf("\n");
+        bar = bar + segments[segment].bars;
+    }
+}
+
+
+/**
+* The numbers of the voices, separated by commas ("-" without voices).
+*/
+void format_voices(byte voices, char *text)
+{
+    size_t length = 0;
+
+    text[0] = '-';
+    text[1] = '\0';
+
+    for (byte voice = 0; voice < Beethduino::VOICES_COUNT; voice++)
+    {
+        if ((voices & (1 << voice)) != 0)
+        {
+            length = length + sprintf(text + length, "%s%u",
+                                      (length == 0) ? "" : ",", voice + 1);
+        }
+    }
+}
@@ -0,0 +1,140 @@
+/*******************************************************************************
+*   Project:        Beethduino, an Arduino Do-it-yourself electronic metronome.
+*
+*   File:           beethduino_host_render_audio.cpp
+*
+*   Description:    Host (PC) tool that renders the clicks of Beethduino, at
+*                   a given BPM, with the audio engine (Beethduino_audio
+*                   folder). The output is a WAV file or raw samples (signed,
+*                   16 bits, little endian, mono), written to a file or to
+*                   the standard output ("-"), so it can be played directly:
+*
+*                       beethduino_host_render_audio 120 30 48000 - raw |
+*                           aplay -f S16_LE -r 48000 -c 1
+*
+*   Language:       C++ (host, g++).
+*                   Compiled with CMake (target of the same name), with the
+*                   Arduino_simulator folder, Beethduino.cpp and
+*                   Beethduino_audio.cpp.
+*
+*   Dependencies:   stdio.h
+*                   stdlib.h
+*                   string.h
+*                   Arduino_simulator.h
+*                   Beethduino.h
+*                   Beethduino_audio.h
+*
+*   Notes:          BPM - Beats Per Minute.
+*                   Usage: beethduino_host_render_audio <bpm> <seconds>
+*                          <sample rate: 44100 or 48000> <output file or ->
+*                          [raw]
+*
+*   Author:         Alberto Martin Cajal
+*                   amartin.glimpse23@gmail.com
+*                   amartin<DOT>glimpse23<AT>gmail<DOT>.com
+*
+*   License:        GNU GPL v3.0
+*
+*   URL:            https://github.com/amcajal/beethduino
+*
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Arduino_simulator.h"
+#include "Beethduino.h"
+#include "Beethduino_audio.h"
+
+const unsigned long BLOCK_SAMPLES   = 4096;
+
+/******************************************************************************/
+
+
+void render_audio(int bpm, unsigned long seconds, unsigned long sample_rate,
+                  FILE *output, bool is_raw);
+
+
+int main(int argc, char *argv[])
+{
+    int bpm = (argc > 1) ? atoi(argv[1]) : 0;
+    unsigned long seconds = (argc > 2) ? strtoul(argv[2], 0, 10) : 0;
+    unsigned long sample_rate = (argc > 3) ? strtoul(argv[3], 0, 10) : 0;
+    bool is_raw = (argc > 5) && (strcmp(argv[5], "raw") == 0);
+    FILE *output;
+
+    if ((argc < 5) || (bpm < Beethduino::BPM_LOWER_BOUND)
+        || (bpm > Beethduino::BPM_UPPER_BOUND) || (seconds == 0)
+        || ((sample_rate != BeethduinoAudio::SAMPLE_RATE_44K)
+            && (sample_rate != BeethduinoAudio::SAMPLE_RATE_48K)))
+    {
+        fprintf(stderr, "Usage: %s <bpm %d-%d> <seconds> <44100 | 48000> "
+                "<output file | -> [raw]\n", argv[0],
+                Beethduino::BPM_LOWER_BOUND, Beethduino::BPM_UPPER_BOUND);
+        return 1;
+    }
+
+    if (strcmp(argv[4], "-") == 0)
+    {
+        output = stdout;
+    }
+    else
+    {
+        output = fopen(argv[4], "wb");
+    }
+
+    if (output == 0)
+    {
+        fprintf(stderr, "Cannot open %s\n", argv[4]);
+        return 1;
+    }
+
+    render_audio(bpm, seconds, sample_rate, output, is_raw);
+
+    if (output != stdout)
+    {
+        fclose(output);
+    }
+
+    return 0;
+}
+
+
+void render_audio(int bpm, unsigned long seconds, unsigned long sample_rate,
+                  FILE *output, bool is_raw)
+{
+    static int16_t samples[BLOCK_SAMPLES];
+    unsigned long long total_samples = (unsigned long long) seconds
+                                       * sample_rate;
+    unsigned long long sample;
+    unsigned long count;
+
+    sim_reset();
+    Beethduino metronome;
+    metronome.bpm = bpm;
+    metronome.calculate_required_iterations();
+    BeethduinoAudio audio(metronome, sample_rate);
+    audio.start();
+
+    if (is_raw == false)
+    {
+        BeethduinoAudio::write_wav_header(output, sample_rate, total_samples);
+    }
+
+    for (sample = 0; sample < total_samples; sample += count)
+    {
+        count = BLOCK_SAMPLES;
+
+        if ((sample + count) > total_samples)
+        {
+            count = total_samples - sample;
+        }
+
+        audio.render(samples, count);
+        BeethduinoAudio::write_samples(output, samples, count);
+    }
+
+    fprintf(stderr, "%lu clicks, %llu samples at %lu Hz\n",
+            audio.rendered_clicks, total_samples, sample_rate);
+}
@@ -0,0 +1,432 @@
+/*******************************************************************************
+*   Project:        Beethduino, an Arduino Do-it-yourself electronic metronome.
+*
+*   File:           beethduino_host_test_audio_render.cpp
+*
+*   Description:    Host (PC) test of the audio engine of Beethduino
+*                   (Beethduino_audio folder). Checks that:
+*                   - Every click starts at the sample of its beat, computed
+*                     in closed form from the BPM (44.1 and 48 KHz).
+*                   - The beats of the audio engine are the ticks in which the
+*                     Beethduino library, over the Arduino simulator, plays
+*                     the buzzer.
+*                   - The rendered samples do not depend on the block size.
+*                   - The WAV header describes the rendered stream.
+*                   - Every kernel set supported by the CPU (scalar, SSE2,
+*                     AVX2) gives the same samples than the scalar one, for
+*                     every count (SIMD blocks and tails), and the sine is
+*                     within one step of 16 bits of the one of math.h.
+*
+*   Language:       C++ (host, g++).
+*                   Compiled with CMake (target of the same name), with the
+*                   Arduino_simulator folder, Beethduino.cpp and
+*                   Beethduino_audio.cpp.
+*
+*   Dependencies:   assert.h
+*                   math.h
+*                   stdio.h
+*                   string.h
+*                   vector
+*                   Arduino_simulator.h
+*                   Beethduino.h
+*                   Beethduino_audio.h
+*                   Beethduino_audio_kernels.h
+*
+*   Notes:          BPM - Beats Per Minute.
+*                   The beat j (from 1) of a BPM sounds at the tick
+*                   p + floor((j - 1) * 60000 / BPM), being p the period in
+*                   ticks (integer part) of the BPM.
+*
+*   Author:         Alberto Martin Cajal
+*                   amartin.glimpse23@gmail.com
+*                   amartin<DOT>glimpse23<AT>gmail<DOT>.com
+*
+*   License:        GNU GPL v3.0
+*
+*   URL:            https://github.com/amcajal/beethduino
+*
+*******************************************************************************/
+#define __ASSERT_USE_STDERR
+
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "Arduino_simulator.h"
+#include "Beethduino.h"
+#include "Beethduino_audio.h"
+#include "Beethduino_audio_kernels.h"
+
+const unsigned long SAMPLE_RATES[]  = {BeethduinoAudio::SAMPLE_RATE_44K,
+                                       BeethduinoAudio::SAMPLE_RATE_48K};
+const int SAMPLE_RATES_COUNT        = 2;
+const int TESTED_BPMS[]             = {1, 7, 60, 61, 97, 120, 233, 299, 300};
+const int TESTED_BPMS_COUNT         = 9;
+const int TESTED_BEATS              = 12;
+const unsigned long BLOCK_SIZES[]   = {1, 37, 4096};
+const int BLOCK_SIZES_COUNT         = 3;
+const unsigned long MS_IN_MINUTE    = 60000;
+const unsigned long KERNEL_SAMPLES  = 67;   /* Blocks of 16 and a tail. */
+const double PI                     = 3.14159265358979323846;
+
+std::vector<unsigned long> buzzer_ticks;
+Beethduino *beethduino;
+
+/******************************************************************************/
+
+
+void execute_tests();
+void test_click_positions();
+void test_buzzer_ticks();
+void test_block_sizes();
+void test_wav_header();
+void test_kernels();
+void test_kernels_sine_accuracy();
+unsigned long beat_tick(int bpm, int beat);
+std::vector<int16_t> render_beats(int bpm, unsigned long sample_rate,
+                                  int beats, unsigned long block_size);
+void record_buzzer_tick(uint8_t pin, int level, unsigned long long time_ns);
+
+
+int main()
+{
+    printf("HOST TESTING STARTED\n******************************\n");
+    printf("%%%%%%Testing: Beethduino audio engine\n");
+
+    execute_tests();
+
+    printf("HOST TESTING FINISHED\n******************************\n");
+    return 0;
+}
+
+
+void execute_tests()
+{
+    test_click_positions();
+    test_buzzer_ticks();
+    test_block_sizes();
+    test_wav_header();
+    test_kernels();
+    test_kernels_sine_accuracy();
+}
+
+
+/**
+* The rendered stream is the sum of one click at the sample of every beat.
+*/
+void test_click_positions()
+{
+    printf("test_click_positions\n");
+
+    for (int rate = 0; rate < SAMPLE_RATES_COUNT; rate++)
+    {
+        for (int test = 0; test < TESTED_BPMS_COUNT; test++)
+        {
+            int bpm = TESTED_BPMS[test];
+            std::vector<int16_t> samples = render_beats(bpm,
+                SAMPLE_RATES[rate], TESTED_BEATS, 4096);
+
+            sim_reset();
+            Beethduino metronome;
+            BeethduinoAudio audio(metronome, SAMPLE_RATES[rate]);
+            std::vector<int16_t> expected_samples(samples.size(), 0);
+
+            for (int beat = 1; beat <= TESTED_BEATS; beat++)
+            {
+                unsigned long long click_start = ((unsigned long long)
+                    beat_tick(bpm, beat) * SAMPLE_RATES[rate] + 500) / 1000;
+
+                for (unsigned int sample = 0; (sample < audio.click_samples)
+                     && ((click_start + sample) < samples.size()); sample++)
+                {
+                    expected_samples[click_start + sample] +=
+                        audio.click[sample];
+                }
+            }
+
+            assert (samples == expected_samples);
+        }
+    }
+
+    printf("\n");
+}
+
+
+/**
+* The Beethduino library, over the simulator, plays the buzzer at the same
+* ticks than the audio engine renders the clicks.
+*/
+void test_buzzer_ticks()
+{
+    printf("test_buzzer_ticks\n");
+
+    for (int test = 0; test < TESTED_BPMS_COUNT; test++)
+    {
+        int bpm = TESTED_BPMS[test];
+
+        if (bpm < 60)
+        {
+            continue;   /* One second of simulation per beat at most. */
+        }
+
+        sim_reset();
+        Beethduino metronome;
+        beethduino = &metronome;
+        metronome.configure_beat_timer();
+        metronome.bpm = bpm;
+        metronome.calculate_required_iterations();
+        metronome.change_mute_state();
+
+        buzzer_ticks.clear();
+        sim_set_pin_listener(record_buzzer_tick);
+
+        while (buzzer_ticks.size() < (unsigned int) TESTED_BEATS)
+        {
+            sim_idle_until_ns(~0ULL);
+        }
+
+        sim_set_pin_listener(0);
+        beethduino = 0;
+
+        sim_reset();
+        Beethduino audio_metronome;
+        audio_metronome.bpm = bpm;
+        audio_metronome.calculate_required_iterations();
+        BeethduinoAudio audio(audio_metronome,
+                              BeethduinoAudio::SAMPLE_RATE_48K);
+        audio.start();
+
+        for (int beat = 0; beat < TESTED_BEATS; beat++)
+        {
+            assert (buzzer_ticks[beat] == beat_tick(bpm, beat + 1));
+            assert (audio.next_click_sample
+                    == (unsigned long long) buzzer_ticks[beat] * 48);
+
+            audio.schedule_next_click();
+        }
+    }
+
+    printf("\n");
+}
+
+
+void test_block_sizes()
+{
+    printf("test_block_sizes\n");
+
+    for (int rate = 0; rate < SAMPLE_RATES_COUNT; rate++)
+    {
+        std::vector<int16_t> expected_samples = render_beats(
+            Beethduino::BPM_UPPER_BOUND, SAMPLE_RATES[rate], TESTED_BEATS,
+            BLOCK_SIZES[0]);
+
+        for (int size = 1; size < BLOCK_SIZES_COUNT; size++)
+        {
+            assert (render_beats(Beethduino::BPM_UPPER_BOUND,
+                                 SAMPLE_RATES[rate], TESTED_BEATS,
+                                 BLOCK_SIZES[size]) == expected_samples);
+        }
+    }
+
+    printf("\n");
+}
+
+
+void test_wav_header()
+{
+    printf("test_wav_header\n");
+    unsigned char header[BeethduinoAudio::WAV_HEADER_SIZE];
+    const unsigned char expected_header[BeethduinoAudio::WAV_HEADER_SIZE] = {
+        'R', 'I', 'F', 'F', 0x24, 0x77, 0x01, 0x00,     /* 36 + 96000. */
+        'W', 'A', 'V', 'E',
+        'f', 'm', 't', ' ', 0x10, 0x00, 0x00, 0x00,
+        0x01, 0x00, 0x01, 0x00,                         /* PCM, mono. */
+        0x80, 0xBB, 0x00, 0x00,                         /* 48000 Hz. */
+        0x00, 0x77, 0x01, 0x00,                         /* 96000 bytes/s. */
+        0x02, 0x00, 0x10, 0x00,                         /* 2 bytes, 16 bits. */
+        'd', 'a', 't', 'a', 0x00, 0x77, 0x01, 0x00};    /* 96000. */
+    FILE *wav = tmpfile();
+    int16_t samples[2] = {0x1234, -2};
+
+    assert (wav != 0);
+    BeethduinoAudio::write_wav_header(wav, BeethduinoAudio::SAMPLE_RATE_48K,
+                                      BeethduinoAudio::SAMPLE_RATE_48K);
+    BeethduinoAudio::write_samples(wav, samples, 2);
+
+    assert (ftell(wav) == BeethduinoAudio::WAV_HEADER_SIZE + 4);
+    rewind(wav);
+    assert (fread(header, 1, sizeof(header), wav) == sizeof(header));
+    assert (memcmp(header, expected_header, sizeof(header)) == 0);
+    assert (fgetc(wav) == 0x34);
+    assert (fgetc(wav) == 0x12);
+    assert (fgetc(wav) == 0xFE);
+    assert (fgetc(wav) == 0xFF);
+
+    fclose(wav);
+    printf("\n");
+}
+
+
+/**
+* Every count from 0 to KERNEL_SAMPLES, at every offset of a SIMD register.
+*/
+void test_kernels()
+{
+    printf("test_kernels\n");
+    const AudioKernels *scalar = &AUDIO_KERNELS[0];
+    float expected_wave[KERNEL_SAMPLES];
+    float wave[KERNEL_SAMPLES];
+    int16_t expected_pcm[KERNEL_SAMPLES];
+    int16_t pcm[KERNEL_SAMPLES];
+    int16_t added_pcm[KERNEL_SAMPLES];
+
+    for (unsigned long sample = 0; sample < KERNEL_SAMPLES; sample++)
+    {
+        added_pcm[sample] = (sample % 2 == 0) ? 30000 : -30000;
+    }
+
+    for (int set = 1; set < AUDIO_KERNELS_COUNT; set++)
+    {
+        const AudioKernels *kernels = &AUDIO_KERNELS[set];
+
+        if (kernels->is_supported() == false)
+        {
+            printf("    %s not supported by the CPU\n", kernels->name);
+            continue;
+        }
+
+        for (unsigned long count = 0; count <= KERNEL_SAMPLES; count++)
+        {
+            for (unsigned long offset = 0; (offset < 16)
+                 && ((offset + count) <= KERNEL_SAMPLES); offset++)
+            {
+                scalar->synthesize_sine(expected_wave, count, 0.0417f,
+                                        40000.0f);
+                kernels->synthesize_sine(&wave[offset], count, 0.0417f,
+                                         40000.0f);
+                assert (memcmp(expected_wave, &wave[offset],
+                               count * sizeof(float)) == 0);
+
+                scalar->apply_envelope(expected_wave, count, 1.0f, -0.03f);
+                kernels->apply_envelope(&wave[offset], count, 1.0f, -0.03f);
+                assert (memcmp(expected_wave, &wave[offset],
+                               count * sizeof(float)) == 0);
+
+                /* Out of range samples (40000) are saturated. */
+                scalar->convert_to_pcm(expected_pcm, expected_wave, count);
+                kernels->convert_to_pcm(&pcm[offset], &wave[offset], count);
+                assert (memcmp(expected_pcm, &pcm[offset],
+                               count * sizeof(int16_t)) == 0);
+
+                scalar->mix_pcm(expected_pcm, added_pcm, count);
+                kernels->mix_pcm(&pcm[offset], added_pcm, count);
+                assert (memcmp(expected_pcm, &pcm[offset],
+                               count * sizeof(int16_t)) == 0);
+            }
+        }
+
+        sim_reset();
+        Beethduino metronome;
+        BeethduinoAudio scalar_audio(metronome,
+                                     BeethduinoAudio::SAMPLE_RATE_44K, scalar);
+        BeethduinoAudio audio(metronome, BeethduinoAudio::SAMPLE_RATE_44K,
+                              kernels);
+        assert (memcmp(audio.click, scalar_audio.click,
+                       audio.click_samples * sizeof(int16_t)) == 0);
+
+        printf("    %s: same samples than scalar\n", kernels->name);
+    }
+
+    printf("\n");
+}
+
+
+void test_kernels_sine_accuracy()
+{
+    printf("test_kernels_sine_accuracy\n");
+    const float cycles_per_sample = (float) BeethduinoAudio::CLICK_FREQUENCY
+                                    / BeethduinoAudio::SAMPLE_RATE_44K;
+    const unsigned long samples = BeethduinoAudio::SAMPLE_RATE_44K;
+    std::vector<float> wave(samples);
+    std::vector<int16_t> pcm(samples);
+
+    AUDIO_KERNELS[0].synthesize_sine(&wave[0], samples, cycles_per_sample,
+                                     INT16_MAX);
+    AUDIO_KERNELS[0].convert_to_pcm(&pcm[0], &wave[0], samples);
+
+    for (unsigned long sample = 0; sample < samples; sample++)
+    {
+        double expected_value = INT16_MAX
+            * sin(2.0 * PI * ((double) ((float) sample * cycles_per_sample)));
+
+        assert (fabs(pcm[sample] - expected_value) <= 1.0);
+    }
+
+    printf("\n");
+}
+
+
+unsigned long beat_tick(int bpm, int beat)
+{
+    return (MS_IN_MINUTE / bpm) + ((beat - 1) * MS_IN_MINUTE) / bpm;
+}
+
+
+/**
+* Renders the given beats (and the rest of the last period).
+*/
+std::vector<int16_t> render_beats(int bpm, unsigned long sample_rate,
+                                  int beats, unsigned long block_size)
+{
+    unsigned long long total_samples = ((unsigned long long)
+        beat_tick(bpm, beats + 1) * sample_rate) / 1000;
+    std::vector<int16_t> samples(total_samples, 0);
+
+    sim_reset();
+    Beethduino metronome;
+    metronome.bpm = bpm;
+    metronome.calculate_required_iterations();
+    BeethduinoAudio audio(metronome, sample_rate);
+    audio.start();
+
+    for (unsigned long long sample = 0; sample < total_samples;
+         sample += block_size)
+    {
+        unsigned long count = block_size;
+
+        if ((sample + count) > total_samples)
+        {
+            count = total_samples - sample;
+        }
+
+        audio.render(&samples[sample], count);
+    }
+
+    assert (audio.rendered_clicks == (unsigned long) beats);
+    return samples;
+}
+
+
+void record_buzzer_tick(uint8_t pin, int level, unsigned long long time_ns)
+{
+    (void) time_ns;
+
+    if ((pin == beethduino->ACTIVE_BUZZER_PIN) && (level == HIGH))
+    {
+        unsigned long tick = beethduino->timer_ticks;
+
+        buzzer_ticks.push_back(tick);
+    }
+}
+
+
+void __assert(const char *__func, const char *__file,
+              int __lineno, const char *__sexp)
+{
+    printf("TEST_FAILED\n%s\n%s\n%d\n%s\n", __file, __func, __lineno, __sexp);
+    fflush(stdout);
+
+    abort();
+}
@@ -0,0 +1,391 @@
+/*******************************************************************************
+*   Project:        Beethduino, an Arduino Do-it-yourself electronic metronome.
+*
+*   File:           beethduino_host_test_beat_scheduler.cpp
+*
+*   Description:    Host (PC) unit testing for the Timer1 based beat scheduler
+*                   ("timer_compare_isr", "process_bpm_frequency" and the
+*                   non-blocking "play_buzzer" and "stop_buzzer").
+*                   The Timer1 compare interrupt is replaced by a simulated
+*                   timer: a virtual clock, in microseconds, that calls the
+*                   interrupt body every millisecond. The main loop work
+*                   (buttons, LCD) is simulated as time spent in the virtual
+*                   clock, so the beat drift can be measured without an Arduino.
+*
+*   Language:       C++ (host, g++).
+*                   Compiled with: g++ -std=c++11 -o beat_scheduler_test
+*                                  beethduino_host_test_beat_scheduler.cpp
+*
+*   Dependencies:   assert.h
+*                   stdio.h
+*
+*   Notes:          BPM - Beats Per Minute.
+*                   LCD - Liquid Crystal Display.
+*
+*   Author:         Alberto Martin Cajal
+*                   amartin.glimpse23@gmail.com
+*                   amartin<DOT>glimpse23<AT>gmail<DOT>.com
+*
+*   License:        GNU GPL v3.0
+*
+*   URL:            https://github.com/amcajal/beethduino
+*
+*******************************************************************************/
+
+#include <assert.h>
+#include <stdio.h>
+
+const int SOUND_DURATION            = 25;   /* In Milliseconds. */
+const int MICROSECONDS_IN_TICK      = 1000; /* Timer1 tick: 1 millisecond. */
+
+const unsigned long CHECK_BUTTONS_DURATION  = 60;   /* In microseconds. */
+const unsigned long LCD_UPDATE_DURATION     = 2500; /* In microseconds. */
+
+const int MAX_RECORDED_BEATS        = 200;
+
+unsigned int bpm_freq_req_iter;
+unsigned int bpm_freq_remainder;
+unsigned int bpm_freq_divisor;
+unsigned int beat_error_accumulator;
+unsigned long timer_ticks;
+unsigned long beat_deadline_tick;
+unsigned long buzzer_off_tick;
+bool is_buzzer_sounding;
+bool is_buzzer_muted;
+
+int iteration_counter;  /* Only used by the previous (delay based) version. */
+bool is_legacy_mode;    /* Simulate the previous (delay based) version. */
+
+unsigned long sim_time_us;  /* Virtual clock. */
+
+unsigned long beat_onset_us[MAX_RECORDED_BEATS];
+int buzzer_bips;
+int main_loop_iterations_while_sounding;
+
+/******************************************************************************/
+
+
+void timer_compare_isr();
+void process_bpm_frequency();
+void schedule_next_beat();
+void legacy_process_bpm_frequency();
+void play_buzzer();
+void stop_buzzer();
+void legacy_play_buzzer();
+
+void execute_tests();
+void test_deadlines_without_ui_load();
+void test_deadlines_with_lcd_load();
+void test_main_loop_while_sounding();
+void test_legacy_iteration_counting_drift();
+void run_main_loop(int lcd_update_every, int beats);
+long measure_drift_us(unsigned long period_us);
+long measure_jitter_us(unsigned long period_us);
+void restore_initial_test_values();
+
+
+int main()
+{
+    printf("HOST UNIT TESTING STARTED\n******************************\n");
+    printf("%%%%%%Testing function: timer_compare_isr, process_bpm_frequency, "
+           "play_buzzer, stop_buzzer\n");
+
+    restore_initial_test_values();
+    execute_tests();
+
+    printf("HOST UNIT TESTING FINISHED\n******************************\n");
+    return 0;
+}
+
+
+void execute_tests()
+{
+    test_deadlines_without_ui_load();
+    test_deadlines_with_lcd_load();
+    test_main_loop_while_sounding();
+    test_legacy_iteration_counting_drift();
+}
+
+
+/**
+* Advance the virtual clock, executing the Timer1 interrupt each time a
+* tick (millisecond) boundary is crossed.
+*/
+void sim_advance_us(unsigned long elapsed_us)
+{
+    unsigned long target_us = sim_time_us + elapsed_us;
+
+    while (((sim_time_us / MICROSECONDS_IN_TICK) + 1) * MICROSECONDS_IN_TICK
+           <= target_us)
+    {
+        sim_time_us = ((sim_time_us / MICROSECONDS_IN_TICK) + 1)
+                      * MICROSECONDS_IN_TICK;
+        timer_compare_isr();
+    }
+
+    sim_time_us = target_us;
+}
+
+
+void sim_delay(unsigned long ms)
+{
+    sim_advance_us(ms * MICROSECONDS_IN_TICK);
+}
+
+
+/**
+* Beats at 60 BPM with an idle main loop: every beat shall sound one period
+* after the previous one.
+*/
+void test_deadlines_without_ui_load()
+{
+    printf("test_deadlines_without_ui_load\n");
+    bpm_freq_req_iter = 1000;
+    run_main_loop(0, 100);
+
+    assert (buzzer_bips == 100);
+    assert (measure_drift_us(1000000) == 0);
+    assert (measure_jitter_us(1000000) == 0);
+    restore_initial_test_values();
+}
+
+
+/**
+* Beats at 61 BPM while the LCD is redrawn every 50 iterations of the main
+* loop. The beats are started by the timer interrupt, so the redraws
+* neither delay a beat nor accumulate error in the following ones.
+*/
+void test_deadlines_with_lcd_load()
+{
+    printf("test_deadlines_with_lcd_load\n");
+    bpm_freq_req_iter = 983;
+    run_main_loop(50, 100);
+
+    long drift_us = measure_drift_us(983000);
+    long jitter_us = measure_jitter_us(983000);
+    printf("    timer scheduler: drift %ld us, jitter %ld us\n",
+           drift_us, jitter_us);
+
+    assert (buzzer_bips == 100);
+    assert (drift_us == 0);
+    assert (jitter_us == 0);
+
+    /* Deadlines are absolute: no error at all after 100 beats. */
+    assert (beat_deadline_tick == 983 + (100 * 983));
+    restore_initial_test_values();
+}
+
+
+/**
+* The buttons are checked while the buzzer is sounding: the main loop is
+* not blocked by the SOUND_DURATION of the beats.
+*/
+void test_main_loop_while_sounding()
+{
+    printf("test_main_loop_while_sounding\n");
+    bpm_freq_req_iter = 200; /* 300 BPM. */
+    run_main_loop(0, 100);
+
+    printf("    timer scheduler: %d button checks while sounding\n",
+           main_loop_iterations_while_sounding);
+
+    /* SOUND_DURATION (25 ms) of each beat, a button check every 60 us. */
+    assert (main_loop_iterations_while_sounding
+            >= (int) (99 * ((SOUND_DURATION * MICROSECONDS_IN_TICK)
+                            / CHECK_BUTTONS_DURATION)));
+    restore_initial_test_values();
+}
+
+
+/**
+* Same conditions with the previous delay(1) iteration counting: each LCD
+* redraw and each buzzer sound delays all the following beats, and no 
+* button is checked while the buzzer is sounding.
+*/
+void test_legacy_iteration_counting_drift()
+{
+    printf("test_legacy_iteration_counting_drift\n");
+    is_legacy_mode = true;
+    bpm_freq_req_iter = 958; /* 61 BPM minus SOUND_DURATION. */
+    run_main_loop(50, 100);
+
+    long drift_us = measure_drift_us(983000);
+    printf("    legacy iteration counting: drift %ld us\n", drift_us);
+
+    assert (buzzer_bips == 100);
+    assert (drift_us > (long) (LCD_UPDATE_DURATION + MICROSECONDS_IN_TICK));
+    assert (main_loop_iterations_while_sounding == 0);
+    restore_initial_test_values();
+}
+
+
+void run_main_loop(int lcd_update_every, int beats)
+{
+    int loop_iteration = 0;
+
+    is_buzzer_muted = false;
+    beat_deadline_tick = timer_ticks + bpm_freq_req_iter;
+
+    while (buzzer_bips < beats)
+    {
+        sim_advance_us(CHECK_BUTTONS_DURATION);
+        if (is_buzzer_sounding == true)
+        {
+            main_loop_iterations_while_sounding++;
+        }
+
+        if ((lcd_update_every > 0) && ((loop_iteration % lcd_update_every) == 0))
+        {
+            sim_advance_us(LCD_UPDATE_DURATION);
+        }
+
+        if (is_legacy_mode == true)
+        {
+            legacy_process_bpm_frequency();
+        }
+
+        loop_iteration++;
+    }
+}
+
+
+/**
+* Difference between the error of the last beat and the error of the first
+* beat, relative to an ideal metronome started at the first beat.
+*/
+long measure_drift_us(unsigned long period_us)
+{
+    int last_beat = buzzer_bips - 1;
+
+    return (long) (beat_onset_us[last_beat]
+                   - (beat_onset_us[0] + (last_beat * period_us)));
+}
+
+
+long measure_jitter_us(unsigned long period_us)
+{
+    long min_error_us = 0;
+    long max_error_us = 0;
+
+    for (int beat = 1; beat < buzzer_bips; beat++)
+    {
+        long error_us = (long) (beat_onset_us[beat]
+                        - (beat_onset_us[0] + (beat * period_us)));
+        if (error_us < min_error_us)
+        {
+            min_error_us = error_us;
+        }
+        if (error_us > max_error_us)
+        {
+            max_error_us = error_us;
+        }
+    }
+
+    return max_error_us - min_error_us;
+}
+
+
+void restore_initial_test_values()
+{
+    sim_time_us = 0;
+    timer_ticks = 0;
+    beat_deadline_tick = 0;
+    bpm_freq_remainder = 0;
+    bpm_freq_divisor = 1;
+    beat_error_accumulator = 0;
+    buzzer_off_tick = 0;
+    is_buzzer_sounding = false;
+    is_buzzer_muted = true;
+    iteration_counter = 0;
+    is_legacy_mode = false;
+    buzzer_bips = 0;
+    main_loop_iterations_while_sounding = 0;
+    printf("\n");
+}
+
+
+void timer_compare_isr()
+{
+    timer_ticks++;
+
+    if (is_legacy_mode == false)
+    {
+        process_bpm_frequency();
+    }
+}
+
+
+void process_bpm_frequency()
+{
+    if ((is_buzzer_sounding == true)
+        && ((long) (timer_ticks - buzzer_off_tick) >= 0))
+    {
+        stop_buzzer();
+    }
+
+    if ((is_buzzer_muted == false)
+        && ((long) (timer_ticks - beat_deadline_tick) >= 0))
+    {
+        schedule_next_beat();
+        play_buzzer();
+    }
+}
+
+
+void schedule_next_beat()
+{
+    beat_deadline_tick = beat_deadline_tick + bpm_freq_req_iter;
+    beat_error_accumulator = beat_error_accumulator + bpm_freq_remainder;
+
+    if (beat_error_accumulator >= bpm_freq_divisor)
+    {
+        beat_error_accumulator = beat_error_accumulator - bpm_freq_divisor;
+        beat_deadline_tick++;
+    }
+}
+
+
+void play_buzzer()
+{
+    if (buzzer_bips < MAX_RECORDED_BEATS)
+    {
+        beat_onset_us[buzzer_bips] = sim_time_us; /* Pin set to HIGH. */
+    }
+    buzzer_off_tick = timer_ticks + SOUND_DURATION;
+    is_buzzer_sounding = true;
+
+    buzzer_bips++;
+}
+
+
+void stop_buzzer()
+{
+    is_buzzer_sounding = false; /* Pin set to LOW. */
+}
+
+
+void legacy_process_bpm_frequency()
+{
+    if (is_buzzer_muted == false)
+    {
+        sim_delay(1);
+        iteration_counter++;
+        if (iteration_counter >= (int) bpm_freq_req_iter)
+        {
+            legacy_play_buzzer();
+            iteration_counter = 0;
+        }
+    }
+}
+
+
+void legacy_play_buzzer()
+{
+    if (buzzer_bips < MAX_RECORDED_BEATS)
+    {
+        beat_onset_us[buzzer_bips] = sim_time_us; /* Pin set to HIGH. */
+    }
+    sim_delay(SOUND_DURATION);
+
+    buzzer_bips++;
+}
@@ -0,0 +1,327 @@
+/*******************************************************************************
+*   Project:        Beethduino, an Arduino Do-it-yourself electronic metronome.
+*
+*   File:           beethduino_host_test_button_auto_repeat.cpp
+*
+*   Description:    Host (PC) testing of the auto-repeat of the held BPM
+*                   buttons of the Beethduino library, over the Arduino
+*                   simulator. Checks that the repetitions follow the
+*                   acceleration curve, that a held button does not perform
+*                   its operation again in the release, that the buttons that
+*                   are not repeated perform their operation once, and that
+*                   the beats keep their period (same edges as without
+*                   pressings) while the fastest repetition redraws the LCD.
+*
+*   Language:       C++ (host, g++).
+*                   Compiled with CMake (target of the same name), with the
+*                   Arduino_simulator folder and Beethduino.cpp.
+*
+*   Dependencies:   assert.h
+*                   stdio.h
+*                   vector
+*                   Arduino_simulator.h
+*                   Beethduino.h
+*                   beethduino_host_test_helpers.h
+*
+*   Notes:          BPM - Beats Per Minute.
+*                   LCD - Liquid Crystal Display.
+*                   The beat timing test is done at BPM_UPPER_BOUND: the
+*                   held button is repeated, but the tempo does not change,
+*                   so every beat period can be compared with the ideal one.
+*
+*   Author:         Alberto Martin Cajal
+*                   amartin.glimpse23@gmail.com
+*                   amartin<DOT>glimpse23<AT>gmail<DOT>.com
+*
+*   License:        GNU GPL v3.0
+*
+*   URL:            https://github.com/amcajal/beethduino
+*
+*******************************************************************************/
+#define __ASSERT_USE_STDERR
+
+#include <assert.h>
+#include <stdio.h>
+#include <vector>
+
+#include "Arduino_simulator.h"
+#include "Beethduino.h"
+#include "beethduino_host_test_helpers.h"
+
+const unsigned long long TICK_NS            = SIM_NS_IN_MS;
+const unsigned long long HOLD_NS            = 5 * SIM_NS_IN_S;
+const unsigned long BUTTON_LEVEL_MS         = 50;
+const int TARGET_BPM                        = 240;
+const int MIN_ATTENDED_EVENTS               = 80;
+
+/******************************************************************************/
+
+
+void execute_tests();
+void test_repeat_acceleration_curve();
+void test_hold_to_target_bpm();
+void test_buttons_not_repeated();
+void test_beat_timing_during_fast_repeat();
+void record_beats(bool is_button_held);
+unsigned long long wait_button_event(Beethduino &metronome);
+
+
+int main()
+{
+    printf("HOST UNIT TESTING STARTED\n******************************\n");
+    printf("%%%%%%Testing: auto-repeat of the held BPM buttons\n");
+
+    execute_tests();
+
+    printf("HOST UNIT TESTING FINISHED\n******************************\n");
+    return 0;
+}
+
+
+void execute_tests()
+{
+    test_repeat_acceleration_curve();
+    test_hold_to_target_bpm();
+    test_buttons_not_repeated();
+    test_beat_timing_during_fast_repeat();
+}
+
+
+/**
+* The first repetition comes BUTTON_LONG_PRESS_TICKS after the pressing;
+* the next ones, every period of BUTTON_REPEAT_PERIODS, and the last period
+* is kept.
+*/
+void test_repeat_acceleration_curve()
+{
+    printf("test_repeat_acceleration_curve\n");
+    sim_reset();
+    Beethduino metronome;
+    configure_beethduino(metronome);
+
+    digitalWrite(metronome.CHANGE_BPM_BY_ONE_BUTTON_PIN, HIGH);
+    unsigned long long press_ns = wait_button_event(metronome);
+    unsigned long long previous_ns = wait_button_event(metronome);
+
+    assert (previous_ns - press_ns
+            == Beethduino::BUTTON_LONG_PRESS_TICKS * TICK_NS);
+
+    for (int repeat = 0; repeat < Beethduino::BUTTON_REPEAT_STEPS + 3;
+         repeat++)
+    {
+        int step = (repeat < Beethduino::BUTTON_REPEAT_STEPS)
+                   ? repeat : (Beethduino::BUTTON_REPEAT_STEPS - 1);
+        unsigned long long repeat_ns = wait_button_event(metronome);
+
+        assert (repeat_ns - previous_ns
+                == Beethduino::BUTTON_REPEAT_PERIODS[step] * TICK_NS);
+        previous_ns = repeat_ns;
+
+        /* The queue is emptied: there are more repetitions than entries. */
+        metronome.exec_main_loop();
+    }
+
+    /* Long pressing and repetitions; the release is still pending. */
+    assert (metronome.bpm == 60 + 1 + Beethduino::BUTTON_REPEAT_STEPS + 3);
+    assert (metronome.repeated_button_pins
+            == (1 << (metronome.CHANGE_BPM_BY_ONE_BUTTON_PIN
+                      - Beethduino::PORTB_FIRST_PIN)));
+    printf("\n");
+}
+
+
+/**
+* Holding the BPM by ten button takes the BPM from 60 to TARGET_BPM; the
+* release, right after the last repetition, does not add ten more.
+*/
+void test_hold_to_target_bpm()
+{
+    printf("test_hold_to_target_bpm\n");
+    sim_reset();
+    Beethduino metronome;
+    configure_beethduino(metronome);
+    int pin = metronome.CHANGE_BPM_BY_TEN_BUTTON_PIN;
+
+    unsigned long long press_ns = sim_time_ns();
+    digitalWrite(pin, HIGH);
+
+    while (metronome.bpm < TARGET_BPM)
+    {
+        unsigned long long loop_start_ns = sim_time_ns();
+
+        metronome.exec_main_loop();
+        sim_finish_loop(loop_start_ns, ~0ULL);
+    }
+
+    unsigned long long hold_ns = sim_time_ns() - press_ns;
+
+    digitalWrite(pin, LOW);
+    run_main_loop_until(metronome,
+                        sim_time_ns() + BUTTON_LEVEL_MS * SIM_NS_IN_MS);
+
+    assert (metronome.bpm == TARGET_BPM);
+    assert (metronome.last_pressed_button_pin == 0);
+    assert (metronome.repeated_button_pins == 0);
+    assert (metronome.is_button_debounce_active == false);
+    assert (strcmp(metronome.bpm_text_info, 
+                   "MUTE_MUTE_MUTE_LFCRADD BPM: 240") == 0);
+
+    printf("    60 to %d BPM: held %.3f s (before, %d pressings)\n",
+           TARGET_BPM, (double) hold_ns / SIM_NS_IN_S,
+           (TARGET_BPM - 60) / 10);
+    printf("\n");
+}
+
+
+/**
+* The mute button is not repeated: held, it starts the tempo map once (long
+* pressing), and its release does not mute the buzzer.
+*/
+void test_buttons_not_repeated()
+{
+    printf("test_buttons_not_repeated\n");
+    sim_reset();
+    Beethduino metronome;
+    configure_beethduino(metronome);
+    int pin = metronome.MUTE_BUZZER_BUTTON_PIN;
+
+    digitalWrite(pin, HIGH);
+    run_main_loop_until(metronome, sim_time_ns() + HOLD_NS);
+    assert (metronome.is_buzzer_muted == false);
+    assert (metronome.is_tempo_map_running == true);
+    assert (metronome.bpm == 80);
+
+    digitalWrite(pin, LOW);
+    run_main_loop_until(metronome,
+                        sim_time_ns() + BUTTON_LEVEL_MS * SIM_NS_IN_MS);
+    assert (metronome.is_buzzer_muted == false);
+    assert (metronome.is_tempo_map_running == true);
+    assert (metronome.repeated_button_pins == 0);
+    printf("\n");
+}
+
+
+/**
+* The repetitions are counted in the timer interrupt, after the beat, and
+* attended by the main loop: the beat edges are the same with the button
+* held (one LCD redraw per repetition) as with the main loop idle.
+*/
+void test_beat_timing_during_fast_repeat()
+{
+    printf("test_beat_timing_during_fast_repeat\n");
+
+    record_beats(false);
+    std::vector<unsigned long long> idle_edges_ns = beat_edges_ns;
+
+    record_beats(true);
+
+    assert (beat_edges_ns.size() == idle_edges_ns.size());
+    assert (beat_edges_ns.size()
+            == HOLD_NS / (Beethduino::MILLISECONDS_IN_MINUTE
+                          / Beethduino::BPM_UPPER_BOUND * TICK_NS));
+
+    long long max_period_error_ns = 0;
+    for (size_t beat = 0; beat < beat_edges_ns.size(); beat++)
+    {
+        assert (beat_edges_ns[beat] == idle_edges_ns[beat]);
+
+        if (beat > 0)
+        {
+            long long period_error_ns
+                = (long long) (beat_edges_ns[beat] - beat_edges_ns[beat - 1])
+                  - (long long) (Beethduino::MILLISECONDS_IN_MINUTE
+                                 / Beethduino::BPM_UPPER_BOUND * TICK_NS);
+
+            if (llabs(period_error_ns) > max_period_error_ns)
+            {
+                max_period_error_ns = llabs(period_error_ns);
+            }
+        }
+    }
+
+    assert (max_period_error_ns == 0);
+    printf("    %d beats at %d BPM, max period error %lld ns\n",
+           (int) beat_edges_ns.size(), Beethduino::BPM_UPPER_BOUND,
+           max_period_error_ns);
+    printf("\n");
+}
+
+
+/**
+* Records the beat edges during HOLD_NS at BPM_UPPER_BOUND, with the main
+* loop running and, if is_button_held, the BPM by ten button held.
+*/
+void record_beats(bool is_button_held)
+{
+    sim_reset();
+    Beethduino metronome;
+    beethduino = &metronome;
+    configure_beethduino(metronome);
+
+    metronome.bpm = Beethduino::BPM_UPPER_BOUND;
+    metronome.calculate_required_iterations();
+    metronome.change_mute_state();
+
+    unsigned long long start_ns = sim_time_ns();
+    unsigned long attended_events = 0;
+
+    beat_edges_ns.clear();
+    sim_set_pin_listener(record_beat_edge);
+
+    if (is_button_held == true)
+    {
+        sim_schedule_pin_level(metronome.CHANGE_BPM_BY_TEN_BUTTON_PIN, HIGH,
+                               start_ns + TICK_NS / 2);
+    }
+
+    while (sim_time_ns() < start_ns + HOLD_NS)
+    {
+        unsigned long long loop_start_ns = sim_time_ns();
+        byte queued_events = (metronome.button_event_head
+                              - metronome.button_event_tail)
+                             & (Beethduino::BUTTON_EVENT_QUEUE_SIZE - 1);
+
+        metronome.exec_main_loop();
+        attended_events = attended_events + queued_events;
+        sim_finish_loop(loop_start_ns, start_ns + HOLD_NS);
+    }
+
+    sim_set_pin_listener(0);
+
+    if (is_button_held == true)
+    {
+        /* Pressing, long pressing and repetitions (all at the upper bound). */
+        assert (attended_events >= MIN_ATTENDED_EVENTS);
+        assert (metronome.bpm == Beethduino::BPM_UPPER_BOUND);
+        printf("    button held: %lu button events attended\n", attended_events);
+    }
+
+    beethduino = 0;
+}
+
+
+/**
+* Advances the clock, event by event, until a new button event is queued;
+* returns its simulated time.
+*/
+unsigned long long wait_button_event(Beethduino &metronome)
+{
+    byte queued_events = metronome.button_event_head;
+
+    while (metronome.button_event_head == queued_events)
+    {
+        sim_idle_until_ns(~0ULL);
+    }
+
+    return sim_time_ns();
+}
+
+
+void __assert(const char *__func, const char *__file,
+              int __lineno, const char *__sexp)
+{
+    printf("TEST_FAILED\n%s\n%s\n%d\n%s\n", __file, __func, __lineno, __sexp);
+    fflush(stdout);
+
+    abort();
+}
@@ -0,0 +1,522 @@
+/*******************************************************************************
+*   Project:        Beethduino, an Arduino Do-it-yourself electronic metronome.
+*
+*   File:           beethduino_host_test_button_events.cpp
+*
+*   Description:    Host (PC) testing of the button input driver of the
+*                   Beethduino library, over the Arduino simulator. Checks
+*                   that the main loop without button events does not read
+*                   any pin, that the pressings done while the main loop is
+*                   busy are attended later in order, that the buzzer pin
+*                   does not trigger the pin change interrupt, and that a
+*                   full event queue loses the new events without corrupting
+*                   the old ones. Bouncy waveforms are injected to check the
+*                   debouncer (one event per pressing and release, short
+*                   glitches filtered, overlapped buttons, long pressings), and
+*                   the latency it adds is reported. The auto-repeat is
+*                   tested by beethduino_host_test_button_auto_repeat.cpp.
+*
+*   Language:       C++ (host, g++).
+*                   Compiled with CMake (target of the same name), with the
+*                   Arduino_simulator folder and Beethduino.cpp.
+*
+*   Dependencies:   assert.h
+*                   stdio.h
+*                   Arduino_simulator.h
+*                   Beethduino.h
+*                   beethduino_host_test_helpers.h
+*
+*   Notes:          BPM - Beats Per Minute.
+*                   LCD - Liquid Crystal Display.
+*                   The latencies are measured from the first and the last
+*                   edge of the bouncy waveform to the button event.
+*
+*   Author:         Alberto Martin Cajal
+*                   amartin.glimpse23@gmail.com
+*                   amartin<DOT>glimpse23<AT>gmail<DOT>.com
+*
+*   License:        GNU GPL v3.0
+*
+*   URL:            https://github.com/amcajal/beethduino
+*
+*******************************************************************************/
+#define __ASSERT_USE_STDERR
+
+#include <assert.h>
+#include <stdio.h>
+
+#include "Arduino_simulator.h"
+#include "Beethduino.h"
+#include "beethduino_host_test_helpers.h"
+
+const unsigned long BUTTON_LEVEL_MS         = 50;
+const unsigned long long BOUNCE_NS          = 300 * SIM_NS_IN_US;
+const unsigned long long GLITCH_NS          = 2 * SIM_NS_IN_MS;
+const unsigned long long TICK_NS            = SIM_NS_IN_MS;
+
+/* Edges of each bouncy waveform (1 is a clean edge). */
+const int BOUNCE_EDGES[]                    = {1, 3, 7, 15};
+const int BOUNCE_WAVEFORMS                  = 4;
+
+unsigned long long first_edge_ns;
+unsigned long long last_edge_ns;
+
+/******************************************************************************/
+
+
+void execute_tests();
+void test_idle_main_loop();
+void test_pressing_while_main_loop_busy();
+void test_events_attended_in_order();
+void test_buzzer_pin_not_latched();
+void test_full_event_queue();
+void test_bouncy_press_and_release();
+void test_short_glitch_filtered();
+void test_overlapped_buttons();
+void test_long_press_without_repeat();
+void hold_button_level(int pin, int level, unsigned long duration_ms);
+void redraw_lcd(Beethduino &beethduino);
+void inject_bouncy_edge(int pin, int level, int edges);
+unsigned long long wait_button_event(Beethduino &beethduino);
+byte queued_button_events(Beethduino &beethduino);
+byte queued_button_event_type(Beethduino &beethduino, byte position);
+
+
+int main()
+{
+    printf("HOST UNIT TESTING STARTED\n******************************\n");
+    printf("%%%%%%Testing: button events (debouncer, pin change interrupt)\n");
+
+    execute_tests();
+
+    printf("HOST UNIT TESTING FINISHED\n******************************\n");
+    return 0;
+}
+
+
+void execute_tests()
+{
+    test_idle_main_loop();
+    test_pressing_while_main_loop_busy();
+    test_events_attended_in_order();
+    test_buzzer_pin_not_latched();
+    test_full_event_queue();
+    test_bouncy_press_and_release();
+    test_short_glitch_filtered();
+    test_overlapped_buttons();
+    test_long_press_without_repeat();
+}
+
+
+/**
+* Without events, the main loop does not call the Arduino core: it takes
+* no simulated time (before, ten digitalRead calls per iteration). The
+* first iterations send the initial LCD frame.
+*/
+void test_idle_main_loop()
+{
+    printf("test_idle_main_loop\n");
+    sim_reset();
+    Beethduino beethduino;
+    configure_beethduino(beethduino);
+
+    while (beethduino.lcd_next_cell < Beethduino::LCD_CELLS)
+    {
+        beethduino.exec_main_loop();
+    }
+
+    unsigned long long start_ns = sim_time_ns();
+
+    for (int i = 0; i < 1000; i++)
+    {
+        beethduino.exec_main_loop();
+    }
+
+    assert (sim_time_ns() == start_ns);
+    assert (sim_pin_change_interrupts() == 0);
+    assert (beethduino.is_button_debounce_active == false);
+    printf("\n");
+}
+
+
+/**
+* A button pressed and released while the main loop is busy (i.e: LCD
+* redraws) is not missed: the operation is performed in the next iteration.
+*/
+void test_pressing_while_main_loop_busy()
+{
+    printf("test_pressing_while_main_loop_busy\n");
+    sim_reset();
+    Beethduino beethduino;
+    configure_beethduino(beethduino);
+
+    unsigned long long press_ns = sim_time_ns() + TICK_NS;
+    unsigned long long level_ns = BUTTON_LEVEL_MS * SIM_NS_IN_MS;
+
+    sim_schedule_pin_level(beethduino.CHANGE_BPM_BY_ONE_BUTTON_PIN, HIGH,
+                           press_ns);
+    sim_schedule_pin_level(beethduino.CHANGE_BPM_BY_ONE_BUTTON_PIN, LOW,
+                           press_ns + level_ns);
+
+    /* Only the changed characters are redrawn: invert the modifier twice,
+    *  and send all the slices (the button events are not attended).
+    */
+    while (sim_time_ns() < press_ns + 2 * level_ns)
+    {
+        beethduino.invert_bpm_modifier();
+        redraw_lcd(beethduino);
+        beethduino.invert_bpm_modifier();
+        redraw_lcd(beethduino);
+    }
+
+    assert (sim_pin_change_interrupts() == 2);
+    assert (queued_button_events(beethduino) == 2);
+    assert (beethduino.bpm == 60);
+
+    beethduino.exec_main_loop();
+
+    assert (queued_button_events(beethduino) == 0);
+    assert (beethduino.last_pressed_button_pin == 0);
+    assert (beethduino.bpm == 61);
+    printf("\n");
+}
+
+
+/**
+* Two pressings done while the main loop is busy are attended in order:
+* first the modifier is inverted, then the BPM is decreased.
+*/
+void test_events_attended_in_order()
+{
+    printf("test_events_attended_in_order\n");
+    sim_reset();
+    Beethduino beethduino;
+    configure_beethduino(beethduino);
+
+    hold_button_level(beethduino.ADD_OR_SUB_BPM_BUTTON_PIN, HIGH,
+                      BUTTON_LEVEL_MS);
+    hold_button_level(beethduino.ADD_OR_SUB_BPM_BUTTON_PIN, LOW,
+                      BUTTON_LEVEL_MS);
+    hold_button_level(beethduino.CHANGE_BPM_BY_TEN_BUTTON_PIN, HIGH,
+                      BUTTON_LEVEL_MS);
+    hold_button_level(beethduino.CHANGE_BPM_BY_TEN_BUTTON_PIN, LOW,
+                      BUTTON_LEVEL_MS);
+
+    assert (queued_button_events(beethduino) == 4);
+
+    beethduino.exec_main_loop();
+
+    assert (beethduino.bpm_modifier == -1);
+    assert (beethduino.bpm == 50);
+    assert (strcmp(beethduino.bpm_text_info, 
+                   "MUTE_MUTE_MUTE_LFCRSUB BPM: 50") == 0);
+    printf("\n");
+}
+
+
+/**
+* The buzzer pin (PB0) is not enabled in PCMSK0: the beats do not trigger
+* the pin change interrupt, nor activate the debouncer.
+*/
+void test_buzzer_pin_not_latched()
+{
+    printf("test_buzzer_pin_not_latched\n");
+    sim_reset();
+    Beethduino beethduino;
+    configure_beethduino(beethduino);
+
+    beethduino.change_mute_state();
+    delay(10 * beethduino.bpm_freq_req_iter);
+
+    assert (beethduino.buzzer_bips == 10);
+    assert (sim_pin_change_interrupts() == 0);
+    assert (beethduino.is_button_debounce_active == false);
+    assert (queued_button_events(beethduino) == 0);
+    printf("\n");
+}
+
+
+/**
+* The queue keeps BUTTON_EVENT_QUEUE_SIZE - 1 events; the following ones
+* are lost. The kept pressings are attended, and the queue is usable again.
+*/
+void test_full_event_queue()
+{
+    printf("test_full_event_queue\n");
+    sim_reset();
+    Beethduino beethduino;
+    configure_beethduino(beethduino);
+
+    /* 7 complete pressings (14 events), and one more event. */
+    for (int i = 0; i < 10; i++)
+    {
+        hold_button_level(beethduino.CHANGE_BPM_BY_ONE_BUTTON_PIN, HIGH,
+                          BUTTON_LEVEL_MS);
+        hold_button_level(beethduino.CHANGE_BPM_BY_ONE_BUTTON_PIN, LOW,
+                          BUTTON_LEVEL_MS);
+    }
+
+    assert (queued_button_events(beethduino)
+            == Beethduino::BUTTON_EVENT_QUEUE_SIZE - 1);
+
+    beethduino.exec_main_loop();
+
+    assert (beethduino.bpm == 67);
+    assert (beethduino.last_pressed_button_pin
+            == beethduino.CHANGE_BPM_BY_ONE_BUTTON_PIN);
+
+    hold_button_level(beethduino.CHANGE_BPM_BY_ONE_BUTTON_PIN, HIGH,
+                      BUTTON_LEVEL_MS);
+    hold_button_level(beethduino.CHANGE_BPM_BY_ONE_BUTTON_PIN, LOW,
+                      BUTTON_LEVEL_MS);
+    beethduino.exec_main_loop();
+
+    assert (beethduino.bpm == 68);
+    assert (beethduino.last_pressed_button_pin == 0);
+    printf("\n");
+}
+
+
+/**
+* Every bouncy pressing and release gives one event, and one operation.
+* The event is generated BUTTON_DEBOUNCE_TICKS ticks (at most) after the
+* last edge.
+*/
+void test_bouncy_press_and_release()
+{
+    printf("test_bouncy_press_and_release\n");
+    printf("    %5s %12s %12s %12s %12s\n", "edges", "press first",
+           "press last", "release first", "release last");
+
+    for (int waveform = 0; waveform < BOUNCE_WAVEFORMS; waveform++)
+    {
+        sim_reset();
+        Beethduino beethduino;
+        configure_beethduino(beethduino);
+        int pin = beethduino.CHANGE_BPM_BY_ONE_BUTTON_PIN;
+
+        inject_bouncy_edge(pin, HIGH, BOUNCE_EDGES[waveform]);
+        unsigned long long press_ns = wait_button_event(beethduino);
+        unsigned long long press_first_ns = press_ns - first_edge_ns;
+        unsigned long long press_last_ns = press_ns - last_edge_ns;
+
+        hold_button_level(pin, HIGH, BUTTON_LEVEL_MS);
+        assert (queued_button_events(beethduino) == 1);
+        assert (queued_button_event_type(beethduino, 0)
+                == Beethduino::BUTTON_PRESSED);
+
+        inject_bouncy_edge(pin, LOW, BOUNCE_EDGES[waveform]);
+        unsigned long long release_ns = wait_button_event(beethduino);
+        unsigned long long release_first_ns = release_ns - first_edge_ns;
+        unsigned long long release_last_ns = release_ns - last_edge_ns;
+
+        hold_button_level(pin, LOW, BUTTON_LEVEL_MS);
+        assert (queued_button_events(beethduino) == 2);
+        assert (queued_button_event_type(beethduino, 1)
+                == Beethduino::BUTTON_RELEASED);
+        assert (beethduino.is_button_debounce_active == false);
+
+        beethduino.exec_main_loop();
+        assert (beethduino.bpm == 61);
+
+        /* One tick of margin: the ISR time after the tick. */
+        assert (press_last_ns
+                <= (Beethduino::BUTTON_DEBOUNCE_TICKS + 1) * TICK_NS);
+        assert (release_last_ns
+                <= (Beethduino::BUTTON_DEBOUNCE_TICKS + 1) * TICK_NS);
+        assert (press_first_ns
+                >= (Beethduino::BUTTON_DEBOUNCE_TICKS - 1) * TICK_NS);
+
+        printf("    %5d %9.3f ms %9.3f ms %9.3f ms %9.3f ms\n",
+               BOUNCE_EDGES[waveform],
+               (double) press_first_ns / SIM_NS_IN_MS,
+               (double) press_last_ns / SIM_NS_IN_MS,
+               (double) release_first_ns / SIM_NS_IN_MS,
+               (double) release_last_ns / SIM_NS_IN_MS);
+    }
+    printf("\n");
+}
+
+
+/**
+* A glitch shorter than the debounce window is not a pressing.
+*/
+void test_short_glitch_filtered()
+{
+    printf("test_short_glitch_filtered\n");
+    sim_reset();
+    Beethduino beethduino;
+    configure_beethduino(beethduino);
+
+    unsigned long long glitch_ns = sim_time_ns() + TICK_NS / 2;
+
+    sim_schedule_pin_level(beethduino.MUTE_BUZZER_BUTTON_PIN, HIGH,
+                           glitch_ns);
+    sim_schedule_pin_level(beethduino.MUTE_BUZZER_BUTTON_PIN, LOW,
+                           glitch_ns + GLITCH_NS);
+    delay(BUTTON_LEVEL_MS);
+
+    assert (sim_pin_change_interrupts() == 2);
+    assert (queued_button_events(beethduino) == 0);
+    assert (beethduino.is_button_debounce_active == false);
+    printf("\n");
+}
+
+
+/**
+* Two overlapped pressings (the first button is released while the second
+* is held) perform both operations; with one tracked button, the first
+* pressing was lost.
+*/
+void test_overlapped_buttons()
+{
+    printf("test_overlapped_buttons\n");
+    sim_reset();
+    Beethduino beethduino;
+    configure_beethduino(beethduino);
+
+    hold_button_level(beethduino.CHANGE_BPM_BY_ONE_BUTTON_PIN, HIGH,
+                      BUTTON_LEVEL_MS);
+    hold_button_level(beethduino.CHANGE_BPM_BY_TEN_BUTTON_PIN, HIGH,
+                      BUTTON_LEVEL_MS);
+    beethduino.exec_main_loop();
+    assert (beethduino.last_pressed_button_pin
+            == beethduino.CHANGE_BPM_BY_TEN_BUTTON_PIN);
+
+    hold_button_level(beethduino.CHANGE_BPM_BY_ONE_BUTTON_PIN, LOW,
+                      BUTTON_LEVEL_MS);
+    beethduino.exec_main_loop();
+    assert (beethduino.bpm == 61);
+    assert (beethduino.last_pressed_button_pin
+            == beethduino.CHANGE_BPM_BY_TEN_BUTTON_PIN);
+
+    hold_button_level(beethduino.CHANGE_BPM_BY_TEN_BUTTON_PIN, LOW,
+                      BUTTON_LEVEL_MS);
+    beethduino.exec_main_loop();
+    assert (beethduino.bpm == 71);
+    assert (beethduino.last_pressed_button_pin == 0);
+    printf("\n");
+}
+
+
+/**
+* A held button gives a long pressing after BUTTON_LONG_PRESS_TICKS. The
+* buttons that are not repeated (i.e: mute) give no more events until the
+* release; the long pressing of the mute button starts the tempo map, and
+* its release does not mute the buzzer again.
+*/
+void test_long_press_without_repeat()
+{
+    printf("test_long_press_without_repeat\n");
+    sim_reset();
+    Beethduino beethduino;
+    configure_beethduino(beethduino);
+    int pin = beethduino.MUTE_BUZZER_BUTTON_PIN;
+
+    inject_bouncy_edge(pin, HIGH, 1);
+    unsigned long long press_ns = wait_button_event(beethduino);
+    unsigned long long long_press_ns = wait_button_event(beethduino);
+
+    assert (long_press_ns - press_ns
+            == Beethduino::BUTTON_LONG_PRESS_TICKS * TICK_NS);
+
+    delay(10 * Beethduino::BUTTON_LONG_PRESS_TICKS);
+    hold_button_level(pin, LOW, BUTTON_LEVEL_MS);
+
+    assert (queued_button_events(beethduino) == 3);
+    assert (queued_button_event_type(beethduino, 0)
+            == Beethduino::BUTTON_PRESSED);
+    assert (queued_button_event_type(beethduino, 1)
+            == Beethduino::BUTTON_LONG_PRESSED);
+    assert (queued_button_event_type(beethduino, 2)
+            == Beethduino::BUTTON_RELEASED);
+
+    beethduino.exec_main_loop();
+    assert (beethduino.is_buzzer_muted == false);
+    assert (beethduino.is_tempo_map_running == true);
+    assert (beethduino.long_pressed_buttons == 0);
+    assert (beethduino.is_button_debounce_active == false);
+    printf("\n");
+}
+
+
+/**
+* The main loop is not executed: the events are kept in the queue.
+*/
+void hold_button_level(int pin, int level, unsigned long duration_ms)
+{
+    digitalWrite(pin, level);
+    delay(duration_ms);
+}
+
+
+void redraw_lcd(Beethduino &beethduino)
+{
+    beethduino.update_lcd();
+
+    while (beethduino.lcd_next_cell < Beethduino::LCD_CELLS)
+    {
+        beethduino.service_lcd();
+    }
+}
+
+
+/**
+* Schedules a waveform of the given number of edges (odd), one every
+* BOUNCE_NS, that starts now and ends in the given level.
+*/
+void inject_bouncy_edge(int pin, int level, int edges)
+{
+    int bounce_level = level;
+
+    first_edge_ns = sim_time_ns();
+    for (int edge = 0; edge < edges; edge++)
+    {
+        last_edge_ns = first_edge_ns + edge * BOUNCE_NS;
+        sim_schedule_pin_level(pin, bounce_level, last_edge_ns);
+        bounce_level = (bounce_level == HIGH) ? LOW : HIGH;
+    }
+}
+
+
+/**
+* Advances the clock, event by event, until a new button event is queued;
+* returns its simulated time.
+*/
+unsigned long long wait_button_event(Beethduino &beethduino)
+{
+    byte queued_events = queued_button_events(beethduino);
+
+    while (queued_button_events(beethduino) == queued_events)
+    {
+        sim_idle_until_ns(~0ULL);
+    }
+
+    return sim_time_ns();
+}
+
+
+byte queued_button_events(Beethduino &beethduino)
+{
+    return (beethduino.button_event_head - beethduino.button_event_tail)
+           & (Beethduino::BUTTON_EVENT_QUEUE_SIZE - 1);
+}
+
+
+byte queued_button_event_type(Beethduino &beethduino, byte position)
+{
+    return beethduino.button_event_types[(beethduino.button_event_tail
+                                           + position)
+                                          & (Beethduino::BUTTON_EVENT_QUEUE_SIZE
+                                             - 1)];
+}
+
+
+void __assert(const char *__func, const char *__file,
+              int __lineno, const char *__sexp)
+{
+    printf("TEST_FAILED\n%s\n%s\n%d\n%s\n", __file, __func, __lineno, __sexp);
+    fflush(stdout);
+
+    abort();
+}
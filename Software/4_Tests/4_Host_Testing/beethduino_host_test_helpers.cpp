@@ -0,0 +1,90 @@
+/*******************************************************************************
+*   Project:        Beethduino, an Arduino Do-it-yourself electronic metronome.
+*
+*   File:           beethduino_host_test_helpers.cpp
+*
+*   Description:    Body file of the fixture shared by the host (PC) tests
+*                   of the Beethduino library.
+*
+*   Language:       C++ (host, g++).
+*
+*   Dependencies:   beethduino_host_test_helpers.h
+*
+*   Author:         Alberto Martin Cajal
+*                   amartin.glimpse23@gmail.com
+*                   amartin<DOT>glimpse23<AT>gmail<DOT>.com
+*
+*   License:        GNU GPL v3.0
+*
+*   URL:            https://github.com/amcajal/beethduino
+*
+*******************************************************************************/
+
+#include "beethduino_host_test_helpers.h"
+
+Beethduino *beethduino;
+std::vector<unsigned long long> beat_edges_ns;
+std::vector<unsigned long long> rising_edges_ns;
+std::vector<unsigned long long> falling_edges_ns;
+
+
+void configure_beethduino(Beethduino &metronome)
+{
+    metronome.configure_beat_timer();
+    metronome.configure_button_interrupts();
+}
+
+
+/**
+* The level is held while the main loop runs (and attends the events).
+*/
+void hold_button_level(Beethduino &metronome, int pin, int level,
+                       unsigned long duration_ms)
+{
+    digitalWrite(pin, level);
+    run_main_loop_until(metronome,
+                        sim_time_ns() + duration_ms * SIM_NS_IN_MS);
+}
+
+
+void run_main_loop_until(Beethduino &metronome, unsigned long long end_ns)
+{
+    while (sim_time_ns() < end_ns)
+    {
+        unsigned long long loop_start_ns = sim_time_ns();
+
+        metronome.exec_main_loop();
+        sim_finish_loop(loop_start_ns, end_ns);
+    }
+}
+
+
+void record_beat_edge(uint8_t pin, int level, unsigned long long time_ns)
+{
+    if ((pin == beethduino->ACTIVE_BUZZER_PIN) && (level == HIGH))
+    {
+        beat_edges_ns.push_back(time_ns);
+    }
+}
+
+
+void record_buzzer_edge(uint8_t pin, int level, unsigned long long time_ns)
+{
+    if (pin != beethduino->ACTIVE_BUZZER_PIN)
+    {
+        return;
+    }
+
+    if (level == HIGH)
+    {
+        rising_edges_ns.push_back(time_ns);
+    }
+    else if (falling_edges_ns.size() < rising_edges_ns.size())
+    {
+        falling_edges_ns.push_back(time_ns);
+    }
+    else
+    {
+        /* No operation. */
+    }
+}
@@ -0,0 +1,58 @@
+/*******************************************************************************
+*   Project:        Beethduino, an Arduino Do-it-yourself electronic metronome.
+*
+*   File:           beethduino_host_test_helpers.h
+*
+*   Description:    Fixture shared by the host (PC) tests of the Beethduino
+*                   library over the Arduino simulator: the configuration of
+*                   the metronome, its main loop until a simulated time, the
+*                   button levels held while it runs, and the pin listeners
+*                   that record the edges of the active buzzer.
+*
+*   Language:       C++ (host, g++).
+*                   Compiled with CMake, with every test that includes it.
+*
+*   Dependencies:   vector
+*                   Arduino_simulator.h
+*                   Beethduino.h
+*
+*   Notes:          The pin listeners are plain functions (see
+*                   sim_set_pin_listener), so the metronome under test and
+*                   the recorded edges are global: the test sets beethduino
+*                   and clears the edges before every run.
+*
+*   Author:         Alberto Martin Cajal
+*                   amartin.glimpse23@gmail.com
+*                   amartin<DOT>glimpse23<AT>gmail<DOT>.com
+*
+*   License:        GNU GPL v3.0
+*
+*   URL:            https://github.com/amcajal/beethduino
+*
+*******************************************************************************/
+
+#ifndef beethduino_host_test_helpers_h
+#define beethduino_host_test_helpers_h
+
+#include <vector>
+
+#include "Arduino_simulator.h"
+#include "Beethduino.h"
+
+extern Beethduino *beethduino;
+
+/* Rising edges of the active buzzer (record_beat_edge). */
+extern std::vector<unsigned long long> beat_edges_ns;
+
+/* Rising and falling edges of the active buzzer (record_buzzer_edge). */
+extern std::vector<unsigned long long> rising_edges_ns;
+extern std::vector<unsigned long long> falling_edges_ns;
+
+void configure_beethduino(Beethduino &metronome);
+void hold_button_level(Beethduino &metronome, int pin, int level,
+                       unsigned long duration_ms);
+void run_main_loop_until(Beethduino &metronome, unsigned long long end_ns);
+void record_beat_edge(uint8_t pin, int level, unsigned long long time_ns);
+void record_buzzer_edge(uint8_t pin, int level, unsigned long long time_ns);
+
+#endif
@@ -0,0 +1,499 @@
+/*******************************************************************************
+*   Project:        Beethduino, an Arduino Do-it-yourself electronic metronome.
+*
+*   File:           beethduino_host_test_polyrhythms.cpp
+*
+*   Description:    Host (PC) testing of the polyrhythm voices (3:4, 5:7,
+*                   2:3 and 7:4), selected by the tempo map and interpreted
+*                   by the Beethduino library over the Arduino simulator.
+*                   Every pulse of a voice is compared with its exact
+*                   reference: the pulse j of a cycle of pulses against
+*                   beats is in the beat k = floor(j * beats / pulses), at
+*                   floor(p * L / pulses) ticks from it, where p = j * beats
+*                   - k * pulses and L is the period of the beat (in a
+*                   ramp, the one of every beat). The accents, the tone of
+*                   the 5:7 voice, the pulses in the buzzer (2:3) and the
+*                   events pending (never more than VOICE_EVENTS_SIZE) are
+*                   checked, and the restart button stops the voices.
+*
+*   Language:       C++ (host, g++).
+*                   Compiled with CMake (target of the same name), with the
+*                   Arduino_simulator folder, Beethduino.cpp and the
+*                   Beethduino_tempo_map folder.
+*
+*   Dependencies:   algorithm
+*                   assert.h
+*                   math.h
+*                   stdio.h
+*                   string.h
+*                   vector
+*                   Arduino_simulator.h
+*                   Beethduino.h
+*                   beethduino_host_test_helpers.h
+*                   Beethduino_tempo_map.h
+*
+*   Notes:          BPM - Beats Per Minute.
+*                   The ticks of the edges are rounded from the first
+*                   downbeat (the pulses are played a few microseconds after
+*                   their tick). The cycles of all the voices start again
+*                   when the voices change, in the first downbeat of the
+*                   segment.
+*
+*   Author:         Alberto Martin Cajal
+*                   amartin.glimpse23@gmail.com
+*                   amartin<DOT>glimpse23<AT>gmail<DOT>.com
+*
+*   License:        GNU GPL v3.0
+*
+*   URL:            https://github.com/amcajal/beethduino
+*
+*******************************************************************************/
+#define __ASSERT_USE_STDERR
+
+#include <algorithm>
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "Arduino_simulator.h"
+#include "Beethduino.h"
+#include "beethduino_host_test_helpers.h"
+#include "Beethduino_tempo_map.h"
+
+const unsigned long long TICK_NS            = SIM_NS_IN_MS;
+const unsigned long BUTTON_LEVEL_MS         = 50;
+const unsigned int MAX_SEGMENTS             = 100;
+const byte BUZZER_VOICE                     = 2;    /* 2 against 3. */
+const byte TONE_VOICE                       = 1;    /* 5 against 7. */
+
+/* Bytes of the program with the voices. */
+const byte VOICES_PROGRAM[] =
+{
+    Beethduino::TEMPO_MAP_VOICES, 0x03,
+    Beethduino::TEMPO_MAP_PLAY, 120, 0, 4,
+    Beethduino::TEMPO_MAP_VOICES, 0x00,
+    Beethduino::TEMPO_MAP_PLAY, 120, 0, 1,
+    Beethduino::TEMPO_MAP_END
+};
+
+struct VoiceProgram
+{
+    const char *name;
+    const char *source;
+};
+
+const VoiceProgram VOICE_PROGRAMS[] =
+{
+    {"all the voices, 4/4",
+     "voices 1 2 3 4\nplay 120 8\n"},
+    {"3:4 and 7:4, 6/8, linear accelerando, then 5:7 and 2:3",
+     "time 6/8\nvoices 1 4\nplay 90 2\nlinear 4 150\nvoices 2 3\n"
+     "play 150 3\n"},
+    {"5:7 and 7:4, linear ritardando, 3/4, the same voices",
+     "voices 2 4\nplay 200 1\ntime 3/4\nlinear 6 80\nplay 80 2\n"}
+};
+const int VOICE_PROGRAMS_COUNT = sizeof(VOICE_PROGRAMS)
+                                 / sizeof(VOICE_PROGRAMS[0]);
+
+struct VoicePulse
+{
+    unsigned long tick;
+    unsigned long duration;
+};
+
+std::vector<unsigned long long> voice_rises_ns[Beethduino::VOICES_COUNT];
+std::vector<unsigned long long> voice_falls_ns[Beethduino::VOICES_COUNT];
+byte max_voice_events;
+
+/******************************************************************************/
+
+
+void execute_tests();
+void test_compile_voices();
+void test_voice_program(const VoiceProgram &voice_program);
+void test_restart_button_stops_voices();
+void expected_pulses(const std::vector<TempoSegment> &segments,
+                     std::vector<VoicePulse> *pulses);
+unsigned long edge_tick(unsigned long long edge_ns,
+                        unsigned long long first_beat_ns);
+void record_voice_edge(uint8_t pin, int level, unsigned long long time_ns);
+
+
+int main()
+{
+    printf("HOST UNIT TESTING STARTED\n******************************\n");
+    printf("%%%%%%Testing: polyrhythm voices\n");
+
+    execute_tests();
+
+    printf("HOST UNIT TESTING FINISHED\n******************************\n");
+    return 0;
+}
+
+
+void execute_tests()
+{
+    test_compile_voices();
+
+    for (int program = 0; program < VOICE_PROGRAMS_COUNT; program++)
+    {
+        test_voice_program(VOICE_PROGRAMS[program]);
+    }
+
+    test_restart_button_stops_voices();
+}
+
+
+/**
+* voices compiles into its opcode and the mask of its voices (none without
+* operands); the voices out of range are rejected in their line. The
+* segments of the expansion keep the voices until the next instruction.
+*/
+void test_compile_voices()
+{
+    printf("test_compile_voices\n");
+    BeethduinoTempoMap tempo_map;
+    std::vector<TempoSegment> segments;
+
+    bool is_compiled = tempo_map.compile("voices 1 2\nplay 120 4\n"
+                                         "voices  # None.\nplay 120 1\n");
+    assert (is_compiled == true);
+    assert (tempo_map.program.size() == sizeof(VOICES_PROGRAM));
+    assert (memcmp(&tempo_map.program[0], VOICES_PROGRAM,
+                   sizeof(VOICES_PROGRAM)) == 0);
+
+    is_compiled = tempo_map.compile("play 60 1\nvoices 5\n");
+    assert (is_compiled == false);
+    assert (tempo_map.error_line == 2);
+    is_compiled = tempo_map.compile("voices 0\n");
+    assert (is_compiled == false);
+    assert (tempo_map.error_line == 1);
+    is_compiled = tempo_map.compile("voices 1 x\n");
+    assert (is_compiled == false);
+    assert (tempo_map.error_line == 1);
+
+    is_compiled = tempo_map.compile("voices 4 3\nplay 60 1\nramp +10 3 90\n"
+                                    "voices 2\nplay 90 1\n");
+    assert (is_compiled == true);
+    tempo_map.expand(60, Beethduino::DEFAULT_TIME_SIGNATURE, MAX_SEGMENTS,
+                     segments);
+    assert (segments.size() == 5);
+    assert (segments[0].voices == 0x0C);
+    assert (segments[3].voices == 0x0C);
+    assert (segments[4].voices == 0x02);
+
+    tempo_map.write_array(stdout);
+    printf("\n");
+}
+
+
+/**
+* The program, started by the long pressing of the mute button, is
+* recorded up to its last downbeat (excluded). The pulses of every voice
+* with a pin (A0, A1 and A2) are exactly the expected ones, with their
+* durations; the ones of the buzzer voice are among the rising edges of the
+* buzzer.
+*/
+void test_voice_program(const VoiceProgram &voice_program)
+{
+    printf("test_voice_program: %s\n", voice_program.name);
+    sim_reset();
+    Beethduino metronome;
+    beethduino = &metronome;
+    configure_beethduino(metronome);
+
+    BeethduinoTempoMap tempo_map;
+    std::vector<TempoSegment> segments;
+    std::vector<VoicePulse> pulses[Beethduino::VOICES_COUNT];
+    std::vector<unsigned long> buzzer_ticks;
+    unsigned int checked_pulses = 0;
+
+    bool is_compiled = tempo_map.compile(voice_program.source);
+    assert (is_compiled == true);
+    tempo_map.expand(metronome.bpm, metronome.time_signature, MAX_SEGMENTS,
+                     segments);
+    metronome.tempo_map = &tempo_map.program[0];
+    metronome.tempo_map_size = tempo_map.program.size();
+    expected_pulses(segments, pulses);
+
+    const TempoSegment &last = segments.back();
+    unsigned long end_tick = last.start_tick
+        + (unsigned long) floorl(BeethduinoTempoMap::beat_time(
+              last, BeethduinoTempoMap::segment_beats(last)));
+
+    for (byte voice = 0; voice < Beethduino::VOICES_COUNT; voice++)
+    {
+        voice_rises_ns[voice].clear();
+        voice_falls_ns[voice].clear();
+    }
+
+    max_voice_events = 0;
+    sim_set_pin_listener(record_voice_edge);
+
+    metronome.perform_operation(metronome.MUTE_BUZZER_BUTTON_PIN,
+                                Beethduino::BUTTON_LONG_PRESSED);
+    assert (metronome.is_tempo_map_running == true);
+    unsigned long long first_beat_ns = sim_time_ns()
+        + metronome.bpm_freq_req_iter * TICK_NS;
+    run_main_loop_until(metronome, first_beat_ns + end_tick * TICK_NS
+                                   - (TICK_NS / 2));
+    sim_set_pin_listener(0);
+
+    for (size_t edge = 0; edge < voice_rises_ns[BUZZER_VOICE].size();
+         edge++)
+    {
+        buzzer_ticks.push_back(edge_tick(voice_rises_ns[BUZZER_VOICE][edge],
+                                         first_beat_ns));
+    }
+
+    for (byte voice = 0; voice < Beethduino::VOICES_COUNT; voice++)
+    {
+        if (voice == BUZZER_VOICE)
+        {
+            for (size_t pulse = 0; pulse < pulses[voice].size(); pulse++)
+            {
+                assert (std::find(buzzer_ticks.begin(), buzzer_ticks.end(),
+                                  pulses[voice][pulse].tick)
+                        != buzzer_ticks.end());
+                checked_pulses++;
+            }
+
+            continue;
+        }
+
+        assert (voice_rises_ns[voice].size() == pulses[voice].size());
+        assert (voice_falls_ns[voice].size() == pulses[voice].size());
+
+        for (size_t pulse = 0; pulse < pulses[voice].size(); pulse++)
+        {
+            assert (edge_tick(voice_rises_ns[voice][pulse], first_beat_ns)
+                    == pulses[voice][pulse].tick);
+            assert (edge_tick(voice_falls_ns[voice][pulse], first_beat_ns)
+                    == pulses[voice][pulse].tick
+                       + pulses[voice][pulse].duration);
+            checked_pulses++;
+        }
+    }
+
+    if (pulses[TONE_VOICE].empty() == false)
+    {
+        assert (sim_tone_pin() == Beethduino::VOICES[TONE_VOICE].pin);
+        assert (sim_tone_frequency()
+                == Beethduino::VOICES[TONE_VOICE].tone_frequency);
+    }
+
+    printf("    %u segments, %u pulses of the voices, at most %u events "
+           "pending\n", (unsigned int) segments.size(), checked_pulses,
+           (unsigned int) max_voice_events);
+
+    assert (max_voice_events <= Beethduino::VOICE_EVENTS_SIZE);
+
+    /* The last downbeat ends the program; the voices go on. */
+    run_main_loop_until(metronome, first_beat_ns + (end_tick + 1) * TICK_NS);
+    assert (metronome.is_tempo_map_running == false);
+    assert (metronome.active_voices == last.voices);
+    beethduino = 0;
+    printf("\n");
+}
+
+
+/**
+* The voices go on after the end of the program, until the restart button:
+* no event pending, the pins of the voices low, and only the beats after
+* the buzzer is unmuted.
+*/
+void test_restart_button_stops_voices()
+{
+    printf("test_restart_button_stops_voices\n");
+    sim_reset();
+    Beethduino metronome;
+    beethduino = &metronome;
+    configure_beethduino(metronome);
+
+    BeethduinoTempoMap tempo_map;
+    bool is_compiled = tempo_map.compile("voices 1 2 4\nplay 100 1\n");
+    assert (is_compiled == true);
+    metronome.tempo_map = &tempo_map.program[0];
+    metronome.tempo_map_size = tempo_map.program.size();
+
+    metronome.perform_operation(metronome.MUTE_BUZZER_BUTTON_PIN,
+                                Beethduino::BUTTON_LONG_PRESSED);
+    run_main_loop_until(metronome, sim_time_ns() + 5 * SIM_NS_IN_S);
+    assert (metronome.is_tempo_map_running == false);
+    assert (metronome.active_voices == 0x0B);
+
+    hold_button_level(metronome, metronome.RESTART_BPM_BUTTON_PIN, HIGH,
+                      BUTTON_LEVEL_MS);
+    hold_button_level(metronome, metronome.RESTART_BPM_BUTTON_PIN, LOW,
+                      BUTTON_LEVEL_MS);
+    assert (metronome.active_voices == 0);
+    assert (metronome.voice_event_count == 0);
+    assert (metronome.sounding_voice_pins == 0);
+    assert (metronome.is_buzzer_muted == true);
+
+    metronome.perform_operation(metronome.MUTE_BUZZER_BUTTON_PIN,
+                                Beethduino::BUTTON_RELEASED);
+
+    for (byte voice = 0; voice < Beethduino::VOICES_COUNT; voice++)
+    {
+        voice_rises_ns[voice].clear();
+    }
+
+    sim_set_pin_listener(record_voice_edge);
+    run_main_loop_until(metronome, sim_time_ns() + 5 * SIM_NS_IN_S);
+    sim_set_pin_listener(0);
+    assert (voice_rises_ns[0].empty() == true);
+    assert (voice_rises_ns[TONE_VOICE].empty() == true);
+    assert (voice_rises_ns[3].empty() == true);
+    assert (voice_rises_ns[BUZZER_VOICE].empty() == false);
+    beethduino = 0;
+    printf("\n");
+}
+
+
+/**
+* Pulses of every voice, from the first downbeat, up to the last downbeat
+* of the segments: the beats are floor(beat_time) ticks after the first
+* downbeat of their segment, and the cycles start again when the voices
+* change.
+*/
+void expected_pulses(const std::vector<TempoSegment> &segments,
+                     std::vector<VoicePulse> *pulses)
+{
+    std::vector<unsigned long> beat_ticks;
+    std::vector<size_t> first_beats;
+    std::vector<byte> beat_voices;
+
+    for (size_t segment = 0; segment < segments.size(); segment++)
+    {
+        unsigned long beats
+            = BeethduinoTempoMap::segment_beats(segments[segment]);
+
+        for (unsigned long beat = 0; beat < beats; beat++)
+        {
+            if ((beat == 0)
+                && ((segment == 0)
+                    || (segments[segment].voices
+                        != segments[segment - 1].voices)))
+            {
+                first_beats.push_back(beat_ticks.size());
+            }
+
+            beat_ticks.push_back(segments[segment].start_tick
+                + (unsigned long) floorl(BeethduinoTempoMap::beat_time(
+                      segments[segment], beat)));
+            beat_voices.push_back(segments[segment].voices);
+        }
+    }
+
+    /* The last downbeat ends the period of the last beat. */
+    const TempoSegment &last = segments.back();
+    beat_ticks.push_back(last.start_tick
+        + (unsigned long) floorl(BeethduinoTempoMap::beat_time(
+              last, BeethduinoTempoMap::segment_beats(last))));
+    first_beats.push_back(beat_ticks.size() - 1);
+
+    for (byte voice = 0; voice < Beethduino::VOICES_COUNT; voice++)
+    {
+        const Beethduino::Voice &entry = Beethduino::VOICES[voice];
+
+        pulses[voice].clear();
+
+        for (size_t run = 0; (run + 1) < first_beats.size(); run++)
+        {
+            size_t first_beat = first_beats[run];
+
+            if ((beat_voices[first_beat] & (1 << voice)) == 0)
+            {
+                continue;
+            }
+
+            for (unsigned long pulse = 0; ; pulse++)
+            {
+                unsigned long cycle = pulse / entry.pulses;
+                unsigned long index = pulse % entry.pulses;
+                unsigned long beat = first_beat + (cycle * entry.beats)
+                                     + ((index * entry.beats) / entry.pulses);
+                unsigned long position = (index * entry.beats)
+                                         % entry.pulses;
+                VoicePulse expected;
+
+                if (beat >= first_beats[run + 1])
+                {
+                    break;
+                }
+
+                expected.tick = beat_ticks[beat]
+                    + ((position * (beat_ticks[beat + 1] - beat_ticks[beat]))
+                       / entry.pulses);
+                expected.duration = (((entry.accents >> index) & 1) != 0)
+                                    ? entry.accent_sound_duration
+                                    : entry.sound_duration;
+                pulses[voice].push_back(expected);
+            }
+        }
+    }
+}
+
+
+unsigned long edge_tick(unsigned long long edge_ns,
+                        unsigned long long first_beat_ns)
+{
+    return (edge_ns - first_beat_ns + (TICK_NS / 2)) / TICK_NS;
+}
+
+
+/**
+* Edges of the output of every voice (the buzzer for the 2:3 voice), and
+* the maximum of events pending in the heap.
+*/
+void record_voice_edge(uint8_t pin, int level, unsigned long long time_ns)
+{
+    byte voice;
+
+    if (beethduino->voice_event_count > max_voice_events)
+    {
+        max_voice_events = beethduino->voice_event_count;
+    }
+
+    for (voice = 0; voice < Beethduino::VOICES_COUNT; voice++)
+    {
+        if (((voice == BUZZER_VOICE)
+             && (pin == beethduino->ACTIVE_BUZZER_PIN))
+            || ((voice != BUZZER_VOICE)
+                && (pin == Beethduino::VOICES[voice].pin)))
+        {
+            break;
+        }
+    }
+
+    if (voice == Beethduino::VOICES_COUNT)
+    {
+        return;
+    }
+
+    if (level == HIGH)
+    {
+        voice_rises_ns[voice].push_back(time_ns);
+    }
+    else if (voice_falls_ns[voice].size() < voice_rises_ns[voice].size())
+    {
+        voice_falls_ns[voice].push_back(time_ns);
+    }
+    else
+    {
+        /* No operation. */
+    }
+}
+
+
+void __assert(const char *__func, const char *__file,
+              int __lineno, const char *__sexp)
+{
+    printf("TEST_FAILED\n%s\n%s\n%d\n%s\n", __file, __func, __lineno, __sexp);
+    fflush(stdout);
+
+    abort();
+}
@@ -0,0 +1,405 @@
+/*******************************************************************************
+*   Project:        Beethduino, an Arduino Do-it-yourself electronic metronome.
+*
+*   File:           beethduino_host_test_subdivisions.cpp
+*
+*   Description:    Host (PC) testing of the subdivisions of the beat of the
+*                   Beethduino library, over the Arduino simulator. Checks
+*                   that the step multipliers are exact for every period,
+*                   that every sub-beat of every BPM and subdivision lands on
+*                   the exact rational reference floor(i * period / clicks)
+*                   during one minute (no drift), that at the highest tempo
+*                   and subdivision the clicks keep their period with the
+*                   LCD redrawn by the buttons, that the beats are the same
+*                   with and without subdivision, and that the long pressing
+*                   of the modifier button selects the subdivision.
+*
+*   Language:       C++ (host, g++).
+*                   Compiled with CMake (target of the same name), with the
+*                   Arduino_simulator folder and Beethduino.cpp.
+*
+*   Dependencies:   assert.h
+*                   stdio.h
+*                   vector
+*                   Arduino_simulator.h
+*                   Beethduino.h
+*                   beethduino_host_test_helpers.h
+*
+*   Notes:          BPM - Beats Per Minute.
+*                   LCD - Liquid Crystal Display.
+*                   The exact deadlines are checked calling the timer
+*                   interrupt body only at the ticks with a deadline (the
+*                   other ticks do nothing), so a minute of every BPM is
+*                   checked in a fraction of a second.
+*
+*   Author:         Alberto Martin Cajal
+*                   amartin.glimpse23@gmail.com
+*                   amartin<DOT>glimpse23<AT>gmail<DOT>.com
+*
+*   License:        GNU GPL v3.0
+*
+*   URL:            https://github.com/amcajal/beethduino
+*
+*******************************************************************************/
+#define __ASSERT_USE_STDERR
+
+#include <assert.h>
+#include <stdio.h>
+#include <vector>
+
+#include "Arduino_simulator.h"
+#include "Beethduino.h"
+#include "beethduino_host_test_helpers.h"
+
+const unsigned long long TICK_NS            = SIM_NS_IN_MS;
+const unsigned long long RECORD_NS          = 5 * SIM_NS_IN_S;
+const unsigned long long BUTTON_INTERVAL_NS = 100 * SIM_NS_IN_MS;
+const unsigned long long BUTTON_PRESS_NS    = 50 * SIM_NS_IN_MS;
+const unsigned long BUTTON_LEVEL_MS         = 50;
+
+/******************************************************************************/
+
+
+void execute_tests();
+void test_step_multipliers();
+void test_exact_deadlines();
+void check_minute_of_clicks(int bpm, byte subdivision);
+void test_highest_tempo_under_ui_load();
+void test_beats_not_moved();
+void test_long_press_changes_subdivision();
+void record_clicks(byte subdivision, bool is_ui_loaded);
+void select_subdivision(Beethduino &metronome, byte subdivision);
+
+
+int main()
+{
+    printf("HOST UNIT TESTING STARTED\n******************************\n");
+    printf("%%%%%%Testing: subdivisions of the beat\n");
+
+    execute_tests();
+
+    printf("HOST UNIT TESTING FINISHED\n******************************\n");
+    return 0;
+}
+
+
+void execute_tests()
+{
+    test_step_multipliers();
+    test_exact_deadlines();
+    test_highest_tempo_under_ui_load();
+    test_beats_not_moved();
+    test_long_press_changes_subdivision();
+}
+
+
+/**
+* (period * multiplier) >> SUBDIVISION_PERIOD_SHIFT is period / clicks for
+* every period of a beat (the base one or one tick more), and the product
+* fits in 32 bits.
+*/
+void test_step_multipliers()
+{
+    printf("test_step_multipliers\n");
+
+    for (byte subdivision = 0; subdivision < Beethduino::SUBDIVISIONS_COUNT;
+         subdivision++)
+    {
+        const Beethduino::Subdivision &entry
+            = Beethduino::SUBDIVISIONS[subdivision];
+
+        if (entry.period_multiplier == 0)
+        {
+            assert (entry.clicks_per_beat == 1);
+            continue;
+        }
+
+        for (unsigned long period = 1;
+             period <= Beethduino::MILLISECONDS_IN_MINUTE + 1; period++)
+        {
+            assert ((period * entry.period_multiplier) <= 0xFFFFFFFFUL);
+            assert (((period * entry.period_multiplier)
+                     >> Beethduino::SUBDIVISION_PERIOD_SHIFT)
+                    == (period / entry.clicks_per_beat));
+        }
+    }
+
+    printf("\n");
+}
+
+
+/**
+* Every BPM and subdivision, one minute of clicks.
+*/
+void test_exact_deadlines()
+{
+    printf("test_exact_deadlines\n");
+    unsigned long checked_clicks = 0;
+
+    for (byte subdivision = 0; subdivision < Beethduino::SUBDIVISIONS_COUNT;
+         subdivision++)
+    {
+        for (int bpm = Beethduino::BPM_LOWER_BOUND;
+             bpm <= Beethduino::BPM_UPPER_BOUND; bpm++)
+        {
+            check_minute_of_clicks(bpm, subdivision);
+            checked_clicks = checked_clicks
+                             + bpm * Beethduino::SUBDIVISIONS[subdivision]
+                                     .clicks_per_beat;
+        }
+    }
+
+    printf("    %lu clicks on their exact tick\n", checked_clicks);
+    printf("\n");
+}
+
+
+/**
+* The beat k is at p + floor(k * 60000 / bpm) ticks from the unmuting (p is
+* the integer period), and its sub-beat i at floor(i * period_k / clicks)
+* ticks from the beat. After bpm beats, the next beat is exactly one minute
+* after the first one.
+*/
+void check_minute_of_clicks(int bpm, byte subdivision)
+{
+    sim_reset();
+    Beethduino metronome;
+    metronome.bpm = bpm;
+    metronome.calculate_required_iterations();
+    select_subdivision(metronome, subdivision);
+    metronome.change_mute_state();
+
+    unsigned long long minute = Beethduino::MILLISECONDS_IN_MINUTE;
+    unsigned long first_beat = metronome.beat_deadline_tick;
+    unsigned long clicks = metronome.clicks_per_beat;
+
+    for (int beat = 0; beat < bpm; beat++)
+    {
+        unsigned long beat_tick = first_beat + (beat * minute) / bpm;
+        unsigned long next_beat_tick = first_beat
+                                       + ((beat + 1) * minute) / bpm;
+
+        assert (metronome.beat_deadline_tick == beat_tick);
+        metronome.timer_ticks = beat_tick;
+        metronome.serve_timer_wheel();
+
+        for (unsigned long click = 1; click < clicks; click++)
+        {
+            unsigned long click_tick = beat_tick
+                + (click * (next_beat_tick - beat_tick)) / clicks;
+
+            assert (metronome.pending_subdivisions == clicks - click);
+            assert (metronome.subdivision_deadline_tick == click_tick);
+            metronome.timer_ticks = click_tick;
+            metronome.serve_timer_wheel();
+        }
+
+        assert (metronome.pending_subdivisions == 0);
+    }
+
+    assert (metronome.beat_deadline_tick == first_beat + minute);
+}
+
+
+/**
+* Sixteenths and triplets at BPM_UPPER_BOUND, with the modifier button
+* pressed every 100 ms (one LCD redraw each): every click starts on its
+* exact tick, and the downbeat, beat and sub-beat sounds keep their length.
+*/
+void test_highest_tempo_under_ui_load()
+{
+    printf("test_highest_tempo_under_ui_load\n");
+
+    for (byte subdivision = 2; subdivision < Beethduino::SUBDIVISIONS_COUNT;
+         subdivision++)
+    {
+        unsigned long clicks = Beethduino::SUBDIVISIONS[subdivision]
+                               .clicks_per_beat;
+        unsigned long period = Beethduino::MILLISECONDS_IN_MINUTE
+                               / Beethduino::BPM_UPPER_BOUND;
+        long long max_error_ns = 0;
+
+        record_clicks(subdivision, true);
+        assert (rising_edges_ns.size() >= 4 * clicks);
+
+        for (size_t click = 0; click < rising_edges_ns.size(); click++)
+        {
+            unsigned long beat = click / clicks;
+            unsigned long long ideal_ns = rising_edges_ns[0]
+                + (beat * period + ((click % clicks) * period) / clicks)
+                  * TICK_NS;
+            long long error_ns = (long long) rising_edges_ns[click]
+                                 - (long long) ideal_ns;
+            unsigned long long width_ns;
+
+            if (llabs(error_ns) > max_error_ns)
+            {
+                max_error_ns = llabs(error_ns);
+            }
+
+            if (click >= falling_edges_ns.size())
+            {
+                continue;
+            }
+
+            width_ns = falling_edges_ns[click] - rising_edges_ns[click];
+
+            if ((click % clicks) != 0)
+            {
+                assert (width_ns
+                        == Beethduino::SUBDIVISION_SOUND_DURATION * TICK_NS);
+            }
+            else if ((beat % 4) == 0)   /* 4/4. */
+            {
+                assert (width_ns
+                        == Beethduino::ACCENT_SOUND_DURATION * TICK_NS);
+            }
+            else
+            {
+                assert (width_ns == Beethduino::SOUND_DURATION * TICK_NS);
+            }
+        }
+
+        assert (max_error_ns == 0);
+        printf("    %lu clicks per beat at %d BPM: %d clicks, "
+               "max error %lld ns\n", clicks, Beethduino::BPM_UPPER_BOUND,
+               (int) rising_edges_ns.size(), max_error_ns);
+    }
+
+    printf("\n");
+}
+
+
+/**
+* The beats are scheduled as without subdivision: the first click of every
+* beat is on the same tick.
+*/
+void test_beats_not_moved()
+{
+    printf("test_beats_not_moved\n");
+
+    record_clicks(0, false);
+    std::vector<unsigned long long> beat_edges_ns = rising_edges_ns;
+
+    for (byte subdivision = 1; subdivision < Beethduino::SUBDIVISIONS_COUNT;
+         subdivision++)
+    {
+        unsigned long clicks = Beethduino::SUBDIVISIONS[subdivision]
+                               .clicks_per_beat;
+
+        record_clicks(subdivision, false);
+        /* The sub-beats of the last beat may be after the end. */
+        assert (rising_edges_ns.size()
+                > (beat_edges_ns.size() - 1) * clicks);
+        assert (rising_edges_ns.size() <= beat_edges_ns.size() * clicks);
+
+        for (size_t beat = 0; beat < beat_edges_ns.size(); beat++)
+        {
+            assert (rising_edges_ns[beat * clicks] == beat_edges_ns[beat]);
+        }
+    }
+
+    printf("\n");
+}
+
+
+/**
+* The long pressing of the modifier button selects the next subdivision
+* (shown in the LCD), and its release does not invert the modifier; a short
+* pressing still inverts it.
+*/
+void test_long_press_changes_subdivision()
+{
+    printf("test_long_press_changes_subdivision\n");
+    sim_reset();
+    Beethduino metronome;
+    configure_beethduino(metronome);
+    int pin = metronome.ADD_OR_SUB_BPM_BUTTON_PIN;
+
+    digitalWrite(pin, HIGH);
+    run_main_loop_until(metronome, sim_time_ns()
+        + (Beethduino::BUTTON_LONG_PRESS_TICKS + BUTTON_LEVEL_MS)
+          * SIM_NS_IN_MS);
+    assert (metronome.subdivision == 1);
+    assert (metronome.clicks_per_beat == 2);
+    assert (metronome.lcd_shown_frame[0][Beethduino::SUBDIVISION_COLUMN]
+            == '2');
+
+    digitalWrite(pin, LOW);
+    run_main_loop_until(metronome,
+                        sim_time_ns() + BUTTON_LEVEL_MS * SIM_NS_IN_MS);
+    assert (metronome.bpm_modifier == 1);
+    assert (metronome.repeated_button_pins == 0);
+
+    digitalWrite(pin, HIGH);
+    run_main_loop_until(metronome,
+                        sim_time_ns() + BUTTON_LEVEL_MS * SIM_NS_IN_MS);
+    digitalWrite(pin, LOW);
+    run_main_loop_until(metronome,
+                        sim_time_ns() + BUTTON_LEVEL_MS * SIM_NS_IN_MS);
+    assert (metronome.bpm_modifier == -1);
+    assert (metronome.subdivision == 1);
+    printf("\n");
+}
+
+
+/**
+* Records the buzzer edges during RECORD_NS at BPM_UPPER_BOUND, with the
+* main loop running and, if is_ui_loaded, the modifier button pressed every
+* BUTTON_INTERVAL_NS.
+*/
+void record_clicks(byte subdivision, bool is_ui_loaded)
+{
+    sim_reset();
+    Beethduino metronome;
+    beethduino = &metronome;
+    configure_beethduino(metronome);
+
+    metronome.bpm = Beethduino::BPM_UPPER_BOUND;
+    metronome.calculate_required_iterations();
+    select_subdivision(metronome, subdivision);
+    metronome.change_mute_state();
+
+    unsigned long long start_ns = sim_time_ns();
+
+    rising_edges_ns.clear();
+    falling_edges_ns.clear();
+    sim_set_pin_listener(record_buzzer_edge);
+
+    if (is_ui_loaded == true)
+    {
+        for (unsigned long long press_ns = start_ns + BUTTON_INTERVAL_NS / 3;
+             press_ns < start_ns + RECORD_NS;
+             press_ns = press_ns + BUTTON_INTERVAL_NS)
+        {
+            sim_schedule_pin_level(metronome.ADD_OR_SUB_BPM_BUTTON_PIN, HIGH,
+                                   press_ns);
+            sim_schedule_pin_level(metronome.ADD_OR_SUB_BPM_BUTTON_PIN, LOW,
+                                   press_ns + BUTTON_PRESS_NS);
+        }
+    }
+
+    run_main_loop_until(metronome, start_ns + RECORD_NS);
+    sim_set_pin_listener(0);
+
+    beethduino = 0;
+}
+
+
+void select_subdivision(Beethduino &metronome, byte subdivision)
+{
+    while (metronome.subdivision != subdivision)
+    {
+        metronome.change_subdivision();
+    }
+}
+
+
+void __assert(const char *__func, const char *__file,
+              int __lineno, const char *__sexp)
+{
+    printf("TEST_FAILED\n%s\n%s\n%d\n%s\n", __file, __func, __lineno, __sexp);
+    fflush(stdout);
+
+    abort();
+}
@@ -0,0 +1,188 @@
+/*******************************************************************************
+*   Project:        Beethduino, an Arduino Do-it-yourself electronic metronome.
+*
+*   File:           beethduino_host_test_tempo_accuracy.cpp
+*
+*   Description:    Host (PC) testing of the integer tempo math of the
+*                   Beethduino library ("calculate_required_iterations",
+*                   with the BeatPeriods table, and "schedule_next_beat",
+*                   with the remainder accumulator), over the Arduino
+*                   simulator. For every BPM value the metronome plays a
+*                   full cycle of the remainder accumulator, and every beat
+*                   (rising edge of the buzzer) shall be in the tick of its
+*                   ideal time, so the cumulative drift is zero. The
+*                   previous version (double division truncated to whole
+*                   milliseconds) is measured too, for comparison.
+*
+*   Language:       C++ (host, g++).
+*                   Compiled with CMake (target of the same name), with the
+*                   Arduino_simulator folder and Beethduino.cpp.
+*
+*   Dependencies:   assert.h
+*                   stdio.h
+*                   Arduino_simulator.h
+*                   Beethduino.h
+*                   beethduino_host_test_helpers.h
+*
+*   Notes:          BPM - Beats Per Minute.
+*                   LCD - Liquid Crystal Display.
+*                   The beat k is due floor(k * 60000 / bpm) ticks after the
+*                   first one; the remainder accumulator repeats every bpm
+*                   beats, so bpm + 1 beats check all its states.
+*
+*   Author:         Alberto Martin Cajal
+*                   amartin.glimpse23@gmail.com
+*                   amartin<DOT>glimpse23<AT>gmail<DOT>.com
+*
+*   License:        GNU GPL v3.0
+*
+*   URL:            https://github.com/amcajal/beethduino
+*
+*******************************************************************************/
+#define __ASSERT_USE_STDERR
+
+#include <assert.h>
+#include <stdio.h>
+
+#include "Arduino_simulator.h"
+#include "Beethduino.h"
+#include "beethduino_host_test_helpers.h"
+
+const unsigned long long TICK_NS            = SIM_NS_IN_MS;
+const int PREVIOUS_VERSION_BPM              = 7;
+const int PREVIOUS_VERSION_BEATS            = 100;
+
+/******************************************************************************/
+
+
+void execute_tests();
+void test_zero_drift_all_bpm();
+void test_drift_previous_version();
+long long play_beats(int bpm, int beats);
+unsigned long long ideal_elapsed_ms(int bpm, int beats);
+
+
+int main()
+{
+    printf("HOST UNIT TESTING STARTED\n******************************\n");
+    printf("%%%%%%Testing function: calculate_required_iterations, "
+           "schedule_next_beat\n");
+
+    execute_tests();
+
+    printf("HOST UNIT TESTING FINISHED\n******************************\n");
+    return 0;
+}
+
+
+void execute_tests()
+{
+    test_zero_drift_all_bpm();
+    test_drift_previous_version();
+}
+
+
+/**
+* For every BPM, the beat k shall sound at the ideal time (k * 60000 / bpm
+* milliseconds) truncated to the tick: the error is always lower than one
+* tick, and does not grow with the number of beats.
+*/
+void test_zero_drift_all_bpm()
+{
+    printf("test_zero_drift_all_bpm\n");
+    unsigned long beats = 0;
+
+    for (int bpm = Beethduino::BPM_LOWER_BOUND;
+         bpm <= Beethduino::BPM_UPPER_BOUND; bpm++)
+    {
+        long long drift = play_beats(bpm, bpm + 1);
+
+        assert (drift == 0);
+        beats = beats + bpm + 1;
+    }
+
+    printf("    %lu beats, %d BPM values: drift 0 ms\n", beats,
+           Beethduino::BPM_UPPER_BOUND - Beethduino::BPM_LOWER_BOUND + 1);
+}
+
+
+/**
+* The previous version truncated the period to whole milliseconds: at 7 BPM
+* (8571.43 ms) the beats were 0.43 ms early each; 42 ms after 100 beats.
+*/
+void test_drift_previous_version()
+{
+    printf("test_drift_previous_version\n");
+
+    double truncated_period = (60.00 / PREVIOUS_VERSION_BPM) * 1000;
+    unsigned long long truncated_elapsed
+        = (unsigned long long) PREVIOUS_VERSION_BEATS
+          * (unsigned int) truncated_period;
+    long long drift = (long long) (ideal_elapsed_ms(PREVIOUS_VERSION_BPM,
+                                                    PREVIOUS_VERSION_BEATS)
+                                   - truncated_elapsed);
+    long long integer_drift = play_beats(PREVIOUS_VERSION_BPM,
+                                         PREVIOUS_VERSION_BEATS);
+
+    printf("    %d BPM, %d beats: previous drift %lld ms, now %lld ms\n",
+           PREVIOUS_VERSION_BPM, PREVIOUS_VERSION_BEATS, drift,
+           integer_drift);
+
+    assert (drift > 40);
+    assert (integer_drift == 0);
+}
+
+
+/**
+* Plays the beats at the BPM, from the unmuting of the metronome; every
+* beat is checked against the first one. Returns the drift of the last
+* beat, in milliseconds (ideal time minus played time).
+*/
+long long play_beats(int bpm, int beats)
+{
+    sim_reset();
+    Beethduino metronome;
+    beethduino = &metronome;
+    configure_beethduino(metronome);
+    metronome.is_sleep_enabled = true;
+
+    metronome.bpm = bpm;
+    metronome.calculate_required_iterations();
+    metronome.change_mute_state();
+
+    beat_edges_ns.clear();
+    sim_set_pin_listener(record_beat_edge);
+    run_main_loop_until(metronome, sim_time_ns()
+                        + (ideal_elapsed_ms(bpm, beats + 1) + 1) * TICK_NS);
+    sim_set_pin_listener(0);
+    beethduino = 0;
+
+    assert (beat_edges_ns.size() > (size_t) beats);
+
+    for (int beat = 1; beat < beats; beat++)
+    {
+        assert (beat_edges_ns[beat] - beat_edges_ns[0]
+                == ideal_elapsed_ms(bpm, beat) * TICK_NS);
+    }
+
+    return (long long) (ideal_elapsed_ms(bpm, beats) * TICK_NS
+                        - (beat_edges_ns[beats] - beat_edges_ns[0]))
+           / (long long) TICK_NS;
+}
+
+
+unsigned long long ideal_elapsed_ms(int bpm, int beats)
+{
+    return ((unsigned long long) beats * Beethduino::MILLISECONDS_IN_MINUTE)
+           / bpm;
+}
+
+
+void __assert(const char *__func, const char *__file,
+              int __lineno, const char *__sexp)
+{
+    printf("TEST_FAILED\n%s\n%s\n%d\n%s\n", __file, __func, __lineno, __sexp);
+    fflush(stdout);
+
+    abort();
+}
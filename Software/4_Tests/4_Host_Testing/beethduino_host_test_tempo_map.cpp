@@ -0,0 +1,525 @@
+/*******************************************************************************
+*   Project:        Beethduino, an Arduino Do-it-yourself electronic metronome.
+*
+*   File:           beethduino_host_test_tempo_map.cpp
+*
+*   Description:    Host (PC) testing of the tempo map: the compiler of the
+*                   Beethduino_tempo_map folder, and the interpreter of the
+*                   Beethduino library, over the Arduino simulator. Checks
+*                   that the text of the default program compiles into
+*                   TEMPO_MAP, that the invalid programs are rejected in
+*                   their line, and that every beat played by the library
+*                   (started by the long pressing of the mute button) is in
+*                   the tick of the compiled timeline: the tempo changes land
+*                   on the downbeats (accented), with no jitter, also with
+*                   time signature changes, repetitions and triplets. The BPM
+*                   buttons stop the program.
+*
+*   Language:       C++ (host, g++).
+*                   Compiled with CMake (target of the same name), with the
+*                   Arduino_simulator folder, Beethduino.cpp and the
+*                   Beethduino_tempo_map folder.
+*
+*   Dependencies:   assert.h
+*                   stdio.h
+*                   string.h
+*                   vector
+*                   Arduino_simulator.h
+*                   Beethduino.h
+*                   beethduino_host_test_helpers.h
+*                   Beethduino_tempo_map.h
+*
+*   Notes:          BPM - Beats Per Minute.
+*                   LCD - Liquid Crystal Display.
+*                   The timeline of the compiler (expand) is computed apart
+*                   from the interpreter: the beat k of a segment is
+*                   floor(k * 60000 / bpm) ticks after its first downbeat.
+*                   After the last segment, its tempo is kept.
+*
+*   Author:         Alberto Martin Cajal
+*                   amartin.glimpse23@gmail.com
+*                   amartin<DOT>glimpse23<AT>gmail<DOT>.com
+*
+*   License:        GNU GPL v3.0
+*
+*   URL:            https://github.com/amcajal/beethduino
+*
+*******************************************************************************/
+#define __ASSERT_USE_STDERR
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "Arduino_simulator.h"
+#include "Beethduino.h"
+#include "beethduino_host_test_helpers.h"
+#include "Beethduino_tempo_map.h"
+
+const unsigned long long TICK_NS            = SIM_NS_IN_MS;
+const unsigned long BUTTON_LEVEL_MS         = 50;
+const unsigned long TAIL_TICKS              = 5000;  /* After the program. */
+const unsigned long REPEATED_PROGRAM_TICKS  = 40000;
+const unsigned int MAX_SEGMENTS             = 1000;
+
+const char *DEFAULT_PROGRAM_SOURCE =
+    "# 4 bars at 80 BPM, then +5 BPM every 8 bars up to 140.\n"
+    "play 80 4\n"
+    "ramp +5 8 140\n";
+
+/* Waltz, a fast 7/8, and a slow down; then, again. */
+const char *REPEATED_PROGRAM_SOURCE =
+    "time 3/4\n"
+    "play 90 2      # 666.67 ticks per beat.\n"
+    "time 7/8\n"
+    "play 300 2\n"
+    "ramp -70 1 90  # 230, 160 and 90 BPM, one bar each.\n"
+    "repeat\n";
+
+struct InvalidProgram
+{
+    const char *source;
+    unsigned int error_line;
+};
+
+const InvalidProgram INVALID_PROGRAMS[] =
+{
+    {"play 80\n", 1},
+    {"play 80 4\nplay 301 4\n", 2},
+    {"play 80 4\n\nplay 0 4\n", 3},
+    {"play 80 256\n", 1},
+    {"play 80 0\n", 1},
+    {"play 80 4 5\n", 1},
+    {"play 8O 4\n", 1},
+    {"ramp 0 8 140\n", 1},
+    {"ramp +128 8 140\n", 1},
+    {"ramp -5 8 0\n", 1},
+    {"# Comment.\ntime 5/4\n", 2},
+    {"play 80 4\nrepeat 2\n", 2},
+    {"play 80 4\naccelerate 5\n", 2},
+    {"time 3/4\nrepeat\n", 2},
+    {"", 0}
+};
+const int INVALID_PROGRAMS_COUNT = sizeof(INVALID_PROGRAMS)
+                                   / sizeof(INVALID_PROGRAMS[0]);
+
+/******************************************************************************/
+
+
+void execute_tests();
+void test_compile_default_program();
+void test_compile_invalid_programs();
+void test_expand_default_program();
+void test_bar_exact_tempo_changes();
+void test_repeated_program_with_triplets();
+void test_bpm_button_stops_tempo_map();
+void expected_beats(const std::vector<TempoSegment> &segments,
+                    unsigned long end_tick,
+                    std::vector<unsigned long> &beat_ticks,
+                    std::vector<bool> &downbeats);
+void check_beats(const std::vector<TempoSegment> &segments,
+                 unsigned long end_tick, int clicks_per_beat);
+void check_lcd_row(Beethduino &metronome, byte row, byte column,
+                   const char *text);
+
+
+int main()
+{
+    printf("HOST UNIT TESTING STARTED\n******************************\n");
+    printf("%%%%%%Testing: tempo map (compiler and interpreter)\n");
+
+    execute_tests();
+
+    printf("HOST UNIT TESTING FINISHED\n******************************\n");
+    return 0;
+}
+
+
+void execute_tests()
+{
+    test_compile_default_program();
+    test_compile_invalid_programs();
+    test_expand_default_program();
+    test_bar_exact_tempo_changes();
+    test_repeated_program_with_triplets();
+    test_bpm_button_stops_tempo_map();
+}
+
+
+/**
+* The text of the default program compiles into TEMPO_MAP, byte by byte.
+*/
+void test_compile_default_program()
+{
+    printf("test_compile_default_program\n");
+    BeethduinoTempoMap tempo_map;
+
+    bool is_compiled = tempo_map.compile(DEFAULT_PROGRAM_SOURCE);
+    assert (is_compiled == true);
+    assert (tempo_map.error_line == 0);
+    assert (tempo_map.program.size() == Beethduino::TEMPO_MAP_SIZE);
+    assert (memcmp(&tempo_map.program[0], Beethduino::TEMPO_MAP,
+                   Beethduino::TEMPO_MAP_SIZE) == 0);
+
+    tempo_map.write_array(stdout);
+    printf("\n");
+}
+
+
+/**
+* Every invalid program is rejected, in the line of the error (the last
+* one, for a program without bars).
+*/
+void test_compile_invalid_programs()
+{
+    printf("test_compile_invalid_programs\n");
+    BeethduinoTempoMap tempo_map;
+
+    for (int program = 0; program < INVALID_PROGRAMS_COUNT; program++)
+    {
+        bool is_compiled = tempo_map.compile(INVALID_PROGRAMS[program].source);
+        assert (is_compiled == false);
+        assert (tempo_map.error_line == INVALID_PROGRAMS[program].error_line);
+        assert (tempo_map.error_message.empty() == false);
+        printf("    line %u: %s\n", tempo_map.error_line,
+               tempo_map.error_message.c_str());
+    }
+
+    printf("\n");
+}
+
+
+/**
+* 4 bars at 80 BPM, and 8 bars at every BPM from 85 to 140.
+*/
+void test_expand_default_program()
+{
+    printf("test_expand_default_program\n");
+    BeethduinoTempoMap tempo_map;
+    std::vector<TempoSegment> segments;
+
+    bool is_compiled = tempo_map.compile(DEFAULT_PROGRAM_SOURCE);
+    assert (is_compiled == true);
+    tempo_map.expand(60, Beethduino::DEFAULT_TIME_SIGNATURE, MAX_SEGMENTS,
+                     segments);
+
+    assert (segments.size() == 1 + ((140 - 80) / 5));
+    assert (segments[0].bpm == 80);
+    assert (segments[0].bars == 4);
+    assert (segments[0].start_tick == 0);
+    assert (segments[1].start_tick == 4 * 4 * 750);
+
+    for (size_t segment = 1; segment < segments.size(); segment++)
+    {
+        assert (segments[segment].bpm == (int) (80 + (5 * segment)));
+        assert (segments[segment].bars == 8);
+        assert (segments[segment].time_signature
+                == Beethduino::DEFAULT_TIME_SIGNATURE);
+    }
+
+    printf("    %u segments, last one at %lu ms\n",
+           (unsigned int) segments.size(), segments.back().start_tick);
+    printf("\n");
+}
+
+
+/**
+* The default program, started by the long pressing of the mute button:
+* every beat, through the 13 tempo changes and TAIL_TICKS after the end,
+* is in the tick of the timeline, and the downbeats are accented. In the
+* middle, the LCD shows the BPM of the segment and the tempo map.
+*/
+void test_bar_exact_tempo_changes()
+{
+    printf("test_bar_exact_tempo_changes\n");
+    sim_reset();
+    Beethduino metronome;
+    beethduino = &metronome;
+    configure_beethduino(metronome);
+
+    BeethduinoTempoMap tempo_map;
+    std::vector<TempoSegment> segments;
+    bool is_compiled = tempo_map.compile(DEFAULT_PROGRAM_SOURCE);
+    assert (is_compiled == true);
+    tempo_map.expand(metronome.bpm, metronome.time_signature, MAX_SEGMENTS,
+                     segments);
+
+    rising_edges_ns.clear();
+    falling_edges_ns.clear();
+    sim_set_pin_listener(record_buzzer_edge);
+
+    unsigned long long press_ns = sim_time_ns();
+    hold_button_level(metronome, metronome.MUTE_BUZZER_BUTTON_PIN, HIGH,
+                      Beethduino::BUTTON_LONG_PRESS_TICKS + BUTTON_LEVEL_MS);
+    hold_button_level(metronome, metronome.MUTE_BUZZER_BUTTON_PIN, LOW,
+                      BUTTON_LEVEL_MS);
+    assert (metronome.is_tempo_map_running == true);
+    assert (rising_edges_ns.size() == 0);
+
+    /* Long pressing (after the debounce), and one period of 80 BPM. */
+    run_main_loop_until(metronome, press_ns + 2 * SIM_NS_IN_S);
+    assert (rising_edges_ns.size() == 1);
+    assert (rising_edges_ns[0] - press_ns
+            >= (Beethduino::BUTTON_LONG_PRESS_TICKS + 750) * TICK_NS);
+    assert (rising_edges_ns[0] - press_ns
+            <= (Beethduino::BUTTON_DEBOUNCE_TICKS
+                + Beethduino::BUTTON_LONG_PRESS_TICKS + 750 + 1) * TICK_NS);
+
+    unsigned long long first_beat_ns = rising_edges_ns[0];
+    run_main_loop_until(metronome, first_beat_ns
+                        + (segments[5].start_tick + 100) * TICK_NS);
+    assert (metronome.bpm == segments[5].bpm);
+    check_lcd_row(metronome, 0, 0, "MAP");
+    check_lcd_row(metronome, 1, 9, "105");
+
+    unsigned long end_tick = segments.back().start_tick
+        + (segments.back().bars * 4 * Beethduino::MILLISECONDS_IN_MINUTE)
+          / segments.back().bpm
+        + TAIL_TICKS;
+    run_main_loop_until(metronome, first_beat_ns + end_tick * TICK_NS);
+    sim_set_pin_listener(0);
+
+    check_beats(segments, end_tick, 1);
+    assert (metronome.is_tempo_map_running == false);
+    assert (metronome.bpm == 140);
+    check_lcd_row(metronome, 0, 0, "   ");
+    check_lcd_row(metronome, 1, 9, "140");
+    beethduino = 0;
+    printf("\n");
+}
+
+
+/**
+* A program with time signature changes, a ramp down and a repetition,
+* loaded in the library, with triplets: the beats and the downbeats are in
+* the timeline, and the sub-beats of every beat are at floor(i * period / 3)
+* ticks from it (the step changes with the segment, in the interrupt).
+*/
+void test_repeated_program_with_triplets()
+{
+    printf("test_repeated_program_with_triplets\n");
+    sim_reset();
+    Beethduino metronome;
+    beethduino = &metronome;
+    configure_beethduino(metronome);
+
+    BeethduinoTempoMap tempo_map;
+    std::vector<TempoSegment> segments;
+    bool is_compiled = tempo_map.compile(REPEATED_PROGRAM_SOURCE);
+    assert (is_compiled == true);
+    tempo_map.expand(metronome.bpm, metronome.time_signature, MAX_SEGMENTS,
+                     segments);
+
+    metronome.tempo_map = &tempo_map.program[0];
+    metronome.tempo_map_size = tempo_map.program.size();
+    metronome.change_subdivision();
+    metronome.change_subdivision();
+    assert (metronome.clicks_per_beat == 3);
+
+    rising_edges_ns.clear();
+    falling_edges_ns.clear();
+    sim_set_pin_listener(record_buzzer_edge);
+
+    unsigned long start_tick = metronome.timer_ticks;
+    metronome.perform_operation(metronome.MUTE_BUZZER_BUTTON_PIN,
+                                Beethduino::BUTTON_LONG_PRESSED);
+    assert (metronome.bpm == 90);
+    assert (metronome.time_signature == 1);
+    assert (metronome.beat_deadline_tick == start_tick + 666);
+
+    unsigned long long first_beat_ns = sim_time_ns() + 666 * TICK_NS;
+    run_main_loop_until(metronome,
+                        first_beat_ns + REPEATED_PROGRAM_TICKS * TICK_NS);
+    sim_set_pin_listener(0);
+
+    check_beats(segments, REPEATED_PROGRAM_TICKS, 3);
+    assert (metronome.is_tempo_map_running == true);
+    beethduino = 0;
+    printf("\n");
+}
+
+
+/**
+* A short pressing of the BPM button in the first segment stops the program:
+* the BPM is changed from the one of the segment, and it is kept in the
+* next bar boundaries.
+*/
+void test_bpm_button_stops_tempo_map()
+{
+    printf("test_bpm_button_stops_tempo_map\n");
+    sim_reset();
+    Beethduino metronome;
+    configure_beethduino(metronome);
+
+    metronome.perform_operation(metronome.MUTE_BUZZER_BUTTON_PIN,
+                                Beethduino::BUTTON_LONG_PRESSED);
+    assert (metronome.is_tempo_map_running == true);
+    run_main_loop_until(metronome, sim_time_ns() + 2 * SIM_NS_IN_S);
+    check_lcd_row(metronome, 0, 0, "MAP");
+
+    hold_button_level(metronome, metronome.CHANGE_BPM_BY_ONE_BUTTON_PIN, HIGH,
+                      BUTTON_LEVEL_MS);
+    hold_button_level(metronome, metronome.CHANGE_BPM_BY_ONE_BUTTON_PIN, LOW,
+                      BUTTON_LEVEL_MS);
+    assert (metronome.is_tempo_map_running == false);
+    assert (metronome.bpm == 81);
+    check_lcd_row(metronome, 0, 0, "   ");
+    check_lcd_row(metronome, 1, 9, "81");
+
+    /* After the 4 bars of the first segment. */
+    run_main_loop_until(metronome, sim_time_ns() + 20 * SIM_NS_IN_S);
+    assert (metronome.bpm == 81);
+    assert (metronome.bpm_freq_req_iter
+            == Beethduino::MILLISECONDS_IN_MINUTE / 81);
+    assert (metronome.is_buzzer_muted == false);
+    printf("\n");
+}
+
+
+/**
+* Beats of the timeline before end_tick (from the first downbeat): the
+* segments end after their bars, and the last one goes on.
+*/
+void expected_beats(const std::vector<TempoSegment> &segments,
+                    unsigned long end_tick,
+                    std::vector<unsigned long> &beat_ticks,
+                    std::vector<bool> &downbeats)
+{
+    beat_ticks.clear();
+    downbeats.clear();
+
+    for (size_t segment = 0; segment < segments.size(); segment++)
+    {
+        const TempoSegment &current = segments[segment];
+        unsigned long beats_per_bar
+            = Beethduino::TIME_SIGNATURES[current.time_signature]
+                  .beats_per_bar;
+        bool is_last = (segment == (segments.size() - 1));
+
+        for (unsigned long beat = 0;
+             is_last || (beat < (current.bars * beats_per_bar)); beat++)
+        {
+            unsigned long tick = current.start_tick
+                + (beat * Beethduino::MILLISECONDS_IN_MINUTE) / current.bpm;
+
+            if (tick >= end_tick)
+            {
+                return;
+            }
+
+            beat_ticks.push_back(tick);
+            downbeats.push_back((beat % beats_per_bar) == 0);
+        }
+    }
+}
+
+
+/**
+* Splits the recorded edges into beats and sub-beats (by their duration),
+* and compares them with the timeline. Reports the maximum deviation.
+*/
+void check_beats(const std::vector<TempoSegment> &segments,
+                 unsigned long end_tick, int clicks_per_beat)
+{
+    std::vector<unsigned long> beat_ticks;
+    std::vector<bool> downbeats;
+    std::vector<unsigned long long> beat_edges_ns;
+    std::vector<unsigned long long> sub_beat_edges_ns;
+    long long max_deviation_ticks = 0;
+    size_t accents = 0;
+    size_t beat;
+
+    expected_beats(segments, end_tick, beat_ticks, downbeats);
+
+    for (size_t edge = 0; edge < falling_edges_ns.size(); edge++)
+    {
+        unsigned long long width_ns = falling_edges_ns[edge]
+                                      - rising_edges_ns[edge];
+
+        if (width_ns == Beethduino::SUBDIVISION_SOUND_DURATION * TICK_NS)
+        {
+            sub_beat_edges_ns.push_back(rising_edges_ns[edge]);
+            continue;
+        }
+
+        beat = beat_edges_ns.size();
+        assert (beat < beat_ticks.size());
+        beat_edges_ns.push_back(rising_edges_ns[edge]);
+
+        long long deviation_ticks
+            = (long long) ((rising_edges_ns[edge] - beat_edges_ns[0])
+                           / TICK_NS)
+              - (long long) beat_ticks[beat];
+
+        if (deviation_ticks < 0)
+        {
+            deviation_ticks = -deviation_ticks;
+        }
+
+        if (deviation_ticks > max_deviation_ticks)
+        {
+            max_deviation_ticks = deviation_ticks;
+        }
+
+        if (downbeats[beat] == true)
+        {
+            assert (width_ns == Beethduino::ACCENT_SOUND_DURATION * TICK_NS);
+            accents++;
+        }
+        else
+        {
+            assert (width_ns == Beethduino::SOUND_DURATION * TICK_NS);
+        }
+    }
+
+    assert (max_deviation_ticks == 0);
+    assert (beat_edges_ns.size() + 1 >= beat_ticks.size());
+
+    /* Sub-beats of every beat with a next beat. */
+    size_t sub_beat = 0;
+
+    for (beat = 0; (beat + 1) < beat_edges_ns.size(); beat++)
+    {
+        unsigned long long period_ns = beat_edges_ns[beat + 1]
+                                       - beat_edges_ns[beat];
+
+        for (int click = 1; click < clicks_per_beat; click++)
+        {
+            assert (sub_beat < sub_beat_edges_ns.size());
+            assert (sub_beat_edges_ns[sub_beat] - beat_edges_ns[beat]
+                    == ((period_ns / TICK_NS) * click / clicks_per_beat)
+                       * TICK_NS);
+            sub_beat++;
+        }
+    }
+
+    printf("    %u segments, %u beats (%u downbeats), %u sub-beats; "
+           "max deviation: %lld ticks\n", (unsigned int) segments.size(),
+           (unsigned int) beat_edges_ns.size(), (unsigned int) accents,
+           (unsigned int) sub_beat, max_deviation_ticks);
+}
+
+
+/**
+* Checks the text in the frame and in the shadow of the LCD (after the main
+* loop has sent it).
+*/
+void check_lcd_row(Beethduino &metronome, byte row, byte column,
+                   const char *text)
+{
+    assert (memcmp(&metronome.lcd_frame[row][column], text,
+                   strlen(text)) == 0);
+    assert (memcmp(&metronome.lcd_shown_frame[row][column], text,
+                   strlen(text)) == 0);
+}
+
+
+void __assert(const char *__func, const char *__file,
+              int __lineno, const char *__sexp)
+{
+    printf("TEST_FAILED\n%s\n%s\n%d\n%s\n", __file, __func, __lineno, __sexp);
+    fflush(stdout);
+
+    abort();
+}
@@ -0,0 +1,506 @@
+/*******************************************************************************
+*   Project:        Beethduino, an Arduino Do-it-yourself electronic metronome.
+*
+*   File:           beethduino_host_test_tempo_ramps.cpp
+*
+*   Description:    Host (PC) testing of the smooth ramps of the tempo map
+*                   (linear and exponential accelerando and ritardando),
+*                   interpreted by the Beethduino library over the Arduino
+*                   simulator. Every beat played is compared with the exact
+*                   reference of the compiler (BeethduinoTempoMap::
+*                   beat_time): the maximum deviation per beat is reported.
+*                   The linear ramps, whose periods are fractions, are exact
+*                   (the beat k is the floor of the exact sum of the periods
+*                   before it, no deviation); the exponential ones, with a
+*                   fixed point ratio, are within one tick of the exact
+*                   curve. Extreme ramps (1 to 300 BPM in one bar, and 255
+*                   bars of 7/8) check the ranges of the fixed point values.
+*                   The sub-beats follow the period of every beat, and the
+*                   BPM buttons stop a ramp at its target BPM. The fixed
+*                   point ratio (integer logarithm and power) is within one
+*                   unit of the rounded exact one, for every pair of BPM.
+*
+*   Language:       C++ (host, g++).
+*                   Compiled with CMake (target of the same name), with the
+*                   Arduino_simulator folder, Beethduino.cpp and the
+*                   Beethduino_tempo_map folder.
+*
+*   Dependencies:   assert.h
+*                   math.h
+*                   stdio.h
+*                   string.h
+*                   vector
+*                   Arduino_simulator.h
+*                   Beethduino.h
+*                   beethduino_host_test_helpers.h
+*                   Beethduino_tempo_map.h
+*
+*   Notes:          BPM - Beats Per Minute.
+*                   The deviation of a beat is measured from the first
+*                   downbeat of its segment (the deviation per beat of the
+*                   ramp), and the one of the downbeats, from the first one
+*                   (the deviation of the timeline). After the last ramp,
+*                   the target BPM is kept, from its last downbeat.
+*
+*   Author:         Alberto Martin Cajal
+*                   amartin.glimpse23@gmail.com
+*                   amartin<DOT>glimpse23<AT>gmail<DOT>.com
+*
+*   License:        GNU GPL v3.0
+*
+*   URL:            https://github.com/amcajal/beethduino
+*
+*******************************************************************************/
+#define __ASSERT_USE_STDERR
+
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "Arduino_simulator.h"
+#include "Beethduino.h"
+#include "beethduino_host_test_helpers.h"
+#include "Beethduino_tempo_map.h"
+
+const unsigned long long TICK_NS            = SIM_NS_IN_MS;
+const unsigned long BUTTON_LEVEL_MS         = 50;
+const unsigned long TAIL_TICKS              = 5000;  /* After the program. */
+const unsigned int MAX_SEGMENTS             = 100;
+
+/* Beats of the exponential ramps whose ratio is checked (2 beats of 2/4 to
+*  255 bars of 7/8).
+*/
+const unsigned int RATIO_BEATS[]            = {2, 3, 7, 32, 255 * 7};
+const int RATIO_BEATS_COUNT = sizeof(RATIO_BEATS) / sizeof(RATIO_BEATS[0]);
+
+/* Bytes of the program with the three smooth instructions. */
+const byte SMOOTH_PROGRAM[] =
+{
+    Beethduino::TEMPO_MAP_PLAY, 60, 0, 1,
+    Beethduino::TEMPO_MAP_LINEAR_RAMP, 8, 180, 0,
+    Beethduino::TEMPO_MAP_EXPONENTIAL_RAMP, 4, 44, 1,  /* 300 = 0x12C. */
+    Beethduino::TEMPO_MAP_END
+};
+
+struct RampProgram
+{
+    const char *name;
+    const char *source;
+    int clicks_per_beat;
+    unsigned long max_beat_deviation_ticks;
+    unsigned long max_timeline_deviation_ticks;
+};
+
+const RampProgram RAMP_PROGRAMS[] =
+{
+    {"linear accelerando",
+     "play 60 1\nlinear 8 180\n", 1, 0, 0},
+    {"linear ritardando, 7/8 and triplets",
+     "time 7/8\nplay 200 1\nlinear 6 45\nplay 45 1\n", 3, 0, 0},
+    {"linear, 1 to 300 BPM in one bar of 2/4",
+     "time 2/4\nplay 1 1\nlinear 1 300\nlinear 1 1\n", 1, 0, 0},
+    {"linear, 255 bars of 7/8",
+     "time 7/8\nplay 30 1\nlinear 255 300\n", 1, 0, 0},
+    {"exponential accelerando and ritardando",
+     "play 40 1\nexponential 16 240\nexponential 8 50\n", 1, 1, 2},
+    {"exponential, 6/8 and sixteenths",
+     "time 6/8\nplay 90 2\nexponential 4 160\nplay 160 1\n", 4, 1, 1},
+    {"exponential, 1 to 300 BPM in one bar of 2/4",
+     "time 2/4\nplay 1 1\nexponential 1 300\nexponential 1 1\n", 1, 1, 2}
+};
+const int RAMP_PROGRAMS_COUNT = sizeof(RAMP_PROGRAMS)
+                                / sizeof(RAMP_PROGRAMS[0]);
+
+/******************************************************************************/
+
+
+void execute_tests();
+void test_compile_smooth_ramps();
+void test_ramp_ratio();
+void test_ramp_program(const RampProgram &ramp_program);
+void test_bpm_button_stops_ramp();
+void expected_beats(const std::vector<TempoSegment> &segments,
+                    unsigned long end_tick,
+                    std::vector<long double> &beat_times,
+                    std::vector<size_t> &first_beats);
+
+
+int main()
+{
+    printf("HOST UNIT TESTING STARTED\n******************************\n");
+    printf("%%%%%%Testing: smooth ramps of the tempo map\n");
+
+    execute_tests();
+
+    printf("HOST UNIT TESTING FINISHED\n******************************\n");
+    return 0;
+}
+
+
+void execute_tests()
+{
+    test_compile_smooth_ramps();
+    test_ramp_ratio();
+
+    for (int program = 0; program < RAMP_PROGRAMS_COUNT; program++)
+    {
+        test_ramp_program(RAMP_PROGRAMS[program]);
+    }
+
+    test_bpm_button_stops_ramp();
+}
+
+
+/**
+* The smooth instructions compile into their opcode, bars and target; the
+* invalid ones are rejected in their line. The timeline of the expansion
+* starts every segment after the exact duration of the previous one.
+*/
+void test_compile_smooth_ramps()
+{
+    printf("test_compile_smooth_ramps\n");
+    BeethduinoTempoMap tempo_map;
+    std::vector<TempoSegment> segments;
+
+    bool is_compiled = tempo_map.compile("play 60 1\nlinear 8 180\n"
+                                         "exponential 4 300  # To 300 BPM.\n");
+    assert (is_compiled == true);
+    assert (tempo_map.program.size() == sizeof(SMOOTH_PROGRAM));
+    assert (memcmp(&tempo_map.program[0], SMOOTH_PROGRAM,
+                   sizeof(SMOOTH_PROGRAM)) == 0);
+
+    is_compiled = tempo_map.compile("play 60 1\nlinear 8\n");
+    assert (is_compiled == false);
+    assert (tempo_map.error_line == 2);
+    is_compiled = tempo_map.compile("exponential 0 120\n");
+    assert (is_compiled == false);
+    assert (tempo_map.error_line == 1);
+    is_compiled = tempo_map.compile("play 60 1\n\nlinear 8 301\n");
+    assert (is_compiled == false);
+    assert (tempo_map.error_line == 3);
+
+    /* 8 bars of 4/4, from 60 to 180 BPM: 32 beats, 21666.67 ticks. */
+    is_compiled = tempo_map.compile("play 60 1\nlinear 8 180\nlinear 8 180\n");
+    assert (is_compiled == true);
+    tempo_map.expand(60, Beethduino::DEFAULT_TIME_SIGNATURE, MAX_SEGMENTS,
+                     segments);
+    assert (segments.size() == 3);
+    assert (segments[1].ramp == Beethduino::TEMPO_RAMP_LINEAR);
+    assert (segments[1].start_bpm == 60);
+    assert (segments[1].bpm == 180);
+    assert (segments[1].start_tick == 4000);
+    assert (segments[2].ramp == Beethduino::TEMPO_RAMP_NONE);
+    assert (segments[2].start_tick == 4000 + 21666);
+    assert (BeethduinoTempoMap::beat_time(segments[1], 1) == 1000.0L);
+    assert (fabsl(BeethduinoTempoMap::beat_time(segments[1], 32)
+                  - (65000.0L / 3.0L)) < 1e-9L);
+
+    tempo_map.write_array(stdout);
+    printf("\n");
+}
+
+
+/**
+* The ratio of the exponential ramps, (start / target) ^ (1 / beats) with
+* RAMP_RATIO_SHIFT fractional bits, computed with integer math only, is at
+* most one unit away from the rounded exact ratio, for every start and
+* target BPM.
+*/
+void test_ramp_ratio()
+{
+    printf("test_ramp_ratio\n");
+    sim_reset();
+    Beethduino metronome;
+    long double max_deviation = 0;
+
+    for (int beats = 0; beats < RATIO_BEATS_COUNT; beats++)
+    {
+        for (int start = Beethduino::BPM_LOWER_BOUND;
+             start <= Beethduino::BPM_UPPER_BOUND; start++)
+        {
+            for (int target = Beethduino::BPM_LOWER_BOUND;
+                 target <= Beethduino::BPM_UPPER_BOUND; target++)
+            {
+                metronome.ramp_start_bpm = start;
+                metronome.tempo_map_bpm = target;
+
+                long double exact = powl((long double) start / target,
+                                         1.0L / RATIO_BEATS[beats])
+                                    * Beethduino::RAMP_RATIO_ONE;
+                long double deviation = fabsl(
+                    metronome.calculate_ramp_ratio(RATIO_BEATS[beats])
+                    - roundl(exact));
+
+                if (deviation > max_deviation)
+                {
+                    max_deviation = deviation;
+                }
+            }
+        }
+    }
+
+    printf("    max deviation: %.0Lf (of 2^%d)\n", max_deviation,
+           Beethduino::RAMP_RATIO_SHIFT);
+    assert (max_deviation <= 1);
+    printf("\n");
+}
+
+
+/**
+* The program, started by the long pressing of the mute button, is
+* recorded up to TAIL_TICKS after its end. Every beat is compared with the
+* reference (from the first downbeat of its segment), and every downbeat of
+* a segment with the timeline (from the first one); the sub-beats are at
+* floor(i * period / clicks) ticks from their beat.
+*/
+void test_ramp_program(const RampProgram &ramp_program)
+{
+    printf("test_ramp_program: %s\n", ramp_program.name);
+    sim_reset();
+    Beethduino metronome;
+    beethduino = &metronome;
+    configure_beethduino(metronome);
+
+    BeethduinoTempoMap tempo_map;
+    std::vector<TempoSegment> segments;
+    std::vector<long double> beat_times;
+    std::vector<size_t> first_beats;
+    std::vector<unsigned long long> beat_edges_ns;
+    std::vector<unsigned long long> sub_beat_edges_ns;
+
+    bool is_compiled = tempo_map.compile(ramp_program.source);
+    assert (is_compiled == true);
+    tempo_map.expand(metronome.bpm, metronome.time_signature, MAX_SEGMENTS,
+                     segments);
+    metronome.tempo_map = &tempo_map.program[0];
+    metronome.tempo_map_size = tempo_map.program.size();
+
+    while (metronome.clicks_per_beat != ramp_program.clicks_per_beat)
+    {
+        metronome.change_subdivision();
+    }
+
+    const TempoSegment &last = segments.back();
+    unsigned long end_tick = last.start_tick
+        + (unsigned long) floorl(BeethduinoTempoMap::beat_time(
+              last, BeethduinoTempoMap::segment_beats(last)))
+        + TAIL_TICKS;
+    expected_beats(segments, end_tick, beat_times, first_beats);
+
+    rising_edges_ns.clear();
+    falling_edges_ns.clear();
+    sim_set_pin_listener(record_buzzer_edge);
+
+    metronome.perform_operation(metronome.MUTE_BUZZER_BUTTON_PIN,
+                                Beethduino::BUTTON_LONG_PRESSED);
+    assert (metronome.is_tempo_map_running == true);
+    unsigned long long first_beat_ns = sim_time_ns()
+        + metronome.bpm_freq_req_iter * TICK_NS;
+    run_main_loop_until(metronome, first_beat_ns + end_tick * TICK_NS);
+    sim_set_pin_listener(0);
+
+    for (size_t edge = 0; edge < falling_edges_ns.size(); edge++)
+    {
+        if ((falling_edges_ns[edge] - rising_edges_ns[edge])
+            == Beethduino::SUBDIVISION_SOUND_DURATION * TICK_NS)
+        {
+            sub_beat_edges_ns.push_back(rising_edges_ns[edge]);
+        }
+        else
+        {
+            beat_edges_ns.push_back(rising_edges_ns[edge]);
+        }
+    }
+
+    assert (beat_edges_ns.size() + 1 >= beat_times.size());
+    assert (beat_edges_ns.size() <= beat_times.size());
+    assert (beat_edges_ns[0] + TICK_NS > first_beat_ns);
+    assert (beat_edges_ns[0] < first_beat_ns + TICK_NS);
+
+    /* Deviation per beat, from the first downbeat of its segment. */
+    unsigned long max_beat_deviation_ticks = 0;
+    unsigned long max_timeline_deviation_ticks = 0;
+    long double max_exact_deviation_ticks = 0.0L;
+    size_t segment = 0;
+
+    for (size_t beat = 0; beat < beat_edges_ns.size(); beat++)
+    {
+        while (((segment + 1) < first_beats.size())
+               && (beat >= first_beats[segment + 1]))
+        {
+            segment++;
+        }
+
+        size_t first_beat = first_beats[segment];
+        long double origin_time = beat_times[first_beat];
+        long long tick = (beat_edges_ns[beat] - beat_edges_ns[first_beat])
+                         / TICK_NS;
+        long long expected_tick = (long long) floorl(beat_times[beat]
+                                                     - origin_time);
+        long long timeline_tick = (beat_edges_ns[beat] - beat_edges_ns[0])
+                                  / TICK_NS;
+        unsigned long deviation = llabs(tick - expected_tick);
+        unsigned long timeline_deviation
+            = llabs(timeline_tick - (long long) floorl(beat_times[beat]));
+
+        if (deviation > max_beat_deviation_ticks)
+        {
+            max_beat_deviation_ticks = deviation;
+        }
+
+        if (timeline_deviation > max_timeline_deviation_ticks)
+        {
+            max_timeline_deviation_ticks = timeline_deviation;
+        }
+
+        if (fabsl(tick - (beat_times[beat] - origin_time))
+            > max_exact_deviation_ticks)
+        {
+            max_exact_deviation_ticks
+                = fabsl(tick - (beat_times[beat] - origin_time));
+        }
+    }
+
+    /* Sub-beats of every beat with a next beat. */
+    size_t sub_beat = 0;
+
+    for (size_t beat = 0; (beat + 1) < beat_edges_ns.size(); beat++)
+    {
+        unsigned long long period = (beat_edges_ns[beat + 1]
+                                     - beat_edges_ns[beat]) / TICK_NS;
+
+        for (int click = 1; click < ramp_program.clicks_per_beat; click++)
+        {
+            assert (sub_beat < sub_beat_edges_ns.size());
+            assert (sub_beat_edges_ns[sub_beat] - beat_edges_ns[beat]
+                    == ((period * click) / ramp_program.clicks_per_beat)
+                       * TICK_NS);
+            sub_beat++;
+        }
+    }
+
+    printf("    %u segments, %u beats, %u sub-beats\n"
+           "    max deviation per beat: %lu ticks (floor), %.3Lf ticks "
+           "(exact); timeline: %lu ticks\n",
+           (unsigned int) segments.size(),
+           (unsigned int) beat_edges_ns.size(), (unsigned int) sub_beat,
+           max_beat_deviation_ticks, max_exact_deviation_ticks,
+           max_timeline_deviation_ticks);
+
+    assert (max_beat_deviation_ticks <= ramp_program.max_beat_deviation_ticks);
+    assert (max_timeline_deviation_ticks
+            <= ramp_program.max_timeline_deviation_ticks);
+    assert (max_exact_deviation_ticks
+            < ramp_program.max_beat_deviation_ticks + 1);
+
+    /* After the end, the target of the last segment is kept. */
+    assert (metronome.is_tempo_map_running == false);
+    assert (metronome.tempo_ramp == Beethduino::TEMPO_RAMP_NONE);
+    assert (metronome.bpm == last.bpm);
+    assert (metronome.bpm_freq_req_iter
+            == Beethduino::MILLISECONDS_IN_MINUTE / last.bpm);
+    beethduino = 0;
+    printf("\n");
+}
+
+
+/**
+* A short pressing of the BPM button in the middle of a ramp stops it: the
+* BPM is the target plus one, with its exact period.
+*/
+void test_bpm_button_stops_ramp()
+{
+    printf("test_bpm_button_stops_ramp\n");
+    sim_reset();
+    Beethduino metronome;
+    configure_beethduino(metronome);
+
+    BeethduinoTempoMap tempo_map;
+    bool is_compiled = tempo_map.compile("play 60 1\nexponential 8 120\n");
+    assert (is_compiled == true);
+    metronome.tempo_map = &tempo_map.program[0];
+    metronome.tempo_map_size = tempo_map.program.size();
+
+    metronome.perform_operation(metronome.MUTE_BUZZER_BUTTON_PIN,
+                                Beethduino::BUTTON_LONG_PRESSED);
+    run_main_loop_until(metronome, sim_time_ns() + 10 * SIM_NS_IN_S);
+    assert (metronome.tempo_ramp == Beethduino::TEMPO_RAMP_EXPONENTIAL);
+    assert (metronome.tempo_ramp_beats_left != 0);
+    assert (metronome.bpm == 120);
+
+    hold_button_level(metronome, metronome.CHANGE_BPM_BY_ONE_BUTTON_PIN, HIGH,
+                      BUTTON_LEVEL_MS);
+    hold_button_level(metronome, metronome.CHANGE_BPM_BY_ONE_BUTTON_PIN, LOW,
+                      BUTTON_LEVEL_MS);
+    assert (metronome.is_tempo_map_running == false);
+    assert (metronome.tempo_ramp == Beethduino::TEMPO_RAMP_NONE);
+    assert (metronome.tempo_ramp_beats_left == 0);
+    assert (metronome.bpm == 121);
+    assert (metronome.bpm_freq_req_iter
+            == Beethduino::MILLISECONDS_IN_MINUTE / 121);
+    assert (metronome.bpm_freq_divisor == 121);
+
+    run_main_loop_until(metronome, sim_time_ns() + 20 * SIM_NS_IN_S);
+    assert (metronome.bpm_freq_req_iter
+            == Beethduino::MILLISECONDS_IN_MINUTE / 121);
+    printf("\n");
+}
+
+
+/**
+* Exact time of every beat before end_tick (from the first downbeat), and
+* the first beat of every segment. After the last one, its target BPM is
+* kept: from its last downbeat if it is a ramp, or from its first one.
+*/
+void expected_beats(const std::vector<TempoSegment> &segments,
+                    unsigned long end_tick,
+                    std::vector<long double> &beat_times,
+                    std::vector<size_t> &first_beats)
+{
+    std::vector<TempoSegment> timeline = segments;
+    const TempoSegment &last = segments.back();
+
+    if (last.ramp != Beethduino::TEMPO_RAMP_NONE)
+    {
+        BeethduinoTempoMap::append_segment(last.bpm, last.bpm,
+                                           Beethduino::TEMPO_RAMP_NONE,
+                                           last.time_signature, 1, timeline);
+    }
+
+    beat_times.clear();
+    first_beats.clear();
+
+    for (size_t segment = 0; segment < timeline.size(); segment++)
+    {
+        bool is_last = (segment == (timeline.size() - 1));
+        unsigned long beats
+            = BeethduinoTempoMap::segment_beats(timeline[segment]);
+
+        first_beats.push_back(beat_times.size());
+
+        for (unsigned long beat = 0; is_last || (beat < beats); beat++)
+        {
+            long double time = timeline[segment].start_tick
+                + BeethduinoTempoMap::beat_time(timeline[segment], beat);
+
+            if (time >= end_tick)
+            {
+                return;
+            }
+
+            beat_times.push_back(time);
+        }
+    }
+}
+
+
+void __assert(const char *__func, const char *__file,
+              int __lineno, const char *__sexp)
+{
+    printf("TEST_FAILED\n%s\n%s\n%d\n%s\n", __file, __func, __lineno, __sexp);
+    fflush(stdout);
+
+    abort();
+}
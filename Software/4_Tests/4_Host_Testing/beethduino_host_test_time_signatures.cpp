@@ -0,0 +1,264 @@
+/*******************************************************************************
+*   Project:        Beethduino, an Arduino Do-it-yourself electronic metronome.
+*
+*   File:           beethduino_host_test_time_signatures.cpp
+*
+*   Description:    Host (PC) testing of the time signatures and the accented
+*                   downbeat of the Beethduino library, over the Arduino
+*                   simulator. Checks that, for every time signature, only
+*                   the first beat of every bar sounds ACCENT_SOUND_DURATION
+*                   milliseconds, that the accent does not move the beat
+*                   edges, and that the long pressing of the restart button
+*                   selects the next time signature (shown in the LCD)
+*                   without restarting the BPM.
+*
+*   Language:       C++ (host, g++).
+*                   Compiled with CMake (target of the same name), with the
+*                   Arduino_simulator folder and Beethduino.cpp.
+*
+*   Dependencies:   assert.h
+*                   stdio.h
+*                   string.h
+*                   vector
+*                   Arduino_simulator.h
+*                   Beethduino.h
+*                   beethduino_host_test_helpers.h
+*
+*   Notes:          BPM - Beats Per Minute.
+*                   LCD - Liquid Crystal Display.
+*                   The beats are recorded at BPM_UPPER_BOUND, the shortest
+*                   period, where the accent is closest to the next beat.
+*
+*   Author:         Alberto Martin Cajal
+*                   amartin.glimpse23@gmail.com
+*                   amartin<DOT>glimpse23<AT>gmail<DOT>.com
+*
+*   License:        GNU GPL v3.0
+*
+*   URL:            https://github.com/amcajal/beethduino
+*
+*******************************************************************************/
+#define __ASSERT_USE_STDERR
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "Arduino_simulator.h"
+#include "Beethduino.h"
+#include "beethduino_host_test_helpers.h"
+
+const unsigned long long TICK_NS            = SIM_NS_IN_MS;
+const unsigned long BUTTON_LEVEL_MS         = 50;
+const int RECORDED_BARS                     = 3;
+const int TEST_BPM                          = 120;
+
+/******************************************************************************/
+
+
+void execute_tests();
+void test_accented_downbeats();
+void test_long_press_changes_time_signature();
+void test_short_press_restarts_bpm();
+void record_bars(Beethduino &metronome);
+void check_lcd_time_signature(Beethduino &metronome, const char *text);
+void redraw_lcd_after_bpm(Beethduino &metronome);
+
+
+int main()
+{
+    printf("HOST UNIT TESTING STARTED\n******************************\n");
+    printf("%%%%%%Testing: time signatures and accented downbeat\n");
+
+    execute_tests();
+
+    printf("HOST UNIT TESTING FINISHED\n******************************\n");
+    return 0;
+}
+
+
+void execute_tests()
+{
+    test_accented_downbeats();
+    test_long_press_changes_time_signature();
+    test_short_press_restarts_bpm();
+}
+
+
+/**
+* For every time signature, RECORDED_BARS bars at BPM_UPPER_BOUND: the
+* downbeats last ACCENT_SOUND_DURATION ticks, the other beats SOUND_DURATION,
+* and every beat starts exactly one period after the previous one.
+*/
+void test_accented_downbeats()
+{
+    printf("test_accented_downbeats\n");
+
+    for (byte signature = 0; signature < Beethduino::TIME_SIGNATURES_COUNT;
+         signature++)
+    {
+        sim_reset();
+        Beethduino metronome;
+        beethduino = &metronome;
+        configure_beethduino(metronome);
+
+        while (metronome.time_signature != signature)
+        {
+            metronome.change_time_signature();
+        }
+
+        record_bars(metronome);
+
+        int beats = RECORDED_BARS * metronome.beats_per_bar;
+        int accents = 0;
+
+        assert (rising_edges_ns.size() == (size_t) beats);
+        assert (falling_edges_ns.size() == (size_t) beats);
+
+        for (int beat = 0; beat < beats; beat++)
+        {
+            unsigned long long width_ns = falling_edges_ns[beat]
+                                          - rising_edges_ns[beat];
+
+            if ((beat % metronome.beats_per_bar) == 0)
+            {
+                assert (width_ns
+                        == Beethduino::ACCENT_SOUND_DURATION * TICK_NS);
+                accents++;
+            }
+            else
+            {
+                assert (width_ns == Beethduino::SOUND_DURATION * TICK_NS);
+            }
+
+            if (beat > 0)
+            {
+                assert (rising_edges_ns[beat] - rising_edges_ns[beat - 1]
+                        == (Beethduino::MILLISECONDS_IN_MINUTE
+                            / Beethduino::BPM_UPPER_BOUND) * TICK_NS);
+            }
+        }
+
+        assert (accents == RECORDED_BARS);
+        printf("    %s: %d beats, %d accents\n",
+               Beethduino::TIME_SIGNATURES[signature].text, beats, accents);
+        beethduino = 0;
+    }
+
+    printf("\n");
+}
+
+
+/**
+* The long pressing of the restart button selects the next time signature
+* (4/4 to 6/8), and its release does not restart the BPM.
+*/
+void test_long_press_changes_time_signature()
+{
+    printf("test_long_press_changes_time_signature\n");
+    sim_reset();
+    Beethduino metronome;
+    configure_beethduino(metronome);
+    redraw_lcd_after_bpm(metronome);
+    check_lcd_time_signature(metronome, "4/4");
+
+    hold_button_level(metronome, metronome.RESTART_BPM_BUTTON_PIN, HIGH,
+                      Beethduino::BUTTON_LONG_PRESS_TICKS + BUTTON_LEVEL_MS);
+    assert (metronome.time_signature == 3);
+    assert (metronome.beats_per_bar == 6);
+    check_lcd_time_signature(metronome, "6/8");
+
+    hold_button_level(metronome, metronome.RESTART_BPM_BUTTON_PIN, LOW,
+                      BUTTON_LEVEL_MS);
+    assert (metronome.bpm == TEST_BPM);
+    assert (metronome.time_signature == 3);
+    assert (metronome.repeated_button_pins == 0);
+    check_lcd_time_signature(metronome, "6/8");
+    printf("\n");
+}
+
+
+/**
+* The short pressing of the restart button restarts the BPM, and keeps the
+* time signature.
+*/
+void test_short_press_restarts_bpm()
+{
+    printf("test_short_press_restarts_bpm\n");
+    sim_reset();
+    Beethduino metronome;
+    configure_beethduino(metronome);
+    redraw_lcd_after_bpm(metronome);
+
+    hold_button_level(metronome, metronome.RESTART_BPM_BUTTON_PIN, HIGH,
+                      BUTTON_LEVEL_MS);
+    hold_button_level(metronome, metronome.RESTART_BPM_BUTTON_PIN, LOW,
+                      BUTTON_LEVEL_MS);
+    assert (metronome.bpm == 60);
+    assert (metronome.time_signature == Beethduino::DEFAULT_TIME_SIGNATURE);
+    check_lcd_time_signature(metronome, "4/4");
+    printf("\n");
+}
+
+
+/**
+* Unmutes the buzzer at BPM_UPPER_BOUND and records the buzzer edges of
+* RECORDED_BARS bars, with the main loop running.
+*/
+void record_bars(Beethduino &metronome)
+{
+    metronome.bpm = Beethduino::BPM_UPPER_BOUND;
+    metronome.calculate_required_iterations();
+    metronome.change_mute_state();
+
+    unsigned long long period_ns = (Beethduino::MILLISECONDS_IN_MINUTE
+                                    / Beethduino::BPM_UPPER_BOUND) * TICK_NS;
+    unsigned long long end_ns = sim_time_ns()
+                                + RECORDED_BARS * metronome.beats_per_bar
+                                  * period_ns
+                                + period_ns / 2;
+
+    rising_edges_ns.clear();
+    falling_edges_ns.clear();
+    sim_set_pin_listener(record_buzzer_edge);
+    run_main_loop_until(metronome, end_ns);
+    sim_set_pin_listener(0);
+}
+
+
+/**
+* Checks the text of the time signature in the frame and in the shadow of the
+* LCD (after the main loop has sent it).
+*/
+void check_lcd_time_signature(Beethduino &metronome, const char *text)
+{
+    assert (memcmp(&metronome.lcd_frame[1][Beethduino::TIME_SIGNATURE_COLUMN],
+                   text, strlen(text)) == 0);
+    assert (memcmp(
+        &metronome.lcd_shown_frame[1][Beethduino::TIME_SIGNATURE_COLUMN],
+        text, strlen(text)) == 0);
+}
+
+
+/**
+* Sets TEST_BPM and lets the main loop send the whole frame to the LCD.
+*/
+void redraw_lcd_after_bpm(Beethduino &metronome)
+{
+    metronome.bpm = TEST_BPM;
+    metronome.calculate_required_iterations();
+    metronome.update_lcd();
+    run_main_loop_until(metronome,
+                        sim_time_ns() + BUTTON_LEVEL_MS * SIM_NS_IN_MS);
+}
+
+
+void __assert(const char *__func, const char *__file,
+              int __lineno, const char *__sexp)
+{
+    printf("TEST_FAILED\n%s\n%s\n%d\n%s\n", __file, __func, __lineno, __sexp);
+    fflush(stdout);
+
+    abort();
+}
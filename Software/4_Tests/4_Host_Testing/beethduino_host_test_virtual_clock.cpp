@@ -0,0 +1,273 @@
+/*******************************************************************************
+*   Project:        Beethduino, an Arduino Do-it-yourself electronic metronome.
+*
+*   File:           beethduino_host_test_virtual_clock.cpp
+*
+*   Description:    Host (PC) testing of the virtual clock of the Arduino
+*                   simulator, with the Beethduino library. Checks that the
+*                   scheduled pin changes are executed at their exact time,
+*                   that an interrupt triggered while the interrupts are
+*                   disabled is kept pending, that a PORTB write only drives
+*                   its changed pins, and that one hour of beats at
+*                   1 and 300 BPM (buttons pressed with scheduled pin
+*                   changes) is simulated in a fraction of a second, without
+*                   drift.
+*
+*   Language:       C++ (host, g++).
+*                   Compiled with CMake (target of the same name), with the
+*                   Arduino_simulator folder and Beethduino.cpp.
+*
+*   Dependencies:   assert.h
+*                   stdio.h
+*                   chrono
+*                   Arduino_simulator.h
+*                   Beethduino.h
+*                   beethduino_host_test_helpers.h
+*
+*   Notes:          BPM - Beats Per Minute.
+*                   LCD - Liquid Crystal Display.
+*
+*   Author:         Alberto Martin Cajal
+*                   amartin.glimpse23@gmail.com
+*                   amartin<DOT>glimpse23<AT>gmail<DOT>.com
+*
+*   License:        GNU GPL v3.0
+*
+*   URL:            https://github.com/amcajal/beethduino
+*
+*******************************************************************************/
+#define __ASSERT_USE_STDERR
+
+#include <assert.h>
+#include <stdio.h>
+#include <chrono>
+
+#include "Arduino_simulator.h"
+#include "Beethduino.h"
+#include "beethduino_host_test_helpers.h"
+
+const unsigned long MILLISECONDS_IN_HOUR        = 3600000;
+
+const unsigned long long BUTTON_PRESS_NS        = 100 * SIM_NS_IN_MS;
+const unsigned long long BUTTON_INTERVAL_NS     = 200 * SIM_NS_IN_MS;
+
+unsigned long long next_button_press_ns;
+
+/******************************************************************************/
+
+
+void execute_tests();
+void test_scheduled_pin_change();
+void test_pin_change_with_interrupts_disabled();
+void test_delay_without_waiting();
+void test_portb_write();
+void test_one_hour_at_bpm(int target_bpm);
+void schedule_button_press(int pin, int times);
+
+
+int main()
+{
+    printf("HOST UNIT TESTING STARTED\n******************************\n");
+    printf("%%%%%%Testing: Arduino simulator virtual clock\n");
+
+    execute_tests();
+
+    printf("HOST UNIT TESTING FINISHED\n******************************\n");
+    return 0;
+}
+
+
+void execute_tests()
+{
+    test_scheduled_pin_change();
+    test_pin_change_with_interrupts_disabled();
+    test_delay_without_waiting();
+    test_portb_write();
+    test_one_hour_at_bpm(1);
+    test_one_hour_at_bpm(300);
+}
+
+
+/**
+* The pin changes exactly at the scheduled nanosecond, and a change
+* scheduled in the past is executed at once.
+*/
+void test_scheduled_pin_change()
+{
+    printf("test_scheduled_pin_change\n");
+    sim_reset();
+
+    sim_schedule_pin_level(11, HIGH, 1234567);
+    sim_schedule_pin_level(11, LOW, 1234568);
+    assert (sim_scheduled_pin_events() == 2);
+
+    sim_advance_ns(1234566);
+    assert (sim_pin_level(11) == LOW);
+    sim_advance_ns(1);
+    assert (sim_pin_level(11) == HIGH);
+    sim_advance_ns(1);
+    assert (sim_pin_level(11) == LOW);
+    assert (sim_scheduled_pin_events() == 0);
+
+    sim_schedule_pin_level(12, HIGH, 0);
+    sim_advance_ns(0);
+    assert (sim_pin_level(12) == HIGH);
+    printf("\n");
+}
+
+
+/**
+* The pin changes are external: they are executed with the interrupts
+* disabled. The Timer1 interrupts are not: only one is kept pending,
+* and executed when the interrupts are enabled.
+*/
+void test_pin_change_with_interrupts_disabled()
+{
+    printf("test_pin_change_with_interrupts_disabled\n");
+    sim_reset();
+    Beethduino beethduino;
+    beethduino.configure_beat_timer();
+
+    unsigned long ticks_before = beethduino.timer_ticks;
+
+    cli();
+    sim_schedule_pin_level(13, HIGH, sim_time_ns() + 2 * SIM_NS_IN_MS);
+    delay(5);
+    assert (sim_pin_level(13) == HIGH);
+    assert (beethduino.timer_ticks == ticks_before);
+
+    sei();
+    assert (beethduino.timer_ticks == ticks_before + 1);
+
+    delay(1);
+    assert (beethduino.timer_ticks == ticks_before + 2);
+    printf("\n");
+}
+
+
+/**
+* delay() does not wait: one hour is simulated, with one Timer1 interrupt
+* per millisecond.
+*/
+void test_delay_without_waiting()
+{
+    printf("test_delay_without_waiting\n");
+    sim_reset();
+    Beethduino beethduino;
+    beethduino.configure_beat_timer();
+
+    unsigned long start_ms = millis();
+    unsigned long start_interrupts = sim_timer1_interrupts();
+
+    delay(MILLISECONDS_IN_HOUR);
+
+    assert (millis() - start_ms == MILLISECONDS_IN_HOUR);
+    assert (sim_timer1_interrupts() - start_interrupts == MILLISECONDS_IN_HOUR);
+    assert (beethduino.timer_ticks == MILLISECONDS_IN_HOUR);
+    printf("\n");
+}
+
+
+/**
+* The BPM is selected and the buzzer unmuted with button pressings
+* (scheduled pin changes, latched by the pin change interrupt), and then one hour
+* is simulated: the number of beats and the last deadline are exact.
+*/
+/**
+* The buzzer is written through PORTB ("sbi" and "cbi"): only the buzzer pin
+* changes, the button pins written by the test keep their level, and the 
+* write takes SIM_PORT_WRITE_NS, instead of SIM_DIGITAL_WRITE_NS.
+*/
+void test_portb_write()
+{
+    printf("test_portb_write\n");
+    sim_reset();
+    Beethduino beethduino;
+
+    digitalWrite(beethduino.MUTE_BUZZER_BUTTON_PIN, HIGH);
+    assert (PORTB == PortBPin<Beethduino::MUTE_BUZZER_BUTTON_PIN>::BIT);
+
+    unsigned long long start_ns = sim_time_ns();
+    beethduino.play_buzzer();
+    assert (sim_time_ns() - start_ns == SIM_PORT_WRITE_NS);
+    assert (sim_pin_level(beethduino.ACTIVE_BUZZER_PIN) == HIGH);
+    assert (sim_pin_level(beethduino.MUTE_BUZZER_BUTTON_PIN) == HIGH);
+
+    digitalWrite(beethduino.MUTE_BUZZER_BUTTON_PIN, LOW);
+    beethduino.stop_buzzer();
+    assert (sim_pin_level(beethduino.ACTIVE_BUZZER_PIN) == LOW);
+    assert (sim_pin_level(beethduino.MUTE_BUZZER_BUTTON_PIN) == LOW);
+    assert (PORTB == 0);
+    printf("\n");
+}
+
+
+void test_one_hour_at_bpm(int target_bpm)
+{
+    printf("test_one_hour_at_bpm (%d BPM)\n", target_bpm);
+    std::chrono::steady_clock::time_point start
+        = std::chrono::steady_clock::now();
+
+    sim_reset();
+    Beethduino beethduino;
+    beethduino.configure_beat_timer();
+    beethduino.configure_button_interrupts();
+
+    int bpm_difference = target_bpm - beethduino.bpm;
+
+    next_button_press_ns = sim_time_ns() + BUTTON_INTERVAL_NS;
+    if (bpm_difference < 0)
+    {
+        schedule_button_press(beethduino.ADD_OR_SUB_BPM_BUTTON_PIN, 1);
+        bpm_difference = -bpm_difference;
+    }
+    schedule_button_press(beethduino.CHANGE_BPM_BY_TEN_BUTTON_PIN,
+                          bpm_difference / 10);
+    schedule_button_press(beethduino.CHANGE_BPM_BY_ONE_BUTTON_PIN,
+                          bpm_difference % 10);
+    schedule_button_press(beethduino.MUTE_BUZZER_BUTTON_PIN, 1);
+
+    run_main_loop_until(beethduino, next_button_press_ns);
+    assert (beethduino.bpm == target_bpm);
+    assert (beethduino.is_buzzer_muted == false);
+
+    unsigned long first_beat_deadline = beethduino.beat_deadline_tick;
+    int first_beat_bips = beethduino.buzzer_bips;
+
+    delay(MILLISECONDS_IN_HOUR);
+
+    int hour_bips = beethduino.buzzer_bips - first_beat_bips;
+    assert (hour_bips == 60 * target_bpm);
+    assert (beethduino.beat_deadline_tick - first_beat_deadline
+            == MILLISECONDS_IN_HOUR);
+
+    std::chrono::duration<double> elapsed
+        = std::chrono::steady_clock::now() - start;
+    printf("    %d beats in one simulated hour, %.3f s of real time\n",
+           hour_bips, elapsed.count());
+    printf("\n");
+}
+
+
+/**
+* Schedules the pressing and release of a button, the given times.
+*/
+void schedule_button_press(int pin, int times)
+{
+    for (int press = 0; press < times; press++)
+    {
+        sim_schedule_pin_level(pin, HIGH, next_button_press_ns);
+        sim_schedule_pin_level(pin, LOW, next_button_press_ns + BUTTON_PRESS_NS);
+        next_button_press_ns = next_button_press_ns + BUTTON_INTERVAL_NS;
+    }
+}
+
+
+void __assert(const char *__func, const char *__file,
+              int __lineno, const char *__sexp)
+{
+    printf("TEST_FAILED\n%s\n%s\n%d\n%s\n", __file, __func, __lineno, __sexp);
+    fflush(stdout);
+
+    abort();
+}